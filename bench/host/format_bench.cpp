@@ -0,0 +1,46 @@
+// ============================================================================
+// format_bench.cpp
+// Host run of the "format" benchmark (src/Benchmark.cpp benchFormat):
+// FixedPoint::format against snprintf("%.2f") over the same spread of
+// values, printed as the same JSON /bench?name=format returns.
+//
+//   pio run -e native-bench && .pio/build/native-bench/program [n]
+//
+// Host figures only rank the two — on-target timing is /bench?name=format.
+// ============================================================================
+
+#include "FixedPoint.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Keeps the optimiser from discarding the formatted output
+static volatile uint32_t s_sink = 0;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    const int N = argc > 1 ? atoi(argv[1]) : 2000000;
+    char buf[24];
+
+    int64_t t0 = nowNs();
+    for (int i = 0; i < N; i++) {
+        int32_t fixed = (int32_t)((int64_t)i * 7919 % 100000) - 50000;   // ±500.00, 2 decimals
+        s_sink += FixedPoint::format(buf, sizeof(buf), fixed, 2);
+    }
+    int64_t t1 = nowNs();
+    for (int i = 0; i < N; i++) {
+        float f = ((int32_t)((int64_t)i * 7919 % 100000) - 50000) / 100.0f;
+        s_sink += snprintf(buf, sizeof(buf), "%.2f", f);
+    }
+    int64_t t2 = nowNs();
+
+    printf("{\"name\":\"format\",\"n\":%d,\"fixed_us\":%lld,\"printf_us\":%lld,"
+           "\"fixed_ns_per\":%lld,\"printf_ns_per\":%lld}\n",
+           N, (long long)((t1 - t0) / 1000), (long long)((t2 - t1) / 1000),
+           (long long)((t1 - t0) / N), (long long)((t2 - t1) / N));
+    return 0;
+}
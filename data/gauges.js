@@ -74,22 +74,34 @@ function calcTicks(min, max)
 	return ticks;
 }
 
+function updateGauge(name, val)
+{
+	var gauge = gauges[name];
+	if (!gauge) return;
+	gauge.options.minValue = Math.min(gauge.options.minValue, Math.floor(val * 0.7));
+	gauge.options.maxValue = Math.max(gauge.options.maxValue, Math.ceil(val * 1.5));
+	gauge.options.majorTicks = calcTicks(gauge.options.minValue, gauge.options.maxValue);
+	gauge.value = val;
+	gauge.update();
+}
+
 function acquire()
 {
 	if (!items.length) return;
 
+	// Pushed over /ws/spot as values change; polled without WebSockets
+	if (spotStream.open(items, 10, function(changed)
+	{
+		for (var name in changed)
+			updateGauge(name, changed[name]);
+	}))
+		return;
+
 	inverter.getValues(items, 1,
 	function(values) 
 	{
 		for (var name in values)
-		{
-			var val = values[name][0];
-			gauges[name].options.minValue = Math.min(gauges[name].options.minValue, Math.floor(val * 0.7));
-			gauges[name].options.maxValue = Math.max(gauges[name].options.maxValue, Math.ceil(val * 1.5));
-			gauges[name].options.majorTicks = calcTicks(gauges[name].options.minValue, gauges[name].options.maxValue);
-			gauges[name].value = val;
-			gauges[name].update();
-		}
+			updateGauge(name, values[name][0]);
 		acquire();
 	});
 }
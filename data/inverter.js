@@ -73,6 +73,104 @@ var paramsCache = {
     }
 }
 
+/** @brief live spot values pushed over /ws/spot — only what changed, at
+ *  most hz times a second (see SpotStream.h on the device) */
+var spotStream = {
+
+	socket: null,
+	request: null,
+	names: [],      // the subscription, in the device's order
+	values: {},     // name -> latest value
+	stale: {},      // name -> true while stale
+	onUpdate: null,
+
+	/** @brief subscribe to names (an array, or "all") at up to hz pushes/s.
+	 *  onUpdate gets {name: value} of what changed. false when the browser
+	 *  has no WebSockets — poll instead. */
+	open: function(names, hz, onUpdate)
+	{
+		if (!window.WebSocket) return false;
+		spotStream.request = { cmd: "sub", names: names, hz: hz };
+		spotStream.onUpdate = onUpdate;
+		if (spotStream.socket && spotStream.socket.readyState == 1)
+			spotStream.socket.send(JSON.stringify(spotStream.request));
+		else if (!spotStream.socket)
+			spotStream.connect();
+		return true;
+	},
+
+	connect: function()
+	{
+		var proto = location.protocol == "https:" ? "wss://" : "ws://";
+		var ws = new WebSocket(proto + location.host + "/ws/spot");
+		spotStream.socket = ws;
+
+		ws.onopen = function()
+		{
+			ws.send(JSON.stringify(spotStream.request));
+		};
+		ws.onmessage = function(ev)
+		{
+			var msg = JSON.parse(ev.data);
+			if (msg.type == "sub")
+			{
+				spotStream.names = msg.names || [];
+				return;
+			}
+			var changed = {};
+			var v = msg.v || [];
+			for (var i = 0; i + 1 < v.length; i += 2)
+			{
+				var name = spotStream.names[v[i]];
+				spotStream.values[name] = v[i + 1];
+				changed[name] = v[i + 1];
+			}
+			(msg.s || []).forEach(function(i) { spotStream.stale[spotStream.names[i]] = true; });
+			(msg.f || []).forEach(function(i) { delete spotStream.stale[spotStream.names[i]]; });
+			if (spotStream.onUpdate) spotStream.onUpdate(changed);
+		};
+		ws.onclose = function()
+		{
+			spotStream.socket = null;
+			spotStream.names = [];
+			setTimeout(spotStream.connect, 2000);
+		};
+	},
+
+	/** @brief true once a subscription to every value is streaming */
+	hasAll: function()
+	{
+		return spotStream.socket != null && spotStream.socket.readyState == 1 &&
+			spotStream.request.names == "all" && spotStream.names.length > 0;
+	}
+}
+
+/** @brief /spot polled as deltas — every reply carries "_gen", and
+ *  /spot?since=<_gen> returns only what changed after it */
+var spotPoll = {
+
+	gen: null,
+	values: {},
+
+	url: function()
+	{
+		return spotPoll.gen ? "/spot?since=" + encodeURIComponent(spotPoll.gen) : "/spot";
+	},
+
+	/** @brief merge one reply, returns the stale names */
+	merge: function(spot)
+	{
+		if (!spotPoll.gen || spot._full)
+			spotPoll.values = {};
+		for (var name in spot) {
+			if (name.charAt(0) != "_")
+				spotPoll.values[name] = spot[name];
+		}
+		spotPoll.gen = spot._gen || null;
+		return spot._stale || [];
+	}
+}
+
 var inverter = {
 
 	firmwareVersion: 0,
@@ -98,30 +196,39 @@ var inverter = {
 	/** @brief fetch live spot values from /spot and merge into params */
 	fetchSpotValues: function(params, replyFunc)
 	{
-		var spotReq = new XMLHttpRequest();
-		spotReq.onload = function()
+		// Already streaming every value — no request needed
+		if (spotStream.hasAll())
 		{
-			try {
-				var spot = JSON.parse(this.responseText);
-				for (var name in spot) {
-					if (name in params) {
-						params[name].value = spot[name];
-					}
+			for (var name in spotStream.values) {
+				if (name in params) {
+					params[name].value = spotStream.values[name];
+					params[name].stale = name in spotStream.stale;
 				}
-			} catch(ex) {
-				// ignore spot fetch errors — static values still show
 			}
 			paramsCache.setData(params);
 			if (replyFunc) replyFunc(params);
-		};
-		spotReq.onerror = function()
+			return;
+		}
+
+		// MessagePack when the dial offers it (msgpack.js)
+		msgpack.get(spotPoll.url(), function(spot)
+		{
+			var stale = spotPoll.merge(spot);
+			for (var name in spotPoll.values) {
+				if (name in params) {
+					params[name].value = spotPoll.values[name];
+					params[name].stale = stale.indexOf(name) >= 0;
+				}
+			}
+			paramsCache.setData(params);
+			if (replyFunc) replyFunc(params);
+		},
+		function()
 		{
 			// spot endpoint failed — still call replyFunc with static values
 			paramsCache.setData(params);
 			if (replyFunc) replyFunc(params);
-		};
-		spotReq.open("GET", "/spot", true);
-		spotReq.send();
+		});
 	},
 
 	/** @brief get the params from the inverter */
@@ -129,11 +236,12 @@ var inverter = {
 	{
 		var cmd = includeHidden ? "json hidden" : "json";
 
-		inverter.sendCmd(cmd, function(reply) {
+		var process = function(reply) {
 			var params = {};
 			try
 			{
-				params = JSON.parse(reply);
+				if (reply instanceof Error) throw reply;
+				params = reply;
 
 				for (var name in params)
 				{
@@ -158,7 +266,10 @@ var inverter = {
 			}
 			// Fetch live spot values and merge before calling replyFunc
 			inverter.fetchSpotValues(params, replyFunc);
-		});
+		};
+
+		// The schema as MessagePack when the dial offers it (msgpack.js)
+		msgpack.get("/cmd?cmd=" + cmd, process, process);
 	},
 
 	getValues: function(items, repeat, replyFunc)
@@ -0,0 +1,163 @@
+/*
+ * MessagePack decoding for the dial's content-negotiated APIs
+ *
+ * /cmd?cmd=json, /spot, /faults and /log answer "Accept: application/msgpack"
+ * with the same data as MessagePack (include/MsgPack.h). msgpack.get() and
+ * msgpack.fetch() ask for it and fall back to the JSON (or CSV) reply an
+ * older firmware sends, so callers only deal with decoded values.
+ *
+ * Fractional values arrive as float32 where that holds their digits; they
+ * are rounded back to 7 significant digits, so 12.34 reads as 12.34 and not
+ * 12.340000152587891.
+ */
+
+var msgpack = {
+
+	mime: "application/msgpack",
+	accept: "application/msgpack, application/json;q=0.9, */*;q=0.5",
+
+	/** @brief decode one MessagePack value from an ArrayBuffer or Uint8Array */
+	decode: function(buffer)
+	{
+		var bytes = buffer instanceof Uint8Array ? buffer : new Uint8Array(buffer);
+		var view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+		var utf8 = new TextDecoder("utf-8");
+		var pos = 0;
+
+		function str(len)
+		{
+			var s = utf8.decode(bytes.subarray(pos, pos + len));
+			pos += len;
+			return s;
+		}
+
+		function bin(len)
+		{
+			var b = bytes.slice(pos, pos + len);
+			pos += len;
+			return b;
+		}
+
+		function array(len)
+		{
+			var a = new Array(len);
+			for (var i = 0; i < len; i++)
+				a[i] = value();
+			return a;
+		}
+
+		function map(len)
+		{
+			var m = {};
+			for (var i = 0; i < len; i++) {
+				var key = value();
+				m[key] = value();
+			}
+			return m;
+		}
+
+		function value()
+		{
+			if (pos >= bytes.length)
+				throw new Error("msgpack: truncated");
+			var b = bytes[pos++];
+			var v;
+
+			if (b < 0x80) return b;                          // positive fixint
+			if (b < 0x90) return map(b & 0x0f);
+			if (b < 0xa0) return array(b & 0x0f);
+			if (b < 0xc0) return str(b & 0x1f);
+			if (b >= 0xe0) return b - 0x100;                 // negative fixint
+
+			switch (b)
+			{
+			case 0xc0: return null;
+			case 0xc2: return false;
+			case 0xc3: return true;
+			case 0xc4: v = view.getUint8(pos);  pos += 1; return bin(v);
+			case 0xc5: v = view.getUint16(pos); pos += 2; return bin(v);
+			case 0xc6: v = view.getUint32(pos); pos += 4; return bin(v);
+			case 0xca:
+				v = view.getFloat32(pos); pos += 4;
+				return parseFloat(v.toPrecision(7));
+			case 0xcb: v = view.getFloat64(pos); pos += 8; return v;
+			case 0xcc: v = view.getUint8(pos);  pos += 1; return v;
+			case 0xcd: v = view.getUint16(pos); pos += 2; return v;
+			case 0xce: v = view.getUint32(pos); pos += 4; return v;
+			case 0xcf:
+				v = view.getUint32(pos) * 4294967296 + view.getUint32(pos + 4);
+				pos += 8;
+				return v;
+			case 0xd0: v = view.getInt8(pos);  pos += 1; return v;
+			case 0xd1: v = view.getInt16(pos); pos += 2; return v;
+			case 0xd2: v = view.getInt32(pos); pos += 4; return v;
+			case 0xd3:
+				v = view.getInt32(pos) * 4294967296 + view.getUint32(pos + 4);
+				pos += 8;
+				return v;
+			case 0xd9: v = view.getUint8(pos);  pos += 1; return str(v);
+			case 0xda: v = view.getUint16(pos); pos += 2; return str(v);
+			case 0xdb: v = view.getUint32(pos); pos += 4; return str(v);
+			case 0xdc: v = view.getUint16(pos); pos += 2; return array(v);
+			case 0xdd: v = view.getUint32(pos); pos += 4; return array(v);
+			case 0xde: v = view.getUint16(pos); pos += 2; return map(v);
+			case 0xdf: v = view.getUint32(pos); pos += 4; return map(v);
+			}
+			throw new Error("msgpack: unsupported type 0x" + b.toString(16));
+		}
+
+		return value();
+	},
+
+	/** @brief true when a reply (XMLHttpRequest or fetch Response) is MessagePack */
+	is: function(reply)
+	{
+		var type = reply.headers && reply.headers.get ?
+			reply.headers.get("Content-Type") : reply.getResponseHeader("Content-Type");
+		return (type || "").indexOf(msgpack.mime) == 0;
+	},
+
+	/** @brief GET url asking for MessagePack; replyFunc gets the decoded
+	 *  value, or the parsed JSON when the dial sent that instead */
+	get: function(url, replyFunc, errorFunc)
+	{
+		var xhr = new XMLHttpRequest();
+		xhr.responseType = "arraybuffer";
+		xhr.onload = function()
+		{
+			var data;
+			try {
+				data = msgpack.is(xhr) ? msgpack.decode(xhr.response) :
+					JSON.parse(new TextDecoder("utf-8").decode(xhr.response));
+			} catch(ex) {
+				if (errorFunc) errorFunc(ex);
+				return;
+			}
+			replyFunc(data);
+		};
+		xhr.onerror = function()
+		{
+			if (errorFunc) errorFunc(new Error("request failed"));
+		};
+		xhr.open("GET", url, true);
+		xhr.setRequestHeader("Accept", msgpack.accept);
+		xhr.send();
+	},
+
+	/** @brief fetch() asking for MessagePack — read the reply with read() */
+	fetch: function(url, init)
+	{
+		init = init || {};
+		init.headers = init.headers || {};
+		init.headers["Accept"] = msgpack.accept;
+		return window.fetch(url, init);
+	},
+
+	/** @brief decoded MessagePack, or the JSON the dial sent instead */
+	read: function(response)
+	{
+		if (msgpack.is(response))
+			return response.arrayBuffer().then(msgpack.decode);
+		return response.json();
+	}
+};
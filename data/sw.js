@@ -1,10 +1,53 @@
-// Self-unregistering service worker.
-// Removes itself and clears all caches so no old SW can interfere.
-self.addEventListener('install', () => self.skipWaiting());
+// Service worker — precaches the web bundle built into the firmware.
+//
+// /assets.json names the bundle and every URL in it. Assets are listed with
+// their content hash (?v=), so a cached copy of one of those is good for
+// ever and is answered from the cache. Pages are listed plain: they are
+// fetched from the network and fall back to the cache (then offline.html)
+// when the dial is out of reach. API requests are never touched.
+//
+// A firmware with a different bundle installs a new cache and the old one
+// is dropped on activate.
+
+const MANIFEST = '/assets.json';
+const PREFIX   = 'zv-web-';
+
+function loadManifest() {
+  return fetch(MANIFEST, { cache: 'no-cache' }).then(r => r.json());
+}
+
+self.addEventListener('install', event => {
+  event.waitUntil(
+    loadManifest()
+      .then(m => caches.open(PREFIX + m.bundle).then(c => c.addAll(m.assets)))
+      .then(() => self.skipWaiting())
+  );
+});
+
 self.addEventListener('activate', event => {
   event.waitUntil(
-    caches.keys()
-      .then(keys => Promise.all(keys.map(k => caches.delete(k))))
-      .then(() => self.registration.unregister())
+    loadManifest()
+      .then(m => caches.keys().then(keys => Promise.all(
+        keys.filter(k => k !== PREFIX + m.bundle).map(k => caches.delete(k)))))
+      .catch(() => {})
+      .then(() => self.clients.claim())
   );
 });
+
+self.addEventListener('fetch', event => {
+  const req = event.request;
+  if (req.method !== 'GET') return;
+  const url = new URL(req.url);
+  if (url.origin !== self.location.origin) return;
+
+  if (url.searchParams.has('v')) {
+    // Pinned asset — the cached copy cannot be out of date
+    event.respondWith(caches.match(req).then(hit => hit || fetch(req)));
+  } else if (req.mode === 'navigate') {
+    event.respondWith(
+      fetch(req).catch(() =>
+        caches.match(req, { ignoreSearch: true })
+          .then(hit => hit || caches.match('/offline.html')))
+    );
+  }
+});
@@ -131,6 +131,8 @@ var ui = {
 			}
 		});
 
+		// Spot values stream in over /ws/spot; the table refresh reads them
+		spotStream.open("all", 1);
 		ui.updateTables();
 		plot.generateChart();
 		ui.parameterDatabaseCheckForUpdates();
@@ -308,6 +310,12 @@ var ui = {
 					sr.style.borderLeft = '3px solid ' + sc;
 					sr.cells[1].style.color = sc;
 					sr.cells[1].style.fontWeight = '500';
+					// Value stopped updating on the dial — show last value greyed out
+					if (param.stale)
+					{
+						sr.style.opacity = '0.45';
+						sr.title = 'stale — no recent update';
+					}
 				}
 			}
       ui.populateVersion();
@@ -0,0 +1,119 @@
+#pragma once
+// ============================================================================
+// BMSCells.h
+// Per-cell BMS voltage engine — configurable frame layout, incremental pack
+// statistics and per-cell trend slopes.
+//
+// Cell frames are described by a BMSLayout stored in NVS ("bmscfg"):
+//   SEQUENTIAL: each range is `frames` consecutive IDs from baseId, each frame
+//               carrying cellsPerFrame 16-bit mV values
+//   MUXED:      each range is one ID; byte 0 selects the group, followed by
+//               up to 3 16-bit mV values
+// CANDataManager never routes IDs it decodes itself (IVT-S, SDO, PDO, ...)
+// here, so a layout overlapping them cannot swallow those frames.
+//
+// Statistics are maintained as each cell is written — running sum/sum² for
+// mean and stddev, and a min/max tournament tree for the extreme cells — so
+// no update or read ever rescans the pack.
+// ============================================================================
+
+#include <Arduino.h>
+
+#define BMS_MAX_CELLS          256
+#define BMS_MAX_RANGES         4
+#define BMS_SLOPE_INTERVAL_MS  10000   // trend sample spacing per cell
+
+enum class BMSType : uint8_t {
+    OFF        = 0,   // cell frames ignored
+    SEQUENTIAL = 1,   // consecutive IDs, cellsPerFrame cells each
+    MUXED      = 2,   // one ID, byte 0 = group index, up to 3 cells
+};
+
+struct BMSRange {
+    uint16_t baseId;
+    uint16_t frames;      // SEQUENTIAL: ID count, MUXED: group count
+    uint16_t firstCell;   // cell index of the first value in this range
+};
+
+struct BMSLayout {
+    BMSType  type;
+    uint8_t  cellsPerFrame;   // 1-4 (SEQUENTIAL) / 1-3 (MUXED)
+    bool     bigEndian;
+    uint8_t  rangeCount;
+    BMSRange ranges[BMS_MAX_RANGES];
+};
+
+struct BMSStats {
+    uint16_t count;        // cells that have reported
+    uint16_t minMv;
+    uint16_t maxMv;
+    uint16_t minIdx;
+    uint16_t maxIdx;
+    uint16_t deltaMv;
+    int32_t  meanDmv;      // mean, 0.1 mV
+    int32_t  stddevDmv;    // population stddev, 0.1 mV
+    int16_t  meanSlope;    // mean trend, 0.1 mV/min
+};
+
+class BMSCells {
+public:
+    BMSCells();
+
+    void begin();                        // load layout from NVS
+    void loadFromNVS();
+    void saveToNVS();
+
+    const BMSLayout& getLayout() const { return _layout; }
+    void setLayout(const BMSLayout& layout);   // validates, clears cells
+
+    // Layout change from another task (web server) — applied and saved to
+    // NVS by applyPending(), called from CANDataManager::update()
+    void requestLayout(const BMSLayout& layout) { _pending = layout; _pendingSet = true; }
+    void applyPending();
+    static BMSLayout defaultLayout();
+
+    // Returns true if the frame belongs to the cell layout and was consumed
+    bool handleFrame(uint32_t id, const uint8_t* data, uint8_t len, uint32_t now);
+
+    void reset();
+
+    // Per-cell access
+    uint16_t getCellCount() const { return _highCell; }   // highest index seen + 1
+    uint16_t getVoltage(uint16_t cell) const     { return cell < BMS_MAX_CELLS ? _mv[cell] : 0; }
+    uint32_t getLastUpdate(uint16_t cell) const  { return cell < BMS_MAX_CELLS ? _updated[cell] : 0; }
+    int16_t  getSlope(uint16_t cell) const       { return cell < BMS_MAX_CELLS ? _slope[cell] : 0; }  // 0.1 mV/min
+
+    BMSStats getStats() const;
+
+private:
+    BMSLayout _layout;
+    BMSLayout _pending;
+    volatile bool _pendingSet;
+
+    uint16_t _mv[BMS_MAX_CELLS];
+    uint32_t _updated[BMS_MAX_CELLS];
+    bool     _valid[BMS_MAX_CELLS];
+    uint16_t _highCell;
+    uint16_t _count;
+
+    // Running sums over valid cells
+    int64_t  _sum;
+    int64_t  _sumSq;
+
+    // Tournament trees: node n holds the cell index of the min/max below it,
+    // leaves at BMS_MAX_CELLS + cell
+    uint16_t _minTree[2 * BMS_MAX_CELLS];
+    uint16_t _maxTree[2 * BMS_MAX_CELLS];
+
+    // Trend: EMA (mV × 16) sampled every BMS_SLOPE_INTERVAL_MS
+    int32_t  _emaQ[BMS_MAX_CELLS];
+    int32_t  _anchorQ[BMS_MAX_CELLS];
+    uint32_t _anchorTime[BMS_MAX_CELLS];
+    int16_t  _slope[BMS_MAX_CELLS];
+    int32_t  _slopeSum;
+
+    void setCell(uint16_t cell, uint16_t mv, uint32_t now);
+    void updateTrees(uint16_t cell);
+    uint16_t pickMin(uint16_t a, uint16_t b) const;
+    uint16_t pickMax(uint16_t a, uint16_t b) const;
+};
@@ -0,0 +1,21 @@
+#pragma once
+// ============================================================================
+// Benchmark.h
+// On-target micro-benchmarks, reachable over HTTP at GET /bench?name=<case>.
+//
+// Each case runs synchronously and returns a small JSON object with its
+// timings (µs from esp_timer). GET /bench with no name lists the cases.
+// Cases are registered in the static table in Benchmark.cpp — add a row and
+// a function there for each new hot path worth measuring.
+// ============================================================================
+
+#include <Arduino.h>
+
+class Benchmark {
+public:
+    // Run the named case; returns JSON. Unknown names return {"error":...}.
+    static String run(const String& name);
+
+    // JSON array of registered case names
+    static String list();
+};
@@ -0,0 +1,147 @@
+#pragma once
+// ============================================================================
+// CANBridge.h
+// Network CAN bridges — all fed from FrameHistory.
+//
+// Every bridge reads the bus from the same place, the history ring, with
+// its own cursor (a bus seq), and encodes straight from the ring slot into
+// the outgoing buffer. Nothing copies frames per bridge or per client. One
+// "CANBridge" task on core 0 pumps every running bridge every
+// CAN_BRIDGE_PUMP_MS; commands and transmit requests arrive on async_tcp /
+// async_udp and go out through CANTxScheduler as PLAYBACK.
+//
+//   GVRETServer       TCP 23      SavvyCAN (GVRET binary)
+//   SLCANServer       TCP 3333    Lawicel / SLCAN ASCII — python-can, cangaroo
+//   CannelloniBridge  UDP 20000   cannelloni datagrams — encoded once per
+//                                 batch and sent to every peer
+//
+// TcpBridge is what the TCP protocols share: AsyncTCP accept, a cursor per
+// client, the client's TCP send buffer as its bounded queue, skip-ahead
+// once a client is CAN_BRIDGE_MAX_LAG frames behind, and per-client stats.
+// A protocol supplies its command parser (async_tcp) and frame encoder
+// (bridge task).
+//
+// Each encoder is also a static function of its class, so the "bridges"
+// benchmark can compare bytes and CPU per frame across protocols. GET
+// /bridges reports every bridge with its clients or peers.
+// ============================================================================
+
+#include <Arduino.h>
+#include <atomic>
+#include "FrameHistory.h"
+
+class AsyncServer;
+class AsyncClient;
+class AsyncWebServer;
+class JsonWriter;
+
+#define CAN_BRIDGE_MAX          4       // bridges the task pumps
+#define CAN_BRIDGE_PUMP_MS      10      // encode pass every 10ms
+#define CAN_BRIDGE_MAX_CLIENTS  4       // per TCP bridge
+#define CAN_BRIDGE_CHUNK        1024    // bytes handed to AsyncTCP per add()
+#define CAN_BRIDGE_MAX_LAG      2048    // frames behind the bus before skipping ahead
+
+class CANBridge {
+public:
+    virtual ~CANBridge() {}
+
+    // loopTask — with the WiFi AP
+    virtual void begin() = 0;
+    virtual void stop() = 0;
+
+    // This bridge as one JSON object for GET /bridges, in statsItems()
+    // pieces of at most JSON_ITEM_MAX bytes. A piece with nothing to say
+    // (a free client slot) renders nothing.
+    virtual uint8_t statsItems() const = 0;
+    virtual void statsItem(JsonWriter& w, uint8_t n) = 0;
+
+    // GET /bridges
+    static void registerEndpoints(AsyncWebServer* server);
+
+protected:
+    explicit CANBridge(const char* name) : _name(name) {}
+
+    // Bridge task — move cursors forward
+    virtual void pump() = 0;
+
+    // Put this bridge on the pump list; the task starts with the first one
+    void attach();
+
+    // A BridgeClientStats / peer address as a dotted-quad string value
+    static void valueIp(JsonWriter& w, uint32_t ip);
+
+    const char*   _name;
+    volatile bool _running = false;
+
+private:
+    class StatsBody;
+    static void taskEntry(void* arg);
+};
+
+// Per-client delivery figures — written by the bridge task, read unlocked
+// by /bridges
+struct BridgeClientStats {
+    uint32_t ip;
+    uint32_t connectedMs;
+    uint32_t sentFrames;
+    uint32_t droppedFrames;   // skipped: over CAN_BRIDGE_MAX_LAG or overwritten
+    uint32_t sentBytes;
+    uint32_t stalls;          // passes that found the send buffer full
+    uint32_t lagFrames;       // cursor distance behind the bus at the last pass
+    uint32_t rateBps;         // bytes/s over the last second
+    uint32_t rateMs;
+    uint32_t rateBytes;
+};
+
+class TcpBridge : public CANBridge {
+public:
+    void begin() override;
+    void stop() override;
+    uint8_t statsItems() const override { return CAN_BRIDGE_MAX_CLIENTS + 2; }
+    void statsItem(JsonWriter& w, uint8_t n) override;
+    bool hasClients() const;
+
+protected:
+    TcpBridge(const char* name, uint16_t port, uint8_t recordMax)
+        : CANBridge(name), _port(port), _recordMax(recordMax) {}
+
+    // One connection. Parser fields belong to async_tcp, the cursor to the
+    // bridge task; `gone` hands the object back for freeing.
+    struct Client {
+        AsyncClient*      tcp;
+        TcpBridge*        owner;
+        uint8_t           slot;
+        std::atomic<bool> gone { false };
+        volatile bool     streaming;     // protocol gate — false holds the cursor at head
+        volatile bool     timestamps;    // protocol option (SLCAN Z1)
+        uint32_t          cursor;        // next FrameHistory seq to send
+        uint8_t           state;         // parser
+        uint8_t           cmd;
+        uint8_t           buf[32];
+        uint8_t           bufLen;
+        uint8_t           need;
+    };
+
+    // async_tcp — bytes from the client
+    virtual void onData(Client& c, const uint8_t* data, size_t len) = 0;
+    // Bridge task — one frame into out (room for recordMax bytes)
+    virtual size_t encode(Client& c, const HistoryFrame& f, uint8_t* out) = 0;
+    // async_tcp — whether a new client streams before asking to
+    virtual bool streamsOnConnect() const { return true; }
+
+    // Reply on async_tcp, between frame chunks (which hold whole records)
+    void reply(Client& c, const void* data, size_t len);
+
+    void pump() override;
+
+private:
+    void onConnect(AsyncClient* tcp);
+    void pumpClient(Client& c, BridgeClientStats& st);
+
+    uint16_t             _port;
+    uint8_t              _recordMax;
+    AsyncServer*         _server = nullptr;
+    std::atomic<Client*> _clients[CAN_BRIDGE_MAX_CLIENTS] {};
+    BridgeClientStats    _stats[CAN_BRIDGE_MAX_CLIENTS] {};
+    uint8_t              _chunk[CAN_BRIDGE_CHUNK];   // bridge task only
+};
@@ -4,21 +4,102 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <functional>
+#include <atomic>
 #include "Config.h"
 #include "SDOManager.h"
+#include "CANTxScheduler.h"
+#include "FixedPoint.h"
+#include "TimerWheel.h"
+#include "BMSCells.h"
+
+// Consistent copy of a parameter's live fields — see CANParameter::snapshot()
+struct ParamSnapshot {
+    int32_t  valueInt;
+    uint32_t lastUpdateTime;
+    uint32_t changeCount;
+    uint32_t gen;
+    bool     stale;
+    bool     received;
+};
 
 // CAN Parameter structure
+//
+// The live fields (valueInt, lastUpdateTime, changeCount, gen, stale, received) are written
+// from three tasks — loopTask (CAN broadcasts, setParameter), the SDO task on
+// core 0 (result callback) and async_tcp (/cmd set) — and read from all of
+// them. Writes go through store(), which brackets them with a per-parameter
+// sequence counter (odd while a write is in progress). Readers that need the
+// value and its timestamp together take a snapshot() and retry if the counter
+// moved; writers never wait on readers.
 struct CANParameter {
     uint16_t id;
     char name[32];
+    uint8_t  nameLen;    // strlen(name) — JSON writers emit the key without a scan
     bool editable;
     bool fromBroadcast;  // true = value comes from CAN broadcast, skip SDO polling
+    FixedScale scale;    // raw → fixed-point descriptor, applied once at ingest
 
-    int32_t valueInt;
+    int32_t valueInt;    // fixed-point: engineering value × 10^scale.decimals
     uint32_t lastUpdateTime;
+    uint32_t changeCount;  // bumped only when valueInt actually changes
+    uint16_t periodMs;     // expected update period — configured or learned (0 = unknown)
+    bool     periodFixed;  // period came from params.json, don't learn
+    bool     stale;        // missed its expected updates — set by the stale timer wheel
+    uint32_t gen;          // updateGen of the last value change or stale flip
+    bool     received;     // a value came off the bus (CAN broadcast, SDO reply)
+                           // since params.json was loaded — not just its default
+
+    std::atomic<uint32_t> seq;  // seqlock counter — odd while store() is writing
+
+    // Table-wide write tracking for CANDataManager::snapshotAll()
+    static std::atomic<uint32_t> tableVersion;  // bumped by every completed store()
+    static std::atomic<uint32_t> tableWriters;  // store() calls in progress, all params
+    // Table-wide change generation for /spot?since= — bumped, and stamped
+    // into `gen`, whenever a value changes or a stale flag flips. Read it
+    // before a snapshot: anything stamped later is in the next delta.
+    static std::atomic<uint32_t> updateGen;
+    void stampGen() { gen = updateGen.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+    // Copy a name from params.json — truncated, and any character a JSON
+    // key would need escaped replaced by '_'
+    void setName(const char* n);
 
-    void setValue(int32_t val) { valueInt = val; lastUpdateTime = millis(); }
-    int32_t getValueAsInt() { return valueInt; }
+    // A value off the bus — the CAN and SDO ingest paths
+    void setFixed(int32_t fixed) { store(fixed, millis(), true); }
+    // A value the dial holds without the VCU having sent it (params.json
+    // default, local echo of a write) — leaves `received` as it is
+    void setLocal(int32_t fixed) { store(fixed, millis(), false); }
+    // Seqlocked write of value + timestamp — `now` is explicit for the stress test
+    void store(int32_t fixed, uint32_t now, bool fromBus = true);
+    // Consistent read of the live fields. Returns false only if writers kept
+    // the counter moving for every retry; `out` then holds a best-effort copy.
+    bool snapshot(ParamSnapshot& out) const;
+    // Stale timer: set the flag under the counter if there has still been no
+    // update within `timeout` ms. Returns true when the flag went false → true.
+    bool markStale(uint32_t timeout);
+
+    void notePeriod(uint32_t dt) {
+        if (dt > 0xFFFF) dt = 0xFFFF;
+        periodMs = periodMs ? (uint16_t)((periodMs * 7u + dt) / 8u) : (uint16_t)dt;
+    }
+    // Whole engineering units (gear index, °C, rpm ...)
+    void setValue(int32_t val) { setFixed(val * FixedPoint::pow10(scale.decimals)); }
+    // Raw wire value (SDO ×32 etc.) — scaled through the descriptor
+    void setRaw(int32_t raw) { setFixed(FixedPoint::fromRaw(raw, scale)); }
+    // Value given as num/div units, e.g. IVT-S mV → setRatio(mv, 1000)
+    void setRatio(int32_t num, int32_t div) { setFixed(FixedPoint::fromRatio(num, div, scale.decimals)); }
+
+    int32_t getValueAsInt() const { return valueInt / FixedPoint::pow10(scale.decimals); }
+    int32_t getValueFixed() const { return valueInt; }
+    uint8_t getDecimals()   const { return scale.decimals; }
+    float   getValueAsFloat() const { return (float)valueInt / FixedPoint::pow10(scale.decimals); }
+
+    size_t format(char* out, size_t cap) const {
+        return FixedPoint::format(out, cap, valueInt, scale.decimals);
+    }
+    size_t format(char* out, size_t cap, uint8_t outDecimals) const {
+        return FixedPoint::format(out, cap, valueInt, scale.decimals, outDecimals);
+    }
 };
 
 // CAN Message structure
@@ -29,6 +110,14 @@ struct CANMessage {
     uint32_t timestamp;
 };
 
+// One entry of a change batch delivered to a subscriber
+struct ParamChange {
+    const CANParameter* param;
+    int32_t oldFixed;    // last value delivered to this subscriber
+    int32_t newFixed;    // current value (same fixed-point scale)
+    bool    stale;       // current staleness — a flip alone also triggers delivery
+};
+
 // Result of fetchParamsFromVCU
 enum class FetchResult {
     SUCCESS,
@@ -37,6 +126,16 @@ enum class FetchResult {
     CAN_ERROR
 };
 
+// One end of the params schema upload — the TWAI bus for fetchParamsFromVCU,
+// an in-memory VCU for the "fetch" benchmark
+class SdoLink {
+public:
+    virtual bool send(const uint8_t* data8) = 0;
+    virtual bool receive(twai_message_t* frame, uint32_t timeoutMs) = 0;
+protected:
+    ~SdoLink() {}
+};
+
 // CAN Data Manager
 class CANDataManager {
 public:
@@ -48,12 +147,25 @@ public:
 
     FetchResult fetchParamsFromVCU();
 
+    // Segmented SDO upload of index 0x5001 (the params schema) into `out`.
+    // The transfer is lock-step — one request per response — so it sends
+    // under FETCH_TX_SOURCE, which is not rate limited; a 30 KB schema is
+    // over 4000 requests.
+    static const TxSource FETCH_TX_SOURCE = TxSource::SAFETY_SDO;
+    static FetchResult sdoUpload(SdoLink& link, String& out);
+
     // Parameter management
     bool loadParametersFromJSON(const char* jsonString);
+    // /params.msgpack from a params.json — served to clients that ask for
+    // MessagePack (MsgPack.h). fetchParamsFromVCU writes it as well.
+    static bool saveParamsMsgPack(const char* jsonString, size_t len);
     CANParameter* getParameter(uint16_t id);
     CANParameter* getParameterByName(const char* name);
     CANParameter* getParameterByIndex(uint8_t index);
+    const CANParameter* getParameters() const { return parameters; }   // index order
     uint16_t getParameterCount() { return parameterCount; }
+    // Bumped whenever the table is reloaded — indices from before are void
+    uint32_t getParamsGeneration() const { return paramsGeneration; }
 
     // CAN communication
     void requestParameter(uint16_t paramId);
@@ -63,14 +175,22 @@ public:
     // Save all parameters to VCU flash
     void saveToFlash() { sdoManager.requestSaveFlash(); }
 
+    // Staleness — params that missed STALE_PERIOD_FACTOR expected updates
+    uint32_t getStaleTimeoutMs(const CANParameter& p) const;
+    uint16_t getStaleCount() const;
+
     // Connection status
     bool isConnected() { return connected; }
     uint32_t getLastMessageTime() { return lastMessageTime; }
 
-    // BMS cell voltage access
-    uint16_t getCellVoltage(uint8_t cellIndex);
-    uint8_t getCellCount() { return bmsCellCount; }
-    uint32_t getCellLastUpdate(uint8_t cellIndex);
+    // BMS cell voltage access — layout, statistics and trends live in BMSCells
+    uint16_t getCellVoltage(uint16_t cellIndex)    { return bmsCells.getVoltage(cellIndex); }
+    uint16_t getCellCount()                        { return bmsCells.getCellCount(); }
+    uint32_t getCellLastUpdate(uint16_t cellIndex) { return bmsCells.getLastUpdate(cellIndex); }
+    BMSCells& getBMSCells() { return bmsCells; }
+
+    // IDs decoded by CANDataManager itself — never routed to the BMS layout
+    static bool isReservedId(uint32_t id);
 
     // SDO statistics
     uint32_t getSDOSuccessCount()  { return sdoManager.getSuccessCount(); }
@@ -86,12 +206,35 @@ public:
     void onSDOResult(const SDOResult& result);
 
     // -----------------------------------------------------------------------
-    // Optional raw frame observer — called for every received CAN frame
-    // before processing. Used by GVRETServer to stream frames to SavvyCAN.
-    // Register once in setup(); zero overhead when no callback is set.
+    // Change subscriptions — consumers register the params they care about
+    // instead of re-reading them every loop. dispatchChanges() runs in the
+    // caller's context and hands each subscriber one batch holding only the
+    // params that moved by more than their deadband, crossed a threshold or
+    // went stale / fresh again.
+    // Params whose changeCount has not moved cost one compare per watch.
+    //
+    // Watches are bound by name and re-resolved after loadParametersFromJSON,
+    // so they may be registered before the parameter list exists. The first
+    // dispatch after a watch resolves delivers the current value with
+    // oldFixed == newFixed.
     // -----------------------------------------------------------------------
-    using FrameObserver = std::function<void(uint32_t id, bool extd, const uint8_t* data, uint8_t dlc)>;
-    void setFrameObserver(FrameObserver obs) { _frameObserver = obs; }
+    using ChangeHandler = std::function<void(const ParamChange* changes, uint8_t count)>;
+    static const int32_t NO_THRESHOLD = INT32_MIN;
+
+    // Returns a subscriber id, or -1 when all MAX_CHANGE_SUBSCRIBERS are taken
+    int8_t subscribe(ChangeHandler handler);
+    // deadband/threshold are in the param's fixed-point units (see getDecimals).
+    // `name` must outlive the watch — pass a string literal.
+    bool watch(int8_t sub, const char* name, int32_t deadband = 0,
+               int32_t threshold = NO_THRESHOLD);
+    void dispatchChanges();           // every subscriber, in registration order
+    void dispatchChanges(int8_t sub); // one subscriber — for other task contexts
+
+    // Consistent copy of the first `cap` parameters' live fields, in index
+    // order. True when no store() overlapped the copy anywhere in the table;
+    // after SEQLOCK_TABLE_RETRIES busy passes it falls back to per-parameter
+    // snapshots (each consistent on its own) and returns false.
+    bool snapshotAll(ParamSnapshot* out, uint16_t cap, uint16_t& count) const;
 
 private:
     CANParameter parameters[MAX_PARAMETERS];
@@ -102,37 +245,49 @@ private:
     static void sdoResultCallback(const SDOResult& result);
     static CANDataManager* instance;
 
-    CANMessage txQueue[TX_QUEUE_SIZE];
     CANMessage rxQueue[RX_QUEUE_SIZE];
-    uint8_t txHead, txTail;
     uint8_t rxHead, rxTail;
 
     bool connected;
     uint32_t lastMessageTime;
 
-    static const uint8_t MAX_BMS_CELLS = 96;
-    uint16_t bmsCellVoltages[MAX_BMS_CELLS];
-    uint32_t bmsCellUpdateTimes[MAX_BMS_CELLS];
-    uint8_t bmsCellCount;
+    BMSCells bmsCells;
+
+
+    struct ChangeWatch {
+        const char*   name;
+        int8_t        sub;
+        int32_t       deadband;
+        int32_t       threshold;
+        CANParameter* param;       // resolved from name, nullptr if absent
+        uint32_t      generation;  // paramsGeneration when resolved
+        uint32_t      seenCount;   // param->changeCount at last dispatch
+        int32_t       lastFixed;   // last value delivered
+        bool          lastStale;   // stale flag last delivered
+        bool          primed;      // initial value delivered
+    };
+    ChangeHandler changeSubs[MAX_CHANGE_SUBSCRIBERS];
+    uint8_t       changeSubCount;
+    ChangeWatch   changeWatches[MAX_CHANGE_WATCHES];
+    uint8_t       changeWatchCount;
+    uint32_t      paramsGeneration;  // bumped by loadParametersFromJSON
 
-    FrameObserver _frameObserver;  // GVRET bridge callback
+    TimerWheel    staleWheel;        // one entry per parameter slot
+    void rearmStaleTimers();
+    void onStaleTimer(uint16_t idx);
 
-    // Low-level SDO helpers for segmented download (bypass SDOManager)
-    bool sdoSendRaw(uint8_t* data8);
-    bool sdoReceiveRaw(twai_message_t* frame, uint32_t timeoutMs = 500);
     FetchResult fetchParamsAttempt();
 
     void processReceivedMessage(CANMessage& msg);
     void handleSDOResponse(CANMessage& msg);
     void handlePDOMessage(CANMessage& msg);
     void handleGenericMessage(CANMessage& msg);
-    void handleBMSCellVoltage(CANMessage& msg);
 
-    void updateParameterBySDOId(uint16_t sdoId, int32_t value);
-    void updateParameterIfExists(uint16_t paramId, int32_t value);
+    CANParameter* findBySDOId(uint16_t sdoId);
+    void updateParameterBySDOId(uint16_t sdoId, int32_t raw);
+    void updateParameterIfExists(uint16_t paramId, int32_t raw);
+    static void applyScaleOverride(CANParameter& p);
 
-    bool enqueueTx(CANMessage& msg);
-    bool dequeueTx(CANMessage& msg);
     bool enqueueRx(CANMessage& msg);
     bool dequeueRx(CANMessage& msg);
 };
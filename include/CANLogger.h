@@ -0,0 +1,158 @@
+#pragma once
+// ============================================================================
+// CANLogger.h
+// Binary CAN frame log on flash (Storage.h), written by a background task.
+//
+// The frame path (append, loopTask) only copies a 16-byte record into one
+// half of a PSRAM double buffer. When that half is full it is handed to the
+// "CANLog" writer task, which writes it to flash in whole CANLOG_PAGE_BYTES
+// pages while the other half fills. If the writer is still busy with the
+// other half when the current one fills, frames are counted in dropped()
+// instead of stalling the bus path.
+//
+// File layout (little-endian):
+//
+//   header  32 bytes — CANLogHeader
+//   record  16 bytes × n — CANLogRecord
+//
+// Record timestamps are µs since the log started, kept in 28 bits next to
+// the DLC. Each time the 28-bit counter wraps (every ~268 s) an epoch mark
+// record is written first: idFlags = CANLOG_MARK, data[0..3] = the new
+// epoch. A reader's absolute time is (epoch << 28) | tsUs — CANLogReader
+// does this and hides the marks.
+//
+// Conversion to CSV / candump / ASC / GVRET / JSON happens at download time, see
+// CANMonitor::handleLogDownload().
+// ============================================================================
+
+#include <Arduino.h>
+#include <FS.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "driver/twai.h"
+
+#define CANLOG_PATH         "/canlog.bin"
+#define CANLOG_VERSION      1
+#define CANLOG_BUF_BYTES    32768   // per half — 2048 records, ~0.5 s of a saturated 500k bus
+#define CANLOG_PAGE_BYTES   4096    // flash sector — writer write() granularity
+#define CANLOG_TS_BITS      28
+#define CANLOG_TS_MASK      ((1u << CANLOG_TS_BITS) - 1)
+
+// idFlags bits
+#define CANLOG_ID_MASK      0x1FFFFFFFu
+#define CANLOG_MARK         0x20000000u   // epoch mark, not a frame
+#define CANLOG_RTR          0x40000000u
+#define CANLOG_EXT          0x80000000u
+
+struct CANLogHeader {
+    char     magic[4];      // "ZCAN"
+    uint16_t version;       // CANLOG_VERSION
+    uint16_t recordSize;    // sizeof(CANLogRecord)
+    uint32_t bitrate;       // bus bitrate the log was taken at
+    uint32_t startUnix;     // wall clock at start, 0 when the clock was never set
+    uint32_t startMs;       // millis() at start
+    uint32_t triggerUs;     // flight-recorder captures: µs from start to the trigger
+    uint32_t triggerArg;    // trigger detail (opmode, threshold index ...)
+    uint8_t  trigger;       // FlightTrigger, 0 for a manual log
+    uint8_t  reserved[3];
+};
+
+struct CANLogRecord {
+    uint32_t tsDlc;         // bits 0-27 µs since start (mod 2^28), bits 28-31 dlc
+    uint32_t idFlags;       // bits 0-28 id, CANLOG_MARK / CANLOG_RTR / CANLOG_EXT
+    uint8_t  data[8];
+};
+
+enum class LogState : uint8_t { IDLE, LOGGING, STOPPING, STOPPED };
+
+// =============================================================================
+
+class CANLogger {
+public:
+    // Allocate the double buffer and start the writer task. Call once.
+    bool init();
+    // Stop the writer task and free the buffers (benchmark instances)
+    void end();
+
+    // Open `path` and start capturing. Any task, while not logging.
+    bool start(const char* path, uint32_t bitrate);
+    // Ask for the capture to stop — any task. poll() hands the last partial
+    // buffer over, the writer closes the file and the state becomes STOPPED.
+    void requestStop() { stopReq = true; }
+
+    // loopTask only
+    void append(const twai_message_t& msg, int64_t nowUs);
+    void poll();
+
+    LogState state() const   { return logState.load(); }
+    bool isLogging() const   { return logState.load() == LogState::LOGGING; }
+    uint32_t frames() const  { return frameCount; }
+    uint32_t dropped() const { return droppedCount; }
+    // Size the file will have once every queued buffer is written
+    uint32_t bytes() const   { return sizeof(CANLogHeader) + recordCount * sizeof(CANLogRecord); }
+    uint32_t writeErrors() const { return writeErrorCount; }
+
+private:
+    struct WriteJob {
+        uint8_t  idx;       // buffer half, 0xFF = none (close only)
+        uint32_t len;
+        bool     last;      // close the file afterwards
+        bool     quit;      // end() — leave the task
+    };
+
+    uint8_t*      buf[2] = { nullptr, nullptr };
+    std::atomic<bool> busy[2];      // half owned by the writer task
+    uint8_t       fillIdx = 0;
+    uint32_t      fillLen = 0;
+
+    File          logFile;          // writer task only, once started
+    QueueHandle_t writeQ = nullptr;
+    TaskHandle_t  writerTask = nullptr;
+    std::atomic<LogState> logState { LogState::IDLE };
+    volatile bool stopReq = false;
+
+    int64_t  startUs = 0;
+    uint32_t epoch = 0;             // last epoch written to the file
+    uint32_t frameCount = 0;
+    uint32_t recordCount = 0;
+    uint32_t droppedCount = 0;
+    volatile uint32_t writeErrorCount = 0;
+
+    bool putRecord(const CANLogRecord& rec);
+    void seal(bool last);
+
+    static void writerEntry(void* arg);
+    void writerLoop();
+};
+
+// =============================================================================
+// Sequential reader — yields frames with absolute µs timestamps
+// =============================================================================
+
+class CANLogReader {
+public:
+    // False when the file is missing or its header is not a CANLOG_VERSION log
+    bool open(fs::FS& fs, const char* path);
+    void close() { file.close(); }
+
+    const CANLogHeader& header() const { return hdr; }
+
+    // Next frame; epoch marks are consumed here. False at end of file.
+    bool next(CANLogRecord& rec, uint64_t& tsUs);
+
+    static uint8_t dlc(const CANLogRecord& r)   { return (uint8_t)(r.tsDlc >> CANLOG_TS_BITS); }
+    static uint32_t id(const CANLogRecord& r)   { return r.idFlags & CANLOG_ID_MASK; }
+    static bool extended(const CANLogRecord& r) { return r.idFlags & CANLOG_EXT; }
+    static bool rtr(const CANLogRecord& r)      { return r.idFlags & CANLOG_RTR; }
+
+private:
+    static const uint8_t READ_RECORDS = 64;   // 1 KB per file read
+
+    File         file;
+    CANLogHeader hdr;
+    CANLogRecord chunk[READ_RECORDS];
+    uint8_t      chunkLen = 0;
+    uint8_t      chunkPos = 0;
+    uint32_t     epoch = 0;
+};
@@ -2,21 +2,115 @@
 // =============================================================================
 // CANMonitor.h — ZombieVerter Dial Display
 //
-// Real-time CAN bus monitor with WebSocket streaming, CSV logging,
-// filtering, and frame transmission.
+// Real-time CAN bus monitor with WebSocket streaming, binary logging
+// (see CANLogger), filtering, and frame transmission.
 //
 // Usage:
 //   1. CANMonitor::instance().init(canDataManager)  — call once in setup()
 //   2. CANMonitor::instance().pushFrame(frame)       — call for every CAN frame
-//   3. CANMonitor::instance().registerEndpoints(server) — registers WS + HTTP
+//   3. CANMonitor::instance().poll()                 — call every loop
+//   4. CANMonitor::instance().registerEndpoints(server) — registers WS + HTTP
+//   5. CANMonitor::instance().cleanupClients()       — call every loop while
+//                                                      the web server runs
+//
+// The CAN side (pushFrame/poll, loopTask) only fills and seals batches from
+// a preallocated pool. A separate sender task on core 0 hands them to each
+// WebSocket client, so a slow client can never stall CAN ingestion:
+//
+//   loopTask ──seal──▶ ready queue ──▶ WSSend task ──▶ per-client ring
+//      ▲                                   │             │ (≤ WS_CLIENT_RING)
+//      └──────────── free queue ◀──────────┘             ▼
+//                                            client->binary() while the
+//                                            client's own queue is short
+//
+// The sender never looks a client up in the library's list. It uses the
+// pointer the WS_EVT_CONNECT handed to wsConns, under wsConnMutex, and
+// WS_EVT_DISCONNECT — which the library fires before it frees the client —
+// takes the same mutex to clear it, so a client cannot go away mid-send.
+//
+// When a client's ring is full its drop policy decides what gives:
+// oldest batch, every other batch, or the client itself. Drops are counted
+// per client and show up in /can/stats.
+//
+// /ws/can streams every frame, unthrottled, as binary batches. One batch is
+// sealed every WS_BATCH_MS (or sooner when full):
+//
+//   header  12 bytes, little-endian
+//     u8  magic 'C'    u8  version (1)    u16 count
+//     u32 baseUs       esp_timer µs of the first record (low 32 bits)
+//     u32 firstSeq     bus sequence number (FrameHistory) of the first
+//                      record — gaps between batches are frames the
+//                      browser never got
+//   record  16 bytes × count
+//     u16 dtUs         µs after baseUs, low 16 bits
+//     u8  flags        bits 0-3 dlc, bit 6 RTR, bit 7 extended id
+//     u8  dtHi         µs after baseUs, bits 16-23 (0 in live batches)
+//     u32 id
+//     u8  data[8]
+//
+// Text messages on the same socket carry control replies and per-ID
+// annotations: {"type":"ann","id":"0x583","name":...,"decoded":...}, sent
+// at most every ANN_INTERVAL_MS per ID.
+//
+// A client can narrow its own stream with a subscription:
+//
+//   {"cmd":"subscribe","ids":[599,"0x355"],"ranges":[{"id":"0x520","mask":"0x7F0"}],
+//    "ext":false,"maxRate":10,"changesOnly":true}
+//   {"cmd":"unsubscribe"}
+//
+// ids match exactly, ranges match (frameId & mask) == (id & mask); with
+// neither, every ID passes. maxRate (Hz) caps each ID separately and
+// changesOnly sends a frame only when its DLC or payload differs from the
+// last one this client got for that ID. The sender task re-encodes each
+// batch per subscribed client, so only the matching records go over WiFi,
+// and a batch left empty is not sent at all. Annotations are filtered the
+// same way. firstSeq still numbers every bus frame, so for a subscribed
+// client a gap includes filtered frames — losses are in /can/stats.
+//
+// Every frame also lands in FrameHistory, so a client can fill gaps and
+// backfill on connect. The hello message carries the current "seq" (next
+// frame number); then
+//
+//   {"cmd":"replay","from":N}   or   {"cmd":"replay","last":N}
+//
+// streams the history from seq N (or the last N frames) as ordinary binary
+// batches, through the client's subscription, until it meets the live
+// stream — the reply {"type":"replay","from":...,"oldest":...,"head":...}
+// says where it actually starts when N has already been overwritten. Live
+// batches that arrive meanwhile are held, and while the replay runs the
+// client's ring keeps only the newest ones; the replay covers the rest.
+// A few frames at the seam may arrive twice — firstSeq tells them apart.
+//
+// GET /can/history?from=N&limit=M pages through the same history over HTTP
+// (application/octet-stream, little-endian):
+//
+//   header  16 bytes
+//     u8  'H'   u8 version (1)   u16 count
+//     u32 firstSeq     seq of the first record (≥ from once N has aged out)
+//     u32 nextSeq      cursor for the next page — firstSeq + count
+//     u32 headSeq      next seq the bus will produce
+//   record  20 bytes × count — a HistoryFrame
+//     u32 us           esp_timer µs (low 32 bits)
+//     u32 tsDlc        bits 28-31 dlc
+//     u32 idFlags      CANLogRecord id + flags; CANLOG_MARK = overwritten
+//                      while this page was being sent (payload zeroed)
+//     u8  data[8]
+//
+// Without from, the page ends at the newest frame. limit defaults to
+// CAN_HISTORY_PAGE and is capped at CAN_HISTORY_PAGE_MAX.
 // =============================================================================
 
 #include <Arduino.h>
 #include <ESPAsyncWebServer.h>
-#include <SPIFFS.h>
+#include "Storage.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
 #include "driver/twai.h"
+#include "CANLogger.h"
+#include "FrameHistory.h"
+#include "StreamExport.h"
+#include "JsonWriter.h"
 
 // Forward declaration
 class CANDataManager;
@@ -30,14 +124,56 @@ struct CANFrame {
 };
 
 // ---- Per-ID statistics ----
+// Inter-arrival times are in µs from esp_timer. Period stats cover the
+// count-1 intervals seen so far: mean = sumDtUs / n, and the variance comes
+// from sumDtUs2 when /can/stats is rendered, never on the frame path.
 struct CANIDStat {
-    uint32_t id;
+    uint64_t sumDtUs;
+    uint64_t sumDtUs2;
+    uint32_t id;          // full identifier; CAN_STAT_EMPTY = unused hash slot
     uint32_t count;
-    uint32_t lastSeen;    // millis()
+    uint32_t lastUs;      // arrival of the last frame
+    uint32_t minDtUs;
+    uint32_t maxDtUs;
+    uint32_t lastAnnMs;   // last annotation sent for this ID — millis()
+    uint16_t dlcChanges;
+    uint16_t missed;      // arrivals later than CAN_STAT_MISS_FACTOR × mean period
+    uint8_t  dlc;         // DLC of the last frame
+    bool     extended;
+};
+
+#define CAN_STAT_EMPTY          0xFFFFFFFFu
+#define CAN_STAT_STD_IDS        2048   // direct-indexed by 11-bit id
+#define CAN_STAT_EXT_SLOTS      64     // open-addressed hash for 29-bit ids (power of 2)
+#define CAN_STAT_MISS_FACTOR    2      // late = gap above 2× the mean period
+#define CAN_STAT_MISS_MIN       8      // intervals needed before judging lateness
+
+// ---- What a backed-up WebSocket client loses ----
+enum class WsDropPolicy : uint8_t {
+    DROP_OLDEST,   // discard the oldest queued batch — live view stays current
+    DECIMATE,      // queue only every other batch while backed up
+    DROP_CLIENT    // disconnect the client — it reconnects and resyncs
+};
+
+// ---- Per-client subscription — see the protocol description at the top ----
+#define WS_FILTER_RULES     16
+
+// ---- GET /can/history page sizes (frames) ----
+#define CAN_HISTORY_PAGE      1024
+#define CAN_HISTORY_PAGE_MAX  4096
+
+struct WsFilterRule {
+    uint32_t id;
+    uint32_t mask;        // 0x7FF / 0x1FFFFFFF for an exact id
+    bool     extended;
 };
 
-// ---- Logging state ----
-enum class LogState { IDLE, LOGGING, STOPPED };
+struct WsFilter {
+    WsFilterRule rules[WS_FILTER_RULES];
+    uint8_t  ruleCount;   // 0 = every ID
+    uint32_t minGapUs;    // per-ID rate cap, 0 = none
+    bool     changesOnly;
+};
 
 // =============================================================================
 
@@ -57,73 +193,198 @@ public:
     // Called by CANData::update() for every received frame
     void pushFrame(const twai_message_t& msg);
 
+    // Seals the filling batch once it is WS_BATCH_MS old so a quiet bus
+    // still flushes — call every loop. Never touches the network.
+    void poll();
+
     // Called by CANData for transmit requests from web UI
     bool transmitFrame(uint32_t id, uint8_t* data, uint8_t len);
 
+    // Drops closed /ws/can clients — loop task, never the sender (it edits
+    // the library's client list, which async_tcp also edits)
+    void cleanupClients();
+
     // Monitoring active only when browser client connected
-    bool isActive() const { return clientCount > 0 || logState == LogState::LOGGING; }
+    bool isActive() const { return clientCount > 0 || logger.isLogging(); }
 
-    // Logging controls
+    // Logging controls — stop is asynchronous, the writer task closes the
+    // file once the last buffer is on flash (state STOPPING → STOPPED)
     void startLogging();
     void stopLogging();
-    LogState getLogState() const { return logState; }
-    uint32_t getLogFrameCount() const { return logFrameCount; }
+    LogState getLogState() const { return logger.state(); }
+    uint32_t getLogFrameCount() const { return logger.frames(); }
 
 private:
     CANMonitor() = default;
 
-    // ---- Circular frame buffer ----
-    static const uint16_t BUF_SIZE = 200;
-    CANFrame frameBuf[BUF_SIZE];
-    uint16_t bufHead = 0;   // next write position
-    uint16_t bufCount = 0;
-    SemaphoreHandle_t bufMutex = nullptr;
-
     // ---- Per-ID statistics ----
-    static const uint8_t MAX_ID_STATS = 64;
-    CANIDStat idStats[MAX_ID_STATS];
-    uint8_t idStatCount = 0;
-    void updateIDStat(uint32_t id);
+    // Standard IDs index straight into stdStats; extended IDs probe a small
+    // hash. Both live in one allocation (PSRAM when present) made in init().
+    // O(1) per frame — no scans, no eviction. An extended ID arriving when
+    // the hash is full is only counted in extOverflow.
+    CANIDStat* idStats = nullptr;      // [CAN_STAT_STD_IDS + CAN_STAT_EXT_SLOTS]
+    uint16_t   idStatCount = 0;        // distinct IDs seen
+    uint32_t   extOverflow = 0;
+    CANIDStat* updateIDStat(const twai_message_t& msg, uint32_t nowUs);
+    CANIDStat* findIDStat(uint32_t id, bool extended, bool create);
 
     // ---- WebSocket ----
     AsyncWebSocket* ws = nullptr;
     volatile uint8_t clientCount = 0;
 
-    // Thread-safe WS send queue — pushFrame (main loop) enqueues,
-    // a periodic flush in pushFrame drains it via ws->textAll which
-    // is safe to call from the main loop only.
+    // Binary frame batch — see the protocol description at the top
+    struct WsBatchHeader {
+        uint8_t  magic;
+        uint8_t  version;
+        uint16_t count;
+        uint32_t baseUs;
+        uint32_t firstSeq;
+    };
+    struct WsFrameRecord {
+        uint16_t dtUs;
+        uint8_t  flags;
+        uint8_t  dtHi;
+        uint32_t id;
+        uint8_t  data[8];
+    };
+    static const uint8_t  WS_BATCH_MAGIC   = 'C';
+    static const uint8_t  WS_BATCH_VERSION = 1;
+    static const uint16_t WS_BATCH_MS      = 25;
+    static const uint16_t WS_BATCH_FRAMES  = 256;     // ~60 ms of a saturated 500k bus
+    static const uint32_t WS_BATCH_SPAN_US = 60000;   // keeps dtUs inside 16 bits
+    static const uint32_t WS_REPLAY_SPAN_US = 0xFFFFFF;  // dtUs + dtHi — replay batches
+
+    // Pool of batches, allocated once in init(). Indices travel between
+    // loopTask and the sender task through two FreeRTOS queues: free → fill
+    // (pushFrame) → ready (sender) → per-client rings → free again. One
+    // extra batch past WS_POOL_SIZE never enters the queues — the sender
+    // builds replay batches in it.
+    struct WsBatch {
+        uint8_t  buf[sizeof(WsBatchHeader) + WS_BATCH_FRAMES * sizeof(WsFrameRecord)];
+        uint16_t count;
+        uint32_t baseUs;
+        uint32_t startMs;
+        uint8_t  refs;     // client rings still holding it (sender task only)
+    };
+    static const uint8_t WS_POOL_SIZE = 8;
+    static const uint8_t WS_REPLAY_IDX = WS_POOL_SIZE;
+    WsBatch* wsPool = nullptr;
+    QueueHandle_t wsFreeQ  = nullptr;
+    QueueHandle_t wsReadyQ = nullptr;
+    int16_t  wsFill = -1;           // pool index pushFrame appends to, -1 = none
+    void appendToBatch(const twai_message_t& msg, uint32_t nowUs, uint32_t seq);
+    void sealBatch();               // loopTask: hand wsFill to the sender
+
+    // ---- Sender task — all network I/O for /ws/can happens here ----
+    static const uint8_t WS_MAX_CLIENTS       = 4;
+    static const uint8_t WS_CLIENT_RING       = 4;  // batches we hold per client
+    static const uint8_t WS_CLIENT_MAX_QUEUED = 4;  // messages in the client's own queue
+
+    // Last frame sent to one client for one ID, indexed like idStats
+    // (CAN_STAT_STD_IDS + CAN_STAT_EXT_SLOTS slots, PSRAM when present)
+    struct WsSentState {
+        uint32_t us;
+        uint8_t  data[8];
+        uint8_t  flags;     // WsFrameRecord flags — dlc, RTR, extended
+        bool     valid;
+        uint8_t  pad[2];
+    };
+    struct WsClientState {
+        uint32_t     id;            // AsyncWebSocketClient id, 0 = free slot
+        WsDropPolicy policy;
+        uint8_t      ring[WS_CLIENT_RING];
+        uint8_t      ringHead;
+        uint8_t      ringCount;
+        bool         skipNext;      // DECIMATE phase
+        bool         closing;       // DROP_CLIENT fired, waiting for disconnect
+        bool         replaying;     // history replay still catching up
+        uint32_t     replaySeq;     // next history frame to replay
+        uint32_t     sentFrames;
+        uint32_t     droppedFrames;
+        uint32_t     droppedBatches;
+        uint32_t     filteredFrames;   // removed by the subscription
+        WsFilter*    filter;           // nullptr = whole bus
+        WsSentState* sent;             // per-ID last sent, only for maxRate / changesOnly
+    };
+    WsClientState wsClients[WS_MAX_CLIENTS];   // owned by the sender task
+
+    // Connected clients as the WebSocket events saw them — see the top of
+    // the file. Written by onWsEvent, read by the sender; both under
+    // wsConnMutex. takeWsConn returns the client with the mutex held (give
+    // it back with giveWsConn) or nullptr with it released.
+    struct WsConn { uint32_t id; AsyncWebSocketClient* cl; };
+    WsConn wsConns[WS_MAX_CLIENTS];
+    SemaphoreHandle_t wsConnMutex = nullptr;
+    AsyncWebSocketClient* takeWsConn(uint32_t id);
+    void giveWsConn() { xSemaphoreGive(wsConnMutex); }
+    void setWsConn(uint32_t id, AsyncWebSocketClient* cl);   // cl nullptr = gone
+
+    // Connect / disconnect / policy / subscription changes arrive from
+    // async_tcp as small control messages, so client state needs no lock.
+    // A SUBSCRIBE carries a heap WsFilter that the sender task adopts, a
+    // REPLAY the history seq to start from.
+    enum class WsCtlOp : uint8_t { ADD, REMOVE, POLICY, SUBSCRIBE, REPLAY };
+    struct WsCtl { WsCtlOp op; WsDropPolicy policy; uint32_t id; WsFilter* filter; uint32_t seq; };
+    QueueHandle_t wsCtlQ = nullptr;
+    bool postWsCtl(WsCtlOp op, uint32_t id, WsDropPolicy policy = WsDropPolicy::DROP_OLDEST,
+                   WsFilter* filter = nullptr, uint32_t seq = 0);
+    void applyWsCtl(const WsCtl& ctl);
+    void setClientFilter(WsClientState& c, WsFilter* filter);
+    void freeClientFilter(WsClientState& c);
+
+    // Subscribed clients get a per-client copy of each batch, built here
+    uint8_t wsScratch[sizeof(WsBatchHeader) + WS_BATCH_FRAMES * sizeof(WsFrameRecord)];
+    uint16_t filterBatch(WsClientState& c, const WsBatch& b);
+    static bool filterMatches(const WsFilter& f, uint32_t id, bool extended);
+
+    TaskHandle_t wsSenderTask = nullptr;
+    static void wsSenderEntry(void* arg);
+    void wsSenderLoop();
+    void distributeBatch(uint8_t idx);
+    void pumpClients();
+    bool buildReplayBatch(WsClientState& c, uint32_t until);
+    void sendBatch(WsClientState& c, AsyncWebSocketClient* cl, const WsBatch& b);
+    void releaseBatch(uint8_t idx);
+    void dropClientRing(WsClientState& c);
+    WsClientState* findWsClient(uint32_t id);
+    static const char* policyName(WsDropPolicy p);
+
+    // End-to-end counters, reported by /can/stats
+    uint32_t wsFramesSent = 0;      // frames × clients
+    uint32_t wsFramesDropped = 0;   // no free batch — lost before any client
+    uint32_t wsBatchesSent = 0;
+
+    // Heap allocations made inside pushFrame() — must stay 0 (see HeapChurn)
+    uint32_t hotPathAllocs = 0;
+
+    // Thread-safe WS text queue — annotations are built straight into a slot
+    // by pushFrame (loopTask) and drained by the sender task, per client,
+    // skipping clients whose queue is already long.
     static const uint8_t WS_QUEUE_SIZE = 16;
-    struct WsMsg { char json[300]; };
+    struct WsMsg { uint32_t id; bool extended; char json[300]; };
     WsMsg wsQueue[WS_QUEUE_SIZE];
     uint8_t wsQHead = 0;
     uint8_t wsQTail = 0;
     SemaphoreHandle_t wsQMutex = nullptr;
-    void enqueueWsMsg(const String& json);
-    void flushWsQueue();  // call from main loop only
+    void enqueueAnnotation(const CANFrame& f, bool extended, const char* decoded);
+    void flushWsQueue();  // sender task only
 
-    // Throttle: only push a given ID at most once per 50ms
-    static const uint8_t THROTTLE_SLOTS = 32;
-    struct ThrottleEntry { uint32_t id; uint32_t lastSentMs; };
-    ThrottleEntry throttle[THROTTLE_SLOTS];
-    bool shouldThrottle(uint32_t id);
-    void markSent(uint32_t id);
+    // Annotations (name + decoded text) go out at most once per
+    // ANN_INTERVAL_MS per ID (CANIDStat::lastAnnMs) — frames themselves are
+    // never throttled
+    static const uint16_t ANN_INTERVAL_MS = 250;
 
     // ---- Logging ----
-    LogState logState = LogState::IDLE;
-    File logFile;
-    uint32_t logFrameCount = 0;
+    CANLogger logger;
     uint32_t sessionFrameCount = 0;
     uint32_t sessionStartMs = 0;
 
-    void writeCSVRow(const CANFrame& f, const String& decoded);
-
     // ---- Decoder ----
+    // Writes the human-readable decode into `out` ("" for unknown IDs) and
+    // returns its length. Only called for frames that are actually emitted.
     CANDataManager* canMgr = nullptr;
-    String decodeFrame(const CANFrame& f);
-
-    // ---- Frame → JSON string ----
-    String frameToJson(const CANFrame& f, const String& decoded,
-                       uint32_t countForID);
+    static const uint8_t DECODE_LEN = 80;
+    size_t decodeFrame(const CANFrame& f, char* out, size_t cap);
 
     // ---- WebSocket event handler (static trampoline) ----
     static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
@@ -136,7 +397,21 @@ private:
     void handleLogStart(AsyncWebServerRequest* request);
     void handleLogStop(AsyncWebServerRequest* request);
     void handleLogDownload(AsyncWebServerRequest* request);
+    void handleHistory(AsyncWebServerRequest* request);
+
+    // Download-time conversion of the binary log, one line (or GVRET
+    // record) per frame, streamed through StreamExport
+    enum class LogExport : uint8_t { CSV, CANDUMP, ASC, GVRET, JSON, RAW };
+    class LogExportSource;
+    static ExportSource* openLogExport(const char* path, uint8_t format);
+    size_t exportHeader(LogExport fmt, const CANLogHeader& h, char* out, size_t cap);
+    size_t exportLine(LogExport fmt, const CANLogHeader& h, const CANLogRecord& r,
+                      uint64_t tsUs, uint32_t index, char* out, size_t cap);
+    size_t exportFooter(LogExport fmt, char* out, size_t cap);
+    // GET /can/stats, streamed through JsonStream — one item per ID slot
+    class StatsBody;
     void handleStats(AsyncWebServerRequest* request);
+    void statJson(JsonWriter& w, const CANIDStat& s);
 
     // Friendly name lookup for known CAN IDs
     static const char* knownIDName(uint32_t id);
@@ -0,0 +1,125 @@
+#pragma once
+// ============================================================================
+// CANTxScheduler.h
+// Single owner of the TWAI transmit path.
+//
+// Nothing else calls twai_transmit. SDOManager, the synchronous SDO
+// helpers, the web UI (CANMonitor, CANDataManager::sendMessage) and the
+// network bridges (CANBridge.h) submit frames here, tagged with a TxSource.
+// submit() never blocks. A frame is refused when its source has run out of
+// tokens or its queue is full, and the caller gets false.
+//
+// Sources are priority classes, served strictly in order:
+//
+//   SAFETY_SDO  high-priority SDO writes, flash save and the boot-time
+//               params fetch — never rate limited
+//   SDO         routine SDO traffic (polling)
+//   USER        frames typed into the web UI
+//   PLAYBACK    bridge transmit / playback — SavvyCAN, SLCAN, cannelloni
+//
+// Each source has its own FreeRTOS queue and a token bucket: rate frames/s
+// with a burst allowance. The "CANTx" task keeps at most
+// CAN_TX_DRIVER_DEPTH frames in the driver's own queue, and the driver is
+// installed with a queue that deep. So a playback burst can only ever be a
+// couple of frames ahead of the next SDO request, instead of the ten frames
+// the driver used to hold.
+//
+// A frame the driver refuses (bus-off, stopped, recovering) stays at the
+// head of its source and is offered again each tick, for up to
+// CAN_TX_RETRY_TICKS; only then is it dropped and counted as failed.
+//
+// Per-source counts, refusals and submit → driver latency are served at
+// GET /can/tx.
+// ============================================================================
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "driver/twai.h"
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
+
+#define CAN_TX_DRIVER_DEPTH   2     // frames handed to the TWAI driver at once
+#define CAN_TX_RETRY_TICKS    100   // driver refusals before a frame is dropped
+
+enum class TxSource : uint8_t {
+    SAFETY_SDO = 0,
+    SDO,
+    USER,
+    PLAYBACK,
+    COUNT
+};
+
+struct TxSourceStats {
+    uint32_t submitted;
+    uint32_t sent;           // accepted by the driver
+    uint32_t queueFull;      // refused — source queue full
+    uint32_t limited;        // refused — out of tokens
+    uint32_t retried;        // driver refused, offered again next tick
+    uint32_t failed;         // dropped after CAN_TX_RETRY_TICKS refusals
+    uint64_t latencySumUs;   // submit → driver, over `sent` (uint32 µs wraps in ~71 min)
+    uint32_t latencyMaxUs;
+};
+
+class CANTxScheduler {
+public:
+    static CANTxScheduler& getInstance() {
+        static CANTxScheduler inst;
+        return inst;
+    }
+
+    // Create the queues and the TX task — after twai_start()
+    void begin();
+    void registerEndpoints(AsyncWebServer* server);
+
+    // Any task, never blocks. false = refused (see TxSourceStats).
+    bool submit(TxSource src, const twai_message_t& msg);
+    // Charge one frame to src's token bucket without queueing anything —
+    // lets a benchmark replay a sender's pacing off the bus. Not counted.
+    bool admit(TxSource src);
+
+    const TxSourceStats& stats(TxSource src) const { return _stats[(uint8_t)src]; }
+    static const char* sourceName(TxSource src);
+
+private:
+    CANTxScheduler() = default;
+    CANTxScheduler(const CANTxScheduler&) = delete;
+    CANTxScheduler& operator=(const CANTxScheduler&) = delete;
+
+    static const uint8_t SOURCES = (uint8_t)TxSource::COUNT;
+
+    struct TxItem {
+        twai_message_t msg;
+        uint32_t       submitUs;
+    };
+
+    // Token bucket kept as µs of credit — a frame costs 1e6 / rate and
+    // credit accrues one per µs, capped at burst frames' worth
+    struct Bucket {
+        uint32_t costUs;     // 0 = unlimited
+        uint32_t capUs;
+        uint32_t creditUs;
+        uint32_t lastUs;
+    };
+
+    // A frame the driver refused, ahead of everything in its queue
+    struct Held {
+        TxItem  item;
+        uint8_t tries;
+        bool    valid;
+    };
+
+    QueueHandle_t _queues[SOURCES] = {};
+    Held          _held[SOURCES] = {};
+    Bucket        _buckets[SOURCES] = {};
+    TxSourceStats _stats[SOURCES] = {};
+    portMUX_TYPE  _mux = portMUX_INITIALIZER_UNLOCKED;
+    TaskHandle_t  _task = nullptr;
+
+    bool take(uint8_t i, uint32_t nowUs);   // token bucket, under _mux
+    void refund(uint8_t i);                 // give back what take() charged, under _mux
+    static void taskEntry(void* arg);
+    void taskLoop();
+    void handleStats(AsyncWebServerRequest* request);
+};
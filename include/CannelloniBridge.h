@@ -0,0 +1,95 @@
+#pragma once
+// ============================================================================
+// CannelloniBridge.h
+// cannelloni-compatible CAN over UDP on port 20000 — the Linux tool that
+// joins a vcan/SocketCAN interface to a remote bus:
+//
+//   cannelloni -I vcan0 -R 192.168.4.1 -r 20000 -l 20000
+//
+// Datagram (cannelloni protocol version 2, all fields big-endian):
+//   [0]    0x02          version
+//   [1]    0x00          op: DATA
+//   [2]    seq           datagram counter, wraps
+//   [3-4]  count         frames in this datagram
+//   then per frame:
+//     [0-3]  can_id      SocketCAN id: bit31 extended, bit30 remote
+//     [4]    len         0-8 (classic CAN only)
+//     [5..]  data        len bytes, none for a remote frame
+//
+// Peers: there is no handshake, so whoever sends a datagram here becomes a
+// peer — an empty DATA datagram (count 0) is enough. A peer that has sent
+// nothing for CANNELLONI_PEER_TIMEOUT_MS (60 s) is dropped. cannelloni
+// only sends when its own side has traffic, so with a quiet vcan send a
+// frame, or an empty datagram, at least once a minute to stay subscribed.
+//
+// One shared cursor: each pump pass encodes what the bus carried since the
+// last one into datagrams of up to CANNELLONI_MTU bytes, once, and sends
+// the same datagram to every peer. UDP has no back-pressure, so a peer
+// that cannot keep up loses datagrams in the network rather than here.
+// Frames from a peer go out through CANTxScheduler as PLAYBACK.
+// ============================================================================
+
+#include "CANBridge.h"
+
+class AsyncUDP;
+class AsyncUDPPacket;
+
+#define CANNELLONI_PORT             20000
+#define CANNELLONI_MAX_PEERS        4
+#define CANNELLONI_PEER_TIMEOUT_MS  60000
+#define CANNELLONI_MTU              1200    // datagram payload — under a 1500 MTU with room to spare
+#define CANNELLONI_HEADER           5
+#define CANNELLONI_RECORD_MAX       13      // id + len + 8 data
+
+class CannelloniBridge : public CANBridge {
+public:
+    static CannelloniBridge& getInstance() {
+        static CannelloniBridge inst;
+        return inst;
+    }
+
+    void begin() override;
+    void stop() override;
+    uint8_t statsItems() const override { return CANNELLONI_MAX_PEERS + 3; }
+    void statsItem(JsonWriter& w, uint8_t n) override;
+
+    // One frame record, returns its length (at most CANNELLONI_RECORD_MAX)
+    static size_t encodeFrame(uint8_t* out, const HistoryFrame& f);
+
+protected:
+    void pump() override;
+
+private:
+    CannelloniBridge() : CANBridge("cannelloni") {}
+    CannelloniBridge(const CannelloniBridge&) = delete;
+    CannelloniBridge& operator=(const CannelloniBridge&) = delete;
+
+    struct Peer {
+        uint32_t ip;          // 0 = free
+        uint16_t port;
+        uint32_t sinceMs;
+        uint32_t lastMs;      // last datagram from the peer
+        uint32_t rxFrames;
+    };
+
+    AsyncUDP*    _udp = nullptr;
+    Peer         _peers[CANNELLONI_MAX_PEERS] = {};
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t     _cursor = 0;      // bridge task
+    uint8_t      _seq = 0;
+    uint8_t      _dgram[CANNELLONI_MTU];
+
+    // Bridge task figures
+    uint32_t     _sentFrames = 0;
+    uint32_t     _droppedFrames = 0;
+    uint32_t     _datagrams = 0;
+    uint32_t     _sentBytes = 0;
+    uint32_t     _sendErrors = 0;
+    // async_udp figures
+    uint32_t     _rxFrames = 0;
+    uint32_t     _rxRefused = 0;   // CANTxScheduler said no
+    uint32_t     _rxErrors = 0;    // malformed datagrams
+
+    void onPacket(AsyncUDPPacket& pkt);
+    void sendDatagram(size_t len, uint16_t count, const Peer* peers, uint8_t n);
+};
@@ -0,0 +1,98 @@
+#pragma once
+// ============================================================================
+// CmdSampler.h
+// Time series for /cmd?cmd=get <names>&repeat=N and /cmd?cmd=stream N <names>
+// — what plot.js and log.js ask for to draw a burst of samples.
+//
+// Each request gets a SampleBody: the "CmdSample" task snapshots the
+// requested parameters every 1/rate seconds (rate from &rate=<hz>, default
+// CMD_SAMPLE_DEFAULT_HZ) into the body's ring, and the response streams each
+// row as soon as it has been taken. The values are whatever the CAN RX and
+// SDO paths last stored, read through the parameter seqlock, so a 10-100 Hz
+// burst is a real series rather than N copies of one cached value.
+//
+// The ring holds CMD_SAMPLE_RING values — at least half a second's worth at
+// the maximum rate for the maximum signal count, which covers a response
+// waiting for its connection's next poll. A row that finds the ring full
+// (a client that stopped reading) is taken on a later tick instead.
+//
+// A response that is dropped before it is complete stops its sampling on
+// the next tick; CMD_SAMPLE_MAX requests can sample at once.
+// ============================================================================
+
+#include <Arduino.h>
+#include <atomic>
+#include <memory>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "CANData.h"
+#include "JsonWriter.h"
+
+#define CMD_SAMPLE_MAX          4       // requests sampling at once
+#define CMD_SAMPLE_SIGNALS      32      // signals in one request (= CMD_GET_MAX_NAMES)
+#define CMD_SAMPLE_RING         2048    // values buffered per request
+#define CMD_SAMPLE_DEFAULT_HZ   50
+#define CMD_SAMPLE_MAX_HZ       100
+
+// One /cmd get|stream response: `repeat` rows of `count` values, each value
+// followed by a space as in the single-shot reply
+class SampleBody : public JsonBody {
+public:
+    SampleBody(const CANParameter* const* params, uint8_t count,
+               uint16_t repeat, uint16_t hz);
+
+    bool ready(uint32_t n) override;
+    bool item(JsonWriter& w, uint32_t n) override;
+
+protected:
+    void complete(uint32_t bytes) override;
+
+private:
+    friend class CmdSampler;
+
+    const CANParameter* _params[CMD_SAMPLE_SIGNALS];   // nullptr = unknown name
+    uint8_t  _count;
+    uint16_t _repeat;
+    uint16_t _rows;            // ring depth in rows
+    uint32_t _periodUs;
+    int64_t  _dueUs = 0;       // sampler task
+    uint16_t _late = 0;        // rows delayed by a full ring
+    bool     _started = false;
+
+    std::atomic<uint16_t> _taken{0};   // rows sampled — sampler task
+    std::atomic<uint16_t> _sent{0};    // rows fully rendered — async_tcp
+
+    int32_t  _ring[CMD_SAMPLE_RING];
+
+    // Sampler task: take row _taken if it is due and there is room
+    void sample(int64_t nowUs);
+    bool finished() const { return _taken.load(std::memory_order_relaxed) >= _repeat; }
+};
+
+class CmdSampler {
+public:
+    static CmdSampler& getInstance() {
+        static CmdSampler inst;
+        return inst;
+    }
+
+    // Sampler task — before the first add()
+    void begin();
+
+    // async_tcp — start sampling for a response; false when CMD_SAMPLE_MAX
+    // are already running (or the task is not up)
+    bool add(const std::shared_ptr<SampleBody>& body);
+
+private:
+    CmdSampler() = default;
+    CmdSampler(const CmdSampler&) = delete;
+    CmdSampler& operator=(const CmdSampler&) = delete;
+
+    std::shared_ptr<SampleBody> _active[CMD_SAMPLE_MAX];
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    TaskHandle_t _task = nullptr;
+
+    static void taskEntry(void* arg);
+    void taskLoop();
+    int64_t pass();
+};
@@ -58,6 +58,7 @@
 // CAN Bus Settings
 #define CAN_BAUDRATE        500000  // 500kbps - standard for ZombieVerter
 #define CAN_NODE_ID         3       // YOUR ZombieVerter is on Node 3!
+#define CAN_RX_QUEUE_LEN    128     // TWAI driver RX queue — ~30 ms of a saturated bus
 
 // UI Settings
 #define MAX_SCREENS         6
@@ -67,9 +68,22 @@
 
 // Data Settings
 #define MAX_PARAMETERS      250
-#define TX_QUEUE_SIZE       16
-#define RX_QUEUE_SIZE       32
+#define RX_QUEUE_SIZE       CAN_RX_QUEUE_LEN  // holds one full TWAI drain
 #define PARAM_UPDATE_INTERVAL_MS  100
+#define MAX_CHANGE_SUBSCRIBERS    4    // CANDataManager::subscribe() slots
+#define MAX_CHANGE_WATCHES        32   // total watched params across subscribers
+
+// Staleness — a value is stale once it misses STALE_PERIOD_FACTOR expected
+// update periods. Periods come from params.json "period" (ms) or are learned.
+#define STALE_TICK_MS             50     // timer wheel resolution
+#define STALE_PERIOD_FACTOR       3
+#define STALE_MIN_TIMEOUT_MS      500
+#define STALE_DEFAULT_TIMEOUT_MS  5000   // broadcast value, period not yet known
+
+// Parameter seqlock (see CANParameter::store / snapshot)
+#define SEQLOCK_SPIN_RETRIES      64     // busy re-reads before sleeping a tick
+#define SEQLOCK_SLEEP_RETRIES     4      // 1-tick sleeps before snapshot() gives up
+#define SEQLOCK_TABLE_RETRIES     8      // whole-table passes before snapshotAll() degrades
 
 // Debug
 #define DEBUG_SERIAL        true
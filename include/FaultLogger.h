@@ -13,6 +13,7 @@
 
 #include <Arduino.h>
 #include <Preferences.h>
+#include "StreamExport.h"
 
 #define FAULTLOG_MAX_ENTRIES  50
 
@@ -24,6 +25,8 @@ struct FaultEntry {
     uint8_t  isFault;        // 1 = SDO abort, 0 = opmode transition
 };
 
+enum class FaultExport : uint8_t { JSON, MSGPACK };
+
 class FaultLogger {
 public:
     static FaultLogger& getInstance() {
@@ -39,8 +42,27 @@ public:
     // Log an opmode transition
     void logOpmodeChange(uint8_t newOpmode);
 
-    // Returns JSON array string of all entries, newest first
-    String getJSON();
+    // JSON (or MessagePack) array export source for StreamExport, newest
+    // first — one NVS read per entry. format is a FaultExport; key is unused.
+    static ExportSource* openExport(const char* key, uint8_t format);
+    // Bumped on every write and clear — the export's cache / ETag version
+    uint32_t exportVersion() const { return _version; }
+
+    // The ring as it stands — an export opens on one and reads every entry
+    // through it, so entries do not shift when a fault lands mid-download
+    struct Window {
+        int      count;
+        int      startIdx;
+        uint32_t version;
+    };
+    Window window() const { return { _count, _startIdx, _version }; }
+
+    // Entry n of the window counting back from the newest (0 = newest);
+    // false once its slot has been overwritten since the window was taken
+    bool   entryFromNewest(const Window& w, int n, FaultEntry& e) const;
+    bool   entryFromNewest(int n, FaultEntry& e) const { return entryFromNewest(window(), n, e); }
+    size_t jsonEntry(const FaultEntry& e, bool first, char* out, size_t cap) const;
+    size_t msgpackEntry(const FaultEntry& e, uint8_t* out, size_t cap) const;
 
     void clear();
     int getCount() const { return _count; }
@@ -50,13 +72,14 @@ public:
     static const char* decodeOpmode(uint8_t opmode);
 
 private:
-    FaultLogger() : _count(0), _startIdx(0) {}
+    FaultLogger() : _count(0), _startIdx(0), _version(0) {}
     FaultLogger(const FaultLogger&) = delete;
     FaultLogger& operator=(const FaultLogger&) = delete;
 
     Preferences _prefs;
     int _count;
     int _startIdx;
+    uint32_t _version;
 
     void writeSlot(int slot, const FaultEntry& e);
     bool readSlot(int slot, FaultEntry& e) const;
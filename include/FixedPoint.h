@@ -0,0 +1,68 @@
+#pragma once
+// ============================================================================
+// FixedPoint.h
+// Fixed-point scaling descriptors and integer-only value formatting.
+//
+// Every CANParameter carries a FixedScale describing how a raw value from the
+// wire (SDO ×32, IVT-S mV, etc.) maps onto its stored fixed-point value:
+//
+//   fixed = raw × rawMul × 10^decimals / rawDiv
+//
+// The stored value therefore keeps `decimals` digits after the point, e.g.
+// udc = 311.53 V is held as 31153 with decimals = 2. Scaling is applied once
+// at ingest; every output (LVGL labels, /spot, /cmd get, CSV, WebSocket) then
+// renders the same integer through format() without float printf.
+//
+// No Arduino dependencies — this file also builds on the host for benchmarks.
+// ============================================================================
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FIXED_MAX_DECIMALS  6
+#define FIXED_UNIT_LEN      8
+
+struct FixedScale {
+    int32_t rawMul;                 // raw → engineering units numerator
+    int32_t rawDiv;                 // raw → engineering units denominator
+    uint8_t decimals;               // digits kept after the decimal point
+    char    unit[FIXED_UNIT_LEN];   // display unit, e.g. "V", "mV", "%"
+};
+
+class FixedPoint {
+public:
+    // ZombieVerter/openinverter SDO encoding: raw ×32, two decimals kept
+    static FixedScale sdoDefault();
+
+    static int32_t pow10(uint8_t decimals);
+
+    // raw wire value → fixed-point value using the descriptor
+    static int32_t fromRaw(int32_t raw, const FixedScale& s);
+    // fixed-point value → raw wire value (inverse of fromRaw)
+    static int32_t toRaw(int32_t fixed, const FixedScale& s);
+
+    // value expressed as num/div engineering units → fixed-point with `decimals`
+    // e.g. fromRatio(311530, 1000, 2) = 31153 (311.530 V from mV)
+    static int32_t fromRatio(int32_t num, int32_t div, uint8_t decimals);
+
+    // Change the number of stored decimals, rounding half away from zero
+    static int32_t rescale(int32_t fixed, uint8_t fromDecimals, uint8_t toDecimals);
+
+    // Render a fixed-point value with exactly outDecimals digits after the
+    // point (rounded). Returns characters written, excluding the terminator.
+    // Output is always NUL-terminated when cap > 0.
+    static size_t format(char* out, size_t cap, int32_t fixed,
+                         uint8_t decimals, uint8_t outDecimals);
+
+    // Render with the value's own decimals
+    static size_t format(char* out, size_t cap, int32_t fixed, uint8_t decimals) {
+        return format(out, cap, fixed, decimals, decimals);
+    }
+
+    // Plain integer rendering (no decimals)
+    static size_t formatInt(char* out, size_t cap, int32_t v);
+
+    // Parse a decimal string ("-12.5", "3", "0.125") into fixed-point with
+    // `decimals` digits, rounding extra digits. Returns false on bad input.
+    static bool parse(const char* str, uint8_t decimals, int32_t& out);
+};
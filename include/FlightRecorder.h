@@ -0,0 +1,155 @@
+#pragma once
+// ============================================================================
+// FlightRecorder.h
+// Always-on pre/post-trigger CAN capture.
+//
+// The frames themselves live in FrameHistory, which records every received
+// frame whether or not a browser is watching. When a trigger fires, the
+// recorder waits out the post-window and then the "FlightRec" task copies
+// the frames from preMs before the trigger to postMs after it out of the
+// history into a numbered capture, /capNNNN.bin. The newest
+// FLIGHT_MAX_CAPTURES are kept.
+//
+// Captures use the CANLogger file format, with the trigger recorded in the
+// header, so /can/log/download?capture=N converts them like the manual log.
+//
+// Triggers (each can be disabled in the config):
+//   SDO abort       — seen in checkFrame(), one compare per frame
+//   opmode change   — polled every FLIGHT_CHECK_MS
+//   health fail     — HealthChecker entering FAIL
+//   threshold       — a decoded parameter crossing a configured level
+//   button          — triple click on the dial, or POST /can/captures/trigger
+//
+// A trigger that fires while a capture is still in its post-window or being
+// written is counted in suppressed() and otherwise ignored.
+//
+// Config is stored in NVS namespace "flightrec". Changes posted from the web
+// are applied on loopTask by poll(), like BMSCells::requestLayout.
+// ============================================================================
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "driver/twai.h"
+#include "CANLogger.h"
+#include "FrameHistory.h"
+
+class CANDataManager;
+class AsyncWebServer;
+class AsyncWebServerRequest;
+
+#define FLIGHT_MAX_CAPTURES      8
+#define FLIGHT_MAX_THRESHOLDS    4
+#define FLIGHT_CHECK_MS          50      // opmode / health / threshold polling
+#define FLIGHT_MAX_WINDOW_MS     120000  // pre + post — keeps a capture inside one log epoch
+#define FLIGHT_MAX_NUMBER        9999    // capture numbers run 1..9999 and wrap
+#define FLIGHT_CONFIG_MAX_BODY   2048    // POST /can/captures/config
+
+enum class FlightTrigger : uint8_t {
+    NONE      = 0,
+    SDO_ABORT = 1,
+    OPMODE    = 2,
+    HEALTH    = 3,
+    THRESHOLD = 4,
+    BUTTON    = 5
+};
+
+struct FlightThreshold {
+    char    name[24];   // parameter name, "" = unused
+    int32_t level;      // engineering value × 1000
+    bool    above;      // fire on crossing upward (false = downward)
+};
+
+struct FlightConfig {
+    uint16_t preMs;
+    uint16_t postMs;
+    uint8_t  triggerMask;   // bit per FlightTrigger
+    uint8_t  thresholdCount;
+    FlightThreshold thresholds[FLIGHT_MAX_THRESHOLDS];
+};
+
+class FlightRecorder {
+public:
+    static FlightRecorder& getInstance() {
+        static FlightRecorder inst;
+        return inst;
+    }
+
+    // Load config and start the writer task — after FrameHistory::begin()
+    void begin(CANDataManager* can);
+    void registerEndpoints(AsyncWebServer* server);
+
+    // loopTask — every received frame, for the SDO abort trigger
+    void checkFrame(const twai_message_t& msg);
+    // loopTask — trigger polling, post-window timing, config apply
+    void poll();
+
+    // Any task
+    void trigger(FlightTrigger kind, uint32_t arg = 0);
+    void requestConfig(const FlightConfig& cfg);
+
+    const FlightConfig& getConfig() const { return _config; }
+    uint32_t suppressed() const { return _suppressed; }
+    static const char* triggerName(FlightTrigger t);
+    // "/capNNNN.bin" for capture n
+    static void capturePath(uint16_t n, char* out, size_t cap);
+
+private:
+    FlightRecorder() = default;
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    enum class State : uint8_t { ARMED, POST, WRITING };
+
+    struct DumpJob {
+        uint32_t trigSeq;    // first frame after the trigger
+        uint32_t endSeq;     // one past the last post-window frame
+        uint32_t trigUs;
+        uint32_t trigMs;
+        uint32_t preUs;
+        uint32_t arg;
+        uint16_t number;
+        FlightTrigger kind;
+    };
+
+    CANDataManager* _can = nullptr;
+    bool            _ready = false;         // history and stage buffer available
+
+    std::atomic<State> _state { State::ARMED };
+    volatile uint8_t  _pendingKind = 0;     // FlightTrigger waiting for poll()
+    volatile uint32_t _pendingArg = 0;
+    uint32_t _suppressed = 0;
+    DumpJob  _job;                          // being timed by poll()
+
+    FlightConfig _config;
+    FlightConfig _pendingConfig;
+    volatile bool _configPending = false;
+    uint16_t _nextCapture = 1;
+
+    uint32_t _lastCheckMs = 0;
+    int32_t  _lastOpmode = -1;
+    bool     _lastHealthFail = false;
+    int32_t  _lastLevel[FLIGHT_MAX_THRESHOLDS];
+    bool     _levelKnown[FLIGHT_MAX_THRESHOLDS];
+
+    QueueHandle_t _jobQ = nullptr;
+    uint8_t*      _stage = nullptr;         // one CANLOG_PAGE_BYTES write
+
+    void checkTriggers();
+    void loadFromNVS();
+    void saveToNVS();
+    void applyConfig(const FlightConfig& cfg);
+    bool enabled(FlightTrigger t) const { return _config.triggerMask & (1u << (uint8_t)t); }
+
+    static void writerEntry(void* arg);
+    void writerLoop();
+    void writeCapture(const DumpJob& job);
+    void fire(FlightTrigger kind, uint32_t arg);
+    static uint16_t captureBefore(uint16_t n, uint16_t back);
+
+    class ListBody;
+    void handleList(AsyncWebServerRequest* request);
+    void handleConfig(AsyncWebServerRequest* request);
+    void handleDelete(AsyncWebServerRequest* request);
+};
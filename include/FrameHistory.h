@@ -0,0 +1,76 @@
+#pragma once
+// ============================================================================
+// FrameHistory.h
+// Always-on history of every received CAN frame, numbered by a bus sequence
+// number that only ever increases.
+//
+// record() is called from CANDataManager::update for every frame, whether
+// or not anything is watching: a 20-byte copy into a PSRAM ring. The
+// sequence number of a frame is its position in the ring's history, so
+// readers on other tasks address frames by seq and read() tells them when
+// one has already been overwritten.
+//
+// Readers:
+//   FlightRecorder  — pre-trigger window of a capture
+//   CANMonitor      — /ws/can batch firstSeq, GET /can/history pages and
+//                     the WebSocket "replay" command (late-join backfill)
+//
+// The ring holds FRAME_HISTORY_FRAMES frames (~15 s of a saturated 500k
+// bus, minutes of typical traffic). A reader treats a slot as intact while
+// the writer is less than ringSize - FRAME_HISTORY_MARGIN frames past it,
+// so the copy it is taking cannot be overwritten under it.
+// ============================================================================
+
+#include <Arduino.h>
+#include <atomic>
+#include "driver/twai.h"
+#include "CANLogger.h"
+
+#define FRAME_HISTORY_FRAMES       65536   // PSRAM, 20 B each
+#define FRAME_HISTORY_FRAMES_IRAM  2048    // fallback when there is no PSRAM
+#define FRAME_HISTORY_MARGIN       256     // slots kept clear of the write head for readers
+
+// One frame — the µs stamp is the low 32 bits of esp_timer; rec.tsDlc
+// carries only the DLC (bits 28-31)
+struct HistoryFrame {
+    uint32_t     us;
+    CANLogRecord rec;
+};
+
+class FrameHistory {
+public:
+    static FrameHistory& getInstance() {
+        static FrameHistory inst;
+        return inst;
+    }
+
+    // Allocate the ring. Call once in setup(). Without memory the sequence
+    // still counts, but nothing can be read back.
+    void begin();
+
+    // loopTask — every received frame. Returns the frame's seq.
+    uint32_t record(const twai_message_t& msg, uint32_t nowUs);
+
+    // Any task
+    uint32_t head() const { return _head.load(std::memory_order_acquire); }   // next seq
+    uint32_t oldest() const;                                                  // oldest readable seq
+    uint32_t size() const { return _size; }
+    bool     enabled() const { return _ring != nullptr; }
+
+    // Copy frame `seq`; false when it is not recorded yet or already
+    // overwritten (or about to be)
+    bool read(uint32_t seq, HistoryFrame& out) const;
+
+private:
+    FrameHistory() = default;
+    FrameHistory(const FrameHistory&) = delete;
+    FrameHistory& operator=(const FrameHistory&) = delete;
+
+    HistoryFrame* _ring = nullptr;
+    uint32_t      _size = 0;            // power of two
+    std::atomic<uint32_t> _head { 0 };  // frames recorded since boot
+
+    bool intact(uint32_t seq) const {
+        return head() - seq - 1 < _size - FRAME_HISTORY_MARGIN;
+    }
+};
@@ -28,18 +28,16 @@
 //
 // Port: 23 (standard GVRET/telnet port expected by SavvyCAN)
 // Max clients: 4 simultaneous SavvyCAN connections
-// Frame buffer: up to 32 frames batched per send cycle (every 10ms)
+//
+// Runs as a TcpBridge (CANBridge.h): AsyncTCP, a FrameHistory cursor per
+// client, the TCP send buffer as the bounded per-client queue. SavvyCAN
+// streams from connect; per-client figures are at GET /bridges.
 // ============================================================================
 
-#include <Arduino.h>
-#include <WiFiServer.h>
-#include <WiFiClient.h>
-#include "driver/twai.h"
+#include "CANBridge.h"
 
 #define GVRET_PORT          23
-#define GVRET_MAX_CLIENTS   4
-#define GVRET_FLUSH_MS      10      // flush frame buffer every 10ms
-#define GVRET_FRAME_BUF_SZ  512     // bytes — holds ~35 CAN frames
+#define GVRET_RECORD_MAX    20      // longest frame record (DLC 8)
 
 // GVRET command bytes
 #define GVRET_CMD_FRAME         0x00
@@ -53,44 +51,27 @@
 #define GVRET_CMD_BINARY_MODE   0xE7  // negotiate binary mode
 #define GVRET_FRAME_START       0xF1
 
-class GVRETServer {
+class GVRETServer : public TcpBridge {
 public:
     static GVRETServer& getInstance() {
         static GVRETServer inst;
         return inst;
     }
 
-    void begin();
-    void stop();
-
-    // Call from main loop every iteration — accepts new clients,
-    // processes incoming commands, flushes frame buffer
-    void update();
-
-    // Push a received CAN frame to all connected SavvyCAN clients
-    void pushFrame(uint32_t id, bool extended, const uint8_t* data, uint8_t dlc);
+    // One CAN frame record, returns its length (at most GVRET_RECORD_MAX)
+    static size_t encodeFrame(uint8_t* out, const HistoryFrame& f);
 
-    bool hasClients() const { return _clientCount > 0; }
+protected:
+    void onData(Client& c, const uint8_t* data, size_t len) override;
+    size_t encode(Client&, const HistoryFrame& f, uint8_t* out) override {
+        return encodeFrame(out, f);
+    }
 
 private:
-    GVRETServer() : _server(GVRET_PORT), _clientCount(0), _lastFlush(0), _bufLen(0), _running(false) {}
+    GVRETServer() : TcpBridge("gvret", GVRET_PORT, GVRET_RECORD_MAX) {}
     GVRETServer(const GVRETServer&) = delete;
     GVRETServer& operator=(const GVRETServer&) = delete;
 
-    WiFiServer      _server;
-    WiFiClient      _clients[GVRET_MAX_CLIENTS];
-    int             _clientCount;
-    uint32_t        _lastFlush;
-    bool            _running;
-
-    // Outgoing frame buffer — batched for efficiency
-    uint8_t         _frameBuf[GVRET_FRAME_BUF_SZ];
-    int             _bufLen;
-
-    void _acceptClients();
-    void _processClientInput(int idx);
-    void _handleCommand(int clientIdx, uint8_t cmd, const uint8_t* payload, int payloadLen);
-    void _flushFrameBuffer();
-    void _sendResponse(int clientIdx, uint8_t cmd, const uint8_t* data, int len);
-    void _appendFrame(uint32_t id, bool extended, const uint8_t* data, uint8_t dlc);
+    void _handleCommand(Client& c, uint8_t cmd, const uint8_t* payload, int payloadLen);
+    void _sendResponse(Client& c, uint8_t cmd, const uint8_t* data, int len);
 };
@@ -0,0 +1,33 @@
+#pragma once
+// ============================================================================
+// HeapChurn.h
+// Counts heap allocations made by one task.
+//
+// Diagnostics only: built with HEAP_CHURN defined (the m5stack-dial-heapchurn
+// env in platformio.ini), malloc, calloc and realloc are wrapped at link
+// time (-Wl,--wrap=...). Each wrapper bumps the counter when the caller is
+// the tracked task, then forwards to the real allocator. String, new and
+// std::function all land in these, so reading count() before and after a
+// block shows exactly how many allocations it made. The default firmware
+// is not wrapped: count() stays 0 and enabled() is false.
+//
+// Used to hold CANMonitor::pushFrame() to zero allocations per frame, and
+// by the "json" benchmark to count what a /spot response allocates.
+// ============================================================================
+
+#include <Arduino.h>
+
+class HeapChurn {
+public:
+    // Start counting for `task` (nullptr = the calling task). One task at a time.
+    static void track(TaskHandle_t task);
+
+    // The task being counted, nullptr before the first track()
+    static TaskHandle_t tracked();
+
+    // Allocations made by the tracked task since boot
+    static uint32_t count();
+
+    // Built with the wrappers — otherwise count() means nothing
+    static bool enabled();
+};
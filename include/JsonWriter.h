@@ -0,0 +1,133 @@
+#pragma once
+// ============================================================================
+// JsonWriter.h
+// Allocation-free JSON output — a writer that renders into a caller's
+// buffer, and chunked responses that point it at AsyncWebServer's own send
+// buffers.
+//
+// JsonWriter keeps the separators itself: open an object or array, add
+// keys and values, close it. Numbers go through FixedPoint (no printf, no
+// float formatting), keys are copied with a length known up front (string
+// literals, CANParameter::nameLen) and string values are escaped on the
+// way in. Running out of room sets overflow() and drops the rest.
+//
+// JsonStream serves a JsonBody — a response that can render any of its
+// items on request, each at most JSON_ITEM_MAX bytes. Every chunk callback
+// renders items straight into the buffer it is given until one does not
+// fit; that item is rewound and comes first in the next chunk. A response
+// therefore costs the response object and one body object whatever its
+// size, instead of a String that reallocates as it grows. A body whose items
+// are still being produced (CmdSampler) holds the stream back with ready().
+// ============================================================================
+
+#include <Arduino.h>
+#include <memory>
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+
+#define JSON_MAX_DEPTH  8
+#define JSON_ITEM_MAX   256     // longest single item a JsonBody may render
+
+class JsonWriter {
+public:
+    JsonWriter() {}
+    JsonWriter(char* buf, size_t cap) { setBuffer(buf, cap); }
+
+    // New output buffer. Nesting carries over, so one document can be
+    // written across many buffers.
+    void setBuffer(char* buf, size_t cap) {
+        _buf = buf;
+        _cap = cap;
+        _st.len = 0;
+        _st.overflow = false;
+    }
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    // Keys are copied as they are — they must not need escaping
+    template <size_t N> void key(const char (&k)[N]) { key(k, N - 1); }
+    void key(const char* k, size_t len);
+
+    void valueInt(int32_t v);
+    void valueUint(uint32_t v);
+    void valueBool(bool v);
+    void valueNull();
+    void valueFixed(int32_t fixed, uint8_t decimals);   // FixedPoint value
+    void valueFloat(float v, uint8_t decimals);         // rounded to decimals
+    void valueString(const char* s);                    // escaped
+    void valueName(const char* s, size_t len);          // escape-free, like keys
+    void valueRaw(const char* json, size_t len);        // pre-rendered value
+
+    // Bytes as they are, no separator — plain-text bodies (/cmd get)
+    void raw(const char* s, size_t len);
+    void raw(char ch) { put(ch); }
+
+    size_t length()   const { return _st.len; }
+    bool   overflow() const { return _st.overflow; }
+    // NUL-terminated output; the buffer needs one byte beyond the text
+    const char* c_str();
+
+    // Undo a partly written item
+    struct Mark {
+        size_t   len;
+        uint16_t first;        // bit per depth: nothing written there yet
+        uint8_t  depth;
+        bool     afterKey;
+        bool     overflow;
+    };
+    Mark mark() const  { return _st; }
+    void rewind(const Mark& m) { _st = m; }
+
+private:
+    char* _buf = nullptr;
+    size_t _cap = 0;
+    Mark  _st = {};
+
+    void sep();
+    void put(char ch);
+    void put(const char* s, size_t len);
+    void open(char ch);
+    void close(char ch);
+};
+
+// A response rendered item by item. An item that did not fit is rewound and
+// asked for again in the next chunk, so item() must not consume anything:
+// render from state fixed in the constructor (a snapshot) or from live
+// values, never from a cursor it advances itself.
+class JsonBody {
+public:
+    virtual ~JsonBody() {}
+    // Render item n; false when there is no item n (the body is complete).
+    // Rendering nothing and returning true skips an item.
+    virtual bool item(JsonWriter& w, uint32_t n) = 0;
+    // Live bodies: false while item n has not happened yet. The chunk
+    // callback then stops there (RESPONSE_TRY_AGAIN if it has nothing) and
+    // is asked again on the connection's next ACK or poll.
+    virtual bool ready(uint32_t n) { return true; }
+
+protected:
+    // The last item has been rendered; `bytes` is the whole body
+    virtual void complete(uint32_t bytes) {}
+
+private:
+    friend class JsonStream;
+    JsonWriter _w;
+    uint32_t   _next = 0;
+    uint32_t   _bytes = 0;
+    bool       _done = false;
+};
+
+class JsonStream {
+public:
+    // Chunked response streaming `body`. Add headers, then request->send().
+    static AsyncWebServerResponse* begin(AsyncWebServerRequest* request,
+                                         const char* mime,
+                                         std::shared_ptr<JsonBody> body);
+
+    // One chunk callback's worth — exposed for the benchmark
+    static size_t fill(JsonBody& body, uint8_t* buf, size_t maxLen);
+};
@@ -0,0 +1,66 @@
+#pragma once
+// ============================================================================
+// MsgPack.h
+// Allocation-free MessagePack output, the binary twin of JsonWriter — for
+// clients that send "Accept: application/msgpack" (data/msgpack.js).
+//
+// Unlike JSON, a MessagePack map or array states its element count up
+// front, so a body has to know how many entries it will write before the
+// first one (SpotBody counts its snapshot; the log exports know theirs).
+// Numbers are as short as their value allows. A FixedPoint value goes out
+// as an integer when it has no fraction, otherwise as a float32 while it
+// has at most 7 significant digits (msgpack.js rounds it back to them) and
+// as a float64 beyond that.
+//
+// Running out of room sets overflow() and drops the rest, as JsonWriter
+// does. Output rendered here is passed on with JsonWriter::raw() or as an
+// ExportSource piece.
+//
+// /params.json is converted once with ArduinoJson's serializeMsgPack when
+// it is saved (PARAMS_MSGPACK_PATH) rather than on every request.
+// ============================================================================
+
+#include <Arduino.h>
+
+class AsyncWebServerRequest;
+
+#define MSGPACK_MIME         "application/msgpack"
+#define PARAMS_MSGPACK_PATH  "/params.msgpack"
+
+class MsgPackWriter {
+public:
+    MsgPackWriter(uint8_t* buf, size_t cap) : _buf(buf), _cap(cap) {}
+
+    // Element counts — a map of n key/value pairs, an array of n values
+    void map(uint32_t n);
+    void array(uint32_t n);
+
+    void str(const char* s, size_t len);
+    void str(const char* s) { str(s, strlen(s)); }
+    void uint(uint32_t v);
+    void sint(int32_t v);
+    void boolean(bool v);
+    void nil();
+    void fixed(int32_t fixed, uint8_t decimals);   // FixedPoint value
+    void float32(float v);
+    void float64(double v);
+
+    size_t length()   const { return _len; }
+    bool   overflow() const { return _overflow; }
+
+private:
+    uint8_t* _buf;
+    size_t   _cap;
+    size_t   _len = 0;
+    bool     _overflow = false;
+
+    void put(uint8_t b);
+    void put(const void* p, size_t len);
+    void be(uint8_t tag, uint64_t v, uint8_t bytes);   // tag, then v big-endian
+};
+
+class MsgPack {
+public:
+    // The client listed application/msgpack in its Accept header
+    static bool accepted(AsyncWebServerRequest* request);
+};
@@ -33,6 +33,15 @@
 // Subindex = paramId & 0xFF
 #define SDO_BASE_INDEX      0x2100
 
+// Commands are writes to index 0x5002, the subindex picks the command
+#define SDO_INDEX_COMMANDS  0x5002
+#define SDO_COMMAND_SAVE        0   // parameters → VCU flash
+#define SDO_COMMAND_LOAD        1   // VCU flash → parameters
+#define SDO_COMMAND_RESET       2
+#define SDO_COMMAND_DEFAULTS    3
+#define SDO_COMMAND_START       4   // value = opmode
+#define SDO_COMMAND_STOP        5
+
 // SDO Abort Codes
 #define SDO_ABORT_TOGGLE        0x05030000
 #define SDO_ABORT_TIMEOUT       0x05040000
@@ -48,7 +57,7 @@
 enum SDORequestType : uint8_t {
     SDO_REQ_READ = 0,
     SDO_REQ_WRITE,
-    SDO_REQ_SAVE_FLASH
+    SDO_REQ_COMMAND             // paramId holds the SDO_COMMAND_* subindex
 };
 
 struct SDORequest {
@@ -56,14 +65,16 @@ struct SDORequest {
     uint16_t        paramId;    // Full 16-bit VCU param ID (supports 2000+ spot values)
     int32_t         value;      // Used for writes
     bool            highPriority;
+    uint32_t        tag;        // Caller's, echoed in the result (0 = none)
 };
 
 struct SDOResult {
     uint16_t    paramId;        // Full 16-bit param ID
     int32_t     value;          // Valid on successful read
     bool        success;
-    bool        isWrite;
+    bool        isWrite;        // Writes and commands
     uint32_t    abortCode;
+    uint32_t    tag;            // From the request
 };
 
 // Callback invoked when a transaction completes
@@ -94,9 +105,12 @@ public:
     bool requestRead(uint16_t paramId, bool highPriority = false);
 
     // Queue a write request — accepts full 16-bit param ID
-    bool requestWrite(uint16_t paramId, int32_t value, bool highPriority = false);
+    bool requestWrite(uint16_t paramId, int32_t value, bool highPriority = false,
+                      uint32_t tag = 0);
 
-    bool requestSaveFlash();
+    // Queue a command (SDO_COMMAND_*) — ahead of routine requests
+    bool requestCommand(uint8_t command, int32_t value = 0, uint32_t tag = 0);
+    bool requestSaveFlash() { return requestCommand(SDO_COMMAND_SAVE); }
 
     void processIncomingFrame(const twai_message_t& msg);
 
@@ -126,7 +140,8 @@ private:
     uint32_t timeoutCount;
 
     void        taskLoop();
-    bool        sendFrame(uint8_t cmd, uint16_t paramId, int32_t value = 0);
+    bool        sendFrame(uint8_t cmd, uint16_t index, uint8_t subindex,
+                          int32_t value = 0);
     void        handleFrame(const twai_message_t& msg);
     void        deliverResult(bool success, uint16_t paramId,
                               int32_t value, bool isWrite,
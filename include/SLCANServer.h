@@ -0,0 +1,61 @@
+#pragma once
+// ============================================================================
+// SLCANServer.h
+// Lawicel / SLCAN ASCII over TCP on port 3333 — for python-can
+// (interface="slcan", channel="socket://192.168.4.1:3333") and cangaroo.
+//
+// Every command and every frame ends in '\r'. OK is "\r" and error is
+// "\a" (BELL).
+//
+//   FRAMES (device → host, only while the channel is open):
+//     tIIILDD..[ssss]        standard, 3 hex id, dlc, dlc data bytes
+//     TIIIIIIIILDD..[ssss]   extended, 8 hex id
+//     rIIIL / RIIIIIIIIL     remote request
+//     ssss                   ms timestamp 0000-EA5F, only after Z1
+//
+//   COMMANDS (host → device):
+//     S6                     500 kbit/s — the only rate the bus runs at;
+//                            any other Sn is refused
+//     s..                    custom bit timing — accepted, ignored
+//     O / L / C              open / open listen-only / close
+//     t.. T.. r.. R..        transmit — answers "z\r" / "Z\r", or "\a" when
+//                            listen-only or refused by CANTxScheduler
+//     Z0 / Z1                timestamps off / on
+//     V / N / F              version / serial / status flags
+//     M.. m.. X.. W..        filters and modes — accepted, ignored
+//
+// A client gets nothing until it opens the channel; closing holds its
+// cursor at the bus head again. Transmits go through CANTxScheduler as
+// PLAYBACK.
+// ============================================================================
+
+#include "CANBridge.h"
+
+#define SLCAN_PORT          3333
+#define SLCAN_RECORD_MAX    31      // T + 8 id + dlc + 16 data + 4 ts + CR
+
+class SLCANServer : public TcpBridge {
+public:
+    static SLCANServer& getInstance() {
+        static SLCANServer inst;
+        return inst;
+    }
+
+    // One frame, returns its length (at most SLCAN_RECORD_MAX)
+    static size_t encodeFrame(uint8_t* out, const HistoryFrame& f, bool stamp);
+
+protected:
+    void onData(Client& c, const uint8_t* data, size_t len) override;
+    size_t encode(Client& c, const HistoryFrame& f, uint8_t* out) override {
+        return encodeFrame(out, f, c.timestamps);
+    }
+    bool streamsOnConnect() const override { return false; }
+
+private:
+    SLCANServer() : TcpBridge("slcan", SLCAN_PORT, SLCAN_RECORD_MAX) {}
+    SLCANServer(const SLCANServer&) = delete;
+    SLCANServer& operator=(const SLCANServer&) = delete;
+
+    void handleCommand(Client& c, const char* cmd, uint8_t len);
+    bool transmit(Client& c, const char* cmd, uint8_t len);
+};
@@ -0,0 +1,199 @@
+#pragma once
+// ============================================================================
+// SpotStream.h
+// /ws/spot — live parameter values pushed as deltas, instead of pages
+// polling /spot, /value and /cmd get.
+//
+// A client subscribes to a set of parameters and a maximum rate:
+//
+//   → {"cmd":"sub","names":["udc","idc","speed"],"hz":10}
+//   → {"cmd":"sub","names":"all","hz":2}
+//   → {"cmd":"unsub"}
+//   ← {"type":"sub","ok":true,"hz":10,"names":["udc","idc","speed"],"unknown":[]}
+//
+// "names" in the reply is the subscription in order; deltas refer to it by
+// position. When the parameter table is reloaded (a new params.json) the
+// request is resolved again by name and a fresh "sub" message sent, so
+// positions always refer to the latest "names". At most hz times a second
+// the client gets one message holding only what changed since the last one
+// it was sent:
+//
+//   ← {"v":[0,352.5,2,1180],"s":[1]}
+//
+//   v   position, value pairs — values whose changeCount moved (the first
+//       message carries every value that has been received at all)
+//   s   positions that went stale    f   positions fresh again
+//
+// Empty arrays are left out, and nothing is sent when nothing changed. A
+// client that is still busy with earlier messages is skipped for that pass
+// — the values it missed are simply in its next delta, never queued. A
+// delta that does not fit SPOT_WS_MSG_MAX (a first "all") continues on the
+// next pass rather than waiting out the rate.
+//
+// The "SpotPush" task on core 0 takes one snapshotAll() per pass and
+// compares each subscribed parameter's changeCount with the one last sent
+// to that client, so an unchanged value costs one compare. Subscriptions
+// are built on async_tcp and handed to the task through a queue. The task
+// sends through the client pointer WS_EVT_CONNECT recorded, held under
+// _connMutex; WS_EVT_DISCONNECT clears it under the same mutex before the
+// library frees the client, as /ws/can does (CANMonitor.h).
+//
+// GET /spot-stats counts what the pages cost: /spot and /value requests
+// against WS messages, with payload bytes and an airtime estimate.
+//
+// SpotBody is the GET /spot response itself, streamed through JsonStream —
+// as JSON, or as the same map in MessagePack (MsgPack.h) when asked for.
+// ============================================================================
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "Config.h"
+#include "CANData.h"
+#include "JsonWriter.h"
+
+#define SPOT_WS_MAX_CLIENTS  6
+#define SPOT_WS_TICK_MS      50      // push pass — 20 Hz ceiling
+#define SPOT_WS_DEFAULT_HZ   5
+#define SPOT_WS_MAX_HZ       20
+#define SPOT_WS_MSG_MAX      4096    // one delta; the rest goes on the next pass
+#define SPOT_WS_MAX_QUEUED   2       // messages in the client's own queue before it is skipped
+
+// Airtime estimate per message beyond its payload: an HTTP poll is a TCP
+// connection (or at least a request + response header pair and their
+// ACKs), a WS push one frame header plus a TCP/IP segment and its ACK
+#define SPOT_HTTP_OVERHEAD   700
+#define SPOT_WS_OVERHEAD     110
+
+class SpotStream {
+public:
+    static SpotStream& getInstance() {
+        static SpotStream inst;
+        return inst;
+    }
+
+    // Control queue and push task — before registerEndpoints
+    void begin(CANDataManager* can);
+    // WS /ws/spot, GET /spot-stats
+    void registerEndpoints(AsyncWebServer* server);
+
+    // Drops closed /ws/spot clients — loop task, never the push task
+    void cleanupClients();
+
+    // async_tcp — the polling endpoints report what they sent
+    enum class Poll : uint8_t { SPOT, VALUE };
+    void notePoll(Poll kind, size_t bytes);
+
+private:
+    SpotStream() = default;
+    SpotStream(const SpotStream&) = delete;
+    SpotStream& operator=(const SpotStream&) = delete;
+
+    // What one client asked for, by parameter index. Built on async_tcp,
+    // owned by the push task once posted. The indices hold for one
+    // paramsGeneration; after a reload they are resolved again from
+    // `requested`.
+    struct Subscription {
+        uint16_t periodMs;
+        uint8_t  hz;
+        bool     all;                          // every parameter
+        String   requested;                    // names asked for, '\n' after each
+        uint32_t generation;                   // paramsGeneration of idx[]
+        uint16_t count;
+        uint8_t  idx[MAX_PARAMETERS];
+        uint32_t sentChange[MAX_PARAMETERS];   // changeCount last sent
+        uint8_t  sentFlags[MAX_PARAMETERS];    // SENT_VALUE | SENT_STALE
+    };
+    static const uint8_t SENT_VALUE = 0x01;
+    static const uint8_t SENT_STALE = 0x02;
+
+    struct Client {
+        uint32_t      id;          // AsyncWebSocketClient id, 0 = free
+        Subscription* sub;         // nullptr = nothing subscribed
+        uint32_t      lastMs;
+        uint32_t      msgs;
+        uint32_t      bytes;
+        uint32_t      values;
+        uint32_t      skipped;     // passes the client was still busy
+    };
+
+    enum class CtlOp : uint8_t { ADD, REMOVE, SUBSCRIBE };
+    struct Ctl { CtlOp op; uint32_t id; Subscription* sub; };
+
+    CANDataManager* _can = nullptr;
+    AsyncWebSocket* _ws = nullptr;
+    QueueHandle_t   _ctlQ = nullptr;
+    TaskHandle_t    _task = nullptr;
+    Client          _clients[SPOT_WS_MAX_CLIENTS] = {};   // push task only
+
+    // Connected clients as the WebSocket events saw them, under _connMutex.
+    // takeConn returns the client with the mutex held (giveConn releases
+    // it) or nullptr with it released.
+    struct Conn { uint32_t id; AsyncWebSocketClient* cl; };
+    Conn              _conns[SPOT_WS_MAX_CLIENTS] = {};
+    SemaphoreHandle_t _connMutex = nullptr;
+    AsyncWebSocketClient* takeConn(uint32_t id);
+    void giveConn() { xSemaphoreGive(_connMutex); }
+    void setConn(uint32_t id, AsyncWebSocketClient* cl);   // cl nullptr = gone
+
+    // Push task scratch
+    ParamSnapshot   _snap[MAX_PARAMETERS];
+    char            _msg[SPOT_WS_MSG_MAX];
+    uint8_t         _staleOn[MAX_PARAMETERS];
+    uint8_t         _staleOff[MAX_PARAMETERS];
+
+    // Counters — polls on async_tcp, pushes on the push task
+    uint32_t _spotPolls = 0, _spotBytes = 0;
+    uint32_t _valuePolls = 0, _valueBytes = 0;
+    uint32_t _wsMsgs = 0, _wsBytes = 0, _wsValues = 0;
+    uint32_t _sinceMs = 0;
+
+    bool postCtl(CtlOp op, uint32_t id, Subscription* sub = nullptr);
+    // Fill idx[] from `requested` and build the "sub" reply — push task
+    void resolve(Subscription& sub, String& reply);
+    void applyCtl(const Ctl& ctl);
+    Client* findClient(uint32_t id);
+
+    static void taskEntry(void* arg);
+    void taskLoop();
+    bool push(Client& c, AsyncWebSocketClient* cl, uint16_t count);
+
+    static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
+                          AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void handleWsMessage(AsyncWebSocketClient* client, uint8_t* data, size_t len);
+    void handleStats(AsyncWebServerRequest* request);
+};
+
+// GET /spot, rendered from one snapshot straight into the send buffers:
+//
+//   {"name":value,...,"_stale":["name",...],"_gen":"<token>"[,"_full":true]}
+//
+// Values whose gen is not above `since` are left out (0 = all of them);
+// "_stale" is always the complete list. The caller fills snap/count with
+// snapshotAll() before the first chunk.
+class SpotBody : public JsonBody {
+public:
+    SpotBody(const CANParameter* params, uint32_t since, const char* token, bool full);
+
+    ParamSnapshot snap[MAX_PARAMETERS];
+    uint16_t      count = 0;
+    bool          counted = true;      // report the body to SpotStream::notePoll
+    bool          msgpack = false;     // MessagePack instead of JSON
+
+    bool item(JsonWriter& w, uint32_t n) override;
+
+protected:
+    void complete(uint32_t bytes) override;
+
+private:
+    bool itemMsgPack(JsonWriter& w, uint32_t n);
+    bool sent(uint16_t i) const  { return snap[i].received && snap[i].gen > _since; }
+    bool stale(uint16_t i) const { return snap[i].received && snap[i].stale; }
+
+    const CANParameter* _params;       // the table snap[] was taken from
+    uint32_t            _since;
+    char                _token[24];
+    bool                _full;
+};
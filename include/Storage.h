@@ -0,0 +1,90 @@
+#pragma once
+// ============================================================================
+// Storage.h
+// The on-flash filesystem — params.json, the splash logo, CAN logs and
+// flight-recorder captures, /edit uploads and whatever the web UI needs
+// beyond the built-in bundle. Everything opens files through Storage::fs()
+// and never names a filesystem driver itself.
+//
+// Backend: LittleFS on the "spiffs" data partition. SPIFFS keeps one flat
+// table of every page, so exists() and open() scan it all and small
+// appends rewrite whole pages; LittleFS has real directories and
+// copy-on-write metadata. SPIFFS remains as the fallback backend.
+//
+// Migration — the first boot of a LittleFS firmware on a SPIFFS partition:
+//   1. mount SPIFFS, run the benchmark suite on it (kept in NVS for /bench)
+//   2. read the files into one RAM block (PSRAM when there is any, up to
+//      STORAGE_STAGE_MAX), set NVS "storage/migrating"
+//   3. format the partition as LittleFS and write the files back
+//   4. clear "migrating"
+// Nothing else in flash is touched — the OTA rollback image stays. Config
+// (params.json, the logo, other .json files) is staged first and must fit
+// whole, or the migration is abandoned; /edit uploads fill the room left
+// and are dropped (and logged) when they do not fit; CAN logs and
+// flight-recorder captures are not carried over. A partition whose config
+// does not fit stays on SPIFFS, and NVS "storage/failed" stops every later
+// boot from trying again.
+// Power lost during 3 loses the staged files — the next boot finds
+// "migrating" set, logs it and starts on the fresh LittleFS; params.json
+// is fetched from the VCU again.
+//
+// The trip log, fault log and settings live in NVS and are not touched.
+// ============================================================================
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define STORAGE_PARTITION       "spiffs"   // partition label, either backend
+#ifndef FS_MAX_OPEN_FILES
+#define FS_MAX_OPEN_FILES       10         // platformio.ini sets it
+#endif
+#define STORAGE_NVS_NS          "storage"
+#define STORAGE_STAGE_MAX       (1024 * 1024)  // RAM held for the files while migrating
+
+// Benchmark suite (Storage::bench) — fixed, so runs are comparable
+#define FS_BENCH_FILES          16         // present while the lookups run
+#define FS_BENCH_LOOKUPS        64         // open / exists iterations
+#define FS_BENCH_BYTES          65536      // sequential write + read
+#define FS_BENCH_CHUNK          512
+#define FS_BENCH_APPENDS        64         // open("a") + one record + close
+#define FS_BENCH_RECORD         64
+
+enum class StorageBackend : uint8_t { NONE, LITTLEFS, SPIFFS };
+
+struct FsBenchResult {
+    bool     valid;
+    uint8_t  backend;          // StorageBackend
+    uint16_t files;            // files on the filesystem besides the bench's own
+    uint32_t openUs;           // open + close of an existing file, per op
+    uint32_t existsHitUs;      // exists() of a present file, per op
+    uint32_t existsMissUs;     // exists() of an absent file, per op
+    uint32_t appendUs;         // open("a") + FS_BENCH_RECORD bytes + close
+    uint32_t writeKBps;        // FS_BENCH_BYTES in FS_BENCH_CHUNK writes
+    uint32_t readKBps;
+};
+
+class Storage {
+public:
+    // Mount (and migrate, once). Before anything opens a file.
+    static bool begin();
+
+    static fs::FS& fs();
+    static StorageBackend backend();
+    static const char* backendName(StorageBackend b);
+    static size_t totalBytes();
+    static size_t usedBytes();
+
+    // Run the suite on the mounted filesystem. Creates and removes its own
+    // /fsb_* files; needs ~FS_BENCH_BYTES free.
+    static bool bench(FsBenchResult& out);
+    // The SPIFFS run taken just before migrating (valid = false if none)
+    static FsBenchResult migrationBench();
+    static void benchJson(String& json, const FsBenchResult& r);
+
+private:
+    static bool runBench(fs::FS& fs, StorageBackend b, FsBenchResult& out);
+    struct Stage { uint8_t* buf; size_t len; };
+    static bool stageFiles(fs::FS& from, Stage& out);
+    static bool restore(fs::FS& to, const Stage& stage);
+    static uint16_t countFiles(fs::FS& fs);
+};
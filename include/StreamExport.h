@@ -0,0 +1,94 @@
+#pragma once
+// ============================================================================
+// StreamExport.h
+// Chunked HTTP export of stored logs — constant RAM, with Range resume.
+//
+// A log owner supplies an ExportSource that renders its content one piece
+// at a time (a header, one line or record per entry, a footer) into a fixed
+// EXPORT_PIECE_MAX buffer. StreamExport::send() streams those pieces as the
+// response body, so memory use does not depend on the size of the log.
+//
+// Converted output has no size until it has been rendered, so Range
+// support works like this:
+//
+//   - The first download of (key, format, version) goes out chunked. At the
+//     same time the "ExpSize" task renders it once more, counting bytes only,
+//     and caches the total. A download that completes caches it as well.
+//   - Once the total is known, responses carry Content-Length and
+//     "Range: bytes=N-" is answered with 206. Sources that can seek (raw
+//     files) jump there; the rest regenerate the first N bytes and throw
+//     them away, EXPORT_SKIP_BUDGET per callback, so a resume never holds
+//     up async_tcp for long.
+//
+// ETags combine a per-boot salt with the owner's version, so an If-Range
+// from before a reboot or a content change gets the full body (200).
+// ============================================================================
+
+#include <Arduino.h>
+#include <FS.h>
+
+class AsyncWebServerRequest;
+struct ExportCursor;
+
+#define EXPORT_PIECE_MAX    256     // longest piece a source may render
+#define EXPORT_KEY_LEN      24
+#define EXPORT_SIZE_CACHE   6       // (key, format, version) totals kept
+#define EXPORT_SKIP_BUDGET  16384   // bytes discarded per callback on resume
+#define EXPORT_SIZE_UNKNOWN 0xFFFFFFFFu
+
+class ExportSource {
+public:
+    virtual ~ExportSource() {}
+
+    // Render the next piece into out (cap ≥ EXPORT_PIECE_MAX) and return its
+    // length. 0 means the output is complete.
+    virtual size_t next(uint8_t* out, size_t cap) = 0;
+
+    // Position at byte n of the output, if the source can do that directly.
+    // false (the default) makes send() render and discard instead.
+    virtual bool seek(size_t n) { return false; }
+};
+
+// Raw file, read straight through — Range resumes seek
+class FileExportSource : public ExportSource {
+public:
+    explicit FileExportSource(File f) : file(f) {}
+    ~FileExportSource() { if (file) file.close(); }
+    size_t next(uint8_t* out, size_t cap) override;
+    bool seek(size_t n) override { return file.seek(n); }
+private:
+    File file;
+};
+
+// Opens a fresh source for (key, format), nullptr when there is nothing to
+// export. Called on async_tcp for a response and on the sizing task, so the
+// sources it returns must not share state.
+typedef ExportSource* (*ExportOpen)(const char* key, uint8_t format);
+
+struct ExportSpec {
+    ExportOpen  open;
+    const char* key;        // source identity, e.g. the file path
+    uint8_t     format;     // owner-defined
+    uint32_t    version;    // changes whenever the content does
+    uint32_t    size;       // total bytes when known up front (raw files), else EXPORT_SIZE_UNKNOWN
+    const char* mime;
+    const char* fileName;   // Content-Disposition attachment, nullptr = inline
+    bool        vary = false; // format picked from the Accept header
+};
+
+class StreamExport {
+public:
+    // Answer `request` with the export described by spec — 200 chunked, 200
+    // with Content-Length, 206 for a Range, 404 when open() returns nullptr
+    // or 416 for a Range past the end
+    static void send(AsyncWebServerRequest* request, const ExportSpec& spec);
+
+    // Cached total for (key, format, version), false while unknown
+    static bool cachedLength(const char* key, uint8_t format, uint32_t version, uint32_t& len);
+
+private:
+    static size_t fill(ExportCursor& c, uint8_t* buf, size_t maxLen);
+    static void storeLength(const char* key, uint8_t format, uint32_t version, uint32_t len);
+    static void requestSizing(const ExportSpec& spec);
+    static void sizerEntry(void* arg);
+};
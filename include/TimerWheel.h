@@ -0,0 +1,66 @@
+#pragma once
+// ============================================================================
+// TimerWheel.h
+// Two-level hierarchical timer wheel over a fixed set of slot indices
+// (parameter table positions). Scheduling, cancelling and expiring an entry
+// are all O(1); advancing one tick touches only the entries due in that tick,
+// so staleness detection never rescans the whole parameter table.
+//
+//   level 0: TW_SLOTS slots of one tick each        (near deadlines)
+//   level 1: TW_SLOTS slots of TW_SLOTS ticks each  (cascaded into level 0)
+//
+// Deadlines further out than the wheel span are clamped to the last slot and
+// re-armed by the owner when they fire. Entries are intrusive doubly-linked
+// lists keyed by index — no heap use.
+// ============================================================================
+
+#include <stdint.h>
+
+#define TW_SLOTS        64
+#define TW_MAX_ENTRIES  256
+#define TW_NIL          0xFFFF
+
+class TimerWheel {
+public:
+    TimerWheel() { reset(0); }
+
+    // Drop every entry and restart the wheel at `nowTick`
+    void reset(uint32_t nowTick);
+
+    // Arm (or re-arm) entry `idx` to fire at absolute tick `deadline`.
+    // Deadlines at or before the current tick fire on the next advance.
+    void schedule(uint16_t idx, uint32_t deadline);
+    void cancel(uint16_t idx);
+    bool isArmed(uint16_t idx) const { return idx < TW_MAX_ENTRIES && _level[idx] != 0xFF; }
+
+    uint32_t currentTick() const { return _tick; }
+
+    // Step the wheel up to `nowTick`, calling fire(idx) for every entry that
+    // comes due. fire() may re-schedule the entry it was given.
+    template <typename F>
+    void advance(uint32_t nowTick, F&& fire) {
+        while ((int32_t)(nowTick - _tick) > 0) {
+            _tick++;
+            uint8_t s0 = _tick % TW_SLOTS;
+            if (s0 == 0) cascade((_tick / TW_SLOTS) % TW_SLOTS);
+            uint16_t idx;
+            while ((idx = _head[0][s0]) != TW_NIL) {
+                unlink(idx);
+                fire(idx);
+            }
+        }
+    }
+
+private:
+    uint32_t _tick;
+    uint16_t _head[2][TW_SLOTS];
+    uint16_t _next[TW_MAX_ENTRIES];
+    uint16_t _prev[TW_MAX_ENTRIES];
+    uint32_t _deadline[TW_MAX_ENTRIES];
+    uint8_t  _level[TW_MAX_ENTRIES];   // 0/1, 0xFF = not armed
+    uint8_t  _slot[TW_MAX_ENTRIES];
+
+    void link(uint16_t idx, uint8_t level, uint8_t slot);
+    void unlink(uint16_t idx);
+    void cascade(uint8_t slot1);
+};
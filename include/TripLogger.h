@@ -3,7 +3,8 @@
 // TripLogger.h
 // Logs key telemetry to NVS (ESP32 Non-Volatile Storage) at 5-second intervals
 // while the vehicle is moving (speed > 0). Survives power cycles.
-// Accessible via GET /log (CSV download) and DELETE /log (clear).
+// Accessible via GET /log (CSV download, streamed — see StreamExport) and
+// DELETE /log (clear).
 //
 // Storage: NVS namespace "triplog"
 //   Keys:  "count"  — number of valid entries (0..MAX)
@@ -20,6 +21,7 @@
 
 #include <Arduino.h>
 #include <Preferences.h>
+#include "StreamExport.h"
 
 #define TRIPLOG_MAX_ENTRIES     200
 #define TRIPLOG_LOG_INTERVAL_MS 5000   // log every 5 seconds
@@ -37,6 +39,8 @@ struct TripEntry {
     int16_t  potnorm;        // throttle position 0-1000 (0.0-100.0%)
 };
 
+enum class TripExport : uint8_t { CSV, MSGPACK };
+
 class TripLogger {
 public:
     static TripLogger& getInstance() {
@@ -56,8 +60,30 @@ public:
                 int tmpm_c,
                 int potnorm);  // throttle 0-1000
 
-    // Returns CSV string (header + all entries, chronological order)
-    String getCSV();
+    // CSV export source (header + all entries, chronological order) for
+    // StreamExport — one NVS read per row. format is a TripExport; the
+    // MessagePack variant is an array of rows in the CSV's column order,
+    // without the header. key is unused.
+    static ExportSource* openExport(const char* key, uint8_t format);
+    // Bumped on every write and clear — the export's cache / ETag version
+    uint32_t exportVersion() const { return _version; }
+
+    // The ring as it stands — an export opens on one and reads every row
+    // through it, so rows do not shift when an entry lands mid-download
+    struct Window {
+        int      count;
+        int      startIdx;
+        uint32_t version;
+    };
+    Window window() const { return { _count, _startIdx, _version }; }
+
+    // Entry n of the window in chronological order (0 = oldest); false
+    // once its slot has been overwritten since the window was taken
+    bool   entryAt(const Window& w, int n, TripEntry& e) const;
+    bool   entryAt(int n, TripEntry& e) const { return entryAt(window(), n, e); }
+    size_t csvHeader(char* out, size_t cap) const;
+    size_t csvRow(const TripEntry& e, int rowNum, char* out, size_t cap) const;
+    size_t msgpackRow(const TripEntry& e, int rowNum, uint8_t* out, size_t cap) const;
 
     // Erases all entries from NVS
     void clear();
@@ -66,7 +92,7 @@ public:
     bool isFull()        const { return _count >= TRIPLOG_MAX_ENTRIES; }
 
 private:
-    TripLogger() : _count(0), _startIdx(0), _lastLogTime(0) {}
+    TripLogger() : _count(0), _startIdx(0), _lastLogTime(0), _version(0) {}
     TripLogger(const TripLogger&) = delete;
     TripLogger& operator=(const TripLogger&) = delete;
 
@@ -74,8 +100,8 @@ private:
     int      _count;       // number of valid entries, capped at MAX
     int      _startIdx;    // slot index of the oldest entry (ring head)
     uint32_t _lastLogTime;
+    uint32_t _version;
 
     void   writeSlot(int slot, const TripEntry& e);
     bool   readSlot (int slot, TripEntry& e) const;
-    String entryToCSVRow(const TripEntry& e, int rowNum) const;
 };
@@ -245,6 +245,7 @@ private:
     ScreenID currentScreen;
     uint32_t lastUpdateTime;
     bool editMode;          // For programmable screens (Gear, Motor, Regen)
+    bool liveDataDirty;     // set by CAN change subscription / screen change
     bool lockPinPadVisible; // Lock screen: false=padlock view, true=PIN entry view
     
     // Version info — set from main.cpp via setVersionInfo()
@@ -0,0 +1,45 @@
+#pragma once
+// ============================================================================
+// WebAssets.h
+// The web UI compiled into the firmware. scripts/embed_web_assets.py gzips
+// and hashes data/ at build time; the files sit back to back in one flash
+// blob and the index below (sorted by path) finds them without a filesystem
+// lookup.
+//
+// Caching: every response carries a strong ETag — the asset's content hash
+// — and a matching If-None-Match gets a 304. A URL whose ?v= is that hash
+// (the build pins the pages' src/href attributes this way) can never change
+// and is sent "immutable" for a year; everything else is "no-cache", i.e.
+// revalidated, so a new firmware is picked up on the next load. sw.js
+// precaches the URLs listed in /assets.json.
+//
+// Files written at run time (params.json, uploads through /edit, logs)
+// are not in the bundle and still come from the filesystem (Storage.h). A
+// bundled path wins over a file of the same name.
+// ============================================================================
+
+#include <Arduino.h>
+
+class AsyncWebServerRequest;
+
+struct WebAsset {
+    const char* path;      // "/ui.js"
+    const char* mime;
+    const char* hash;      // 16 hex digits of SHA-256 over the stored bytes
+    uint32_t    offset;    // into the blob
+    uint32_t    length;
+    bool        gzip;      // stored gzipped — sent with Content-Encoding
+};
+
+class WebAssets {
+public:
+    // nullptr when `path` is not bundled (or the firmware was built without
+    // the bundle)
+    static const WebAsset* find(const char* path);
+    static uint16_t count();
+    static const char* bundle();     // hash over the whole bundle, "" if none
+    static const uint8_t* data(const WebAsset& a);
+
+    // Answer from the bundle (200 or 304); false when `path` is not in it
+    static bool serve(AsyncWebServerRequest* request, const char* path);
+};
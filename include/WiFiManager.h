@@ -4,34 +4,84 @@
 //
 // API surface:
 //   GET  /cmd?cmd=json          → parameter + spot value list as JSON
-//   GET  /cmd?cmd=get <names>   → spot value(s), one per line "name=value\n"
-//   GET  /cmd?cmd=set <n> <v>   → write parameter via SDO, returns "1\n"
-//   GET  /cmd?cmd=save          → save to VCU flash, returns "1\n"
-//   GET  /cmd?cmd=load          → no-op, returns "1\n"
+//   GET  /cmd?cmd=get <names>   → spot value(s), space-separated; &repeat=N samples
+//                                 them N times at &rate=<hz> (default 50, max 100),
+//                                 streamed as they are taken — see CmdSampler.h
+//   GET  /cmd?cmd=stream N <names> → the same series, plot.js's newer spelling
+//   GET  /cmd?cmd=set <n> <v>   → write parameter via SDO, returns "1\n" / "0\n"
+//   GET  /cmd?cmd=save          → save parameters to VCU flash, "1\n" / "0\n"
+//   GET  /cmd?cmd=load          → reload parameters from VCU flash, "1\n" / "0\n"
+//   GET  /cmd?cmd=defaults|reset|stop|start <mode> → VCU commands, "1\n" / "0\n"
+//
+// Writes and commands are queued on SDOManager and the reply is held back
+// until the VCU answers (or CMD_WRITE_TIMEOUT_MS passes) — the async_tcp
+// task never waits on CAN. The reply goes out on the connection's next
+// poll, within about half a second of the answer.
 //   GET  /wifi                  → WiFi settings page
 //   POST /wifi                  → update AP or STA credentials
-//   GET  /list                  → SPIFFS file list JSON
-//   POST /edit                  → upload file to SPIFFS
-//   DELETE /edit?f=<path>       → delete file from SPIFFS
+//   GET  /list                  → file list JSON (name, size), all directories
+//   POST /edit                  → upload file to flash (see Storage.h)
+//   DELETE /edit?f=<path>       → delete file from flash
 //   GET  /version               → firmware version string
 //   POST /update                → OTA firmware update
-//   GET  /spot                  → live parameter values as compact JSON
+//   GET  /spot                  → live parameter values as compact JSON,
+//                                 "_stale":[names] lists values past their period,
+//                                 "_gen" the change token (also the ETag) —
+//                                 ?since=<_gen> returns only what changed after it,
+//                                 If-None-Match with the ETag → 304 when nothing did
 //   WS   /ws/can                → WebSocket CAN frame stream
+//   WS   /ws/spot               → live values pushed as deltas, see SpotStream.h
+//   GET  /spot-stats            → /spot + /value polls vs /ws/spot pushes, airtime estimate
 //   POST /can/transmit          → transmit a CAN frame
-//   POST /can/log/start         → start CSV logging to /canlog.csv
-//   POST /can/log/stop          → stop CSV logging
-//   GET  /can/log/download      → download canlog.csv
+//   POST /can/log/start         → start binary frame logging to /canlog.bin
+//   POST /can/log/stop          → stop logging (writer task finishes the file)
+//   GET  /can/log/download      → download the log, ?format=csv|candump|asc|gvret|json|bin,
+//                                 ?capture=<n> for a flight-recorder capture
+//   GET  /log                   → trip log CSV
+//   GET  /faults                → fault / opmode log JSON
+//
+// Log downloads are streamed (StreamExport) and resumable with Range once
+// their size is known.
+//   GET  /can/captures          → flight-recorder state, config and captures
+//   POST /can/captures/config   → update recorder pre/post window and triggers
+//   POST /can/captures/trigger  → capture now
+//   DELETE /can/captures?n=<n>  → delete a capture
+//   GET  /can/history           → page of the frame history, ?from=<seq>&limit=<n>, binary
 //   GET  /can/stats             → per-ID frame statistics JSON
+//   GET  /can/tx                → TX scheduler per-source counts, refusals, latency
+//   GET  /bridges               → network CAN bridges — GVRET (TCP 23), SLCAN (TCP 3333),
+//                                 cannelloni (UDP 20000) — with per-client delivery
+//   GET  /bms                   → BMS pack statistics + per-cell mV / trend
+//   GET  /bms-settings          → BMS cell-frame layout (NVS)
+//   POST /bms-settings          → update cell-frame layout
+//   GET  /bench?name=<case>     → run an on-target benchmark (no name = list)
+//
+//   GET  /assets.json           → web bundle hash + URLs for sw.js to precache
 //
-// Web assets (index.html, can.html, inverter.js etc.) served from SPIFFS.
+// Web assets (index.html, can.html, inverter.js etc.) are built into the
+// firmware with ETags and immutable caching, see WebAssets.h; anything not
+// in the bundle is served from the filesystem (Storage.h).
+//
+// /cmd?cmd=json (and /params.json), /spot, /log and /faults answer
+// "Accept: application/msgpack" with the same data in MessagePack — see
+// MsgPack.h, and data/msgpack.js for the decoder. Responses carry
+// "Vary: Accept".
 // =============================================================================
 
 #include <Arduino.h>
 #include <Preferences.h>
 #include "driver/twai.h"
 
+#define CMD_GET_MAX_NAMES   32    // signals in one /cmd get or stream request
+#define CMD_WRITE_MAX       8     // /cmd writes and commands awaiting the VCU
+#define CMD_WRITE_TIMEOUT_MS 4000 // SDOManager gives up after ~1.6 s plus queueing
+#define BMS_SETTINGS_MAX_BODY 2048 // POST /bms-settings
+
 class CANDataManager;
+struct CANParameter;
+struct SDOResult;
 class AsyncWebServerRequest;
+class AsyncWebServerResponse;
 class UIManager;
 class Immobilizer;
 
@@ -57,6 +107,10 @@ public:
     void clearLogoReloadRequest() { logoReloadRequested = false; }
     bool isLogoUploadInProgress() const { return logoUploadInProgress; }
 
+    // SDO task — a tagged /cmd write or command result: applied to the
+    // parameter table here, then reported to the request if it is still waiting
+    void onSDOResult(const SDOResult& result);
+
     // PNG buffer — public so static lambdas in startServer() can access via instance->
     uint8_t* pngBuffer  = nullptr;
     size_t   pngBufLen  = 0;
@@ -74,6 +128,9 @@ public:
     void handleDialSettingsPost(AsyncWebServerRequest* request,
                                 uint8_t* data, size_t len,
                                 size_t index, size_t total);
+    void handleBMS(AsyncWebServerRequest* request);
+    void handleBMSSettingsGet(AsyncWebServerRequest* request);
+    void handleBMSSettingsPost(AsyncWebServerRequest* request);
     void handleHealthSettingsGet(AsyncWebServerRequest* request);
     void handleHealthSettingsPost(AsyncWebServerRequest* request,
                                   uint8_t* data, size_t len,
@@ -113,9 +170,14 @@ private:
     void stopServer();
 
     String cmdJson();
-    String cmdGet(const String& names);
-    String cmdGetRepeated(const String& names, int repeat);
-    String cmdSet(const String& name, const String& value);
+    AsyncWebServerResponse* cmdGetResponse(AsyncWebServerRequest* request,
+                                           const String& names, int repeat, int hz);
+    AsyncWebServerResponse* cmdSetResponse(AsyncWebServerRequest* request,
+                                           const String& name, const String& value);
+    AsyncWebServerResponse* cmdCommandResponse(AsyncWebServerRequest* request,
+                                               uint8_t command, int32_t value);
+    AsyncWebServerResponse* cmdWriteResponse(AsyncWebServerRequest* request,
+                                             uint32_t tag);
 
     String getContentType(const String& filename);
 };
@@ -0,0 +1,186 @@
+# =============================================================================
+# embed_web_assets.py — PlatformIO extra script
+#
+# Bakes data/ into the firmware so the web UI is served from flash without
+# touching SPIFFS (see include/WebAssets.h):
+#
+#   * every file is gzipped (kept as is when that does not save 10 %, and
+#     taken as is when data/ already holds "<name>.gz")
+#   * each stored file is named by the first 16 hex digits of its SHA-256
+#   * HTML src/href attributes naming a bundled asset get "?v=<hash>", so
+#     those URLs can be cached as immutable
+#   * /assets.json lists the bundle hash and every URL for sw.js to precache
+#
+# Output goes to $BUILD_DIR/webassets: webassets.bin (all the files back to
+# back) and WebAssetsData.cpp (the sorted index, with the blob pulled in by
+# .incbin). Both are regenerated on every build; identical input gives
+# identical output, so an unchanged data/ does not relink.
+#
+# platformio.ini:  custom_web_exclude = <names in data/ to leave out>
+# =============================================================================
+
+Import("env")
+
+import gzip
+import hashlib
+import io
+import json
+import os
+import re
+
+MIME = {
+    ".html": "text/html",
+    ".htm":  "text/html",
+    ".css":  "text/css",
+    ".js":   "application/javascript",
+    ".json": "application/json",
+    ".png":  "image/png",
+    ".gif":  "image/gif",
+    ".jpg":  "image/jpeg",
+    ".ico":  "image/x-icon",
+    ".svg":  "image/svg+xml",
+    ".dbc":  "text/plain",
+}
+
+# Changed at run time or never meant for the browser
+ALWAYS_EXCLUDE = {"params.json"}
+
+
+def sha16(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def gz(data):
+    buf = io.BytesIO()
+    # mtime=0 keeps the output (and so the hash) stable between builds
+    with gzip.GzipFile(fileobj=buf, mode="wb", compresslevel=9, mtime=0) as f:
+        f.write(data)
+    return buf.getvalue()
+
+
+def collect(data_dir, exclude):
+    """url path -> (raw bytes, already gzipped)"""
+    files = {}
+    for root, _, names in os.walk(data_dir):
+        for name in sorted(names):
+            rel = os.path.relpath(os.path.join(root, name), data_dir).replace(os.sep, "/")
+            if rel in exclude or name.endswith(".py") or name.startswith("."):
+                continue
+            with open(os.path.join(root, name), "rb") as f:
+                body = f.read()
+            if rel.endswith(".gz"):
+                files["/" + rel[:-3]] = (body, True)
+            elif ("/" + rel) not in files:        # a .gz twin wins
+                files["/" + rel] = (body, False)
+    return files
+
+
+def store(body, is_gz):
+    """(bytes as stored, gzip flag)"""
+    if is_gz:
+        return body, True
+    packed = gz(body)
+    if len(packed) < len(body) * 0.9:
+        return packed, True
+    return body, False
+
+
+def pin_references(html, versions):
+    """src="x.js" → src="x.js?v=<hash>" for bundled, non-HTML assets"""
+    def repl(m):
+        attr, quote, url = m.group(1), m.group(2), m.group(3)
+        path = url if url.startswith("/") else "/" + url
+        v = versions.get(path)
+        if not v or path.endswith(".html"):
+            return m.group(0)
+        return '%s=%s%s?v=%s%s' % (attr, quote, url, v, quote)
+    return re.sub(r'\b(src|href)=(["\'])([A-Za-z0-9_./-]+)\2', repl, html)
+
+
+def build(data_dir, out_dir, exclude):
+    files = collect(data_dir, exclude)
+    stored = {}
+
+    # Everything but HTML first — the pages need those hashes
+    for path, (body, is_gz) in files.items():
+        if not path.endswith(".html"):
+            stored[path] = store(body, is_gz)
+    versions = {p: sha16(d) for p, (d, _) in stored.items()}
+
+    for path, (body, is_gz) in files.items():
+        if path.endswith(".html") and not is_gz:
+            body = pin_references(body.decode("utf-8"), versions).encode("utf-8")
+        if path.endswith(".html"):
+            stored[path] = store(body, is_gz)
+            versions[path] = sha16(stored[path][0])
+
+    bundle = sha16("".join(p + versions[p] for p in sorted(versions)).encode())
+
+    # Precache list: pages as they are (they revalidate), the rest pinned.
+    # sw.js is fetched by the browser itself and never cached.
+    urls = ["/"]
+    for p in sorted(stored):
+        if p == "/sw.js":
+            continue
+        urls.append(p if p.endswith(".html") else "%s?v=%s" % (p, versions[p]))
+    manifest = json.dumps({"bundle": bundle, "assets": urls}, separators=(",", ":"))
+    stored["/assets.json"] = store(manifest.encode(), False)
+    versions["/assets.json"] = sha16(stored["/assets.json"][0])
+
+    os.makedirs(out_dir, exist_ok=True)
+    blob = bytearray()
+    entries = []
+    for path in sorted(stored):
+        data, is_gz = stored[path]
+        ext = os.path.splitext(path)[1].lower()
+        entries.append((path, MIME.get(ext, "application/octet-stream"),
+                        versions[path], len(blob), len(data), is_gz))
+        blob += data
+        blob += b"\0" * (-len(blob) % 4)
+
+    write_if_changed(os.path.join(out_dir, "webassets.bin"), bytes(blob))
+
+    incbin = os.path.join(out_dir, "webassets.bin").replace("\\", "/")
+    lines = [
+        "// Generated by scripts/embed_web_assets.py from data/ — do not edit",
+        '#include "WebAssets.h"',
+        "",
+        'asm(".section .rodata.webassets\\n"',
+        '    ".balign 4\\n"',
+        '    ".global webAssetBlob\\n"',
+        '    "webAssetBlob:\\n"',
+        '    ".incbin \\"%s\\"\\n"' % incbin,
+        '    ".previous\\n");',
+        "",
+        'extern const char webAssetBundle[] = "%s";' % bundle,
+        "extern const uint16_t webAssetCount = %d;" % len(entries),
+        "extern const WebAsset webAssetIndex[] = {",
+    ]
+    for path, mime, h, off, n, is_gz in entries:
+        lines.append('    { "%s", "%s", "%s", %d, %d, %s },'
+                     % (path, mime, h, off, n, "true" if is_gz else "false"))
+    lines.append("};")
+    write_if_changed(os.path.join(out_dir, "WebAssetsData.cpp"),
+                     ("\n".join(lines) + "\n").encode())
+
+    raw = sum(len(b) for b, _ in files.values())
+    print("[webassets] %d files, %d bytes from %d (bundle %s)"
+          % (len(entries), len(blob), raw, bundle))
+
+
+def write_if_changed(path, data):
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            if f.read() == data:
+                return
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+exclude = set(ALWAYS_EXCLUDE)
+if env.GetProjectOption("custom_web_exclude", ""):
+    exclude.update(env.GetProjectOption("custom_web_exclude").split())
+
+out_dir = os.path.join(env.subst("$BUILD_DIR"), "webassets")
+build(env.subst("$PROJECT_DATA_DIR"), out_dir, exclude)
+env.BuildSources(os.path.join("$BUILD_DIR", "webassets_obj"), out_dir)
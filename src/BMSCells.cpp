@@ -0,0 +1,224 @@
+// ============================================================================
+// BMSCells.cpp
+// ============================================================================
+
+#include "BMSCells.h"
+#include <Preferences.h>
+
+static const char* NVS_NS = "bmscfg";
+
+// Integer square root — stddev without float
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) { v -= r + bit; r = (r >> 1) + bit; }
+        else              { r >>= 1; }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+BMSCells::BMSCells() : _layout(defaultLayout()), _pendingSet(false) {
+    reset();
+}
+
+// Legacy layout: 0x400-0x417 and 0x600-0x617, four little-endian cells per
+// frame, both banks starting at cell 0 (96 cells, as before)
+BMSLayout BMSCells::defaultLayout() {
+    BMSLayout l;
+    memset(&l, 0, sizeof(l));
+    l.type          = BMSType::SEQUENTIAL;
+    l.cellsPerFrame = 4;
+    l.bigEndian     = false;
+    l.rangeCount    = 2;
+    l.ranges[0]     = { 0x400, 24, 0 };
+    l.ranges[1]     = { 0x600, 24, 0 };
+    return l;
+}
+
+void BMSCells::begin() {
+    loadFromNVS();
+}
+
+void BMSCells::loadFromNVS() {
+    Preferences prefs;
+    prefs.begin(NVS_NS, true);
+    BMSLayout l;
+    size_t len = prefs.getBytes("layout", &l, sizeof(l));
+    prefs.end();
+    setLayout(len == sizeof(l) ? l : defaultLayout());
+    Serial.printf("[BMS] Layout: type=%d ranges=%d cells/frame=%d %s\n",
+        (int)_layout.type, _layout.rangeCount, _layout.cellsPerFrame,
+        _layout.bigEndian ? "BE" : "LE");
+}
+
+void BMSCells::saveToNVS() {
+    Preferences prefs;
+    prefs.begin(NVS_NS, false);
+    prefs.putBytes("layout", &_layout, sizeof(_layout));
+    prefs.end();
+    Serial.println("[BMS] Layout saved to NVS");
+}
+
+void BMSCells::setLayout(const BMSLayout& layout) {
+    _layout = layout;
+    if ((uint8_t)_layout.type > (uint8_t)BMSType::MUXED) _layout.type = BMSType::OFF;
+    uint8_t maxCpf = (_layout.type == BMSType::MUXED) ? 3 : 4;
+    _layout.cellsPerFrame = constrain(_layout.cellsPerFrame, 1, maxCpf);
+    if (_layout.rangeCount > BMS_MAX_RANGES) _layout.rangeCount = BMS_MAX_RANGES;
+    for (uint8_t r = 0; r < _layout.rangeCount; r++) {
+        BMSRange& rg = _layout.ranges[r];
+        if (rg.baseId > 0x7FF) rg.baseId = 0x7FF;
+        if (rg.firstCell >= BMS_MAX_CELLS) rg.firstCell = BMS_MAX_CELLS - 1;
+        // Clip so the range never addresses past the cell table
+        uint16_t maxFrames = (BMS_MAX_CELLS - rg.firstCell + _layout.cellsPerFrame - 1)
+                             / _layout.cellsPerFrame;
+        if (rg.frames > maxFrames) rg.frames = maxFrames;
+        if (_layout.type == BMSType::SEQUENTIAL && rg.baseId + rg.frames > 0x800)
+            rg.frames = 0x800 - rg.baseId;
+    }
+    reset();
+}
+
+void BMSCells::applyPending() {
+    if (!_pendingSet) return;
+    _pendingSet = false;
+    setLayout(_pending);
+    saveToNVS();
+}
+
+void BMSCells::reset() {
+    for (uint16_t i = 0; i < BMS_MAX_CELLS; i++) {
+        _mv[i] = 0; _updated[i] = 0; _valid[i] = false;
+        _emaQ[i] = 0; _anchorQ[i] = 0; _anchorTime[i] = 0; _slope[i] = 0;
+        _minTree[BMS_MAX_CELLS + i] = i;
+        _maxTree[BMS_MAX_CELLS + i] = i;
+    }
+    for (uint16_t n = BMS_MAX_CELLS - 1; n >= 1; n--) {
+        _minTree[n] = _minTree[2 * n];
+        _maxTree[n] = _maxTree[2 * n];
+    }
+    _highCell = 0;
+    _count    = 0;
+    _sum      = 0;
+    _sumSq    = 0;
+    _slopeSum = 0;
+}
+
+// ---------------------------------------------------------------------------
+// handleFrame — map a frame onto cell indices via the layout
+// ---------------------------------------------------------------------------
+bool BMSCells::handleFrame(uint32_t id, const uint8_t* data, uint8_t len, uint32_t now) {
+    if (_layout.type == BMSType::OFF) return false;
+
+    for (uint8_t r = 0; r < _layout.rangeCount; r++) {
+        const BMSRange& rg = _layout.ranges[r];
+        uint16_t group;
+        const uint8_t* p = data;
+        uint8_t avail;
+
+        if (_layout.type == BMSType::SEQUENTIAL) {
+            if (id < rg.baseId || id >= (uint32_t)rg.baseId + rg.frames) continue;
+            group = id - rg.baseId;
+            avail = len / 2;
+        } else {
+            if (id != rg.baseId || len < 1) continue;
+            group = data[0];
+            if (group >= rg.frames) return true;   // ours, but out of range
+            p = data + 1;
+            avail = (len - 1) / 2;
+        }
+
+        uint8_t cells = avail < _layout.cellsPerFrame ? avail : _layout.cellsPerFrame;
+        uint16_t base = rg.firstCell + group * _layout.cellsPerFrame;
+        for (uint8_t i = 0; i < cells; i++) {
+            uint16_t mv = _layout.bigEndian ? (uint16_t)((p[i*2] << 8) | p[i*2+1])
+                                            : (uint16_t)(p[i*2] | (p[i*2+1] << 8));
+            if (base + i < BMS_MAX_CELLS) setCell(base + i, mv, now);
+        }
+        return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// setCell — O(log n) statistics update
+// ---------------------------------------------------------------------------
+void BMSCells::setCell(uint16_t cell, uint16_t mv, uint32_t now) {
+    if (_valid[cell]) {
+        int32_t old = _mv[cell];
+        _sum   += (int32_t)mv - old;
+        _sumSq += (int64_t)mv * mv - (int64_t)old * old;
+        _emaQ[cell] += (((int32_t)mv << 4) - _emaQ[cell]) >> 3;
+    } else {
+        _valid[cell] = true;
+        _count++;
+        _sum   += mv;
+        _sumSq += (int64_t)mv * mv;
+        _emaQ[cell]       = (int32_t)mv << 4;
+        _anchorQ[cell]    = _emaQ[cell];
+        _anchorTime[cell] = now;
+        if (cell >= _highCell) _highCell = cell + 1;
+    }
+    _mv[cell]      = mv;
+    _updated[cell] = now;
+
+    // Trend — slope of the smoothed voltage between anchor samples,
+    // itself smoothed so single noisy intervals don't flag a cell
+    uint32_t dt = now - _anchorTime[cell];
+    if (dt >= BMS_SLOPE_INTERVAL_MS) {
+        int64_t s = (int64_t)(_emaQ[cell] - _anchorQ[cell]) * 600000 / 16 / dt;   // 0.1 mV/min
+        s = constrain(s, -32768, 32767);
+        int16_t next = (int16_t)((_slope[cell] * 3 + (int32_t)s) / 4);
+        _slopeSum += next - _slope[cell];
+        _slope[cell]      = next;
+        _anchorQ[cell]    = _emaQ[cell];
+        _anchorTime[cell] = now;
+    }
+
+    updateTrees(cell);
+}
+
+uint16_t BMSCells::pickMin(uint16_t a, uint16_t b) const {
+    if (!_valid[a]) return b;
+    if (!_valid[b]) return a;
+    return _mv[b] < _mv[a] ? b : a;
+}
+
+uint16_t BMSCells::pickMax(uint16_t a, uint16_t b) const {
+    if (!_valid[a]) return b;
+    if (!_valid[b]) return a;
+    return _mv[b] > _mv[a] ? b : a;
+}
+
+void BMSCells::updateTrees(uint16_t cell) {
+    for (uint16_t n = (BMS_MAX_CELLS + cell) >> 1; n >= 1; n >>= 1) {
+        _minTree[n] = pickMin(_minTree[2 * n], _minTree[2 * n + 1]);
+        _maxTree[n] = pickMax(_maxTree[2 * n], _maxTree[2 * n + 1]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// getStats — O(1), everything is already maintained
+// ---------------------------------------------------------------------------
+BMSStats BMSCells::getStats() const {
+    BMSStats s;
+    memset(&s, 0, sizeof(s));
+    s.count = _count;
+    if (!_count) return s;
+
+    s.minIdx  = _minTree[1];
+    s.maxIdx  = _maxTree[1];
+    s.minMv   = _mv[s.minIdx];
+    s.maxMv   = _mv[s.maxIdx];
+    s.deltaMv = s.maxMv - s.minMv;
+    s.meanDmv = (int32_t)((_sum * 10 + _count / 2) / _count);
+
+    // var (0.1 mV)² = 100 × (n·Σx² − (Σx)²) / n²
+    int64_t num = (int64_t)_count * _sumSq - _sum * _sum;
+    if (num < 0) num = 0;
+    s.stddevDmv = (int32_t)isqrt64((uint64_t)(num * 100) / ((uint64_t)_count * _count));
+    s.meanSlope = (int16_t)(_slopeSum / _count);
+    return s;
+}
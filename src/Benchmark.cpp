@@ -0,0 +1,703 @@
+// ============================================================================
+// Benchmark.cpp
+// ============================================================================
+
+#include "Benchmark.h"
+#include "FixedPoint.h"
+#include "CANData.h"
+#include "CANLogger.h"
+#include "CANMonitor.h"
+#include "GVRETServer.h"
+#include "SLCANServer.h"
+#include "CannelloniBridge.h"
+#include "SpotStream.h"
+#include "HeapChurn.h"
+#include "Storage.h"
+#include "MsgPack.h"
+#include "TripLogger.h"
+#include "FaultLogger.h"
+#include "CANTxScheduler.h"
+#include <esp_timer.h>
+
+typedef String (*BenchFn)();
+
+struct BenchCase {
+    const char* name;
+    BenchFn     fn;
+};
+
+// Keeps the optimiser from discarding the formatted output
+static volatile uint32_t s_sink = 0;
+
+// ---------------------------------------------------------------------------
+// format — FixedPoint::format vs snprintf("%.2f") over a spread of values
+// ---------------------------------------------------------------------------
+static String benchFormat() {
+    const int N = 20000;
+    char buf[24];
+
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < N; i++) {
+        int32_t fixed = (i * 7919) - 50000;        // ±500.00 with 2 decimals
+        s_sink += FixedPoint::format(buf, sizeof(buf), fixed, 2);
+    }
+    int64_t t1 = esp_timer_get_time();
+    for (int i = 0; i < N; i++) {
+        float f = ((i * 7919) - 50000) / 100.0f;
+        s_sink += snprintf(buf, sizeof(buf), "%.2f", f);
+    }
+    int64_t t2 = esp_timer_get_time();
+
+    char out[160];
+    snprintf(out, sizeof(out),
+        "{\"name\":\"format\",\"n\":%d,\"fixed_us\":%lld,\"printf_us\":%lld,"
+        "\"fixed_ns_per\":%lld,\"printf_ns_per\":%lld}",
+        N, (long long)(t1 - t0), (long long)(t2 - t1),
+        (long long)((t1 - t0) * 1000 / N), (long long)((t2 - t1) * 1000 / N));
+    return String(out);
+}
+
+// ---------------------------------------------------------------------------
+// seqlock — dual-core stress test for CANParameter::store / snapshot
+//
+// One writer and one reader task are pinned to each core, all hammering a
+// private CANParameter for SEQLOCK_STRESS_MS. Writers keep the invariant
+// lastUpdateTime == valueInt * 7, so any snapshot that breaks it is torn.
+// Readers also do an unprotected two-field read for contrast: raw_torn > 0
+// shows the race is really being exercised. Pass = torn == 0.
+// ---------------------------------------------------------------------------
+#define SEQLOCK_STRESS_MS  1000
+
+struct StressCounters {
+    uint32_t ops;       // writes (writer) or snapshots (reader)
+    uint32_t torn;      // snapshots that broke the invariant
+    uint32_t gaveUp;    // snapshot() returned false
+    uint32_t rawTorn;   // unprotected reads that broke the invariant
+};
+
+static CANParameter        s_stressParam;
+static std::atomic<bool>    s_stressRun(false);
+static std::atomic<uint8_t> s_stressDone(0);
+static StressCounters      s_stress[4];    // writer0, writer1, reader0, reader1
+
+static void stressWriter(void* arg) {
+    uint32_t core = (uint32_t)arg;
+    StressCounters& c = s_stress[core];
+    for (uint32_t i = 0; s_stressRun; i++) {
+        int32_t v = (int32_t)((i << 1) | core);   // distinct per writer
+        s_stressParam.store(v, (uint32_t)v * 7u);
+        c.ops++;
+        if ((i & 1023) == 1023) vTaskDelay(1);     // let IDLE feed the watchdog
+    }
+    s_stressDone++;
+    vTaskDelete(nullptr);
+}
+
+static void stressReader(void* arg) {
+    uint32_t core = (uint32_t)arg;
+    StressCounters& c = s_stress[2 + core];
+    volatile int32_t*  rawVal  = &s_stressParam.valueInt;
+    volatile uint32_t* rawTime = &s_stressParam.lastUpdateTime;
+    for (uint32_t i = 0; s_stressRun; i++) {
+        ParamSnapshot snap;
+        if (!s_stressParam.snapshot(snap)) c.gaveUp++;
+        else if (snap.lastUpdateTime != (uint32_t)snap.valueInt * 7u) c.torn++;
+        c.ops++;
+
+        int32_t  v = *rawVal;
+        uint32_t t = *rawTime;
+        if (t != (uint32_t)v * 7u) c.rawTorn++;
+
+        if ((i & 1023) == 1023) vTaskDelay(1);
+    }
+    s_stressDone++;
+    vTaskDelete(nullptr);
+}
+
+static String benchSeqlock() {
+    memset(s_stress, 0, sizeof(s_stress));
+    s_stressParam.periodFixed = true;   // skip period learning — not under test
+    s_stressParam.store(0, 0);
+    s_stressDone = 0;
+    s_stressRun  = true;
+
+    for (uint32_t core = 0; core < 2; core++) {
+        xTaskCreatePinnedToCore(stressWriter, "seqW", 2048, (void*)core, 1, nullptr, core);
+        xTaskCreatePinnedToCore(stressReader, "seqR", 2048, (void*)core, 1, nullptr, core);
+    }
+    vTaskDelay(pdMS_TO_TICKS(SEQLOCK_STRESS_MS));
+    s_stressRun = false;
+    while (s_stressDone < 4) vTaskDelay(1);
+
+    uint32_t writes = s_stress[0].ops + s_stress[1].ops;
+    uint32_t reads  = s_stress[2].ops + s_stress[3].ops;
+    uint32_t torn   = s_stress[2].torn + s_stress[3].torn;
+    uint32_t gaveUp = s_stress[2].gaveUp + s_stress[3].gaveUp;
+    uint32_t raw    = s_stress[2].rawTorn + s_stress[3].rawTorn;
+
+    char out[200];
+    snprintf(out, sizeof(out),
+        "{\"name\":\"seqlock\",\"ms\":%d,\"writes\":%lu,\"snapshots\":%lu,"
+        "\"torn\":%lu,\"gave_up\":%lu,\"raw_torn\":%lu,\"pass\":%s}",
+        SEQLOCK_STRESS_MS, (unsigned long)writes, (unsigned long)reads,
+        (unsigned long)torn, (unsigned long)gaveUp, (unsigned long)raw,
+        torn == 0 ? "true" : "false");
+    return String(out);
+}
+
+// ---------------------------------------------------------------------------
+// canlog — sustained binary logging rate vs the old synchronous CSV path
+//
+// A private CANLogger (own double buffer and writer task) is offered
+// synthetic frames as fast as this task can produce them for
+// CANLOG_BENCH_MS. logged_fps counts only frames that reached flash, over
+// the time until the writer closed the file; dropped is what the double
+// buffer had to refuse. The CSV baseline formats and println()s
+// CANLOG_BENCH_CSV rows synchronously, the way pushFrame used to.
+// Scratch files are removed afterwards.
+// ---------------------------------------------------------------------------
+#define CANLOG_BENCH_MS    2000
+#define CANLOG_BENCH_CSV   1000
+
+static String benchCanLog() {
+    if (CANMonitor::instance().getLogState() == LogState::LOGGING)
+        return "{\"error\":\"stop the CAN log first\"}";
+
+    CANLogger log;
+    if (!log.init()) return "{\"error\":\"no memory for log buffers\"}";
+    if (!log.start("/canbench.bin", CAN_BAUDRATE)) {
+        log.end();
+        return "{\"error\":\"cannot open /canbench.bin\"}";
+    }
+
+    twai_message_t msg = {};
+    msg.data_length_code = 8;
+    uint32_t offered  = 0;
+    int64_t  appendUs = 0;
+    int64_t  t0  = esp_timer_get_time();
+    int64_t  end = t0 + CANLOG_BENCH_MS * 1000LL;
+    while (esp_timer_get_time() < end) {
+        int64_t a0 = esp_timer_get_time();
+        for (int i = 0; i < 256; i++) {
+            msg.identifier = 0x100 + (offered & 0x3FF);
+            memcpy(msg.data, &offered, sizeof(offered));
+            log.append(msg, esp_timer_get_time());
+            offered++;
+        }
+        appendUs += esp_timer_get_time() - a0;
+        vTaskDelay(1);   // give the writer and IDLE the CPU, as loopTask does
+    }
+    log.requestStop();
+    log.poll();
+    int64_t t1 = esp_timer_get_time();
+    while (log.state() != LogState::STOPPED && esp_timer_get_time() - t1 < 3000000LL)
+        vTaskDelay(1);
+    int64_t t2 = esp_timer_get_time();
+
+    uint32_t logged  = log.frames();
+    uint32_t dropped = log.dropped();
+    uint32_t errors  = log.writeErrors();
+    uint32_t binSize = 0;
+    {
+        File f = Storage::fs().open("/canbench.bin", "r");
+        if (f) binSize = f.size();
+    }
+    log.end();
+    Storage::fs().remove("/canbench.bin");
+
+    // Baseline — one snprintf + println per frame straight to the filesystem
+    uint32_t csvRows = 0, csvSize = 0;
+    int64_t  c0 = esp_timer_get_time();
+    File csv = Storage::fs().open("/canbench.csv", "w");
+    if (csv) {
+        char row[200];
+        for (uint32_t i = 0; i < CANLOG_BENCH_CSV; i++) {
+            uint8_t d[8];
+            memcpy(d, &i, sizeof(i));
+            memset(d + 4, 0, 4);
+            snprintf(row, sizeof(row),
+                "%u,0x%03X,%s,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%s",
+                (unsigned)millis(), (unsigned)(0x100 + (i & 0x3FF)), "", 8,
+                d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7], "");
+            csv.println(row);
+            csvRows++;
+        }
+        csvSize = csv.size();
+        csv.close();
+    }
+    int64_t c1 = esp_timer_get_time();
+    Storage::fs().remove("/canbench.csv");
+
+    int64_t total = t2 - t0;
+    char out[420];
+    snprintf(out, sizeof(out),
+        "{\"name\":\"canlog\",\"ms\":%d,\"offered\":%lu,\"logged\":%lu,\"dropped\":%lu,"
+        "\"write_errors\":%lu,\"flush_ms\":%lld,\"logged_fps\":%lld,\"append_ns_per\":%lld,"
+        "\"bin_bytes\":%lu,\"csv_rows\":%lu,\"csv_fps\":%lld,\"csv_bytes_per\":%lu}",
+        CANLOG_BENCH_MS, (unsigned long)offered, (unsigned long)logged, (unsigned long)dropped,
+        (unsigned long)errors, (long long)((t2 - t1) / 1000),
+        (long long)(total > 0 ? (int64_t)logged * 1000000 / total : 0),
+        (long long)(offered ? appendUs * 1000 / offered : 0),
+        (unsigned long)binSize, (unsigned long)csvRows,
+        (long long)(c1 > c0 ? (int64_t)csvRows * 1000000 / (c1 - c0) : 0),
+        (unsigned long)(csvRows ? csvSize / csvRows : 0));
+    return String(out);
+}
+
+// ---------------------------------------------------------------------------
+// bridges — bytes and CPU per frame for each network bridge encoder, fed
+// from HistoryFrame slots as the bridge task feeds them. The mix is mostly
+// 8-byte standard frames with some extended, short and remote ones, like
+// the ZombieVerter bus. cannelloni is packed into CANNELLONI_MTU datagrams
+// so its header is counted per frame.
+// ---------------------------------------------------------------------------
+#define BRIDGE_BENCH_FRAMES  20000
+#define BRIDGE_BENCH_MIX     64
+
+static String benchBridges() {
+    static HistoryFrame mix[BRIDGE_BENCH_MIX];
+    for (int i = 0; i < BRIDGE_BENCH_MIX; i++) {
+        HistoryFrame& f = mix[i];
+        memset(&f, 0, sizeof(f));
+        uint8_t dlc = (i % 8 == 7) ? 2 : 8;
+        f.us          = 1000u * i;
+        f.rec.tsDlc   = ((uint32_t)dlc << CANLOG_TS_BITS) | (f.us & CANLOG_TS_MASK);
+        f.rec.idFlags = (i % 10 == 3) ? (0x18FF50E5u | CANLOG_EXT) : (0x100u + i * 7) & 0x7FF;
+        if (i % 16 == 9) f.rec.idFlags |= CANLOG_RTR;
+        for (int b = 0; b < 8; b++) f.rec.data[b] = (uint8_t)(i * 31 + b);
+    }
+
+    static uint8_t out[CANNELLONI_MTU];
+    const int N = BRIDGE_BENCH_FRAMES;
+    struct Row { const char* name; int64_t us; uint32_t bytes; uint32_t extra; };
+    Row rows[4];
+
+    // GVRET
+    uint32_t bytes = 0, sink = 0;
+    int64_t  t0 = esp_timer_get_time();
+    for (int i = 0; i < N; i++) {
+        size_t n = GVRETServer::encodeFrame(out, mix[i % BRIDGE_BENCH_MIX]);
+        bytes += n;
+        sink  += out[n - 2];
+    }
+    rows[0] = { "gvret", esp_timer_get_time() - t0, bytes, 0 };
+
+    // SLCAN, without and with Z1 timestamps
+    for (int z = 0; z < 2; z++) {
+        bytes = 0;
+        t0 = esp_timer_get_time();
+        for (int i = 0; i < N; i++) {
+            size_t n = SLCANServer::encodeFrame(out, mix[i % BRIDGE_BENCH_MIX], z != 0);
+            bytes += n;
+            sink  += out[n - 2];
+        }
+        rows[1 + z] = { z ? "slcan_ts" : "slcan", esp_timer_get_time() - t0, bytes, 0 };
+    }
+
+    // cannelloni — datagram header once per full MTU
+    bytes = 0;
+    uint32_t datagrams = 0;
+    size_t   len = CANNELLONI_HEADER;
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < N; i++) {
+        if (len + CANNELLONI_RECORD_MAX > sizeof(out)) {
+            bytes += len;
+            sink  += out[len - 1];
+            datagrams++;
+            len = CANNELLONI_HEADER;
+        }
+        len += CannelloniBridge::encodeFrame(out + len, mix[i % BRIDGE_BENCH_MIX]);
+    }
+    bytes += len;
+    datagrams++;
+    rows[3] = { "cannelloni", esp_timer_get_time() - t0, bytes, datagrams };
+    s_sink = sink;
+
+    String json = "{\"name\":\"bridges\",\"frames\":";
+    json += N;
+    json += ",\"protocols\":[";
+    for (int r = 0; r < 4; r++) {
+        char row[160];
+        snprintf(row, sizeof(row),
+            "%s{\"name\":\"%s\",\"bytes_per\":%lu.%02lu,\"ns_per\":%lld,\"fps\":%lld%s",
+            r ? "," : "", rows[r].name,
+            (unsigned long)(rows[r].bytes / N), (unsigned long)(rows[r].bytes % N * 100 / N),
+            (long long)(rows[r].us * 1000 / N),
+            (long long)(rows[r].us > 0 ? (int64_t)N * 1000000 / rows[r].us : 0),
+            rows[r].extra ? "" : "}");
+        json += row;
+        if (rows[r].extra) {
+            json += ",\"datagrams\":";
+            json += rows[r].extra;
+            json += "}";
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+// ---------------------------------------------------------------------------
+// json — a full MAX_PARAMETERS /spot, built the way handleSpot used to
+// (String +=) and through SpotBody into TCP-segment-sized chunks, as
+// JsonStream does. Heap allocations are counted with HeapChurn, borrowed
+// from the CAN loop for the duration, so /can/stats hotPathAllocs may pick
+// up a few of the bench's own while it runs. Without HEAP_CHURN the
+// allocs_per figures are 0 and "allocs" is false.
+// ---------------------------------------------------------------------------
+#define JSON_BENCH_RUNS   50
+#define JSON_BENCH_CHUNK  1436
+
+static CANParameter s_jsonParams[MAX_PARAMETERS];
+
+// The table the /spot benches render — values, names and a few stale flags
+static void jsonBenchParams(ParamSnapshot* snap) {
+    for (int i = 0; i < MAX_PARAMETERS; i++) {
+        CANParameter& p = s_jsonParams[i];
+        char name[16];
+        snprintf(name, sizeof(name), "param%03d", i);
+        p.setName(name);
+        p.scale = FixedPoint::sdoDefault();
+        p.store((int32_t)((i * 7919) % 200000) - 100000, 1 + i);
+        p.snapshot(snap[i]);
+        snap[i].stale = i % 16 == 5;
+    }
+}
+
+static String benchJson() {
+    static ParamSnapshot snap[MAX_PARAMETERS];
+    jsonBenchParams(snap);
+
+    TaskHandle_t prev = HeapChurn::tracked();
+    HeapChurn::track(nullptr);
+    const int N = JSON_BENCH_RUNS;
+
+    // String concatenation
+    size_t   strBytes = 0;
+    uint32_t a0 = HeapChurn::count();
+    int64_t  t0 = esp_timer_get_time();
+    for (int r = 0; r < N; r++) {
+        String json = "{";
+        bool first = true;
+        for (int i = 0; i < MAX_PARAMETERS; i++) {
+            char valBuf[16];
+            FixedPoint::format(valBuf, sizeof(valBuf), snap[i].valueInt,
+                               s_jsonParams[i].getDecimals());
+            if (!first) json += ",";
+            json += "\"";
+            json += s_jsonParams[i].name;
+            json += "\":";
+            json += valBuf;
+            first = false;
+        }
+        String stale;
+        for (int i = 0; i < MAX_PARAMETERS; i++) {
+            if (!snap[i].stale) continue;
+            if (stale.length()) stale += ",";
+            stale += "\"";
+            stale += s_jsonParams[i].name;
+            stale += "\"";
+        }
+        json += ",\"_stale\":[";
+        json += stale;
+        json += "]}";
+        strBytes = json.length();
+        s_sink += strBytes;
+    }
+    int64_t  t1 = esp_timer_get_time();
+    uint32_t a1 = HeapChurn::count();
+
+    // SpotBody — snapshot copy included, as handleSpot takes it into the body
+    static uint8_t chunk[JSON_BENCH_CHUNK];
+    size_t   bodyBytes = 0;
+    uint32_t chunks = 0;
+    for (int r = 0; r < N; r++) {
+        std::shared_ptr<SpotBody> body =
+            std::make_shared<SpotBody>(s_jsonParams, 0, "00000000-0", false);
+        body->counted = false;
+        memcpy(body->snap, snap, sizeof(snap));
+        body->count = MAX_PARAMETERS;
+        bodyBytes = 0;
+        size_t n;
+        while ((n = JsonStream::fill(*body, chunk, sizeof(chunk))) != 0 && n <= sizeof(chunk)) {
+            bodyBytes += n;
+            chunks++;
+            s_sink += chunk[n - 1];
+        }
+    }
+    int64_t  t2 = esp_timer_get_time();
+    uint32_t a2 = HeapChurn::count();
+    if (prev) HeapChurn::track(prev);
+
+    char out[320];
+    snprintf(out, sizeof(out),
+        "{\"name\":\"json\",\"params\":%d,\"runs\":%d,\"allocs\":%s,"
+        "\"string\":{\"us_per\":%lld,\"allocs_per\":%lu.%02lu,\"bytes\":%u},"
+        "\"stream\":{\"us_per\":%lld,\"allocs_per\":%lu.%02lu,\"bytes\":%u,\"chunks_per\":%lu}}",
+        MAX_PARAMETERS, N, HeapChurn::enabled() ? "true" : "false",
+        (long long)((t1 - t0) / N),
+        (unsigned long)((a1 - a0) / N), (unsigned long)((a1 - a0) % N * 100 / N),
+        (unsigned)strBytes,
+        (long long)((t2 - t1) / N),
+        (unsigned long)((a2 - a1) / N), (unsigned long)((a2 - a1) % N * 100 / N),
+        (unsigned)bodyBytes, (unsigned long)(chunks / N));
+    return String(out);
+}
+
+// ---------------------------------------------------------------------------
+// fs — open / exists / append / sequential throughput on the mounted
+// filesystem, next to the SPIFFS run taken before the LittleFS migration
+// ---------------------------------------------------------------------------
+static String benchFs() {
+    FsBenchResult now;
+    String out = "{\"name\":\"fs\",\"total_bytes\":";
+    out += String((uint32_t)Storage::totalBytes());
+    out += ",\"used_bytes\":";
+    out += String((uint32_t)Storage::usedBytes());
+    out += ",\"current\":";
+    if (Storage::bench(now)) Storage::benchJson(out, now);
+    else                     out += "null";
+    out += ",\"before_migration\":";
+    FsBenchResult before = Storage::migrationBench();
+    if (before.valid) Storage::benchJson(out, before);
+    else              out += "null";
+    out += "}";
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// msgpack — payload bytes and serialise time of the content-negotiated
+// variants against their JSON (CSV for /log) originals: /spot over the
+// json bench's table, the fault and trip exports over what is logged on
+// this dial, and the params.json document, serialised from memory
+// ---------------------------------------------------------------------------
+#define MSGPACK_BENCH_RUNS  20
+
+struct FormatCost { uint32_t bytes; int64_t us; };
+
+static FormatCost benchSpotFormat(const ParamSnapshot* snap, bool msgpack) {
+    static uint8_t chunk[JSON_BENCH_CHUNK];
+    FormatCost c = { 0, 0 };
+    int64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < MSGPACK_BENCH_RUNS; r++) {
+        std::shared_ptr<SpotBody> body =
+            std::make_shared<SpotBody>(s_jsonParams, 0, "00000000-0", false);
+        body->counted = false;
+        body->msgpack = msgpack;
+        memcpy(body->snap, snap, sizeof(ParamSnapshot) * MAX_PARAMETERS);
+        body->count = MAX_PARAMETERS;
+        c.bytes = 0;
+        size_t n;
+        while ((n = JsonStream::fill(*body, chunk, sizeof(chunk))) != 0 && n <= sizeof(chunk)) {
+            c.bytes += n;
+            s_sink += chunk[n - 1];
+        }
+    }
+    c.us = (esp_timer_get_time() - t0) / MSGPACK_BENCH_RUNS;
+    return c;
+}
+
+static FormatCost benchExportFormat(ExportOpen open, uint8_t format) {
+    uint8_t piece[EXPORT_PIECE_MAX];
+    FormatCost c = { 0, 0 };
+    int64_t t0 = esp_timer_get_time();
+    std::unique_ptr<ExportSource> src(open("", format));
+    size_t n;
+    while (src && (n = src->next(piece, sizeof(piece))) != 0) {
+        c.bytes += n;
+        s_sink += piece[n - 1];
+    }
+    c.us = esp_timer_get_time() - t0;
+    return c;
+}
+
+static void appendCosts(String& out, const char* name, const FormatCost& text,
+                        const FormatCost& mp) {
+    char buf[128];
+    snprintf(buf, sizeof(buf),
+        ",\"%s\":{\"text_bytes\":%u,\"text_us\":%lld,\"msgpack_bytes\":%u,\"msgpack_us\":%lld}",
+        name, (unsigned)text.bytes, (long long)text.us, (unsigned)mp.bytes, (long long)mp.us);
+    out += buf;
+}
+
+static String benchMsgPack() {
+    static ParamSnapshot snap[MAX_PARAMETERS];
+    jsonBenchParams(snap);
+
+    String out = "{\"name\":\"msgpack\"";
+    appendCosts(out, "spot", benchSpotFormat(snap, false), benchSpotFormat(snap, true));
+    appendCosts(out, "faults",
+        benchExportFormat(FaultLogger::openExport, (uint8_t)FaultExport::JSON),
+        benchExportFormat(FaultLogger::openExport, (uint8_t)FaultExport::MSGPACK));
+    appendCosts(out, "triplog",
+        benchExportFormat(TripLogger::openExport, (uint8_t)TripExport::CSV),
+        benchExportFormat(TripLogger::openExport, (uint8_t)TripExport::MSGPACK));
+
+    // The schema — the response itself is a file read either way, so this
+    // is the one-off conversion cost next to re-serialising the JSON
+    File f = Storage::fs().open("/params.json", "r");
+    if (f) {
+        JsonDocument doc;
+        bool ok = deserializeJson(doc, f) == DeserializationError::Ok;
+        f.close();
+        if (ok) {
+            FormatCost text, mp;
+            int64_t t0 = esp_timer_get_time();
+            text.bytes = measureJson(doc);
+            int64_t t1 = esp_timer_get_time();
+            mp.bytes = measureMsgPack(doc);
+            int64_t t2 = esp_timer_get_time();
+            text.us = t1 - t0;
+            mp.us   = t2 - t1;
+            appendCosts(out, "params", text, mp);
+        }
+    }
+    out += "}";
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// fetch — the boot-time params upload (CANDataManager::sdoUpload) of
+// multi-KB schemas from an in-memory VCU that answers every request at
+// once. Each request is charged to FETCH_TX_SOURCE's token bucket as the
+// TWAI link's submit would be, so a rate-limited class shows up as a
+// refusal partway through. Nothing goes on the bus.
+// ---------------------------------------------------------------------------
+static const uint32_t FETCH_BENCH_SIZES[] = { 2048, 8192, 32768 };
+
+class BenchVcu : public SdoLink {
+public:
+    explicit BenchVcu(const String& json) : _json(json) {}
+
+    uint32_t requests = 0;
+    uint32_t refused  = 0;
+
+    bool send(const uint8_t* d) override {
+        requests++;
+        if (!CANTxScheduler::getInstance().admit(CANDataManager::FETCH_TX_SOURCE)) {
+            refused++;
+            return false;
+        }
+        memset(&_reply, 0, sizeof(_reply));
+        _reply.identifier       = SDO_RX_ID;
+        _reply.data_length_code = 8;
+        uint8_t cmd = d[0] & 0xE0;
+        if (cmd == 0x40) {
+            // Initiate upload — size indicated
+            uint32_t n = _json.length();
+            _reply.data[0] = 0x41;
+            memcpy(_reply.data + 1, d + 1, 3);
+            for (int i = 0; i < 4; i++) _reply.data[4 + i] = (uint8_t)(n >> (8 * i));
+            _pos    = 0;
+            _toggle = false;
+        } else if (cmd == 0x60 && ((d[0] & 0x10) != 0) == _toggle) {
+            uint32_t left = _json.length() - _pos;
+            uint8_t  n    = left > 7 ? 7 : (uint8_t)left;
+            _reply.data[0] = (_toggle ? 0x10 : 0) | (left <= 7 ? (0x01 | ((7 - n) << 1)) : 0);
+            memcpy(_reply.data + 1, _json.c_str() + _pos, n);
+            _pos   += n;
+            _toggle = !_toggle;
+        } else {
+            _reply.data[0] = 0x80;    // abort — unexpected command or toggle
+        }
+        _pending = true;
+        return true;
+    }
+
+    bool receive(twai_message_t* frame, uint32_t) override {
+        if (!_pending) return false;
+        *frame   = _reply;
+        _pending = false;
+        return true;
+    }
+
+private:
+    const String&  _json;
+    twai_message_t _reply;
+    uint32_t       _pos = 0;
+    bool           _toggle = false;
+    bool           _pending = false;
+};
+
+static const char* fetchResultName(FetchResult r) {
+    switch (r) {
+        case FetchResult::SUCCESS:     return "ok";
+        case FetchResult::TIMEOUT:     return "timeout";
+        case FetchResult::PARSE_ERROR: return "parse_error";
+        case FetchResult::CAN_ERROR:   return "can_error";
+    }
+    return "?";
+}
+
+static String benchFetch() {
+    String out = "{\"name\":\"fetch\",\"source\":\"";
+    out += CANTxScheduler::sourceName(CANDataManager::FETCH_TX_SOURCE);
+    out += "\",\"runs\":[";
+    for (size_t r = 0; r < sizeof(FETCH_BENCH_SIZES) / sizeof(FETCH_BENCH_SIZES[0]); r++) {
+        // A params.json-shaped schema of about the requested size
+        String json;
+        json.reserve(FETCH_BENCH_SIZES[r] + 64);
+        json = "{";
+        for (int i = 0; json.length() < FETCH_BENCH_SIZES[r]; i++) {
+            char entry[64];
+            snprintf(entry, sizeof(entry), "%s\"param%04d\":{\"id\":%d,\"value\":0,\"unit\":\"V\"}",
+                i ? "," : "", i, i);
+            json += entry;
+        }
+        json += "}";
+
+        BenchVcu vcu(json);
+        String received;
+        int64_t t0 = esp_timer_get_time();
+        FetchResult res = CANDataManager::sdoUpload(vcu, received);
+        int64_t us = esp_timer_get_time() - t0;
+
+        char row[224];
+        snprintf(row, sizeof(row),
+            "%s{\"bytes\":%u,\"result\":\"%s\",\"match\":%s,\"requests\":%lu,"
+            "\"refused\":%lu,\"us\":%lld,\"kbps\":%lld}",
+            r ? "," : "", (unsigned)json.length(), fetchResultName(res),
+            received == json ? "true" : "false",
+            (unsigned long)vcu.requests, (unsigned long)vcu.refused, (long long)us,
+            (long long)(us > 0 ? (int64_t)received.length() * 1000 / us : 0));
+        out += row;
+    }
+    out += "]}";
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Case table — terminated by a null entry
+// ---------------------------------------------------------------------------
+static const BenchCase CASES[] = {
+    { "format",  benchFormat  },
+    { "seqlock", benchSeqlock },
+    { "canlog",  benchCanLog  },
+    { "bridges", benchBridges },
+    { "json",    benchJson    },
+    { "fs",      benchFs      },
+    { "msgpack", benchMsgPack },
+    { "fetch",   benchFetch   },
+    { nullptr,   nullptr      }
+};
+
+String Benchmark::run(const String& name) {
+    for (const BenchCase* c = CASES; c->name; c++) {
+        if (name == c->name) {
+            Serial.printf("[BENCH] Running %s\n", c->name);
+            return c->fn();
+        }
+    }
+    return "{\"error\":\"unknown benchmark\"}";
+}
+
+String Benchmark::list() {
+    String out = "[";
+    for (const BenchCase* c = CASES; c->name; c++) {
+        if (c != CASES) out += ",";
+        out += "\"";
+        out += c->name;
+        out += "\"";
+    }
+    out += "]";
+    return out;
+}
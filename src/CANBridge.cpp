@@ -0,0 +1,316 @@
+// ============================================================================
+// CANBridge.cpp
+// ============================================================================
+
+#include "CANBridge.h"
+#include "CANLogger.h"
+#include "JsonWriter.h"
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+
+// Pump list — appended on loopTask, walked by the bridge task. A slot is
+// filled before the count covers it and never emptied.
+static CANBridge* volatile s_bridges[CAN_BRIDGE_MAX];
+static volatile uint8_t    s_bridgeCount = 0;
+static TaskHandle_t        s_task = nullptr;
+
+// ---------------------------------------------------------------------------
+// Registry and bridge task
+// ---------------------------------------------------------------------------
+
+void CANBridge::attach() {
+    for (uint8_t i = 0; i < s_bridgeCount; i++)
+        if (s_bridges[i] == this) return;
+    if (s_bridgeCount >= CAN_BRIDGE_MAX) {
+        Serial.printf("[BRIDGE] No room for %s\n", _name);
+        return;
+    }
+    s_bridges[s_bridgeCount] = this;
+    s_bridgeCount = s_bridgeCount + 1;
+    if (!s_task) {
+        // Core 0 with the WiFi stack, like the /ws/can sender
+        xTaskCreatePinnedToCore(taskEntry, "CANBridge", 4096, nullptr, 1, &s_task, 0);
+    }
+}
+
+void CANBridge::taskEntry(void*) {
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(CAN_BRIDGE_PUMP_MS));
+        uint8_t n = s_bridgeCount;
+        for (uint8_t i = 0; i < n; i++) s_bridges[i]->pump();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// GET /bridges — every bridge, read without locking
+// ---------------------------------------------------------------------------
+
+// Item 0 is the head, then each bridge's statsItems() pieces in pump-list
+// order, then the closing. The bridge count is fixed when the request
+// arrives; the pump list only ever grows.
+class CANBridge::StatsBody : public JsonBody {
+public:
+    StatsBody() : _count(s_bridgeCount) {}
+
+    bool item(JsonWriter& w, uint32_t n) override {
+        if (n == 0) {
+            w.beginObject();
+            w.key("head");
+            w.valueUint(FrameHistory::getInstance().head());
+            w.key("bridges");
+            w.beginArray();
+            return true;
+        }
+        n--;
+        for (uint8_t i = 0; i < _count; i++) {
+            uint8_t k = s_bridges[i]->statsItems();
+            if (n < k) {
+                s_bridges[i]->statsItem(w, (uint8_t)n);
+                return true;
+            }
+            n -= k;
+        }
+        if (n > 0) return false;
+        w.endArray();
+        w.endObject();
+        return true;
+    }
+
+private:
+    uint8_t _count;
+};
+
+void CANBridge::registerEndpoints(AsyncWebServer* server) {
+    server->on("/bridges", HTTP_GET, [](AsyncWebServerRequest* request) {
+        AsyncWebServerResponse* resp = JsonStream::begin(request, "application/json",
+                                                         std::make_shared<StatsBody>());
+        resp->addHeader("Cache-Control", "no-cache");
+        request->send(resp);
+    });
+}
+
+void CANBridge::valueIp(JsonWriter& w, uint32_t ip) {
+    // IPAddress byte order — first octet in the low byte
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%u.%u.%u.%u",
+                       (unsigned)(ip & 0xFF), (unsigned)((ip >> 8) & 0xFF),
+                       (unsigned)((ip >> 16) & 0xFF), (unsigned)(ip >> 24));
+    w.valueName(buf, len);
+}
+
+// ---------------------------------------------------------------------------
+// TcpBridge — begin / stop
+// ---------------------------------------------------------------------------
+
+void TcpBridge::begin() {
+    if (_running) return;
+    attach();
+    _server = new AsyncServer(_port);
+    _server->onClient([](void* arg, AsyncClient* tcp) {
+        static_cast<TcpBridge*>(arg)->onConnect(tcp);
+    }, this);
+    _server->setNoDelay(true);
+    _server->begin();
+    _running = true;
+    Serial.printf("[BRIDGE] %s listening on TCP %u\n", _name, _port);
+}
+
+void TcpBridge::stop() {
+    if (!_running) return;
+    _running = false;
+    // Disconnect callbacks hand each client back to the task for freeing
+    for (int i = 0; i < CAN_BRIDGE_MAX_CLIENTS; i++) {
+        Client* c = _clients[i].load(std::memory_order_acquire);
+        if (c && !c->gone) c->tcp->close(true);
+    }
+    _server->end();
+    delete _server;
+    _server = nullptr;
+    Serial.printf("[BRIDGE] %s stopped\n", _name);
+}
+
+bool TcpBridge::hasClients() const {
+    for (int i = 0; i < CAN_BRIDGE_MAX_CLIENTS; i++)
+        if (_clients[i].load(std::memory_order_relaxed)) return true;
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// onConnect — async_tcp. Claims a slot and publishes the client to the
+// bridge task, which starts it at the current bus position.
+// ---------------------------------------------------------------------------
+
+void TcpBridge::onConnect(AsyncClient* tcp) {
+    int slot = -1;
+    for (int i = 0; i < CAN_BRIDGE_MAX_CLIENTS && slot < 0; i++)
+        if (!_clients[i].load(std::memory_order_acquire)) slot = i;
+    if (!_running || slot < 0) {
+        Serial.printf("[BRIDGE] %s: max clients reached — connection rejected\n", _name);
+        tcp->close(true);
+        delete tcp;
+        return;
+    }
+
+    Client* c = new Client();
+    c->tcp       = tcp;
+    c->owner     = this;
+    c->slot      = (uint8_t)slot;
+    c->cursor    = FrameHistory::getInstance().head();
+    c->streaming = streamsOnConnect();
+    tcp->setNoDelay(true);
+    tcp->onData([](void* arg, AsyncClient*, void* data, size_t len) {
+        Client* c = (Client*)arg;
+        c->owner->onData(*c, (const uint8_t*)data, len);
+    }, c);
+    tcp->onDisconnect([](void* arg, AsyncClient*) {
+        Client* c = (Client*)arg;
+        Serial.printf("[BRIDGE] %s: client %d disconnected\n", c->owner->_name, c->slot);
+        c->gone = true;
+    }, c);
+    tcp->onTimeout([](void*, AsyncClient* tcp, uint32_t) { tcp->close(true); }, nullptr);
+
+    BridgeClientStats& st = _stats[slot];
+    memset(&st, 0, sizeof(st));
+    st.ip          = tcp->getRemoteAddress();
+    st.connectedMs = millis();
+    st.rateMs      = st.connectedMs;
+    _clients[slot].store(c, std::memory_order_release);
+    Serial.printf("[BRIDGE] %s: client %d connected from %s\n",
+                  _name, slot, tcp->remoteIP().toString().c_str());
+}
+
+// ---------------------------------------------------------------------------
+// reply — async_tcp. Straight into the client's TCP buffer.
+// ---------------------------------------------------------------------------
+
+void TcpBridge::reply(Client& c, const void* data, size_t len) {
+    if (c.gone || !c.tcp->connected()) return;
+    c.tcp->write((const char*)data, len);
+}
+
+// ---------------------------------------------------------------------------
+// pump — bridge task. Frees departed clients, moves every cursor forward.
+// ---------------------------------------------------------------------------
+
+void TcpBridge::pump() {
+    for (int i = 0; i < CAN_BRIDGE_MAX_CLIENTS; i++) {
+        Client* c = _clients[i].load(std::memory_order_acquire);
+        if (!c) continue;
+        if (c->gone) {
+            _clients[i].store(nullptr, std::memory_order_release);
+            delete c->tcp;
+            delete c;
+            continue;
+        }
+        pumpClient(*c, _stats[i]);
+    }
+}
+
+// Encode from the client's cursor into its TCP send buffer while there is
+// room. A full buffer leaves the cursor where it is — the client falls
+// behind on its own — until it is CAN_BRIDGE_MAX_LAG frames back. A client
+// that has not opened its channel is held at the head.
+void TcpBridge::pumpClient(Client& c, BridgeClientStats& st) {
+    FrameHistory& hist = FrameHistory::getInstance();
+    uint32_t head = hist.head();
+
+    if (!c.streaming) {
+        c.cursor     = head;
+        st.lagFrames = 0;
+        return;
+    }
+    if (head - c.cursor > CAN_BRIDGE_MAX_LAG) {
+        uint32_t skip = head - c.cursor - CAN_BRIDGE_MAX_LAG / 2;
+        st.droppedFrames += skip;
+        c.cursor += skip;
+    }
+
+    while (c.cursor != head && c.tcp->connected()) {
+        size_t room = c.tcp->space();
+        if (room < _recordMax) {
+            st.stalls++;
+            break;
+        }
+        if (room > sizeof(_chunk)) room = sizeof(_chunk);
+
+        size_t len = 0;
+        HistoryFrame fr;
+        while (c.cursor != head && len + _recordMax <= room) {
+            if (!hist.read(c.cursor, fr)) {
+                // Overwritten before we got to it
+                uint32_t oldest = hist.oldest();
+                if ((int32_t)(oldest - c.cursor) <= 0) break;
+                st.droppedFrames += oldest - c.cursor;
+                c.cursor = oldest;
+                continue;
+            }
+            len += encode(c, fr, _chunk + len);
+            c.cursor++;
+            st.sentFrames++;
+        }
+        if (!len) break;
+        c.tcp->add((const char*)_chunk, len, ASYNC_WRITE_FLAG_COPY);
+        c.tcp->send();
+        st.sentBytes += len;
+    }
+
+    st.lagFrames = head - c.cursor;
+    uint32_t now = millis();
+    if (now - st.rateMs >= 1000) {
+        st.rateBps   = (uint32_t)((uint64_t)(st.sentBytes - st.rateBytes) * 1000 / (now - st.rateMs));
+        st.rateBytes = st.sentBytes;
+        st.rateMs    = now;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// statsItem — per-client delivery
+// ---------------------------------------------------------------------------
+
+void TcpBridge::statsItem(JsonWriter& w, uint8_t n) {
+    if (n == 0) {
+        w.beginObject();
+        w.key("name");
+        w.valueString(_name);
+        w.key("transport");
+        w.valueName("tcp", 3);
+        w.key("port");
+        w.valueUint(_port);
+        w.key("running");
+        w.valueBool(_running);
+        w.key("clients");
+        w.beginArray();
+        return;
+    }
+    if (n > CAN_BRIDGE_MAX_CLIENTS) {
+        w.endArray();
+        w.endObject();
+        return;
+    }
+    int i = n - 1;
+    const Client* c = _clients[i].load(std::memory_order_acquire);
+    if (!c) return;
+    const BridgeClientStats& st = _stats[i];
+    w.beginObject();
+    w.key("slot");
+    w.valueInt(i);
+    w.key("ip");
+    valueIp(w, st.ip);
+    w.key("connectedS");
+    w.valueUint((millis() - st.connectedMs) / 1000);
+    w.key("open");
+    w.valueBool(c->streaming);
+    w.key("sent");
+    w.valueUint(st.sentFrames);
+    w.key("dropped");
+    w.valueUint(st.droppedFrames);
+    w.key("bytes");
+    w.valueUint(st.sentBytes);
+    w.key("bps");
+    w.valueUint(st.rateBps);
+    w.key("lag");
+    w.valueUint(st.lagFrames);
+    w.key("stalls");
+    w.valueUint(st.stalls);
+    w.endObject();
+}
@@ -1,8 +1,13 @@
 #include "CANData.h"
 #include "CANMonitor.h"
+#include "FlightRecorder.h"
+#include "FrameHistory.h"
+#include "CANTxScheduler.h"
 #include "Config.h"
 #include "driver/twai.h"
-#include <SPIFFS.h>
+#include "Storage.h"
+#include "MsgPack.h"
+#include <esp_timer.h>
 
 // Static instance pointer for SDO callback
 CANDataManager* CANDataManager::instance = nullptr;
@@ -22,17 +27,11 @@ void CANDataManager::sdoResultCallback(const SDOResult& result) {
         return;
     }
 
-    // ZombieVerter SDO values are always fixed-point ×32 regardless of param type.
-    // BMS cell voltages (2084=BMS_Vmin, 2085=BMS_Vmax) are stored in mV (×1000/32)
-    // to preserve decimal precision for display as e.g. 3.780V.
-    if (result.paramId == 2084 || result.paramId == 2085) {
-        instance->updateParameterBySDOId(result.paramId, result.value * 1000 / 32);
-    } else {
-        instance->updateParameterBySDOId(result.paramId, result.value / 32);
-    }
+    // ZombieVerter SDO values are fixed-point ×32 — each parameter's
+    // FixedScale descriptor converts the raw value exactly once, here.
+    instance->updateParameterBySDOId(result.paramId, result.value);
     #if DEBUG_CAN
-    Serial.printf("[SDO CB] Read param %d raw=%d scaled=%d\n",
-                  result.paramId, result.value, result.value / 32);
+    Serial.printf("[SDO CB] Read param %d raw=%d\n", result.paramId, result.value);
     #endif
 }
 
@@ -46,19 +45,183 @@ void CANDataManager::onSDOResult(const SDOResult& result) {
 // CANParameter helpers — setValue and getValueAsInt are inline in the struct
 // ============================================================================
 
+// Per-parameter scale overrides. Everything else uses FixedPoint::sdoDefault()
+// (raw ×32, two decimals) unless params.json supplies "decimals".
+// BMS cell voltages (2084=BMS_Vmin, 2085=BMS_Vmax) are held in whole mV so the
+// UI and health check can render them as e.g. 3.780V.
+static const struct { uint16_t id; FixedScale scale; } scaleOverrides[] = {
+    {2084, {1000, 32, 0, "mV"}},
+    {2085, {1000, 32, 0, "mV"}},
+    {0,    {1, 1, 0, ""}}
+};
+
+void CANDataManager::applyScaleOverride(CANParameter& p) {
+    for (int i = 0; scaleOverrides[i].id; i++) {
+        if (scaleOverrides[i].id == p.id) {
+            p.scale = scaleOverrides[i].scale;
+            return;
+        }
+    }
+}
+
+// ============================================================================
+// CANParameter seqlock
+//
+// store() bumps `seq` to odd, writes the live fields, then bumps it to the
+// next even value. snapshot() copies the fields between two reads of `seq`
+// and retries if the counter was odd or moved. Writers only ever contend
+// with other writers of the same parameter (CAS on the counter), never with
+// readers.
+//
+// tableVersion / tableWriters extend the same idea to the whole array for
+// snapshotAll(): a pass is consistent if no store() was in flight when it
+// started and none completed while it ran.
+// ============================================================================
+
+std::atomic<uint32_t> CANParameter::tableVersion(0);
+std::atomic<uint32_t> CANParameter::tableWriters(0);
+std::atomic<uint32_t> CANParameter::updateGen(0);
+
+// Shared retry policy: spin, then sleep a tick every SEQLOCK_SPIN_RETRIES so
+// a lower-priority task preempted mid-write on this core gets to finish.
+// Returns false once `maxSleeps` sleeps have been used.
+static bool seqlockBackoff(uint32_t& spins, uint32_t maxSleeps) {
+    if (++spins % SEQLOCK_SPIN_RETRIES) return true;
+    if (spins / SEQLOCK_SPIN_RETRIES > maxSleeps) return false;
+    vTaskDelay(1);
+    return true;
+}
+
+// Open a write: counted in tableWriters, counter claimed even → odd. Writers
+// of the same parameter serialise here. The CAS acquire alone does not stop
+// the field writes that follow from becoming visible ahead of the odd count
+// (it orders loads after it, not the CAS's own store before later stores);
+// the release fence does, so a reader that sees new fields sees the count
+// odd or bumped and retries.
+static uint32_t seqBegin(std::atomic<uint32_t>& seq) {
+    CANParameter::tableWriters.fetch_add(1, std::memory_order_acq_rel);
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    uint32_t spins = 0;
+    while ((s & 1) || !seq.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+        seqlockBackoff(spins, UINT32_MAX);
+        s = seq.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return s;
+}
+
+static void seqEnd(std::atomic<uint32_t>& seq, uint32_t s) {
+    seq.store(s + 2, std::memory_order_release);
+    CANParameter::tableVersion.fetch_add(1, std::memory_order_release);
+    CANParameter::tableWriters.fetch_sub(1, std::memory_order_release);
+}
+
+void CANParameter::store(int32_t fixed, uint32_t now, bool fromBus) {
+    uint32_t s = seqBegin(seq);
+    // Learn the update period from live intervals only — the gap that
+    // ends a stale spell would skew the average
+    if (!periodFixed && !stale && lastUpdateTime) notePeriod(now - lastUpdateTime);
+    bool changed = stale;
+    if (fixed != valueInt) { valueInt = fixed; changeCount++; changed = true; }
+    if (changed) stampGen();
+    lastUpdateTime = now;
+    stale = false;
+    if (fromBus) received = true;
+    seqEnd(seq, s);
+}
+
+bool CANParameter::markStale(uint32_t timeout) {
+    uint32_t s = seqBegin(seq);
+    // Checked under the counter, so a store() racing in from another task
+    // either lands first (and wins) or clears the flag straight after.
+    // The clock is read here, not by the caller, so a store that just
+    // landed can never look like it happened in the future.
+    bool changed = !stale && millis() - lastUpdateTime >= timeout;
+    if (changed) { stale = true; stampGen(); }
+    seqEnd(seq, s);
+    return changed;
+}
+
+bool CANParameter::snapshot(ParamSnapshot& out) const {
+    uint32_t spins = 0;
+    do {
+        uint32_t s = seq.load(std::memory_order_acquire);
+        if (!(s & 1)) {
+            out.valueInt       = valueInt;
+            out.lastUpdateTime = lastUpdateTime;
+            out.changeCount    = changeCount;
+            out.gen            = gen;
+            out.stale          = stale;
+            out.received       = received;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s) return true;
+        }
+    } while (seqlockBackoff(spins, SEQLOCK_SLEEP_RETRIES));
+    return false;
+}
+
+bool CANDataManager::snapshotAll(ParamSnapshot* out, uint16_t cap, uint16_t& count) const {
+    count = parameterCount < cap ? parameterCount : cap;
+
+    uint32_t spins  = 0;
+    uint8_t  passes = 0;
+    while (passes < SEQLOCK_TABLE_RETRIES) {
+        uint32_t v = CANParameter::tableVersion.load(std::memory_order_acquire);
+        if (CANParameter::tableWriters.load(std::memory_order_acquire)) {
+            if (!seqlockBackoff(spins, SEQLOCK_SLEEP_RETRIES)) break;
+            continue;
+        }
+
+        for (uint16_t i = 0; i < count; i++) {
+            const CANParameter& p = parameters[i];
+            out[i].valueInt       = p.valueInt;
+            out[i].lastUpdateTime = p.lastUpdateTime;
+            out[i].changeCount    = p.changeCount;
+            out[i].gen            = p.gen;
+            out[i].stale          = p.stale;
+            out[i].received       = p.received;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (CANParameter::tableWriters.load(std::memory_order_relaxed) == 0 &&
+            CANParameter::tableVersion.load(std::memory_order_relaxed) == v) return true;
+        passes++;
+    }
+
+    // Table kept changing under us — settle for per-parameter consistency
+    for (uint16_t i = 0; i < count; i++) parameters[i].snapshot(out[i]);
+    return false;
+}
+
+// Copy a params.json unit string into the descriptor. Enum-style units
+// ("0=Off, 1=On") are not display units and are dropped.
+static void setScaleUnit(FixedScale& s, const char* unit) {
+    s.unit[0] = '\0';
+    if (!unit || strchr(unit, '=')) return;
+    strncpy(s.unit, unit, FIXED_UNIT_LEN - 1);
+    s.unit[FIXED_UNIT_LEN - 1] = '\0';
+}
+
+void CANParameter::setName(const char* n) {
+    uint8_t i = 0;
+    for (; n[i] && i < sizeof(name) - 1; i++) {
+        char ch = n[i];
+        name[i] = (ch == '"' || ch == '\\' || (uint8_t)ch < 0x20) ? '_' : ch;
+    }
+    name[i] = '\0';
+    nameLen = i;
+}
+
 // ============================================================================
 // Constructor
 // ============================================================================
 
 CANDataManager::CANDataManager()
-    : parameterCount(0), txHead(0), txTail(0), rxHead(0), rxTail(0),
-      connected(false), lastMessageTime(0), bmsCellCount(0), _frameObserver(nullptr)
+    : parameterCount(0), rxHead(0), rxTail(0),
+      connected(false), lastMessageTime(0),
+      changeSubCount(0), changeWatchCount(0), paramsGeneration(1)
 {
     instance = this;
-    for (uint8_t i = 0; i < MAX_BMS_CELLS; i++) {
-        bmsCellVoltages[i]    = 0;
-        bmsCellUpdateTimes[i] = 0;
-    }
 }
 
 // ============================================================================
@@ -73,8 +236,8 @@ bool CANDataManager::init() {
         (gpio_num_t)CAN_RX_PIN,
         TWAI_MODE_NORMAL
     );
-    g_config.rx_queue_len = 32;  // deeper queue prevents broadcast frames evicting SDO responses
-    g_config.tx_queue_len = 10;
+    g_config.rx_queue_len = CAN_RX_QUEUE_LEN;  // deep queue — a busy bus during an LVGL redraw must not evict SDO responses
+    g_config.tx_queue_len = CAN_TX_DRIVER_DEPTH;  // CANTxScheduler holds the backlog, by priority
 
     if (twai_driver_install(&g_config, &t_config, &f_config) != ESP_OK) {
         Serial.println("[CAN] TWAI driver install failed");
@@ -85,6 +248,8 @@ bool CANDataManager::init() {
         return false;
     }
     Serial.println("[CAN] TWAI initialized at 500kbps");
+    CANTxScheduler::getInstance().begin();
+    bmsCells.begin();
     // Note: SDOManager is NOT started here — call initSDO() after fetchParamsFromVCU()
     return true;
 }
@@ -99,37 +264,71 @@ bool CANDataManager::initSDO() {
 }
 
 // ============================================================================
-// sdoSendRaw — send 8 bytes directly via TWAI (bypasses SDOManager)
-// Used only during fetchParamsFromVCU before SDOManager starts
+// TwaiSdoLink — SDO requests and responses straight on TWAI (bypasses
+// SDOManager). Used only during fetchParamsFromVCU before SDOManager starts.
+// Responses are taken from TWAI directly; non-SDO frames (CAN broadcasts
+// etc.) are discarded.
 // ============================================================================
 
-bool CANDataManager::sdoSendRaw(uint8_t* data8) {
-    twai_message_t tx = {};
-    tx.identifier       = SDO_TX_ID;
-    tx.data_length_code = 8;
-    tx.extd             = 0;
-    memcpy(tx.data, data8, 8);
-    return twai_transmit(&tx, pdMS_TO_TICKS(10)) == ESP_OK;
-}
+#define SDO_SEND_RETRY_MS  50   // source queue full — the lone request waits
+
+class TwaiSdoLink : public SdoLink {
+public:
+    bool send(const uint8_t* data8) override {
+        twai_message_t tx = {};
+        tx.identifier       = SDO_TX_ID;
+        tx.data_length_code = 8;
+        tx.extd             = 0;
+        memcpy(tx.data, data8, 8);
+        uint32_t start = millis();
+        while (!CANTxScheduler::getInstance().submit(CANDataManager::FETCH_TX_SOURCE, tx)) {
+            if (millis() - start >= SDO_SEND_RETRY_MS) return false;
+            vTaskDelay(1);
+        }
+        return true;
+    }
+
+    bool receive(twai_message_t* frame, uint32_t timeoutMs) override {
+        uint32_t deadline = millis() + timeoutMs;
+        while (millis() < deadline) {
+            if (twai_receive(frame, pdMS_TO_TICKS(5)) == ESP_OK) {
+                if (frame->identifier == SDO_RX_ID) return true;
+            }
+        }
+        return false;
+    }
+};
 
 // ============================================================================
-// sdoReceiveRaw — wait for an SDO response frame directly from TWAI
-// Discards non-SDO frames (CAN broadcasts etc.)
+// /params.msgpack — the schema converted once, so a MessagePack request
+// costs a file read like /params.json does
 // ============================================================================
-
-bool CANDataManager::sdoReceiveRaw(twai_message_t* frame, uint32_t timeoutMs) {
-    uint32_t deadline = millis() + timeoutMs;
-    while (millis() < deadline) {
-        if (twai_receive(frame, pdMS_TO_TICKS(5)) == ESP_OK) {
-            if (frame->identifier == SDO_RX_ID) return true;
-        }
+static bool writeParamsMsgPack(const JsonDocument& doc) {
+    File f = Storage::fs().open(PARAMS_MSGPACK_PATH, "w");
+    if (!f) {
+        Serial.println("[Fetch] WARNING: Could not write " PARAMS_MSGPACK_PATH);
+        return false;
     }
-    return false;
+    size_t n = serializeMsgPack(doc, f);
+    f.close();
+    if (!n) {
+        Storage::fs().remove(PARAMS_MSGPACK_PATH);
+        Serial.println("[Fetch] WARNING: Could not write " PARAMS_MSGPACK_PATH);
+        return false;
+    }
+    Serial.printf("[Fetch] Saved " PARAMS_MSGPACK_PATH " (%u bytes)\n", (unsigned)n);
+    return true;
+}
+
+bool CANDataManager::saveParamsMsgPack(const char* jsonString, size_t len) {
+    JsonDocument doc;
+    if (deserializeJson(doc, jsonString, len) != DeserializationError::Ok) return false;
+    return writeParamsMsgPack(doc);
 }
 
 // ============================================================================
 // fetchParamsFromVCU — download parameter schema from VCU via SDO segmented
-// transfer on index 0x5001. Saves result to SPIFFS as /params.json and
+// transfer on index 0x5001. Saves result to flash as /params.json and
 // loads into parameters[].
 //
 // Must be called AFTER init() (TWAI running) but the SDOManager internal
@@ -187,10 +386,8 @@ FetchResult CANDataManager::fetchParamsFromVCU() {
     return lastResult;
 }
 
-// Internal single attempt — called by fetchParamsFromVCU with retry wrapper
-FetchResult CANDataManager::fetchParamsAttempt() {
-    Serial.println("[Fetch] Starting VCU parameter download via SDO...");
-
+// The transfer itself — fetchParamsAttempt over TWAI, Benchmark over memory
+FetchResult CANDataManager::sdoUpload(SdoLink& link, String& jsonBuffer) {
     // Step 1: Send initiate upload request for index 0x5001 subindex 0
     uint8_t initReq[8] = {
         SDO_CMD_UPLOAD_REQ,
@@ -200,14 +397,14 @@ FetchResult CANDataManager::fetchParamsAttempt() {
         0, 0, 0, 0
     };
 
-    if (!sdoSendRaw(initReq)) {
+    if (!link.send(initReq)) {
         Serial.println("[Fetch] Failed to send initiate upload request");
         return FetchResult::CAN_ERROR;
     }
 
     // Step 2: Wait for initiate upload response
     twai_message_t frame;
-    if (!sdoReceiveRaw(&frame, 1500)) {
+    if (!link.receive(&frame, 1500)) {
         Serial.println("[Fetch] Timeout waiting for initiate upload response");
         return FetchResult::TIMEOUT;
     }
@@ -226,7 +423,7 @@ FetchResult CANDataManager::fetchParamsAttempt() {
         Serial.printf("[Fetch] Total JSON size: %u bytes\n", (unsigned)totalSize);
     }
 
-    String jsonBuffer;
+    jsonBuffer = "";
     if (totalSize > 0 && totalSize < 65536) {
         jsonBuffer.reserve(totalSize + 64);
     }
@@ -242,12 +439,12 @@ FetchResult CANDataManager::fetchParamsAttempt() {
             0, 0, 0, 0, 0, 0, 0
         };
 
-        if (!sdoSendRaw(segReq)) {
+        if (!link.send(segReq)) {
             Serial.println("[Fetch] Failed to send segment request");
             return FetchResult::CAN_ERROR;
         }
 
-        if (!sdoReceiveRaw(&frame, 500)) {
+        if (!link.receive(&frame, 500)) {
             Serial.printf("[Fetch] Timeout on segment %u\n", (unsigned)segmentCount);
             return FetchResult::TIMEOUT;
         }
@@ -278,6 +475,17 @@ FetchResult CANDataManager::fetchParamsAttempt() {
 
     Serial.printf("[Fetch] Download complete: %u bytes in %u segments\n",
         (unsigned)jsonBuffer.length(), (unsigned)segmentCount);
+    return FetchResult::SUCCESS;
+}
+
+// Internal single attempt — called by fetchParamsFromVCU with retry wrapper
+FetchResult CANDataManager::fetchParamsAttempt() {
+    Serial.println("[Fetch] Starting VCU parameter download via SDO...");
+
+    TwaiSdoLink link;
+    String jsonBuffer;
+    FetchResult r = sdoUpload(link, jsonBuffer);
+    if (r != FetchResult::SUCCESS) return r;
 
     // Step 4: Validate JSON
     if (jsonBuffer.length() < 10 || jsonBuffer[0] != '{') {
@@ -286,25 +494,32 @@ FetchResult CANDataManager::fetchParamsAttempt() {
     }
 
     // Quick parse to validate
-    {
-        JsonDocument testDoc;
-        DeserializationError err = deserializeJson(testDoc, jsonBuffer.c_str(), jsonBuffer.length());
-        if (err != DeserializationError::Ok) {
-            Serial.printf("[Fetch] JSON parse error: %s\n", err.c_str());
-            return FetchResult::PARSE_ERROR;
-        }
-        Serial.printf("[Fetch] JSON valid — %u top-level keys\n", (unsigned)testDoc.size());
+    JsonDocument testDoc;
+    DeserializationError err = deserializeJson(testDoc, jsonBuffer.c_str(), jsonBuffer.length());
+    if (err != DeserializationError::Ok) {
+        Serial.printf("[Fetch] JSON parse error: %s\n", err.c_str());
+        return FetchResult::PARSE_ERROR;
     }
+    Serial.printf("[Fetch] JSON valid — %u top-level keys\n", (unsigned)testDoc.size());
 
-    // Step 5: Save to SPIFFS
-    File f = SPIFFS.open("/params.json", "w");
+    // Step 5: Save to flash. The MessagePack copy is only written next to a
+    // saved /params.json — an older copy left beside a stale JSON would
+    // serve a schema the JSON does not have.
+    bool saved = false;
+    File f = Storage::fs().open("/params.json", "w");
     if (f) {
-        f.print(jsonBuffer);
+        saved = f.print(jsonBuffer) == jsonBuffer.length();
         f.close();
+    }
+    if (saved) {
         Serial.printf("[Fetch] Saved /params.json (%u bytes)\n", (unsigned)jsonBuffer.length());
+        writeParamsMsgPack(testDoc);
     } else {
         Serial.println("[Fetch] WARNING: Could not write /params.json");
+        Storage::fs().remove("/params.json");    // opened "w" — truncated if anything
+        Storage::fs().remove(PARAMS_MSGPACK_PATH);
     }
+    testDoc.clear();
 
     // Step 6: Load into parameters[]
     if (!loadParametersFromJSON(jsonBuffer.c_str())) {
@@ -332,6 +547,11 @@ void CANDataManager::update() {
         Serial.println("]");
         #endif
 
+        // Always-on frame history (late-join backfill, flight recorder
+        // pre-trigger window) — a 20-byte copy per frame
+        FrameHistory::getInstance().record(rx_message, (uint32_t)esp_timer_get_time());
+        FlightRecorder::getInstance().checkFrame(rx_message);
+
         if (rx_message.identifier == SDO_RX_ID) {
             sdoManager.processIncomingFrame(rx_message);
             lastMessageTime = millis();
@@ -339,22 +559,12 @@ void CANDataManager::update() {
             // Forward to monitor even for SDO frames
             if (CANMonitor::instance().isActive())
                 CANMonitor::instance().pushFrame(rx_message);
-            if (_frameObserver)
-                _frameObserver(rx_message.identifier,
-                               rx_message.extd != 0,
-                               rx_message.data,
-                               rx_message.data_length_code);
             continue;
         }
 
         // Forward all non-SDO frames to monitor
         if (CANMonitor::instance().isActive())
             CANMonitor::instance().pushFrame(rx_message);
-        if (_frameObserver)
-            _frameObserver(rx_message.identifier,
-                           rx_message.extd != 0,
-                           rx_message.data,
-                           rx_message.data_length_code);
 
         CANMessage msg;
         msg.id        = rx_message.identifier;
@@ -373,21 +583,18 @@ void CANDataManager::update() {
         processReceivedMessage(rxMsg);
     }
 
-    CANMessage txMsg;
-    if (dequeueTx(txMsg)) {
-        twai_message_t tx_message;
-        tx_message.identifier       = txMsg.id;
-        tx_message.data_length_code = txMsg.length;
-        tx_message.flags            = TWAI_MSG_FLAG_NONE;
-        for (int i = 0; i < txMsg.length; i++) {
-            tx_message.data[i] = txMsg.data[i];
-        }
-        twai_transmit(&tx_message, pdMS_TO_TICKS(100));
-    }
+    // Flush the monitor's binary batch on time even when the bus goes quiet
+    CANMonitor::instance().poll();
+    FlightRecorder::getInstance().poll();
 
     if (connected && (millis() - lastMessageTime > 5000)) {
         connected = false;
     }
+
+    bmsCells.applyPending();
+
+    // Stale detection — only the parameters due in the elapsed ticks are touched
+    staleWheel.advance(millis() / STALE_TICK_MS, [this](uint16_t idx) { onStaleTimer(idx); });
 }
 
 // ============================================================================
@@ -425,10 +632,13 @@ void CANDataManager::setParameter(uint16_t paramId, int32_t value) {
     // All parameters written via SDO — no CAN map required on VCU.
     // Update local cache immediately so dial display reflects change without
     // waiting for the next SDO poll cycle.
-    updateParameterBySDOId(paramId, value);
+    CANParameter* p = findBySDOId(paramId);
+    FixedScale scale = p ? p->scale : FixedPoint::sdoDefault();
+    int32_t fixed = value * FixedPoint::pow10(scale.decimals);
+    if (p) p->setLocal(fixed);
 
-    // SDO write with ×32 fixed-point scaling (all VCU params use this encoding)
-    sdoManager.requestWrite(paramId, value * 32, true);
+    // SDO write through the parameter's descriptor (×32 for all VCU params)
+    sdoManager.requestWrite(paramId, FixedPoint::toRaw(fixed, scale), true);
 }
 
 // ============================================================================
@@ -456,10 +666,21 @@ bool CANDataManager::loadParametersFromJSON(const char* jsonString) {
 
             CANParameter& p = parameters[parameterCount];
             p.id       = param["id"];
-            strncpy(p.name, param["name"] | "Unknown", 31);
-            p.name[31] = '\0';
+            p.setName(param["name"] | "Unknown");
             p.editable = param["editable"] | false;
-            p.setValue((int32_t)(param["value"] | 0.0f));
+            p.fromBroadcast = false;
+            p.changeCount = 0;
+            p.scale    = FixedPoint::sdoDefault();
+            if (param["decimals"].is<int>())
+                p.scale.decimals = (uint8_t)constrain(param["decimals"].as<int>(), 0, FIXED_MAX_DECIMALS);
+            setScaleUnit(p.scale, param["unit"] | "");
+            applyScaleOverride(p);
+            p.received = false;
+            p.setLocal((int32_t)lround((param["value"] | 0.0) * FixedPoint::pow10(p.scale.decimals)));
+            p.periodMs    = param["period"] | 0;
+            p.periodFixed = p.periodMs != 0;
+            p.stale       = true;   // JSON default, not a live value yet
+            p.stampGen();
             parameterCount++;
         }
     } else {
@@ -474,15 +695,25 @@ bool CANDataManager::loadParametersFromJSON(const char* jsonString) {
 
             CANParameter& p = parameters[parameterCount];
             p.id            = param["id"].as<uint16_t>();
-            strncpy(p.name, kv.key().c_str(), 31);
-            p.name[31]      = '\0';
+            p.setName(kv.key().c_str());
             p.editable      = param["isparam"] | false;
             p.fromBroadcast = param["canid"].is<int>();  // has canid = comes from CAN broadcast
-            p.setValue((int32_t)(param["value"] | 0.0f));
+            p.changeCount   = 0;
+            p.scale         = FixedPoint::sdoDefault();
+            setScaleUnit(p.scale, param["unit"] | "");
+            applyScaleOverride(p);
+            p.received      = false;
+            p.setLocal((int32_t)lround((param["value"] | 0.0) * FixedPoint::pow10(p.scale.decimals)));
+            p.periodMs      = param["period"] | 0;
+            p.periodFixed   = p.periodMs != 0;
+            p.stale         = true;   // JSON default, not a live value yet
+            p.stampGen();             // new slot contents — every /spot delta resends it
             parameterCount++;
         }
     }
 
+    paramsGeneration++;   // parameter slots moved — watches re-resolve by name
+    rearmStaleTimers();
     Serial.printf("[CAN] Loaded %d parameters\n", parameterCount);
     return parameterCount > 0;
 }
@@ -515,16 +746,13 @@ CANParameter* CANDataManager::getParameterByIndex(uint8_t index) {
 }
 
 // ============================================================================
-// updateParameterBySDOId — updates by VCU short id (1-999)
-// Used by SDO callback and CAN broadcast handlers
+// findBySDOId — lookup by VCU short id (1-999), then by name map
 // ============================================================================
 
-void CANDataManager::updateParameterBySDOId(uint16_t sdoId, int32_t value) {
+CANParameter* CANDataManager::findBySDOId(uint16_t sdoId) {
     CANParameter* param = getParameter(sdoId);
-    if (param) {
-        param->setValue(value);
-        return;
-    }
+    if (param) return param;
+
     // VCU spot values use id >= 2000; try name-based mapping for key spots
     // These are the broadcast params we care about most
     static const struct { uint16_t sdoId; const char* name; } sdoMap[] = {
@@ -537,20 +765,159 @@ void CANDataManager::updateParameterBySDOId(uint16_t sdoId, int32_t value) {
         {0,   nullptr}
     };
     for (int i = 0; sdoMap[i].name; i++) {
-        if (sdoMap[i].sdoId == sdoId) {
-            CANParameter* p = getParameterByName(sdoMap[i].name);
-            if (p) p->setValue(value);
-            return;
-        }
+        if (sdoMap[i].sdoId == sdoId) return getParameterByName(sdoMap[i].name);
     }
+    return nullptr;
+}
+
+// ============================================================================
+// updateParameterBySDOId — stores a raw SDO value through the descriptor
+// ============================================================================
+
+void CANDataManager::updateParameterBySDOId(uint16_t sdoId, int32_t raw) {
+    CANParameter* param = findBySDOId(sdoId);
+    if (param) param->setRaw(raw);
 }
 
 // ============================================================================
 // updateParameterIfExists — legacy alias, looks up by VCU id then by name map
 // ============================================================================
 
-void CANDataManager::updateParameterIfExists(uint16_t paramId, int32_t value) {
-    updateParameterBySDOId(paramId, value);
+void CANDataManager::updateParameterIfExists(uint16_t paramId, int32_t raw) {
+    updateParameterBySDOId(paramId, raw);
+}
+
+// ============================================================================
+// Staleness — hierarchical timer wheel, one entry per parameter slot
+//
+// Each parameter is armed for lastUpdateTime + timeout. When its tick comes
+// up it is either re-armed from its newer lastUpdateTime, or flagged stale
+// and re-checked one timeout later. setFixed() clears the flag immediately,
+// so recovery is visible to readers without waiting for the wheel.
+// ============================================================================
+
+uint32_t CANDataManager::getStaleTimeoutMs(const CANParameter& p) const {
+    uint32_t period = p.periodMs;
+    if (!period) {
+        // Not learned yet. Broadcast values keep the old fixed 5s window;
+        // SDO-polled values wait for a full round-robin pass.
+        if (p.fromBroadcast) return STALE_DEFAULT_TIMEOUT_MS;
+        period = (uint32_t)parameterCount * PARAM_UPDATE_INTERVAL_MS;
+    }
+    uint32_t timeout = period * STALE_PERIOD_FACTOR;
+    return timeout < STALE_MIN_TIMEOUT_MS ? STALE_MIN_TIMEOUT_MS : timeout;
+}
+
+uint16_t CANDataManager::getStaleCount() const {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < parameterCount; i++) if (parameters[i].stale) n++;
+    return n;
+}
+
+void CANDataManager::rearmStaleTimers() {
+    uint32_t now = millis();
+    staleWheel.reset(now / STALE_TICK_MS);
+    for (uint16_t i = 0; i < parameterCount && i < TW_MAX_ENTRIES; i++) {
+        staleWheel.schedule(i, (now + getStaleTimeoutMs(parameters[i])) / STALE_TICK_MS);
+    }
+}
+
+void CANDataManager::onStaleTimer(uint16_t idx) {
+    if (idx >= parameterCount) return;
+    CANParameter& p = parameters[idx];
+    uint32_t now     = millis();
+    uint32_t timeout = getStaleTimeoutMs(p);
+
+    if (now - p.lastUpdateTime < timeout) {
+        staleWheel.schedule(idx, (p.lastUpdateTime + timeout) / STALE_TICK_MS);
+        return;
+    }
+
+    if (p.markStale(timeout)) {
+        #if DEBUG_CAN
+        Serial.printf("[CAN] %s stale (no update for %lu ms)\n", p.name,
+                      (unsigned long)(now - p.lastUpdateTime));
+        #endif
+    }
+    staleWheel.schedule(idx, (now + timeout) / STALE_TICK_MS);
+}
+
+// ============================================================================
+// Change subscriptions
+// ============================================================================
+
+int8_t CANDataManager::subscribe(ChangeHandler handler) {
+    if (changeSubCount >= MAX_CHANGE_SUBSCRIBERS || !handler) return -1;
+    changeSubs[changeSubCount] = handler;
+    return (int8_t)changeSubCount++;
+}
+
+bool CANDataManager::watch(int8_t sub, const char* name, int32_t deadband, int32_t threshold) {
+    if (sub < 0 || sub >= changeSubCount || !name) return false;
+    if (changeWatchCount >= MAX_CHANGE_WATCHES) {
+        Serial.printf("[CAN] Change watch table full — '%s' not watched\n", name);
+        return false;
+    }
+    ChangeWatch& w = changeWatches[changeWatchCount++];
+    w.name       = name;
+    w.sub        = sub;
+    w.deadband   = deadband < 0 ? -deadband : deadband;
+    w.threshold  = threshold;
+    w.param      = nullptr;
+    w.generation = 0;      // forces resolve on first dispatch
+    w.seenCount  = 0;
+    w.lastFixed  = 0;
+    w.lastStale  = false;
+    w.primed     = false;
+    return true;
+}
+
+void CANDataManager::dispatchChanges() {
+    for (uint8_t s = 0; s < changeSubCount; s++) dispatchChanges((int8_t)s);
+}
+
+void CANDataManager::dispatchChanges(int8_t sub) {
+    if (sub < 0 || sub >= changeSubCount) return;
+
+    ParamChange batch[MAX_CHANGE_WATCHES];
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < changeWatchCount; i++) {
+        ChangeWatch& w = changeWatches[i];
+        if (w.sub != sub) continue;
+
+        if (w.generation != paramsGeneration) {
+            w.param      = getParameterByName(w.name);
+            w.generation = paramsGeneration;
+            w.primed     = false;
+        }
+        if (!w.param) continue;
+
+        uint32_t cc    = w.param->changeCount;
+        bool     stale = w.param->stale;
+        if (w.primed && cc == w.seenCount && stale == w.lastStale) continue;   // unchanged
+        w.seenCount = cc;
+
+        int32_t v = w.param->valueInt;
+        if (w.primed && stale == w.lastStale) {
+            bool crossed = (w.threshold != NO_THRESHOLD) &&
+                           ((w.lastFixed >= w.threshold) != (v >= w.threshold));
+            int32_t delta = v - w.lastFixed;
+            if (delta < 0) delta = -delta;
+            if (!crossed && delta <= w.deadband) continue;
+        }
+
+        batch[n].param    = w.param;
+        batch[n].oldFixed = w.primed ? w.lastFixed : v;
+        batch[n].newFixed = v;
+        batch[n].stale    = stale;
+        n++;
+        w.lastFixed = v;
+        w.lastStale = stale;
+        w.primed    = true;
+    }
+
+    if (n) changeSubs[sub](batch, n);
 }
 
 // ============================================================================
@@ -562,8 +929,10 @@ void CANDataManager::processReceivedMessage(CANMessage& msg) {
     Serial.printf("Processing CAN ID: 0x%03X\n", msg.id);
     #endif
 
-    if ((msg.id >= 0x400 && msg.id < 0x500) || (msg.id >= 0x600 && msg.id < 0x700)) {
-        handleBMSCellVoltage(msg);
+    // BMS cell frames — only IDs nobody else decodes, so a layout covering
+    // e.g. 0x411 (IVT-S current) or 0x603 (SDO) cannot swallow them
+    if (!isReservedId(msg.id) &&
+        bmsCells.handleFrame(msg.id, msg.data, msg.length, msg.timestamp)) {
         return;
     }
 
@@ -580,7 +949,7 @@ void CANDataManager::processReceivedMessage(CANMessage& msg) {
 }
 
 // ============================================================================
-// handleSDOResponse — legacy fallback, also applies ÷32 scaling
+// handleSDOResponse — legacy fallback, scaled through the descriptor
 // ============================================================================
 
 void CANDataManager::handleSDOResponse(CANMessage& msg) {
@@ -594,7 +963,7 @@ void CANDataManager::handleSDOResponse(CANMessage& msg) {
     if (cmd == 0x43 || cmd == 0x4B) {
         int32_t raw = msg.data[4] | (msg.data[5] << 8) |
                       (msg.data[6] << 16) | (msg.data[7] << 24);
-        updateParameterBySDOId(paramId, raw / 32);
+        updateParameterBySDOId(paramId, raw);
     }
 }
 
@@ -660,12 +1029,12 @@ void CANDataManager::handleGenericMessage(CANMessage& msg) {
 
     if (msg.id == 0x522 && msg.length == 6) {
         CANParameter* p = getParameterByName("udc");
-        if (p) p->setValue(ivt24(msg) / 1000);
+        if (p) p->setRatio(ivt24(msg), 1000);   // mV → V, decimals kept
         return;
     }
     if (msg.id == 0x411 && msg.length == 6) {
         CANParameter* p = getParameterByName("idc");
-        if (p) p->setValue(ivt24(msg) / 1000);
+        if (p) p->setRatio(ivt24(msg), 1000);   // mA → A, decimals kept
         return;
     }
     if (msg.id == 0x526 && msg.length == 6) {
@@ -723,7 +1092,7 @@ void CANDataManager::handleGenericMessage(CANMessage& msg) {
     if (msg.id == 0x257 && msg.length >= 2) {
         int16_t raw = msg.data[0] | (msg.data[1] << 8);
         CANParameter* p = getParameterByName("speed");
-        if (p) p->setValue((int32_t)(raw * 0.09f));
+        if (p) p->setRatio((int32_t)raw * 9, 100);   // ×0.09 without float
         return;
     }
 
@@ -731,59 +1100,28 @@ void CANDataManager::handleGenericMessage(CANMessage& msg) {
 }
 
 // ============================================================================
-// handleBMSCellVoltage
+// isReservedId — frames with a dedicated decoder above, plus our own SDO/PDO
 // ============================================================================
 
-void CANDataManager::handleBMSCellVoltage(CANMessage& msg) {
-    uint8_t baseCell = 0;
-    if      (msg.id >= 0x400 && msg.id < 0x500) baseCell = (msg.id - 0x400) * 4;
-    else if (msg.id >= 0x600 && msg.id < 0x700) baseCell = (msg.id - 0x600) * 4;
-    else return;
-
-    uint8_t cellsInMsg = msg.length / 2;
-    if (cellsInMsg > 4) cellsInMsg = 4;
-
-    for (uint8_t i = 0; i < cellsInMsg; i++) {
-        uint8_t idx = baseCell + i;
-        if (idx < MAX_BMS_CELLS) {
-            bmsCellVoltages[idx]    = msg.data[i*2] | (msg.data[i*2+1] << 8);
-            bmsCellUpdateTimes[idx] = millis();
-            if (idx >= bmsCellCount) bmsCellCount = idx + 1;
-        }
+bool CANDataManager::isReservedId(uint32_t id) {
+    static const uint16_t reserved[] = {
+        0x126, 0x210, 0x257, 0x300, 0x301, 0x302, 0x355, 0x356, 0x373,
+        0x411, 0x500,
+        0x180 + CAN_NODE_ID, 0x280 + CAN_NODE_ID, 0x380 + CAN_NODE_ID, 0x480 + CAN_NODE_ID,
+        SDO_RX_ID, SDO_TX_ID,
+        0
+    };
+    if (id >= 0x521 && id <= 0x528) return true;   // IVT-S result channels
+    for (int i = 0; reserved[i]; i++) {
+        if (reserved[i] == id) return true;
     }
-}
-
-// ============================================================================
-// Cell voltage accessors
-// ============================================================================
-
-uint16_t CANDataManager::getCellVoltage(uint8_t cellIndex) {
-    return (cellIndex < MAX_BMS_CELLS) ? bmsCellVoltages[cellIndex] : 0;
-}
-
-uint32_t CANDataManager::getCellLastUpdate(uint8_t cellIndex) {
-    return (cellIndex < MAX_BMS_CELLS) ? bmsCellUpdateTimes[cellIndex] : 0;
+    return false;
 }
 
 // ============================================================================
 // Queue helpers
 // ============================================================================
 
-bool CANDataManager::enqueueTx(CANMessage& msg) {
-    uint8_t next = (txHead + 1) % TX_QUEUE_SIZE;
-    if (next == txTail) return false;
-    txQueue[txHead] = msg;
-    txHead = next;
-    return true;
-}
-
-bool CANDataManager::dequeueTx(CANMessage& msg) {
-    if (txHead == txTail) return false;
-    msg = txQueue[txTail];
-    txTail = (txTail + 1) % TX_QUEUE_SIZE;
-    return true;
-}
-
 bool CANDataManager::enqueueRx(CANMessage& msg) {
     uint8_t next = (rxHead + 1) % RX_QUEUE_SIZE;
     if (next == rxTail) return false;
@@ -800,12 +1138,11 @@ bool CANDataManager::dequeueRx(CANMessage& msg) {
 }
 
 bool CANDataManager::sendMessage(uint32_t id, uint8_t* data, uint8_t length) {
-    CANMessage msg;
-    msg.id        = id;
-    msg.length    = length;
-    msg.timestamp = millis();
-    memcpy(msg.data, data, length);
-    return enqueueTx(msg);
+    twai_message_t tx = {};
+    tx.identifier       = id;
+    tx.data_length_code = length > 8 ? 8 : length;
+    memcpy(tx.data, data, tx.data_length_code);
+    return CANTxScheduler::getInstance().submit(TxSource::USER, tx);
 }
 
 // ============================================================================
@@ -0,0 +1,208 @@
+// ============================================================================
+// CANLogger.cpp
+// ============================================================================
+
+#include "CANLogger.h"
+#include "Storage.h"
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+bool CANLogger::init() {
+    for (uint8_t i = 0; i < 2; i++) {
+        // PSRAM when present — only memcpy and the flash writer touch it
+        buf[i] = (uint8_t*)heap_caps_malloc(CANLOG_BUF_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!buf[i]) buf[i] = (uint8_t*)heap_caps_malloc(CANLOG_BUF_BYTES, MALLOC_CAP_8BIT);
+        busy[i] = false;
+    }
+    if (!buf[0] || !buf[1]) {
+        Serial.println("[CANLog] No memory for log buffers");
+        end();
+        return false;
+    }
+    writeQ = xQueueCreate(4, sizeof(WriteJob));
+    // Low priority on core 0 — flash writes must never preempt CAN or the UI
+    xTaskCreatePinnedToCore(writerEntry, "CANLog", 4096, this, 1, &writerTask, 0);
+    return true;
+}
+
+void CANLogger::end() {
+    if (writerTask) {
+        WriteJob job = { 0xFF, 0, isLogging(), true };
+        xQueueSend(writeQ, &job, portMAX_DELAY);
+        while (writerTask) vTaskDelay(1);   // writer clears it on the way out
+    }
+    if (writeQ) { vQueueDelete(writeQ); writeQ = nullptr; }
+    for (uint8_t i = 0; i < 2; i++) {
+        if (buf[i]) heap_caps_free(buf[i]);
+        buf[i] = nullptr;
+    }
+}
+
+bool CANLogger::start(const char* path, uint32_t bitrate) {
+    LogState s = logState.load();
+    if (!writerTask || s == LogState::LOGGING || s == LogState::STOPPING) return false;
+
+    if (Storage::fs().exists(path)) Storage::fs().remove(path);
+    logFile = Storage::fs().open(path, "w");
+    if (!logFile) {
+        Serial.printf("[CANLog] Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    // The header goes into the first buffer so every flash write stays whole
+    fillIdx = 0;
+    fillLen = sizeof(CANLogHeader);
+    CANLogHeader* h = (CANLogHeader*)buf[0];
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, "ZCAN", 4);
+    h->version    = CANLOG_VERSION;
+    h->recordSize = sizeof(CANLogRecord);
+    h->bitrate    = bitrate;
+    time_t now    = time(nullptr);
+    h->startUnix  = now > 1600000000 ? (uint32_t)now : 0;
+    h->startMs    = millis();
+
+    startUs         = esp_timer_get_time();
+    epoch           = 0;
+    frameCount      = 0;
+    recordCount     = 0;
+    droppedCount    = 0;
+    writeErrorCount = 0;
+    stopReq         = false;
+    logState        = LogState::LOGGING;   // publishes the fields above to loopTask
+    Serial.printf("[CANLog] Logging to %s\n", path);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Frame path — loopTask
+// ---------------------------------------------------------------------------
+
+void CANLogger::append(const twai_message_t& msg, int64_t nowUs) {
+    if (logState.load() != LogState::LOGGING) return;
+
+    uint64_t elapsed = (uint64_t)(nowUs - startUs);
+    uint32_t e = (uint32_t)(elapsed >> CANLOG_TS_BITS);
+    if (e != epoch) {
+        CANLogRecord mark = {};
+        mark.idFlags = CANLOG_MARK;
+        memcpy(mark.data, &e, sizeof(e));
+        if (!putRecord(mark)) { droppedCount++; return; }
+        epoch = e;
+    }
+
+    CANLogRecord rec;
+    rec.tsDlc   = ((uint32_t)elapsed & CANLOG_TS_MASK) |
+                  ((uint32_t)(msg.data_length_code & 0x0F) << CANLOG_TS_BITS);
+    rec.idFlags = (msg.identifier & CANLOG_ID_MASK) |
+                  (msg.extd ? CANLOG_EXT : 0) | (msg.rtr ? CANLOG_RTR : 0);
+    memcpy(rec.data, msg.data, 8);
+    if (putRecord(rec)) frameCount++;
+    else droppedCount++;
+}
+
+bool CANLogger::putRecord(const CANLogRecord& rec) {
+    // Writer still flushing this half — the other one filled up first
+    if (busy[fillIdx]) return false;
+    memcpy(buf[fillIdx] + fillLen, &rec, sizeof(rec));
+    fillLen += sizeof(rec);
+    recordCount++;
+    if (fillLen + sizeof(rec) > CANLOG_BUF_BYTES) seal(false);
+    return true;
+}
+
+void CANLogger::seal(bool last) {
+    WriteJob job = { 0xFF, 0, last, false };
+    if (fillLen && !busy[fillIdx]) {
+        job.idx = fillIdx;
+        job.len = fillLen;
+        busy[fillIdx] = true;
+        fillIdx ^= 1;
+        fillLen = 0;
+    }
+    // Queue depth covers both halves plus the close — never blocks
+    xQueueSend(writeQ, &job, 0);
+}
+
+void CANLogger::poll() {
+    if (stopReq && logState.load() == LogState::LOGGING) {
+        stopReq  = false;
+        logState = LogState::STOPPING;
+        seal(true);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Writer task
+// ---------------------------------------------------------------------------
+
+void CANLogger::writerEntry(void* arg) {
+    static_cast<CANLogger*>(arg)->writerLoop();
+}
+
+void CANLogger::writerLoop() {
+    WriteJob job;
+    for (;;) {
+        if (xQueueReceive(writeQ, &job, portMAX_DELAY) != pdTRUE) continue;
+
+        if (job.idx < 2) {
+            const uint8_t* p = buf[job.idx];
+            for (uint32_t off = 0; off < job.len; off += CANLOG_PAGE_BYTES) {
+                size_t n = job.len - off;
+                if (n > CANLOG_PAGE_BYTES) n = CANLOG_PAGE_BYTES;
+                if (logFile.write(p + off, n) != n) writeErrorCount++;
+            }
+            busy[job.idx] = false;
+        }
+
+        if (job.last) {
+            logFile.close();
+            logState = LogState::STOPPED;
+            Serial.printf("[CANLog] Logging stopped — %u frames, %u dropped, %u write errors\n",
+                frameCount, droppedCount, writeErrorCount);
+        }
+        if (job.quit) break;
+    }
+    writerTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+// =============================================================================
+// CANLogReader
+// =============================================================================
+
+bool CANLogReader::open(fs::FS& fs, const char* path) {
+    chunkLen = chunkPos = 0;
+    epoch = 0;
+    file = fs.open(path, "r");
+    if (!file) return false;
+    if (file.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr) ||
+        memcmp(hdr.magic, "ZCAN", 4) != 0 || hdr.version != CANLOG_VERSION ||
+        hdr.recordSize != sizeof(CANLogRecord)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool CANLogReader::next(CANLogRecord& rec, uint64_t& tsUs) {
+    for (;;) {
+        if (chunkPos >= chunkLen) {
+            if (!file) return false;
+            size_t n = file.read((uint8_t*)chunk, sizeof(chunk));
+            chunkLen = n / sizeof(CANLogRecord);
+            chunkPos = 0;
+            if (!chunkLen) return false;
+        }
+        rec = chunk[chunkPos++];
+        if (rec.idFlags & CANLOG_MARK) {
+            memcpy(&epoch, rec.data, sizeof(epoch));
+            continue;
+        }
+        tsUs = ((uint64_t)epoch << CANLOG_TS_BITS) | (rec.tsDlc & CANLOG_TS_MASK);
+        return true;
+    }
+}
@@ -1,6 +1,13 @@
 #include "CANMonitor.h"
 #include "CANData.h"
+#include "FixedPoint.h"
 #include <ArduinoJson.h>
+#include "HeapChurn.h"
+#include "FlightRecorder.h"
+#include "CANTxScheduler.h"
+#include <esp_timer.h>
+#include <memory>
+#include <time.h>
 
 // =============================================================================
 // Known CAN ID names
@@ -41,10 +48,38 @@ const char* CANMonitor::knownIDName(uint32_t id) {
 
 void CANMonitor::init(CANDataManager* mgr) {
     canMgr = mgr;
-    bufMutex  = xSemaphoreCreateMutex();
     wsQMutex  = xSemaphoreCreateMutex();
-    memset(idStats, 0, sizeof(idStats));
-    memset(throttle, 0, sizeof(throttle));
+    wsConnMutex = xSemaphoreCreateMutex();
+    memset(wsConns, 0, sizeof(wsConns));
+
+    // Per-ID table: 2048 direct slots + the extended-ID hash, ~100 KB
+    const size_t statSlots = CAN_STAT_STD_IDS + CAN_STAT_EXT_SLOTS;
+    idStats = (CANIDStat*)heap_caps_calloc(statSlots, sizeof(CANIDStat),
+                                           MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!idStats) {
+        idStats = (CANIDStat*)heap_caps_calloc(statSlots, sizeof(CANIDStat), MALLOC_CAP_8BIT);
+        if (!idStats) Serial.println("[CANMonitor] No memory for per-ID stats");
+    }
+    for (size_t i = 0; idStats && i < statSlots; i++) idStats[i].id = CAN_STAT_EMPTY;
+    logger.init();
+    memset(wsClients, 0, sizeof(wsClients));
+    // pushFrame runs in this (loop) task — count its allocations
+    HeapChurn::track(nullptr);
+
+    // Batch pool — PSRAM when available, it is only touched by memcpy and
+    // the WebSocket stack. Allocated once; the frame path never allocates.
+    // The extra batch is the sender's replay batch.
+    wsPool = (WsBatch*)heap_caps_calloc(WS_POOL_SIZE + 1, sizeof(WsBatch),
+                                        MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!wsPool)
+        wsPool = (WsBatch*)heap_caps_calloc(WS_POOL_SIZE + 1, sizeof(WsBatch), MALLOC_CAP_8BIT);
+    wsFreeQ  = xQueueCreate(WS_POOL_SIZE, sizeof(uint8_t));
+    wsReadyQ = xQueueCreate(WS_POOL_SIZE, sizeof(uint8_t));
+    wsCtlQ   = xQueueCreate(8, sizeof(WsCtl));
+    for (uint8_t i = 0; wsPool && i < WS_POOL_SIZE; i++) xQueueSend(wsFreeQ, &i, 0);
+
+    // Sender on core 0 with the WiFi stack; loopTask (CAN, LVGL) stays on core 1
+    xTaskCreatePinnedToCore(wsSenderEntry, "WSSend", 4096, this, 1, &wsSenderTask, 0);
     sessionStartMs = millis();
     Serial.println("[CANMonitor] Initialized");
 }
@@ -73,6 +108,9 @@ void CANMonitor::registerEndpoints(AsyncWebServer* server) {
     server->on("/can/log/download", HTTP_GET,
         [](AsyncWebServerRequest* r){ CANMonitor::instance().handleLogDownload(r); });
 
+    server->on("/can/history", HTTP_GET,
+        [](AsyncWebServerRequest* r){ CANMonitor::instance().handleHistory(r); });
+
     server->on("/can/stats", HTTP_GET,
         [](AsyncWebServerRequest* r){ CANMonitor::instance().handleStats(r); });
 
@@ -84,52 +122,487 @@ void CANMonitor::registerEndpoints(AsyncWebServer* server) {
 // =============================================================================
 
 void CANMonitor::pushFrame(const twai_message_t& msg) {
+    // Runs for every frame on a busy bus — fixed buffers only, no String,
+    // no network I/O. hotPathAllocs proves it (reported in /can/stats) in
+    // a HEAP_CHURN build.
+    uint32_t allocs0 = HeapChurn::count();
+
     CANFrame f;
     f.timestamp = millis();
     f.id        = msg.identifier;
     f.len       = msg.data_length_code;
     memcpy(f.data, msg.data, 8);
 
-    // Periodic WebSocket cleanup — prevents stale connections piling up
+    // Update per-ID statistics (always, regardless of active state)
+    int64_t  now64 = esp_timer_get_time();
+    uint32_t nowUs = (uint32_t)now64;
+    CANIDStat* st = updateIDStat(msg, nowUs);
+    sessionFrameCount++;
+
+    // Binary log — a 16-byte copy into the writer's double buffer
+    logger.append(msg, now64);
+
+    // Every frame goes into the binary batch — no per-ID throttling.
+    // CANData has already recorded it, so its seq is the one before head.
+    bool streaming = clientCount > 0 && ws;
+    if (streaming) appendToBatch(msg, nowUs, FrameHistory::getInstance().head() - 1);
+
+    // Decode only when an annotation is due for this ID — the log is
+    // decoded at download time
+    if (streaming && st && f.timestamp - st->lastAnnMs >= ANN_INTERVAL_MS) {
+        char decoded[DECODE_LEN];
+        decodeFrame(f, decoded, sizeof(decoded));
+        st->lastAnnMs = f.timestamp;
+        if (decoded[0] || knownIDName(f.id)) enqueueAnnotation(f, msg.extd, decoded);
+    }
+
+    hotPathAllocs += HeapChurn::count() - allocs0;
+}
+
+void CANMonitor::poll() {
+    logger.poll();
+    if (wsFill >= 0 && millis() - wsPool[wsFill].startMs >= WS_BATCH_MS) sealBatch();
+}
+
+// =============================================================================
+// Binary batch — loopTask side
+// =============================================================================
+
+void CANMonitor::appendToBatch(const twai_message_t& msg, uint32_t nowUs, uint32_t seq) {
+    // Full, the next record's offset would not fit in dtUs, or frames went
+    // unbatched since (streaming paused) — records must stay consecutive
+    if (wsFill >= 0) {
+        const WsBatch& cur = wsPool[wsFill];
+        uint32_t next = ((const WsBatchHeader*)cur.buf)->firstSeq + cur.count;
+        if (cur.count == WS_BATCH_FRAMES || nowUs - cur.baseUs > WS_BATCH_SPAN_US || seq != next)
+            sealBatch();
+    }
+
+    if (wsFill < 0) {
+        uint8_t idx;
+        if (!wsFreeQ || xQueueReceive(wsFreeQ, &idx, 0) != pdTRUE) {
+            // Every batch is still queued for some client — the browser
+            // sees this as a firstSeq gap
+            wsFramesDropped++;
+            return;
+        }
+        wsFill = idx;
+        WsBatch& b = wsPool[idx];
+        b.count   = 0;
+        b.baseUs  = nowUs;
+        b.startMs = millis();
+        WsBatchHeader* h = (WsBatchHeader*)b.buf;
+        h->magic    = WS_BATCH_MAGIC;
+        h->version  = WS_BATCH_VERSION;
+        h->baseUs   = nowUs;
+        h->firstSeq = seq;
+    }
+
+    WsBatch& b = wsPool[wsFill];
+    WsFrameRecord* r = (WsFrameRecord*)(b.buf + sizeof(WsBatchHeader)) + b.count;
+    uint8_t dlc = msg.data_length_code > 8 ? 8 : msg.data_length_code;
+    r->dtUs     = (uint16_t)(nowUs - b.baseUs);
+    r->flags    = dlc | (msg.rtr ? 0x40 : 0) | (msg.extd ? 0x80 : 0);
+    r->dtHi     = 0;
+    r->id       = msg.identifier;
+    memcpy(r->data, msg.data, 8);
+    b.count++;
+}
+
+void CANMonitor::sealBatch() {
+    uint8_t idx = (uint8_t)wsFill;
+    ((WsBatchHeader*)wsPool[idx].buf)->count = wsPool[idx].count;
+    xQueueSend(wsReadyQ, &idx, 0);   // sized for the whole pool — never full
+    wsFill = -1;
+}
+
+// =============================================================================
+// Sender task — the only place /ws/can touches the network
+// =============================================================================
+
+void CANMonitor::wsSenderEntry(void* arg) {
+    static_cast<CANMonitor*>(arg)->wsSenderLoop();
+}
+
+void CANMonitor::wsSenderLoop() {
+    for (;;) {
+        WsCtl ctl;
+        while (xQueueReceive(wsCtlQ, &ctl, 0) == pdTRUE) applyWsCtl(ctl);
+
+        // Wake for each sealed batch, or every WS_BATCH_MS to drain rings
+        // into clients whose queues have emptied
+        uint8_t idx;
+        if (xQueueReceive(wsReadyQ, &idx, pdMS_TO_TICKS(WS_BATCH_MS)) == pdTRUE) {
+            do {
+                distributeBatch(idx);
+                pumpClients();
+            } while (xQueueReceive(wsReadyQ, &idx, 0) == pdTRUE);
+        } else {
+            pumpClients();
+        }
+        flushWsQueue();
+    }
+}
+
+// Periodic WebSocket cleanup — prevents stale connections piling up
+void CANMonitor::cleanupClients() {
     static uint32_t lastCleanup = 0;
     if (ws && millis() - lastCleanup > 2000) {
         ws->cleanupClients();
         lastCleanup = millis();
     }
+}
 
-    // Update per-ID statistics (always, regardless of active state)
-    updateIDStat(f.id);
-    sessionFrameCount++;
+AsyncWebSocketClient* CANMonitor::takeWsConn(uint32_t id) {
+    if (!wsConnMutex || xSemaphoreTake(wsConnMutex, portMAX_DELAY) != pdTRUE) return nullptr;
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++)
+        if (wsConns[i].id == id && wsConns[i].cl) return wsConns[i].cl;
+    xSemaphoreGive(wsConnMutex);
+    return nullptr;
+}
+
+void CANMonitor::setWsConn(uint32_t id, AsyncWebSocketClient* cl) {
+    if (!wsConnMutex) return;
+    xSemaphoreTake(wsConnMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        WsConn& w = wsConns[i];
+        if (cl && !w.id) { w.id = id; w.cl = cl; break; }
+        if (!cl && w.id == id) { w.id = 0; w.cl = nullptr; break; }
+    }
+    xSemaphoreGive(wsConnMutex);
+}
+
+void CANMonitor::releaseBatch(uint8_t idx) {
+    if (wsPool[idx].refs && --wsPool[idx].refs) return;
+    xQueueSend(wsFreeQ, &idx, 0);
+}
+
+void CANMonitor::dropClientRing(WsClientState& c) {
+    while (c.ringCount) {
+        uint8_t idx = c.ring[c.ringHead];
+        c.droppedFrames += wsPool[idx].count;
+        c.droppedBatches++;
+        c.ringHead = (c.ringHead + 1) % WS_CLIENT_RING;
+        c.ringCount--;
+        releaseBatch(idx);
+    }
+}
+
+// Queue a sealed batch on every client ring, applying each client's policy
+// when its ring is backed up
+void CANMonitor::distributeBatch(uint8_t idx) {
+    WsBatch& b = wsPool[idx];
+    b.refs = 1;   // held by this function until every ring has it
+
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        WsClientState& c = wsClients[i];
+        if (!c.id || c.closing) continue;
+
+        if (c.replaying) {
+            // The replay runs up to the oldest batch still queued, so the
+            // ring only has to keep the newest ones — nothing dropped here
+            // is lost, whatever the policy
+            if (c.ringCount == WS_CLIENT_RING) {
+                uint8_t old = c.ring[c.ringHead];
+                c.ringHead = (c.ringHead + 1) % WS_CLIENT_RING;
+                c.ringCount--;
+                releaseBatch(old);
+            }
+        } else if (c.policy == WsDropPolicy::DECIMATE) {
+            // Backed up: alternate batches until the ring drains below half
+            if (c.ringCount >= WS_CLIENT_RING / 2) {
+                c.skipNext = !c.skipNext;
+                if (c.skipNext) {
+                    c.droppedFrames += b.count;
+                    c.droppedBatches++;
+                    continue;
+                }
+            } else {
+                c.skipNext = false;
+            }
+        }
+
+        if (c.ringCount == WS_CLIENT_RING && !c.replaying) {
+            if (c.policy == WsDropPolicy::DROP_CLIENT) {
+                c.droppedFrames += b.count;
+                c.droppedBatches++;
+                dropClientRing(c);
+                c.closing = true;
+                if (AsyncWebSocketClient* cl = takeWsConn(c.id)) {
+                    cl->close();
+                    giveWsConn();
+                }
+                Serial.printf("[CANMonitor] WS client %u too slow — dropped\n", c.id);
+                continue;
+            }
+            // DROP_OLDEST, and DECIMATE when halving wasn't enough
+            uint8_t old = c.ring[c.ringHead];
+            c.droppedFrames += wsPool[old].count;
+            c.droppedBatches++;
+            c.ringHead = (c.ringHead + 1) % WS_CLIENT_RING;
+            c.ringCount--;
+            releaseBatch(old);
+        }
+
+        c.ring[(c.ringHead + c.ringCount) % WS_CLIENT_RING] = idx;
+        c.ringCount++;
+        b.refs++;
+    }
+    releaseBatch(idx);
+}
 
-    // Decode once — used by both logging and WebSocket
-    String decoded = (logState == LogState::LOGGING || clientCount > 0)
-                     ? decodeFrame(f) : String("");
+// Move batches from our rings into each client's own send queue, but only
+// while that queue is short — a slow client backs up here, where its
+// policy applies, instead of inside the WebSocket stack
+void CANMonitor::pumpClients() {
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+        WsClientState& c = wsClients[i];
+        if (!c.id || !(c.ringCount || c.replaying)) continue;
+
+        // Held until this client is done — its disconnect waits for it
+        AsyncWebSocketClient* cl = takeWsConn(c.id);
+        if (cl && cl->status() != WS_CONNECTED) {
+            giveWsConn();
+            cl = nullptr;
+        }
+        if (!cl) {
+            dropClientRing(c);
+            c.replaying = false;
+            continue;
+        }
 
-    // Write to CSV log if logging
-    if (logState == LogState::LOGGING) {
-        writeCSVRow(f, decoded);
-        logFrameCount++;
+        // History first, up to where the queued live batches begin
+        while (c.replaying && cl->queueLen() < WS_CLIENT_MAX_QUEUED) {
+            uint32_t until = c.ringCount
+                ? ((const WsBatchHeader*)wsPool[c.ring[c.ringHead]].buf)->firstSeq
+                : FrameHistory::getInstance().head();
+            if (!buildReplayBatch(c, until)) {
+                c.replaying = false;
+                break;
+            }
+            sendBatch(c, cl, wsPool[WS_REPLAY_IDX]);
+        }
+        if (c.replaying) { giveWsConn(); continue; }
+
+        while (c.ringCount && cl->queueLen() < WS_CLIENT_MAX_QUEUED) {
+            uint8_t idx = c.ring[c.ringHead];
+            sendBatch(c, cl, wsPool[idx]);
+            c.ringHead = (c.ringHead + 1) % WS_CLIENT_RING;
+            c.ringCount--;
+            releaseBatch(idx);
+        }
+        giveWsConn();
     }
+}
 
-    // Push to WebSocket clients if any connected
-    if (clientCount > 0 && ws) {
-        if (!shouldThrottle(f.id)) {
-            markSent(f.id);
-            uint32_t cnt = 0;
-            for (uint8_t i = 0; i < idStatCount; i++) {
-                if (idStats[i].id == f.id) { cnt = idStats[i].count; break; }
+// One batch to one client — through its subscription when it has one
+void CANMonitor::sendBatch(WsClientState& c, AsyncWebSocketClient* cl, const WsBatch& b) {
+    if (c.filter) {
+        uint16_t kept = filterBatch(c, b);
+        c.filteredFrames += b.count - kept;
+        if (!kept) return;
+        cl->binary(wsScratch, sizeof(WsBatchHeader) + kept * sizeof(WsFrameRecord));
+        c.sentFrames += kept;
+        wsFramesSent += kept;
+    } else {
+        cl->binary(b.buf, sizeof(WsBatchHeader) + b.count * sizeof(WsFrameRecord));
+        c.sentFrames += b.count;
+        wsFramesSent += b.count;
+    }
+    wsBatchesSent++;
+}
+
+// Next replay batch for `c` into the replay slot — history frames from
+// c.replaySeq up to (not including) `until`. Frames the history has
+// already overwritten are skipped, which the client sees as a firstSeq
+// gap. false once there is nothing left to replay.
+bool CANMonitor::buildReplayBatch(WsClientState& c, uint32_t until) {
+    FrameHistory& hist = FrameHistory::getInstance();
+    WsBatch& b = wsPool[WS_REPLAY_IDX];
+    WsBatchHeader* h = (WsBatchHeader*)b.buf;
+    WsFrameRecord* r = (WsFrameRecord*)(b.buf + sizeof(WsBatchHeader));
+    b.count = 0;
+
+    HistoryFrame fr;
+    while (b.count < WS_BATCH_FRAMES && (int32_t)(c.replaySeq - until) < 0) {
+        if (!hist.read(c.replaySeq, fr)) {
+            if (b.count) break;   // send these first; the jump shows as a gap
+            uint32_t oldest = hist.oldest();
+            if ((int32_t)(oldest - c.replaySeq) <= 0) break;
+            c.replaySeq = oldest;
+            continue;
+        }
+        if (!b.count) {
+            b.baseUs    = fr.us;
+            h->baseUs   = fr.us;
+            h->firstSeq = c.replaySeq;
+        } else if (fr.us - b.baseUs > WS_REPLAY_SPAN_US) {
+            break;
+        }
+        uint32_t dt  = fr.us - b.baseUs;
+        uint8_t  dlc = CANLogReader::dlc(fr.rec);
+        WsFrameRecord& o = r[b.count++];
+        o.dtUs  = (uint16_t)dt;
+        o.dtHi  = (uint8_t)(dt >> 16);
+        o.flags = (dlc > 8 ? 8 : dlc) | (CANLogReader::rtr(fr.rec) ? 0x40 : 0) |
+                  (CANLogReader::extended(fr.rec) ? 0x80 : 0);
+        o.id    = CANLogReader::id(fr.rec);
+        memcpy(o.data, fr.rec.data, 8);
+        c.replaySeq++;
+    }
+
+    h->magic   = WS_BATCH_MAGIC;
+    h->version = WS_BATCH_VERSION;
+    h->count   = b.count;
+    return b.count > 0;
+}
+
+// -----------------------------------------------------------------------------
+// Subscriptions — applied per client while pumping, so the cost of a filter
+// lands on the sender task and only matching records reach the WiFi stack
+// -----------------------------------------------------------------------------
+
+bool CANMonitor::filterMatches(const WsFilter& f, uint32_t id, bool extended) {
+    if (!f.ruleCount) return true;
+    for (uint8_t i = 0; i < f.ruleCount; i++) {
+        const WsFilterRule& r = f.rules[i];
+        if (r.extended == extended && (id & r.mask) == (r.id & r.mask)) return true;
+    }
+    return false;
+}
+
+// Copy the records of `b` this client wants into wsScratch; returns how many
+uint16_t CANMonitor::filterBatch(WsClientState& c, const WsBatch& b) {
+    const WsFilter& f = *c.filter;
+    const WsFrameRecord* in = (const WsFrameRecord*)(b.buf + sizeof(WsBatchHeader));
+    WsFrameRecord* out = (WsFrameRecord*)(wsScratch + sizeof(WsBatchHeader));
+    uint16_t kept = 0;
+
+    for (uint16_t i = 0; i < b.count; i++) {
+        const WsFrameRecord& r = in[i];
+        bool ext = r.flags & 0x80;
+        if (!filterMatches(f, r.id, ext)) continue;
+
+        // Rate / change state lives in the slot idStats gave this ID. The
+        // slot was created by pushFrame before the frame was batched, so a
+        // lookup without create always finds it (an extended ID that
+        // overflowed the hash simply passes unthrottled).
+        CANIDStat* st = c.sent ? findIDStat(r.id, ext, false) : nullptr;
+        if (st) {
+            WsSentState& s = c.sent[st - idStats];
+            uint32_t us = b.baseUs + r.dtUs + ((uint32_t)r.dtHi << 16);
+            uint8_t  n  = r.flags & 0x40 ? 0 : (r.flags & 0x0F);
+            if (s.valid) {
+                if (f.minGapUs && us - s.us < f.minGapUs) continue;
+                if (f.changesOnly && s.flags == r.flags && memcmp(s.data, r.data, n) == 0) continue;
             }
-            enqueueWsMsg(frameToJson(f, decoded, cnt));
+            s.valid = true;
+            s.us    = us;
+            s.flags = r.flags;
+            memcpy(s.data, r.data, 8);
         }
+        out[kept++] = r;
     }
-    flushWsQueue();
 
-    // Store in circular buffer
-    if (xSemaphoreTake(bufMutex, 0) == pdTRUE) {
-        frameBuf[bufHead] = f;
-        bufHead = (bufHead + 1) % BUF_SIZE;
-        if (bufCount < BUF_SIZE) bufCount++;
-        xSemaphoreGive(bufMutex);
+    if (kept) {
+        memcpy(wsScratch, b.buf, sizeof(WsBatchHeader));
+        ((WsBatchHeader*)wsScratch)->count = kept;
+    }
+    return kept;
+}
+
+void CANMonitor::freeClientFilter(WsClientState& c) {
+    delete c.filter;
+    c.filter = nullptr;
+    if (c.sent) heap_caps_free(c.sent);
+    c.sent = nullptr;
+}
+
+// Sender task — adopt `filter` (nullptr = whole bus). Per-ID state is only
+// kept when the subscription needs it, and starts empty so the first frame
+// of every ID goes out.
+void CANMonitor::setClientFilter(WsClientState& c, WsFilter* filter) {
+    bool needState = filter && (filter->minGapUs || filter->changesOnly);
+    WsSentState* sent = c.sent;
+    c.sent = nullptr;
+    freeClientFilter(c);
+    c.filter = filter;
+    if (!needState) {
+        if (sent) heap_caps_free(sent);
+        return;
+    }
+
+    const size_t slots = CAN_STAT_STD_IDS + CAN_STAT_EXT_SLOTS;
+    if (!sent) {
+        sent = (WsSentState*)heap_caps_calloc(slots, sizeof(WsSentState),
+                                              MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!sent) sent = (WsSentState*)heap_caps_calloc(slots, sizeof(WsSentState), MALLOC_CAP_8BIT);
+        if (!sent) Serial.printf("[CANMonitor] WS client %u: no memory for maxRate/changesOnly\n", c.id);
+    } else {
+        memset(sent, 0, slots * sizeof(WsSentState));
+    }
+    c.sent = sent;
+}
+
+// -----------------------------------------------------------------------------
+// Client bookkeeping — async_tcp posts, the sender task applies
+// -----------------------------------------------------------------------------
+
+bool CANMonitor::postWsCtl(WsCtlOp op, uint32_t id, WsDropPolicy policy, WsFilter* filter,
+                           uint32_t seq) {
+    WsCtl ctl = { op, policy, id, filter, seq };
+    if (wsCtlQ && xQueueSend(wsCtlQ, &ctl, pdMS_TO_TICKS(10)) == pdTRUE) return true;
+    delete filter;
+    return false;
+}
+
+CANMonitor::WsClientState* CANMonitor::findWsClient(uint32_t id) {
+    for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++)
+        if (wsClients[i].id == id) return &wsClients[i];
+    return nullptr;
+}
+
+void CANMonitor::applyWsCtl(const WsCtl& ctl) {
+    WsClientState* c = findWsClient(ctl.id);
+    switch (ctl.op) {
+        case WsCtlOp::ADD:
+            if (c) break;
+            c = findWsClient(0);
+            if (!c) {
+                Serial.printf("[CANMonitor] WS client %u not streamed — %d clients max\n",
+                    ctl.id, WS_MAX_CLIENTS);
+                break;
+            }
+            memset(c, 0, sizeof(*c));   // filter / sent were freed on REMOVE
+            c->id     = ctl.id;
+            c->policy = WsDropPolicy::DROP_OLDEST;
+            break;
+        case WsCtlOp::REMOVE:
+            if (!c) break;
+            dropClientRing(*c);
+            freeClientFilter(*c);
+            c->id = 0;
+            break;
+        case WsCtlOp::POLICY:
+            if (c) c->policy = ctl.policy;
+            break;
+        case WsCtlOp::SUBSCRIBE:
+            if (c) setClientFilter(*c, ctl.filter);
+            else   delete ctl.filter;
+            break;
+        case WsCtlOp::REPLAY:
+            if (!c) break;
+            c->replaying = true;
+            c->replaySeq = ctl.seq;
+            break;
+    }
+}
+
+const char* CANMonitor::policyName(WsDropPolicy p) {
+    switch (p) {
+        case WsDropPolicy::DECIMATE:    return "decimate";
+        case WsDropPolicy::DROP_CLIENT: return "close";
+        default:                        return "oldest";
     }
 }
 
@@ -143,12 +616,11 @@ bool CANMonitor::transmitFrame(uint32_t id, uint8_t* data, uint8_t len) {
     msg.data_length_code = len;
     msg.extd             = 0;
     memcpy(msg.data, data, len);
-    esp_err_t err = twai_transmit(&msg, pdMS_TO_TICKS(20));
-    if (err != ESP_OK) {
-        Serial.printf("[CANMonitor] Transmit failed: 0x%X\n", err);
+    if (!CANTxScheduler::getInstance().submit(TxSource::USER, msg)) {
+        Serial.printf("[CANMonitor] Transmit refused: ID=0x%03X (rate limit or queue full)\n", id);
         return false;
     }
-    Serial.printf("[CANMonitor] TX: ID=0x%03X len=%d\n", id, len);
+    Serial.printf("[CANMonitor] TX queued: ID=0x%03X len=%d\n", id, len);
     return true;
 }
 
@@ -157,56 +629,21 @@ bool CANMonitor::transmitFrame(uint32_t id, uint8_t* data, uint8_t len) {
 // =============================================================================
 
 void CANMonitor::startLogging() {
-    if (logState == LogState::LOGGING) return;
-
-    // Remove old log
-    if (SPIFFS.exists("/canlog.csv")) SPIFFS.remove("/canlog.csv");
-
-    logFile = SPIFFS.open("/canlog.csv", "w");
-    if (!logFile) {
-        Serial.println("[CANMonitor] Failed to open /canlog.csv for writing");
-        return;
-    }
-
-    // CSV header
-    logFile.println("timestamp_ms,id_hex,id_name,len,b0,b1,b2,b3,b4,b5,b6,b7,decoded");
-    logFrameCount = 0;
-    logState = LogState::LOGGING;
-    Serial.println("[CANMonitor] Logging started");
+    // Drop the pre-binary CSV log so it can't be mistaken for the new one
+    if (Storage::fs().exists("/canlog.csv")) Storage::fs().remove("/canlog.csv");
+    logger.start(CANLOG_PATH, CAN_BAUDRATE);
 }
 
 void CANMonitor::stopLogging() {
-    if (logState != LogState::LOGGING) return;
-    logFile.flush();
-    logFile.close();
-    logState = LogState::STOPPED;
-    Serial.printf("[CANMonitor] Logging stopped — %u frames\n", logFrameCount);
-}
-
-void CANMonitor::writeCSVRow(const CANFrame& f, const String& decoded) {
-    if (!logFile) return;
-    const char* name = knownIDName(f.id);
-
-    char row[200];
-    snprintf(row, sizeof(row),
-        "%u,0x%03X,%s,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%s",
-        f.timestamp,
-        f.id,
-        name ? name : "",
-        f.len,
-        f.data[0], f.data[1], f.data[2], f.data[3],
-        f.data[4], f.data[5], f.data[6], f.data[7],
-        decoded.c_str()
-    );
-    logFile.println(row);
+    logger.requestStop();
 }
 
 // =============================================================================
 // Decoder
 // =============================================================================
 
-String CANMonitor::decodeFrame(const CANFrame& f) {
-    char buf[80];
+size_t CANMonitor::decodeFrame(const CANFrame& f, char* out, size_t cap) {
+    char num[16];   // integer-only FixedPoint rendering — no float printf
 
     switch (f.id) {
         case 0x583: {
@@ -217,28 +654,30 @@ String CANMonitor::decodeFrame(const CANFrame& f) {
             int32_t val  = (int32_t)(f.data[4] | (f.data[5]<<8) |
                                      (f.data[6]<<16) | (f.data[7]<<24));
             if (cmd == 0x80) {
-                snprintf(buf, sizeof(buf), "ABORT idx=0x%04X sub=%d err=0x%08X",
+                snprintf(out, cap, "ABORT idx=0x%04X sub=%d err=0x%08X",
                     idx, sub, (unsigned)val);
             } else if (cmd == 0x60) {
-                snprintf(buf, sizeof(buf), "WRITE ACK idx=0x%04X sub=%d", idx, sub);
+                snprintf(out, cap, "WRITE ACK idx=0x%04X sub=%d", idx, sub);
             } else {
-                // Read response — look up param name
-                float fval = val / 32.0f;
+                // Read response — look up param name and its scale descriptor
                 const char* paramName = nullptr;
+                FixedScale scale = FixedPoint::sdoDefault();
                 if (canMgr) {
                     // Reconstruct paramId from index/subindex
                     uint16_t paramId = ((idx & 0xFF) << 8) | sub;
                     CANParameter* p = canMgr->getParameter(paramId);
-                    if (p) paramName = p->name;
+                    if (p) { paramName = p->name; scale = p->scale; }
                 }
+                FixedPoint::format(num, sizeof(num),
+                                   FixedPoint::fromRaw(val, scale), scale.decimals);
                 if (paramName) {
-                    snprintf(buf, sizeof(buf), "READ %s = %.2f", paramName, fval);
+                    snprintf(out, cap, "READ %s = %s", paramName, num);
                 } else {
-                    snprintf(buf, sizeof(buf), "READ idx=0x%04X sub=%d val=%.2f",
-                        idx, sub, fval);
+                    snprintf(out, cap, "READ idx=0x%04X sub=%d val=%s",
+                        idx, sub, num);
                 }
             }
-            return String(buf);
+            break;
         }
 
         case 0x603: {
@@ -247,232 +686,255 @@ String CANMonitor::decodeFrame(const CANFrame& f) {
             uint16_t idx = f.data[1] | (f.data[2] << 8);
             uint8_t sub  = f.data[3];
             if (cmd == 0x40) {
-                snprintf(buf, sizeof(buf), "READ REQ idx=0x%04X sub=%d", idx, sub);
+                snprintf(out, cap, "READ REQ idx=0x%04X sub=%d", idx, sub);
             } else if (cmd == 0x23) {
                 int32_t val = (int32_t)(f.data[4] | (f.data[5]<<8) |
                                         (f.data[6]<<16) | (f.data[7]<<24));
-                snprintf(buf, sizeof(buf), "WRITE REQ idx=0x%04X sub=%d val=%d (%.2f)",
-                    idx, sub, val, val / 32.0f);
+                FixedPoint::format(num, sizeof(num),
+                    FixedPoint::fromRaw(val, FixedPoint::sdoDefault()), 2);
+                snprintf(out, cap, "WRITE REQ idx=0x%04X sub=%d val=%d (%s)",
+                    idx, sub, val, num);
             } else if (cmd == 0x60) {
-                snprintf(buf, sizeof(buf), "SEGMENT REQ toggle=%d",
+                snprintf(out, cap, "SEGMENT REQ toggle=%d",
                     (f.data[0] >> 4) & 1);
             } else {
-                snprintf(buf, sizeof(buf), "SDO cmd=0x%02X", cmd);
+                snprintf(out, cap, "SDO cmd=0x%02X", cmd);
             }
-            return String(buf);
+            break;
         }
 
         case 0x355: {
             int16_t soc = f.data[0] | (f.data[1] << 8);
-            snprintf(buf, sizeof(buf), "SOC=%d%%", soc);
-            return String(buf);
+            snprintf(out, cap, "SOC=%d%%", soc);
+            break;
         }
 
         case 0x356: {
             int16_t tmpm = (int16_t)(f.data[4] | (f.data[5] << 8));
-            snprintf(buf, sizeof(buf), "Motor temp=%d°C", tmpm);
-            return String(buf);
+            snprintf(out, cap, "Motor temp=%d°C", tmpm);
+            break;
         }
 
         case 0x126: {
             int16_t tmphs = (int16_t)(f.data[4] | (f.data[5] << 8));
-            snprintf(buf, sizeof(buf), "Inverter temp=%d°C", tmphs);
-            return String(buf);
+            snprintf(out, cap, "Inverter temp=%d°C", tmphs);
+            break;
         }
 
         case 0x257: {
             int16_t spd = (int16_t)(f.data[0] | (f.data[1] << 8));
-            snprintf(buf, sizeof(buf), "Speed=%d rpm", spd);
-            return String(buf);
+            snprintf(out, cap, "Speed=%d rpm", spd);
+            break;
         }
 
         case 0x521: {
             int32_t mv = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (mv & 0x800000) mv |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "U1=%.1fV", mv / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(mv, 1000, 1), 1);
+            snprintf(out, cap, "U1=%sV", num);
+            break;
         }
         case 0x522: {
             // IVT-S: bytes 2-4 = 24-bit little-endian value in mV
             int32_t mv = (int32_t)(f.data[2] | (f.data[3] << 8) | (f.data[4] << 16));
             if (mv & 0x800000) mv |= 0xFF000000;  // sign extend
-            snprintf(buf, sizeof(buf), "Voltage=%.1fV", mv / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(mv, 1000, 1), 1);
+            snprintf(out, cap, "Voltage=%sV", num);
+            break;
         }
         case 0x523: {
             int32_t mv = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (mv & 0x800000) mv |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "U3=%.1fV", mv / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(mv, 1000, 1), 1);
+            snprintf(out, cap, "U3=%sV", num);
+            break;
         }
         case 0x524: {
             int32_t mv = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (mv & 0x800000) mv |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "U4=%.1fV", mv / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(mv, 1000, 1), 1);
+            snprintf(out, cap, "U4=%sV", num);
+            break;
         }
         case 0x525: {
             int32_t ma = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (ma & 0x800000) ma |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "I2=%.2fA", ma / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(ma, 1000, 2), 2);
+            snprintf(out, cap, "I2=%sA", num);
+            break;
         }
         case 0x526: {
             int32_t dt = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (dt & 0x800000) dt |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "Temp=%.1f°C", dt / 10.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(dt, 10, 1), 1);
+            snprintf(out, cap, "Temp=%s°C", num);
+            break;
         }
         case 0x527: {
             int32_t pw = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (pw & 0x800000) pw |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "Power=%.1fkW", pw / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(pw, 1000, 1), 1);
+            snprintf(out, cap, "Power=%skW", num);
+            break;
         }
         case 0x528: {
             int32_t as = (int32_t)(f.data[2] | (f.data[3]<<8) | (f.data[4]<<16));
             if (as & 0x800000) as |= 0xFF000000;
-            snprintf(buf, sizeof(buf), "Charge=%.1fAs", as / 10.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(as, 10, 1), 1);
+            snprintf(out, cap, "Charge=%sAs", num);
+            break;
         }
 
         case 0x411: {
             // IVT-S: bytes 2-4 = 24-bit little-endian value in mA
             int32_t ma = (int32_t)(f.data[2] | (f.data[3] << 8) | (f.data[4] << 16));
             if (ma & 0x800000) ma |= 0xFF000000;  // sign extend
-            snprintf(buf, sizeof(buf), "Current=%.2fA", ma / 1000.0f);
-            return String(buf);
+            FixedPoint::format(num, sizeof(num), FixedPoint::fromRatio(ma, 1000, 2), 2);
+            snprintf(out, cap, "Current=%sA", num);
+            break;
         }
 
         case 0x373: {
             uint16_t vmin = f.data[0] | (f.data[1] << 8);
             uint16_t vmax = f.data[2] | (f.data[3] << 8);
-            snprintf(buf, sizeof(buf), "Vmin=%umV Vmax=%umV delta=%umV",
+            snprintf(out, cap, "Vmin=%umV Vmax=%umV delta=%umV",
                 vmin, vmax, vmax - vmin);
-            return String(buf);
+            break;
         }
 
         case 0x35E: {
-            // BMS name — ASCII string
+            // BMS name — ASCII string, padded with NULs. Anything else is
+            // shown as '?', so the text needs no escaping in JSON or CSV.
             char name[9] = {0};
-            for (int i = 0; i < 8 && i < (int)f.len; i++) name[i] = f.data[i];
-            snprintf(buf, sizeof(buf), "BMS=%s", name);
-            return String(buf);
+            for (int i = 0; i < 8 && i < (int)f.len && f.data[i]; i++) {
+                char c = (char)f.data[i];
+                name[i] = (c >= 0x20 && c < 0x7F && c != '"' && c != '\\' && c != ',') ? c : '?';
+            }
+            snprintf(out, cap, "BMS=%s", name);
+            break;
         }
 
         default:
-            return String("");
+            out[0] = '\0';
+            break;
     }
+    return strlen(out);
 }
 
 // =============================================================================
-// Frame → JSON
+// WebSocket text queue — enqueue from anywhere, flush from main loop only
 // =============================================================================
 
-String CANMonitor::frameToJson(const CANFrame& f, const String& decoded,
-                                uint32_t countForID) {
-    char json[300];
-    const char* name = knownIDName(f.id);
-
-    snprintf(json, sizeof(json),
-        "{\"t\":%u,\"id\":\"0x%03X\",\"name\":\"%s\",\"len\":%d,"
-        "\"data\":[%d,%d,%d,%d,%d,%d,%d,%d],"
-        "\"decoded\":\"%s\",\"count\":%u}",
-        f.timestamp,
-        f.id,
-        name ? name : "",
-        f.len,
-        f.data[0], f.data[1], f.data[2], f.data[3],
-        f.data[4], f.data[5], f.data[6], f.data[7],
-        decoded.c_str(),
-        countForID
-    );
-    return String(json);
-}
-
-// =============================================================================
-// WebSocket send queue — enqueue from anywhere, flush from main loop only
-// =============================================================================
-
-void CANMonitor::enqueueWsMsg(const String& json) {
+// Annotation JSON is rendered straight into the next free queue slot
+void CANMonitor::enqueueAnnotation(const CANFrame& f, bool extended, const char* decoded) {
     if (!wsQMutex) return;
     if (xSemaphoreTake(wsQMutex, 0) == pdTRUE) {
         uint8_t next = (wsQHead + 1) % WS_QUEUE_SIZE;
         if (next != wsQTail) {  // not full
-            strncpy(wsQueue[wsQHead].json, json.c_str(), 299);
-            wsQueue[wsQHead].json[299] = '\0';
-            wsQHead = next;
+            const char* name = knownIDName(f.id);
+            WsMsg& m = wsQueue[wsQHead];
+            m.id       = f.id;
+            m.extended = extended;
+            char id[12];
+            snprintf(id, sizeof(id), "0x%03X", (unsigned)f.id);
+            // decoded can carry bytes straight off the bus — escaped on the way in
+            JsonWriter w(m.json, sizeof(m.json));
+            w.beginObject();
+            w.key("type");    w.valueName("ann", 3);
+            w.key("id");      w.valueName(id, strlen(id));
+            w.key("name");    w.valueString(name ? name : "");
+            w.key("decoded"); w.valueString(decoded);
+            w.endObject();
+            w.c_str();
+            if (!w.overflow()) wsQHead = next;
         }
         xSemaphoreGive(wsQMutex);
     }
 }
 
+// Annotations are lossy (re-sent every ANN_INTERVAL_MS) — a client that is
+// already backed up simply misses them, and a subscribed client only gets
+// those for IDs it asked for
 void CANMonitor::flushWsQueue() {
     if (!ws || !wsQMutex) return;
     if (xSemaphoreTake(wsQMutex, 0) != pdTRUE) return;
     while (wsQTail != wsQHead) {
-        ws->textAll(wsQueue[wsQTail].json);
+        const WsMsg& m = wsQueue[wsQTail];
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; i++) {
+            const WsClientState& c = wsClients[i];
+            if (!c.id || c.closing) continue;
+            if (c.filter && !filterMatches(*c.filter, m.id, m.extended)) continue;
+            AsyncWebSocketClient* cl = takeWsConn(c.id);
+            if (!cl) continue;
+            if (cl->status() == WS_CONNECTED && cl->queueLen() < WS_CLIENT_MAX_QUEUED)
+                cl->text(m.json);
+            giveWsConn();
+        }
         wsQTail = (wsQTail + 1) % WS_QUEUE_SIZE;
     }
     xSemaphoreGive(wsQMutex);
 }
 
 // =============================================================================
-// Throttle — don't send same ID more than once per 50ms to WebSocket
+// Per-ID statistics — O(1) per frame
 // =============================================================================
 
-bool CANMonitor::shouldThrottle(uint32_t id) {
-    for (uint8_t i = 0; i < THROTTLE_SLOTS; i++) {
-        if (throttle[i].id == id) {
-            return (millis() - throttle[i].lastSentMs) < 50;
-        }
-    }
-    return false;  // ID not seen before — don't throttle
-}
+CANIDStat* CANMonitor::findIDStat(uint32_t id, bool extended, bool create) {
+    if (!idStats) return nullptr;
 
-void CANMonitor::markSent(uint32_t id) {
-    // Find existing slot
-    for (uint8_t i = 0; i < THROTTLE_SLOTS; i++) {
-        if (throttle[i].id == id) {
-            throttle[i].lastSentMs = millis();
-            return;
+    if (!extended) {
+        CANIDStat* st = &idStats[id & (CAN_STAT_STD_IDS - 1)];
+        if (st->id == CAN_STAT_EMPTY) {
+            if (!create) return nullptr;
+            st->id = id & (CAN_STAT_STD_IDS - 1);
+            idStatCount++;
         }
+        return st;
     }
-    // Find empty slot
-    for (uint8_t i = 0; i < THROTTLE_SLOTS; i++) {
-        if (throttle[i].id == 0) {
-            throttle[i].id = id;
-            throttle[i].lastSentMs = millis();
-            return;
+
+    // Fibonacci hash + linear probe; slots are never removed, so an empty
+    // slot ends the probe
+    CANIDStat* ext = idStats + CAN_STAT_STD_IDS;
+    uint32_t h = (id * 2654435769u) >> 26;   // top 6 bits → 0..63
+    for (uint32_t n = 0; n < CAN_STAT_EXT_SLOTS; n++) {
+        CANIDStat* st = &ext[(h + n) & (CAN_STAT_EXT_SLOTS - 1)];
+        if (st->id == id && st->extended) return st;
+        if (st->id == CAN_STAT_EMPTY) {
+            if (!create) return nullptr;
+            st->id = id;
+            st->extended = true;
+            idStatCount++;
+            return st;
         }
     }
-    // All slots full — evict oldest
-    uint8_t oldest = 0;
-    for (uint8_t i = 1; i < THROTTLE_SLOTS; i++) {
-        if (throttle[i].lastSentMs < throttle[oldest].lastSentMs) oldest = i;
-    }
-    throttle[oldest].id = id;
-    throttle[oldest].lastSentMs = millis();
+    if (create) extOverflow++;
+    return nullptr;
 }
 
-// =============================================================================
-// Per-ID statistics
-// =============================================================================
+CANIDStat* CANMonitor::updateIDStat(const twai_message_t& msg, uint32_t nowUs) {
+    CANIDStat* st = findIDStat(msg.identifier, msg.extd, true);
+    if (!st) return nullptr;
 
-void CANMonitor::updateIDStat(uint32_t id) {
-    for (uint8_t i = 0; i < idStatCount; i++) {
-        if (idStats[i].id == id) {
-            idStats[i].count++;
-            idStats[i].lastSeen = millis();
-            return;
-        }
-    }
-    if (idStatCount < MAX_ID_STATS) {
-        idStats[idStatCount].id       = id;
-        idStats[idStatCount].count    = 1;
-        idStats[idStatCount].lastSeen = millis();
-        idStatCount++;
+    if (st->count) {
+        uint32_t dt = nowUs - st->lastUs;
+        uint32_t n  = st->count - 1;         // intervals before this one
+
+        // Late against the mean period so far — a missed deadline
+        if (n >= CAN_STAT_MISS_MIN &&
+            (uint64_t)dt * n > st->sumDtUs * CAN_STAT_MISS_FACTOR &&
+            st->missed != 0xFFFF) st->missed++;
+
+        if (n == 0 || dt < st->minDtUs) st->minDtUs = dt;
+        if (dt > st->maxDtUs) st->maxDtUs = dt;
+        st->sumDtUs  += dt;
+        st->sumDtUs2 += (uint64_t)dt * dt;
+
+        if (msg.data_length_code != st->dlc && st->dlcChanges != 0xFFFF) st->dlcChanges++;
     }
+    st->dlc    = msg.data_length_code;
+    st->lastUs = nowUs;
+    st->count++;
+    return st;
 }
 
 // =============================================================================
@@ -486,20 +948,29 @@ void CANMonitor::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
     switch (type) {
         case WS_EVT_CONNECT:
             mon.clientCount++;
+            mon.setWsConn(client->id(), client);
+            mon.postWsCtl(WsCtlOp::ADD, client->id());
             Serial.printf("[CANMonitor] WS client %u connected (total=%d)\n",
                 client->id(), mon.clientCount);
-            // Send a hello with current log state
+            // Send a hello with current log state and the next bus seq —
+            // the starting point for a "replay"
             {
-                char hello[80];
+                char hello[112];
                 snprintf(hello, sizeof(hello),
-                    "{\"type\":\"hello\",\"logState\":%d,\"logFrames\":%u}",
-                    (int)mon.logState, mon.logFrameCount);
+                    "{\"type\":\"hello\",\"logState\":%d,\"logFrames\":%u,\"bin\":%d,"
+                    "\"seq\":%u,\"history\":%u}",
+                    (int)mon.logger.state(), mon.logger.frames(), WS_BATCH_VERSION,
+                    FrameHistory::getInstance().head(), FrameHistory::getInstance().size());
                 client->text(hello);
             }
             break;
 
         case WS_EVT_DISCONNECT:
             if (mon.clientCount > 0) mon.clientCount--;
+            // Waits for the sender to finish with this client — it is freed
+            // as soon as this handler returns
+            mon.setWsConn(client->id(), nullptr);
+            mon.postWsCtl(WsCtlOp::REMOVE, client->id());
             Serial.printf("[CANMonitor] WS client %u disconnected (total=%d)\n",
                 client->id(), mon.clientCount);
             break;
@@ -517,12 +988,50 @@ void CANMonitor::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
 // Handle messages from browser over WebSocket
 // =============================================================================
 
+// IDs may be numbers or strings ("0x583", "1411")
+static uint32_t jsonId(JsonVariantConst v) {
+    if (v.is<const char*>()) return strtoul(v.as<const char*>(), nullptr, 0);
+    return v.as<uint32_t>();
+}
+
+// {"cmd":"subscribe",...} → heap filter for the sender task, or nullptr when
+// it asks for nothing narrower than the whole bus. Rules past
+// WS_FILTER_RULES are ignored — the reply reports how many were kept.
+static WsFilter* parseSubscription(JsonDocument& doc) {
+    WsFilter f = {};
+    bool ext = doc["ext"] | false;
+
+    for (JsonVariantConst v : doc["ids"].as<JsonArrayConst>()) {
+        if (f.ruleCount == WS_FILTER_RULES) break;
+        WsFilterRule& r = f.rules[f.ruleCount++];
+        r.id       = jsonId(v);
+        r.extended = ext;
+        r.mask     = ext ? CANLOG_ID_MASK : 0x7FF;
+    }
+    for (JsonObjectConst o : doc["ranges"].as<JsonArrayConst>()) {
+        if (f.ruleCount == WS_FILTER_RULES) break;
+        WsFilterRule& r = f.rules[f.ruleCount++];
+        r.extended = o["ext"] | ext;
+        r.id       = jsonId(o["id"]);
+        r.mask     = o["mask"].isNull() ? (r.extended ? CANLOG_ID_MASK : 0x7FF) : jsonId(o["mask"]);
+    }
+
+    float rate = doc["maxRate"] | 0.0f;
+    f.minGapUs    = rate > 0 ? (uint32_t)(1000000.0f / rate) : 0;
+    f.changesOnly = doc["changesOnly"] | false;
+
+    if (!f.ruleCount && !f.minGapUs && !f.changesOnly) return nullptr;
+    return new WsFilter(f);
+}
+
 void CANMonitor::handleWsMessage(AsyncWebSocketClient* client,
                                   uint8_t* data, size_t len) {
     // Parse JSON command from browser
     // {"cmd":"transmit","id":1539,"data":[64,0,33,37,0,0,0,0]}
     // {"cmd":"logStart"}
     // {"cmd":"logStop"}
+    // {"cmd":"subscribe",...} / {"cmd":"unsubscribe"} — see CANMonitor.h
+    // {"cmd":"replay","from":N} / {"cmd":"replay","last":N} — see CANMonitor.h
 
     JsonDocument doc;
     DeserializationError err = deserializeJson(doc, data, len);
@@ -550,18 +1059,67 @@ void CANMonitor::handleWsMessage(AsyncWebSocketClient* client,
     }
     else if (strcmp(cmd, "logStart") == 0) {
         startLogging();
-        client->text("{\"type\":\"logState\",\"state\":\"logging\"}");
+        client->text(logger.isLogging()
+            ? "{\"type\":\"logState\",\"state\":\"logging\"}"
+            : "{\"type\":\"logState\",\"state\":\"idle\",\"error\":\"log busy or no space\"}");
     }
     else if (strcmp(cmd, "logStop") == 0) {
         stopLogging();
-        char resp[80];
+        char resp[100];
         snprintf(resp, sizeof(resp),
-            "{\"type\":\"logState\",\"state\":\"stopped\",\"frames\":%u}", logFrameCount);
+            "{\"type\":\"logState\",\"state\":\"stopped\",\"frames\":%u,\"dropped\":%u}",
+            logger.frames(), logger.dropped());
         client->text(resp);
     }
     else if (strcmp(cmd, "ping") == 0) {
         client->text("{\"type\":\"pong\"}");
     }
+    else if (strcmp(cmd, "dropPolicy") == 0) {
+        // {"cmd":"dropPolicy","policy":"oldest"|"decimate"|"close"}
+        const char* name = doc["policy"] | "oldest";
+        WsDropPolicy policy = WsDropPolicy::DROP_OLDEST;
+        if (strcmp(name, "decimate") == 0)   policy = WsDropPolicy::DECIMATE;
+        else if (strcmp(name, "close") == 0) policy = WsDropPolicy::DROP_CLIENT;
+        postWsCtl(WsCtlOp::POLICY, client->id(), policy);
+        char resp[60];
+        snprintf(resp, sizeof(resp), "{\"type\":\"dropPolicy\",\"policy\":\"%s\"}",
+            policyName(policy));
+        client->text(resp);
+    }
+    else if (strcmp(cmd, "subscribe") == 0 || strcmp(cmd, "unsubscribe") == 0) {
+        WsFilter* f = cmd[0] == 's' ? parseSubscription(doc) : nullptr;
+        uint8_t  rules = f ? f->ruleCount : 0;
+        uint32_t gap   = f ? f->minGapUs : 0;
+        bool     chg   = f && f->changesOnly;
+        bool ok = postWsCtl(WsCtlOp::SUBSCRIBE, client->id(), WsDropPolicy::DROP_OLDEST, f);
+        char resp[120];
+        snprintf(resp, sizeof(resp),
+            "{\"type\":\"subscribed\",\"ok\":%s,\"filtered\":%s,\"rules\":%u,"
+            "\"minGapUs\":%u,\"changesOnly\":%s}",
+            ok ? "true" : "false", f ? "true" : "false", rules, gap, chg ? "true" : "false");
+        client->text(resp);
+    }
+    else if (strcmp(cmd, "replay") == 0) {
+        FrameHistory& hist = FrameHistory::getInstance();
+        uint32_t head   = hist.head();
+        uint32_t oldest = hist.oldest();
+        uint32_t from;
+        if (!doc["last"].isNull()) {
+            uint32_t last = doc["last"] | 0u;
+            from = last < head - oldest ? head - last : oldest;
+        } else {
+            from = doc["from"] | head;
+        }
+        // Already overwritten, or a seq from before a reboot
+        if ((int32_t)(from - oldest) < 0 || (int32_t)(from - head) > 0) from = oldest;
+        bool ok = hist.enabled() && postWsCtl(WsCtlOp::REPLAY, client->id(),
+                                              WsDropPolicy::DROP_OLDEST, nullptr, from);
+        char resp[100];
+        snprintf(resp, sizeof(resp),
+            "{\"type\":\"replay\",\"ok\":%s,\"from\":%u,\"oldest\":%u,\"head\":%u}",
+            ok ? "true" : "false", from, oldest, head);
+        client->text(resp);
+    }
 }
 
 // =============================================================================
@@ -575,63 +1133,477 @@ void CANMonitor::handleTransmit(AsyncWebServerRequest* request) {
 
 void CANMonitor::handleLogStart(AsyncWebServerRequest* request) {
     startLogging();
+    if (!logger.isLogging()) {
+        request->send(409, "application/json", "{\"ok\":false,\"error\":\"log busy or no space\"}");
+        return;
+    }
     request->send(200, "application/json",
         "{\"ok\":true,\"state\":\"logging\"}");
 }
 
 void CANMonitor::handleLogStop(AsyncWebServerRequest* request) {
     stopLogging();
-    char resp[100];
+    // The writer is still flushing — sizeBytes is what the file will hold
+    char resp[120];
     snprintf(resp, sizeof(resp),
-        "{\"ok\":true,\"state\":\"stopped\",\"frames\":%u,\"sizeBytes\":%u}",
-        logFrameCount,
-        SPIFFS.exists("/canlog.csv") ? (unsigned)SPIFFS.open("/canlog.csv").size() : 0);
+        "{\"ok\":true,\"state\":\"stopped\",\"frames\":%u,\"dropped\":%u,\"sizeBytes\":%u}",
+        logger.frames(), logger.dropped(), logger.bytes());
     request->send(200, "application/json", resp);
 }
 
+// GET /can/log/download?format=csv|candump|asc|bin — csv by default.
+// bin is the raw file; the others are converted while streaming.
+// &capture=<n> picks a flight-recorder capture instead of the manual log.
 void CANMonitor::handleLogDownload(AsyncWebServerRequest* request) {
-    if (!SPIFFS.exists("/canlog.csv")) {
+    char path[24];
+    char baseName[16];
+    if (request->hasParam("capture")) {
+        uint16_t n = (uint16_t)request->getParam("capture")->value().toInt();
+        FlightRecorder::capturePath(n, path, sizeof(path));
+        snprintf(baseName, sizeof(baseName), "cap%04u", n);
+    } else {
+        // The manual log is only complete once the writer has closed it
+        LogState state = logger.state();
+        if (state == LogState::LOGGING || state == LogState::STOPPING) {
+            AsyncWebServerResponse* resp = request->beginResponse(503, "text/plain",
+                "Log is still being written");
+            resp->addHeader("Retry-After", "1");
+            request->send(resp);
+            return;
+        }
+        strlcpy(path, CANLOG_PATH, sizeof(path));
+        strlcpy(baseName, "canlog", sizeof(baseName));
+    }
+
+    String format = request->hasParam("format") ? request->getParam("format")->value() : "csv";
+    LogExport fmt;
+    const char* mime;
+    const char* ext;
+    if (format == "csv")          { fmt = LogExport::CSV;     mime = "text/csv";   ext = "csv"; }
+    else if (format == "candump") { fmt = LogExport::CANDUMP; mime = "text/plain"; ext = "log"; }
+    else if (format == "asc")     { fmt = LogExport::ASC;     mime = "text/plain"; ext = "asc"; }
+    else if (format == "gvret")   { fmt = LogExport::GVRET;   mime = "application/octet-stream"; ext = "gvret"; }
+    else if (format == "json")    { fmt = LogExport::JSON;    mime = "application/json"; ext = "json"; }
+    else if (format == "bin")     { fmt = LogExport::RAW;     mime = "application/octet-stream"; ext = "bin"; }
+    else {
+        request->send(400, "text/plain", "format must be csv, candump, asc, gvret, json or bin");
+        return;
+    }
+
+    // File size plus the start stamp from its header identify this log —
+    // a new log under the same path gets a new ETag
+    File f = Storage::fs().open(path, "r");
+    if (!f) {
         request->send(404, "text/plain", "No log file");
         return;
     }
-    request->send(SPIFFS, "/canlog.csv", "text/csv",
-        true);  // true = download (Content-Disposition: attachment)
+    CANLogHeader hdr;
+    uint32_t size = f.size();
+    bool isLog = f.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+                 memcmp(hdr.magic, "ZCAN", 4) == 0;
+    f.close();
+    if (!isLog) {
+        request->send(404, "text/plain", "Not a CAN log");
+        return;
+    }
+
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%s.%s", baseName, ext);
+    ExportSpec spec;
+    spec.open     = openLogExport;
+    spec.key      = path;
+    spec.format   = (uint8_t)fmt;
+    spec.version  = size ^ (hdr.startMs * 2654435761u) ^ hdr.startUnix;
+    spec.size     = fmt == LogExport::RAW ? size : EXPORT_SIZE_UNKNOWN;
+    spec.mime     = mime;
+    spec.fileName = fileName;
+    StreamExport::send(request, spec);
 }
 
-void CANMonitor::handleStats(AsyncWebServerRequest* request) {
-    // Build stats JSON
-    String json = "{\"sessionFrames\":";
-    json += sessionFrameCount;
-    json += ",\"uptime\":";
-    json += (millis() - sessionStartMs);
-    json += ",\"ids\":[";
-
-    // Sort by count (simple selection sort for small array)
-    uint8_t order[MAX_ID_STATS];
-    for (uint8_t i = 0; i < idStatCount; i++) order[i] = i;
-    for (uint8_t i = 0; i < idStatCount; i++) {
-        for (uint8_t j = i+1; j < idStatCount; j++) {
-            if (idStats[order[j]].count > idStats[order[i]].count) {
-                uint8_t tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+// -----------------------------------------------------------------------------
+// Export source — header, one piece per frame, footer. Reads the log in
+// CANLogReader's 1 KB chunks, so RAM use does not grow with the log.
+// -----------------------------------------------------------------------------
+
+class CANMonitor::LogExportSource : public ExportSource {
+public:
+    explicit LogExportSource(LogExport f) : fmt(f) {}
+    bool open(const char* path) { return reader.open(Storage::fs(), path); }
+
+    size_t next(uint8_t* out, size_t cap) override {
+        CANMonitor& mon = CANMonitor::instance();
+        char* text = (char*)out;
+        for (;;) {
+            size_t n = 0;
+            switch (stage) {
+                case Stage::HEADER:
+                    stage = Stage::FRAMES;
+                    n = mon.exportHeader(fmt, reader.header(), text, cap);
+                    break;
+                case Stage::FRAMES: {
+                    CANLogRecord rec;
+                    uint64_t tsUs;
+                    if (reader.next(rec, tsUs))
+                        return mon.exportLine(fmt, reader.header(), rec, tsUs, index++, text, cap);
+                    reader.close();
+                    stage = Stage::FOOTER;
+                    break;
+                }
+                case Stage::FOOTER:
+                    stage = Stage::DONE;
+                    n = mon.exportFooter(fmt, text, cap);
+                    break;
+                case Stage::DONE:
+                    return 0;
+            }
+            if (n) return n;   // formats without a header / footer fall through
+        }
+    }
+
+private:
+    enum class Stage : uint8_t { HEADER, FRAMES, FOOTER, DONE };
+    CANLogReader reader;
+    LogExport    fmt;
+    Stage        stage = Stage::HEADER;
+    uint32_t     index = 0;
+};
+
+ExportSource* CANMonitor::openLogExport(const char* path, uint8_t format) {
+    if ((LogExport)format == LogExport::RAW) {
+        File f = Storage::fs().open(path, "r");
+        return f ? new FileExportSource(f) : nullptr;
+    }
+    LogExportSource* src = new LogExportSource((LogExport)format);
+    if (!src->open(path)) {
+        delete src;
+        return nullptr;
+    }
+    return src;
+}
+
+size_t CANMonitor::exportHeader(LogExport fmt, const CANLogHeader& h, char* out, size_t cap) {
+    int len = 0;
+    if (fmt == LogExport::CSV) {
+        len = snprintf(out, cap,
+            "timestamp_ms,id_hex,id_name,len,b0,b1,b2,b3,b4,b5,b6,b7,decoded\n");
+    } else if (fmt == LogExport::ASC) {
+        // Vector ASC — absolute timestamps from the start of the log
+        time_t t = h.startUnix;
+        struct tm tmv;
+        gmtime_r(&t, &tmv);
+        char date[40];
+        strftime(date, sizeof(date), "%a %b %d %I:%M:%S.000 %p %Y", &tmv);
+        len = snprintf(out, cap,
+            "date %s\nbase hex  timestamps absolute\ninternal events logged\n"
+            "Begin TriggerBlock %s\n", date, date);
+    } else if (fmt == LogExport::JSON) {
+        len = snprintf(out, cap,
+            "{\"bitrate\":%u,\"startUnix\":%u,\"startMs\":%u,\"trigger\":\"%s\","
+            "\"triggerUs\":%u,\"frames\":[\n",
+            (unsigned)h.bitrate, (unsigned)h.startUnix, (unsigned)h.startMs,
+            FlightRecorder::triggerName((FlightTrigger)h.trigger), (unsigned)h.triggerUs);
+    }
+    return len < 0 ? 0 : ((size_t)len >= cap ? cap - 1 : (size_t)len);
+}
+
+size_t CANMonitor::exportFooter(LogExport fmt, char* out, size_t cap) {
+    int len = 0;
+    if (fmt == LogExport::ASC)       len = snprintf(out, cap, "End TriggerBlock\n");
+    else if (fmt == LogExport::JSON) len = snprintf(out, cap, "\n]}\n");
+    return len < 0 ? 0 : ((size_t)len >= cap ? cap - 1 : (size_t)len);
+}
+
+size_t CANMonitor::exportLine(LogExport fmt, const CANLogHeader& h, const CANLogRecord& r,
+                              uint64_t tsUs, uint32_t index, char* out, size_t cap) {
+    uint32_t id  = CANLogReader::id(r);
+    bool     ext = CANLogReader::extended(r);
+    bool     rtr = CANLogReader::rtr(r);
+    uint8_t  dlc = CANLogReader::dlc(r);
+    uint8_t  n   = rtr ? 0 : (dlc > 8 ? 8 : dlc);
+
+    // GVRET binary — the same 12 + n byte record GVRETServer sends live,
+    // with µs since the start of the log as its timestamp
+    if (fmt == LogExport::GVRET) {
+        if (cap < 12 + 8) return 0;
+        uint8_t* p = (uint8_t*)out;
+        uint32_t ts = (uint32_t)tsUs;
+        uint32_t wireId = id | (ext ? 0x80000000u : 0);
+        *p++ = 0xF1;
+        *p++ = 0x00;
+        memcpy(p, &ts, 4);      p += 4;
+        memcpy(p, &wireId, 4);  p += 4;
+        *p++ = n;               // bus 0 in the upper nibble
+        memcpy(p, r.data, n);   p += n;
+        *p++ = 0x00;            // checksum, unused
+        return p - (uint8_t*)out;
+    }
+
+    char hex[32];      // data bytes, separator per format
+    size_t hp = 0;
+    const char* sep = fmt == LogExport::CANDUMP || fmt == LogExport::JSON ? "" : " ";
+    for (uint8_t i = 0; i < n; i++)
+        hp += snprintf(hex + hp, sizeof(hex) - hp, "%s%02X", i ? sep : "", r.data[i]);
+    hex[hp] = '\0';
+
+    int len = 0;
+    switch (fmt) {
+        case LogExport::CSV: {
+            // Same columns the synchronous CSV logger used to write
+            CANFrame f;
+            f.timestamp = h.startMs + (uint32_t)(tsUs / 1000);
+            f.id        = id;
+            f.len       = dlc;
+            memcpy(f.data, r.data, 8);
+            char decoded[DECODE_LEN];
+            decoded[0] = '\0';
+            if (!ext) decodeFrame(f, decoded, sizeof(decoded));
+            const char* name = ext ? nullptr : knownIDName(id);
+            len = snprintf(out, cap,
+                ext ? "%u,0x%08X,%s,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%s\n"
+                    : "%u,0x%03X,%s,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%s\n",
+                f.timestamp, id, name ? name : "", dlc,
+                r.data[0], r.data[1], r.data[2], r.data[3],
+                r.data[4], r.data[5], r.data[6], r.data[7], decoded);
+            break;
+        }
+        case LogExport::CANDUMP: {
+            // candump -l: (sec.usec) can0 ID#DATA, ID#R for remote frames
+            uint64_t sec = h.startUnix + tsUs / 1000000;
+            len = snprintf(out, cap, ext ? "(%llu.%06u) can0 %08X#%s%s\n"
+                                         : "(%llu.%06u) can0 %03X#%s%s\n",
+                (unsigned long long)sec, (unsigned)(tsUs % 1000000), id,
+                rtr ? "R" : "", hex);
+            break;
+        }
+        case LogExport::ASC: {
+            char idStr[12];
+            snprintf(idStr, sizeof(idStr), ext ? "%Xx" : "%X", id);
+            if (rtr) {
+                len = snprintf(out, cap, "%4llu.%06u 1  %-15s Rx   r\n",
+                    (unsigned long long)(tsUs / 1000000), (unsigned)(tsUs % 1000000), idStr);
+            } else {
+                len = snprintf(out, cap, "%4llu.%06u 1  %-15s Rx   d %u %s\n",
+                    (unsigned long long)(tsUs / 1000000), (unsigned)(tsUs % 1000000),
+                    idStr, dlc, hex);
             }
+            break;
         }
+        case LogExport::JSON:
+            len = snprintf(out, cap,
+                "%s{\"t\":%llu,\"id\":%u,\"ext\":%s,\"rtr\":%s,\"dlc\":%u,\"data\":\"%s\"}",
+                index ? ",\n" : "", (unsigned long long)tsUs, id,
+                ext ? "true" : "false", rtr ? "true" : "false", dlc, hex);
+            break;
+        default:
+            break;
+    }
+    return len < 0 ? 0 : ((size_t)len >= cap ? cap - 1 : (size_t)len);
+}
+
+// GET /can/history?from=N&limit=M — one page of FrameHistory, binary (see
+// CANMonitor.h). The length is fixed when the request arrives; records are
+// copied out of the history as the body is sent, so one overwritten by then
+// goes out flagged CANLOG_MARK rather than torn.
+void CANMonitor::handleHistory(AsyncWebServerRequest* request) {
+    FrameHistory& hist = FrameHistory::getInstance();
+    if (!hist.enabled()) {
+        request->send(503, "text/plain", "No frame history");
+        return;
+    }
+
+    uint32_t head   = hist.head();
+    uint32_t oldest = hist.oldest();
+    uint32_t limit  = request->hasParam("limit")
+        ? strtoul(request->getParam("limit")->value().c_str(), nullptr, 10) : CAN_HISTORY_PAGE;
+    if (limit > CAN_HISTORY_PAGE_MAX) limit = CAN_HISTORY_PAGE_MAX;
+
+    uint32_t from;
+    if (request->hasParam("from")) {
+        from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+        // Aged out, or a cursor from before a reboot — start at the oldest
+        if ((int32_t)(from - oldest) < 0 || (int32_t)(from - head) > 0) from = oldest;
+    } else {
+        from = head - oldest > limit ? head - limit : oldest;
+    }
+    uint32_t count = head - from < limit ? head - from : limit;
+
+    struct PageHeader {
+        uint8_t  magic;
+        uint8_t  version;
+        uint16_t count;
+        uint32_t firstSeq;
+        uint32_t nextSeq;
+        uint32_t headSeq;
+    };
+    struct Cursor {
+        uint8_t  piece[sizeof(HistoryFrame)];   // header, then one record at a time
+        uint8_t  len;
+        uint8_t  pos;
+        uint32_t seq;
+        uint32_t end;
+    };
+    static_assert(sizeof(PageHeader) <= sizeof(HistoryFrame), "page header fits the piece");
+
+    std::shared_ptr<Cursor> cur(new Cursor());
+    PageHeader ph = { 'H', 1, (uint16_t)count, from, from + count, head };
+    memcpy(cur->piece, &ph, sizeof(ph));
+    cur->len = sizeof(ph);
+    cur->seq = from;
+    cur->end = from + count;
+
+    AsyncWebServerResponse* resp = request->beginResponse("application/octet-stream",
+        sizeof(PageHeader) + count * sizeof(HistoryFrame),
+        [cur](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+            size_t used = 0;
+            while (used < maxLen) {
+                if (cur->pos == cur->len) {
+                    if (cur->seq == cur->end) break;
+                    HistoryFrame fr;
+                    if (!FrameHistory::getInstance().read(cur->seq, fr)) {
+                        memset(&fr, 0, sizeof(fr));
+                        fr.rec.idFlags = CANLOG_MARK;
+                    }
+                    memcpy(cur->piece, &fr, sizeof(fr));
+                    cur->len = sizeof(fr);
+                    cur->pos = 0;
+                    cur->seq++;
+                }
+                size_t n = cur->len - cur->pos;
+                if (n > maxLen - used) n = maxLen - used;
+                memcpy(buf + used, cur->piece + cur->pos, n);
+                cur->pos += n;
+                used     += n;
+            }
+            return used;
+        });
+    resp->addHeader("Cache-Control", "no-cache");
+    resp->addHeader("Access-Control-Allow-Origin", "*");
+    request->send(resp);
+}
+
+class CANMonitor::StatsBody : public JsonBody {
+public:
+    StatsBody() {
+        // End-to-end accounting: frames the TWAI driver lost before we read
+        // them, frames streamed to the browser and frames refused by a full
+        // client queue
+        twai_status_info_t st;
+        _rxMissed = twai_get_status_info(&st) == ESP_OK ? st.rx_missed_count : 0;
     }
 
-    uint8_t shown = min((uint8_t)10, idStatCount);
-    for (uint8_t i = 0; i < shown; i++) {
-        if (i) json += ",";
-        const CANIDStat& s = idStats[order[i]];
-        const char* name = knownIDName(s.id);
-        json += "{\"id\":\"0x";
-        char hex[8]; snprintf(hex, sizeof(hex), "%03X", s.id);
-        json += hex;
-        json += "\",\"name\":\"";
-        json += name ? name : "";
-        json += "\",\"count\":";
-        json += s.count;
-        json += "}";
+    bool item(JsonWriter& w, uint32_t n) override {
+        CANMonitor& mon = CANMonitor::instance();
+        switch (n) {
+            case 0:
+                w.beginObject();
+                w.key("sessionFrames"); w.valueUint(mon.sessionFrameCount);
+                w.key("uptime");        w.valueUint(millis() - mon.sessionStartMs);
+                w.key("historySeq");    w.valueUint(FrameHistory::getInstance().head());
+                w.key("historyOldest"); w.valueUint(FrameHistory::getInstance().oldest());
+                return true;
+            case 1:
+                w.key("rxMissed");      w.valueUint(_rxMissed);
+                w.key("wsFrames");      w.valueUint(mon.wsFramesSent);
+                w.key("wsBatches");     w.valueUint(mon.wsBatchesSent);
+                w.key("wsDropped");     w.valueUint(mon.wsFramesDropped);
+                // null unless built with HEAP_CHURN
+                w.key("hotPathAllocs");
+                if (HeapChurn::enabled()) w.valueUint(mon.hotPathAllocs);
+                else                      w.valueNull();
+                return true;
+            case 2:
+                w.key("logState");      w.valueInt((int)mon.logger.state());
+                w.key("logFrames");     w.valueUint(mon.logger.frames());
+                w.key("logDropped");    w.valueUint(mon.logger.dropped());
+                w.key("logBytes");      w.valueUint(mon.logger.bytes());
+                w.key("clients");
+                w.beginArray();
+                return true;
+        }
+        n -= 3;
+
+        // Per-client delivery — read without locking, a stats snapshot only
+        if (n < WS_MAX_CLIENTS) {
+            const WsClientState& c = mon.wsClients[n];
+            if (!c.id) return true;
+            w.beginObject();
+            w.key("id");             w.valueUint(c.id);
+            w.key("policy");         w.valueString(policyName(c.policy));
+            w.key("queued");         w.valueUint(c.ringCount);
+            w.key("sent");           w.valueUint(c.sentFrames);
+            w.key("dropped");        w.valueUint(c.droppedFrames);
+            w.key("droppedBatches"); w.valueUint(c.droppedBatches);
+            w.key("subscribed");     w.valueBool(c.filter != nullptr);
+            w.key("filtered");       w.valueUint(c.filteredFrames);
+            w.endObject();
+            return true;
+        }
+        n -= WS_MAX_CLIENTS;
+        if (n == 0) {
+            w.endArray();
+            w.key("extOverflow"); w.valueUint(mon.extOverflow);
+            w.key("idCount");     w.valueUint(mon.idStatCount);
+            w.key("ids");
+            w.beginArray();
+            return true;
+        }
+        n--;
+
+        // Every ID seen is listed, in table order (standard IDs ascending,
+        // then the extended hash) — sorting is left to the browser. Up to
+        // ~2k rows, one item per table slot.
+        const uint32_t slots = mon.idStats ? CAN_STAT_STD_IDS + CAN_STAT_EXT_SLOTS : 0;
+        if (n < slots) {
+            const CANIDStat& s = mon.idStats[n];
+            if (s.id != CAN_STAT_EMPTY && s.count) mon.statJson(w, s);
+            return true;
+        }
+        if (n == slots) {
+            w.endArray();
+            w.endObject();
+            return true;
+        }
+        return false;
     }
-    json += "]}";
 
-    request->send(200, "application/json", json);
+private:
+    uint32_t _rxMissed;
+};
+
+void CANMonitor::handleStats(AsyncWebServerRequest* request) {
+    AsyncWebServerResponse* resp = JsonStream::begin(request, "application/json",
+                                                     std::make_shared<StatsBody>());
+    resp->addHeader("Cache-Control", "no-cache");
+    request->send(resp);
+}
+
+// One /can/stats entry. Period figures are µs over the count-1 intervals;
+// stddev comes from the running sums here, off the frame path.
+void CANMonitor::statJson(JsonWriter& w, const CANIDStat& s) {
+    uint32_t n = s.count - 1;
+    uint32_t mean = 0, stddev = 0;
+    if (n) {
+        uint64_t m = s.sumDtUs / n;
+        uint64_t sq = s.sumDtUs2 / n;
+        mean   = (uint32_t)m;
+        stddev = sq > m * m ? (uint32_t)sqrt((double)(sq - m * m)) : 0;
+    }
+    const char* name = s.extended ? nullptr : knownIDName(s.id);
+    char id[12];
+    int idLen = snprintf(id, sizeof(id), "0x%03X", (unsigned)s.id);
+
+    w.beginObject();
+    w.key("id");         w.valueName(id, idLen);
+    w.key("ext");        w.valueBool(s.extended);
+    w.key("name");       w.valueString(name ? name : "");
+    w.key("count");      w.valueUint(s.count);
+    w.key("dlc");        w.valueUint(s.dlc);
+    w.key("periodUs");   w.valueUint(mean);
+    w.key("minUs");      w.valueUint(n ? s.minDtUs : 0);
+    w.key("maxUs");      w.valueUint(s.maxDtUs);
+    w.key("jitterUs");   w.valueUint(stddev);
+    w.key("dlcChanges"); w.valueUint(s.dlcChanges);
+    w.key("missed");     w.valueUint(s.missed);
+    w.key("agoMs");      w.valueUint(((uint32_t)esp_timer_get_time() - s.lastUs) / 1000);
+    w.endObject();
 }
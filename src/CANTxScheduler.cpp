@@ -0,0 +1,214 @@
+// ============================================================================
+// CANTxScheduler.cpp
+// ============================================================================
+
+#include "CANTxScheduler.h"
+#include "JsonWriter.h"
+#include <ESPAsyncWebServer.h>
+#include <esp_timer.h>
+
+// Per-source queue depth and token bucket. A saturated 500k bus carries
+// ~4000 8-byte frames/s; playback is held to well under half of that so
+// the ZombieVerter's own traffic still gets through.
+static const struct {
+    uint16_t    queueLen;
+    uint16_t    ratePerSec;   // 0 = unlimited
+    uint16_t    burst;
+    const char* name;
+} s_sources[] = {
+    {  8,    0,  0, "safetySdo" },
+    { 32,  500, 32, "sdo"       },
+    { 16,  200, 16, "user"      },
+    { 64, 1500, 64, "playback"  },
+};
+
+// ---------------------------------------------------------------------------
+// begin
+// ---------------------------------------------------------------------------
+
+void CANTxScheduler::begin() {
+    if (_task) return;
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    for (uint8_t i = 0; i < SOURCES; i++) {
+        _queues[i] = xQueueCreate(s_sources[i].queueLen, sizeof(TxItem));
+        Bucket& b = _buckets[i];
+        b.costUs   = s_sources[i].ratePerSec ? 1000000u / s_sources[i].ratePerSec : 0;
+        b.capUs    = b.costUs * s_sources[i].burst;
+        b.creditUs = b.capUs;
+        b.lastUs   = now;
+    }
+    // Above loopTask on the CAN core, so a queued SDO request goes out as
+    // soon as the driver has room
+    xTaskCreatePinnedToCore(taskEntry, "CANTx", 3072, this, 6, &_task, 1);
+    Serial.printf("[CANTX] Scheduler started, driver depth %d\n", CAN_TX_DRIVER_DEPTH);
+}
+
+// ---------------------------------------------------------------------------
+// submit — any task
+// ---------------------------------------------------------------------------
+
+bool CANTxScheduler::submit(TxSource src, const twai_message_t& msg) {
+    uint8_t i = (uint8_t)src;
+    if (i >= SOURCES || !_queues[i]) return false;
+
+    TxItem item;
+    item.msg      = msg;
+    item.submitUs = (uint32_t)esp_timer_get_time();
+
+    portENTER_CRITICAL(&_mux);
+    _stats[i].submitted++;
+    bool allowed = take(i, item.submitUs);
+    if (!allowed) _stats[i].limited++;
+    portEXIT_CRITICAL(&_mux);
+    if (!allowed) return false;
+
+    if (xQueueSend(_queues[i], &item, 0) != pdTRUE) {
+        // Nothing was queued, so nothing was spent — a full queue must not
+        // also drain the source's rate budget
+        portENTER_CRITICAL(&_mux);
+        _stats[i].queueFull++;
+        refund(i);
+        portEXIT_CRITICAL(&_mux);
+        return false;
+    }
+    xTaskNotifyGive(_task);
+    return true;
+}
+
+bool CANTxScheduler::admit(TxSource src) {
+    uint8_t i = (uint8_t)src;
+    if (i >= SOURCES || !_queues[i]) return false;
+    portENTER_CRITICAL(&_mux);
+    bool allowed = take(i, (uint32_t)esp_timer_get_time());
+    portEXIT_CRITICAL(&_mux);
+    return allowed;
+}
+
+bool CANTxScheduler::take(uint8_t i, uint32_t nowUs) {
+    Bucket& b = _buckets[i];
+    if (!b.costUs) return true;
+    uint32_t credit = b.creditUs + (nowUs - b.lastUs);
+    if (credit > b.capUs || credit < b.creditUs) credit = b.capUs;   // capped, or wrapped
+    b.lastUs = nowUs;
+    bool allowed = credit >= b.costUs;
+    if (allowed) credit -= b.costUs;
+    b.creditUs = credit;
+    return allowed;
+}
+
+void CANTxScheduler::refund(uint8_t i) {
+    Bucket& b = _buckets[i];
+    uint32_t credit = b.creditUs + b.costUs;
+    b.creditUs = credit > b.capUs ? b.capUs : credit;
+}
+
+// ---------------------------------------------------------------------------
+// TX task — strict priority, driver queue kept shallow
+// ---------------------------------------------------------------------------
+
+void CANTxScheduler::taskEntry(void* arg) {
+    static_cast<CANTxScheduler*>(arg)->taskLoop();
+}
+
+void CANTxScheduler::taskLoop() {
+    for (;;) {
+        // Driver still holds CAN_TX_DRIVER_DEPTH frames — a frame takes
+        // ~0.25 ms on the wire, so look again next tick
+        twai_status_info_t st;
+        if (twai_get_status_info(&st) == ESP_OK && st.msgs_to_tx >= CAN_TX_DRIVER_DEPTH) {
+            vTaskDelay(1);
+            continue;
+        }
+
+        TxItem item;
+        int8_t src = -1;
+        for (uint8_t i = 0; i < SOURCES && src < 0; i++) {
+            if (_held[i].valid) { item = _held[i].item; src = i; }
+            else if (xQueueReceive(_queues[i], &item, 0) == pdTRUE) src = i;
+        }
+        if (src < 0) {
+            // A submit between the scan and here leaves the notification
+            // pending, so this returns at once
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        TxSourceStats& s = _stats[src];
+        Held& h = _held[src];
+        if (twai_transmit(&item.msg, 0) == ESP_OK) {
+            uint32_t lat = (uint32_t)esp_timer_get_time() - item.submitUs;
+            s.sent++;
+            s.latencySumUs += lat;
+            if (lat > s.latencyMaxUs) s.latencyMaxUs = lat;
+            h.valid = false;
+            continue;
+        }
+
+        // Refused — keep it at the head of its source and try again next
+        // tick; a caller was told it was queued, so it is not lost quietly
+        if (!h.valid) {
+            h.item  = item;
+            h.tries = 0;
+            h.valid = true;
+        }
+        if (++h.tries >= CAN_TX_RETRY_TICKS) {
+            h.valid = false;
+            s.failed++;
+            Serial.printf("[CANTX] %s frame 0x%03X dropped after %d refusals\n",
+                s_sources[src].name, (unsigned)item.msg.identifier, CAN_TX_RETRY_TICKS);
+        } else {
+            s.retried++;
+        }
+        vTaskDelay(1);
+    }
+}
+
+const char* CANTxScheduler::sourceName(TxSource src) {
+    uint8_t i = (uint8_t)src;
+    return i < SOURCES ? s_sources[i].name : "?";
+}
+
+// ---------------------------------------------------------------------------
+// GET /can/tx
+// ---------------------------------------------------------------------------
+
+void CANTxScheduler::registerEndpoints(AsyncWebServer* server) {
+    server->on("/can/tx", HTTP_GET,
+        [](AsyncWebServerRequest* r){ CANTxScheduler::getInstance().handleStats(r); });
+}
+
+void CANTxScheduler::handleStats(AsyncWebServerRequest* request) {
+    twai_status_info_t st;
+    bool ok = twai_get_status_info(&st) == ESP_OK;
+
+    char buf[96 + SOURCES * 240];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.key("driverDepth"); w.valueUint(CAN_TX_DRIVER_DEPTH);
+    w.key("inDriver");    w.valueUint(ok ? st.msgs_to_tx : 0);
+    w.key("txErrors");    w.valueUint(ok ? st.tx_error_counter : 0);
+    w.key("txFailed");    w.valueUint(ok ? st.tx_failed_count : 0);
+    w.key("sources");
+    w.beginArray();
+    for (uint8_t i = 0; i < SOURCES; i++) {
+        const TxSourceStats& s = _stats[i];
+        w.beginObject();
+        w.key("name");      w.valueString(s_sources[i].name);
+        w.key("rate");      w.valueUint(s_sources[i].ratePerSec);
+        w.key("burst");     w.valueUint(s_sources[i].burst);
+        w.key("queued");    w.valueUint((_queues[i] ? (uint32_t)uxQueueMessagesWaiting(_queues[i]) : 0) +
+                                        (_held[i].valid ? 1 : 0));
+        w.key("submitted"); w.valueUint(s.submitted);
+        w.key("sent");      w.valueUint(s.sent);
+        w.key("queueFull"); w.valueUint(s.queueFull);
+        w.key("limited");   w.valueUint(s.limited);
+        w.key("retried");   w.valueUint(s.retried);
+        w.key("failed");    w.valueUint(s.failed);
+        w.key("latAvgUs");  w.valueUint(s.sent ? (uint32_t)(s.latencySumUs / s.sent) : 0);
+        w.key("latMaxUs");  w.valueUint(s.latencyMaxUs);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    request->send(200, "application/json", w.c_str());
+}
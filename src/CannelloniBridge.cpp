@@ -0,0 +1,289 @@
+// ============================================================================
+// CannelloniBridge.cpp
+// ============================================================================
+
+#include "CannelloniBridge.h"
+#include "CANLogger.h"
+#include "CANTxScheduler.h"
+#include "JsonWriter.h"
+#include <AsyncUDP.h>
+
+#define CANNELLONI_VERSION   2
+#define CANNELLONI_OP_DATA   0
+#define CANNELLONI_EFF_FLAG  0x80000000u
+#define CANNELLONI_RTR_FLAG  0x40000000u
+
+// ---------------------------------------------------------------------------
+// begin / stop
+// ---------------------------------------------------------------------------
+
+void CannelloniBridge::begin() {
+    if (_running) return;
+    attach();
+    // Kept across stop/begin — the bridge task may still be in a send
+    // when the AP goes down
+    if (!_udp) {
+        _udp = new AsyncUDP();
+        _udp->onPacket([](void* arg, AsyncUDPPacket& pkt) {
+            static_cast<CannelloniBridge*>(arg)->onPacket(pkt);
+        }, this);
+    }
+    if (!_udp->listen(CANNELLONI_PORT)) {
+        Serial.printf("[BRIDGE] cannelloni: cannot listen on UDP %d\n", CANNELLONI_PORT);
+        return;
+    }
+    _running = true;
+    Serial.printf("[BRIDGE] cannelloni listening on UDP %d\n", CANNELLONI_PORT);
+}
+
+void CannelloniBridge::stop() {
+    if (!_running) return;
+    _running = false;
+    portENTER_CRITICAL(&_mux);
+    memset(_peers, 0, sizeof(_peers));
+    portEXIT_CRITICAL(&_mux);
+    _udp->close();
+    Serial.println("[BRIDGE] cannelloni stopped");
+}
+
+// ---------------------------------------------------------------------------
+// onPacket — async_udp. Registers the sender as a peer, then transmits the
+// frames it carries.
+// ---------------------------------------------------------------------------
+
+void CannelloniBridge::onPacket(AsyncUDPPacket& pkt) {
+    const uint8_t* d   = pkt.data();
+    size_t         len = pkt.length();
+    uint32_t       ip  = (uint32_t)pkt.remoteIP();
+    uint16_t       port = pkt.remotePort();
+    uint32_t       now = millis();
+
+    if (len < CANNELLONI_HEADER || d[0] != CANNELLONI_VERSION) {
+        _rxErrors++;
+        return;
+    }
+
+    // Refresh or add the peer; a full table replaces the quietest one
+    int added = -1;
+    portENTER_CRITICAL(&_mux);
+    int slot = -1, quietest = 0;
+    for (int i = 0; i < CANNELLONI_MAX_PEERS && slot < 0; i++) {
+        if (_peers[i].ip == ip && _peers[i].port == port) slot = i;
+        else if (!_peers[i].ip) quietest = i;
+        else if (_peers[quietest].ip && now - _peers[i].lastMs > now - _peers[quietest].lastMs)
+            quietest = i;
+    }
+    if (slot < 0) {
+        slot = quietest;
+        _peers[slot].ip       = ip;
+        _peers[slot].port     = port;
+        _peers[slot].sinceMs  = now;
+        _peers[slot].rxFrames = 0;
+        added = slot;
+    }
+    _peers[slot].lastMs = now;
+    portEXIT_CRITICAL(&_mux);
+    if (added >= 0) {
+        Serial.printf("[BRIDGE] cannelloni: peer %d is %s:%u\n",
+                      added, pkt.remoteIP().toString().c_str(), port);
+    }
+
+    if (d[1] != CANNELLONI_OP_DATA) return;
+    uint16_t count = ((uint16_t)d[3] << 8) | d[4];
+    const uint8_t* p   = d + CANNELLONI_HEADER;
+    const uint8_t* end = d + len;
+    uint16_t frames = 0;
+    for (uint16_t n = 0; n < count; n++) {
+        if (end - p < 5) { _rxErrors++; break; }
+        uint32_t id  = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                       ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+        uint8_t  dlc = p[4];
+        bool     rtr = (id & CANNELLONI_RTR_FLAG) != 0;
+        p += 5;
+        // CAN FD (len bit 7) is not something this bus can carry
+        if (dlc > 8) { _rxErrors++; break; }
+        if (!rtr && end - p < dlc) { _rxErrors++; break; }
+
+        twai_message_t msg = {};
+        msg.extd             = (id & CANNELLONI_EFF_FLAG) ? 1 : 0;
+        msg.rtr              = rtr ? 1 : 0;
+        msg.identifier       = id & (msg.extd ? 0x1FFFFFFFu : 0x7FFu);
+        msg.data_length_code = dlc;
+        if (!rtr) {
+            memcpy(msg.data, p, dlc);
+            p += dlc;
+        }
+        if (CANTxScheduler::getInstance().submit(TxSource::PLAYBACK, msg)) frames++;
+        else _rxRefused++;
+    }
+    _rxFrames += frames;
+    portENTER_CRITICAL(&_mux);
+    if (_peers[slot].ip == ip) _peers[slot].rxFrames += frames;
+    portEXIT_CRITICAL(&_mux);
+}
+
+// ---------------------------------------------------------------------------
+// pump — bridge task. Expires quiet peers, then encodes what the bus
+// carried since the last pass, once, for all of them.
+// ---------------------------------------------------------------------------
+
+void CannelloniBridge::pump() {
+    FrameHistory& hist = FrameHistory::getInstance();
+    uint32_t head = hist.head();
+    if (!_running) {
+        _cursor = head;
+        return;
+    }
+
+    Peer    peers[CANNELLONI_MAX_PEERS];
+    uint8_t n = 0;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&_mux);
+    for (int i = 0; i < CANNELLONI_MAX_PEERS; i++) {
+        if (!_peers[i].ip) continue;
+        if (now - _peers[i].lastMs > CANNELLONI_PEER_TIMEOUT_MS) {
+            _peers[i].ip = 0;
+            continue;
+        }
+        peers[n++] = _peers[i];
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (!n) {
+        _cursor = head;
+        return;
+    }
+
+    if (head - _cursor > CAN_BRIDGE_MAX_LAG) {
+        uint32_t skip = head - _cursor - CAN_BRIDGE_MAX_LAG / 2;
+        _droppedFrames += skip;
+        _cursor += skip;
+    }
+
+    size_t   len   = CANNELLONI_HEADER;
+    uint16_t count = 0;
+    HistoryFrame fr;
+    while (_cursor != head) {
+        if (!hist.read(_cursor, fr)) {
+            // Overwritten before we got to it
+            uint32_t oldest = hist.oldest();
+            if ((int32_t)(oldest - _cursor) <= 0) break;
+            _droppedFrames += oldest - _cursor;
+            _cursor = oldest;
+            continue;
+        }
+        if (len + CANNELLONI_RECORD_MAX > sizeof(_dgram)) {
+            sendDatagram(len, count, peers, n);
+            len   = CANNELLONI_HEADER;
+            count = 0;
+        }
+        len += encodeFrame(_dgram + len, fr);
+        count++;
+        _cursor++;
+    }
+    if (count) sendDatagram(len, count, peers, n);
+}
+
+void CannelloniBridge::sendDatagram(size_t len, uint16_t count,
+                                    const Peer* peers, uint8_t n) {
+    _dgram[0] = CANNELLONI_VERSION;
+    _dgram[1] = CANNELLONI_OP_DATA;
+    _dgram[2] = _seq++;
+    _dgram[3] = (uint8_t)(count >> 8);
+    _dgram[4] = (uint8_t)count;
+    for (uint8_t i = 0; i < n; i++) {
+        if (_udp->writeTo(_dgram, len, IPAddress(peers[i].ip), peers[i].port) == len)
+            _sentBytes += len;
+        else
+            _sendErrors++;
+    }
+    _datagrams++;
+    _sentFrames += count;
+}
+
+// ---------------------------------------------------------------------------
+// encodeFrame — one frame record, straight from the history slot
+// ---------------------------------------------------------------------------
+
+size_t CannelloniBridge::encodeFrame(uint8_t* out, const HistoryFrame& f) {
+    uint32_t id  = f.rec.idFlags & CANLOG_ID_MASK;
+    bool     rtr = (f.rec.idFlags & CANLOG_RTR) != 0;
+    uint8_t  dlc = CANLogReader::dlc(f.rec);
+    if (dlc > 8) dlc = 8;
+    if (f.rec.idFlags & CANLOG_EXT) id |= CANNELLONI_EFF_FLAG;
+    if (rtr)                        id |= CANNELLONI_RTR_FLAG;
+
+    uint8_t* p = out;
+    *p++ = (uint8_t)(id >> 24);
+    *p++ = (uint8_t)(id >> 16);
+    *p++ = (uint8_t)(id >> 8);
+    *p++ = (uint8_t)id;
+    *p++ = dlc;
+    if (!rtr) {
+        memcpy(p, f.rec.data, dlc);
+        p += dlc;
+    }
+    return p - out;
+}
+
+// ---------------------------------------------------------------------------
+// statsItem
+// ---------------------------------------------------------------------------
+
+void CannelloniBridge::statsItem(JsonWriter& w, uint8_t n) {
+    if (n == 0) {
+        w.beginObject();
+        w.key("name");
+        w.valueString(_name);
+        w.key("transport");
+        w.valueName("udp", 3);
+        w.key("port");
+        w.valueUint(CANNELLONI_PORT);
+        w.key("running");
+        w.valueBool(_running);
+        return;
+    }
+    if (n == 1) {
+        w.key("sent");
+        w.valueUint(_sentFrames);
+        w.key("dropped");
+        w.valueUint(_droppedFrames);
+        w.key("datagrams");
+        w.valueUint(_datagrams);
+        w.key("bytes");
+        w.valueUint(_sentBytes);
+        w.key("sendErrors");
+        w.valueUint(_sendErrors);
+        w.key("rx");
+        w.valueUint(_rxFrames);
+        w.key("rxRefused");
+        w.valueUint(_rxRefused);
+        w.key("rxErrors");
+        w.valueUint(_rxErrors);
+        w.key("peers");
+        w.beginArray();
+        return;
+    }
+    if (n > CANNELLONI_MAX_PEERS + 1) {
+        w.endArray();
+        w.endObject();
+        return;
+    }
+    Peer p;
+    portENTER_CRITICAL(&_mux);
+    p = _peers[n - 2];
+    portEXIT_CRITICAL(&_mux);
+    if (!p.ip) return;
+    uint32_t now = millis();
+    w.beginObject();
+    w.key("ip");
+    valueIp(w, p.ip);
+    w.key("port");
+    w.valueUint(p.port);
+    w.key("connectedS");
+    w.valueUint((now - p.sinceMs) / 1000);
+    w.key("idleS");
+    w.valueUint((now - p.lastMs) / 1000);
+    w.key("rx");
+    w.valueUint(p.rxFrames);
+    w.endObject();
+}
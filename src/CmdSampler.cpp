@@ -0,0 +1,156 @@
+// ============================================================================
+// CmdSampler.cpp
+// ============================================================================
+
+#include "CmdSampler.h"
+#include <esp_timer.h>
+
+// ---------------------------------------------------------------------------
+// SampleBody
+// ---------------------------------------------------------------------------
+
+SampleBody::SampleBody(const CANParameter* const* params, uint8_t count,
+                       uint16_t repeat, uint16_t hz)
+    : _count(count), _repeat(repeat) {
+    if (_count > CMD_SAMPLE_SIGNALS) _count = CMD_SAMPLE_SIGNALS;
+    if (!_count) _repeat = 0;
+    memcpy(_params, params, _count * sizeof(_params[0]));
+    if (hz < 1) hz = 1;
+    if (hz > CMD_SAMPLE_MAX_HZ) hz = CMD_SAMPLE_MAX_HZ;
+    _periodUs = 1000000UL / hz;
+    uint16_t fit = _count ? CMD_SAMPLE_RING / _count : 0;
+    _rows = _repeat < fit ? _repeat : fit;
+}
+
+void SampleBody::sample(int64_t nowUs) {
+    uint16_t taken = _taken.load(std::memory_order_relaxed);
+    if (taken >= _repeat) return;
+    if (!_started) { _started = true; _dueUs = nowUs; }
+    if (nowUs < _dueUs) return;
+    _dueUs += _periodUs;
+    // More than a period behind — restart the phase rather than catch up
+    if (_dueUs <= nowUs) _dueUs = nowUs + _periodUs;
+
+    // The row would overwrite one that has not been rendered yet
+    if ((uint16_t)(taken - _sent.load(std::memory_order_acquire)) >= _rows) {
+        _late++;
+        return;
+    }
+
+    int32_t* row = &_ring[(taken % _rows) * _count];
+    for (uint8_t i = 0; i < _count; i++) {
+        ParamSnapshot s;
+        if (_params[i]) {
+            _params[i]->snapshot(s);
+            row[i] = s.valueInt;
+        } else {
+            row[i] = 0;
+        }
+    }
+    _taken.store(taken + 1, std::memory_order_release);
+}
+
+bool SampleBody::ready(uint32_t n) {
+    if (n >= (uint32_t)_count * _repeat) return true;      // item() ends the body
+    return n / _count < _taken.load(std::memory_order_acquire);
+}
+
+bool SampleBody::item(JsonWriter& w, uint32_t n) {
+    if (n >= (uint32_t)_count * _repeat) return false;
+    uint16_t r = n / _count;
+    uint8_t  c = n % _count;
+    // Asked for row r: every row before it is in the send buffers already
+    _sent.store(r, std::memory_order_release);
+
+    // Same rendering as /cmd get — at least two decimals, for inverter.js
+    char valBuf[24];
+    size_t len;
+    const CANParameter* p = _params[c];
+    if (p) {
+        uint8_t dec = p->getDecimals();
+        len = FixedPoint::format(valBuf, sizeof(valBuf), _ring[(r % _rows) * _count + c],
+                                 dec, dec < 2 ? 2 : dec);
+    } else {
+        len = FixedPoint::format(valBuf, sizeof(valBuf), 0, 0, 2);
+    }
+    w.raw(valBuf, len);
+    w.raw(' ');
+    return true;
+}
+
+void SampleBody::complete(uint32_t bytes) {
+    if (_late) {
+        Serial.printf("[Sampler] %u x %u: %u rows delayed, client not reading\n",
+                      _repeat, _count, _late);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// CmdSampler
+// ---------------------------------------------------------------------------
+
+void CmdSampler::begin() {
+    if (_task) return;
+    // Core 0 with async_tcp, above SpotPush so the sample clock keeps time
+    xTaskCreatePinnedToCore(taskEntry, "CmdSample", 3072, this, 2, &_task, 0);
+}
+
+bool CmdSampler::add(const std::shared_ptr<SampleBody>& body) {
+    if (!_task) return false;
+    bool added = false;
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < CMD_SAMPLE_MAX; i++) {
+        if (_active[i]) continue;
+        _active[i] = body;
+        added = true;
+        break;
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (added) xTaskNotifyGive(_task);
+    return added;
+}
+
+void CmdSampler::taskEntry(void* arg) {
+    static_cast<CmdSampler*>(arg)->taskLoop();
+}
+
+// One pass: sample whatever is due, retire finished and abandoned bodies.
+// Returns the earliest next due time, 0 when nothing is sampling.
+int64_t CmdSampler::pass() {
+    std::shared_ptr<SampleBody> live[CMD_SAMPLE_MAX];
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < CMD_SAMPLE_MAX; i++) live[i] = _active[i];
+    portEXIT_CRITICAL(&_mux);
+
+    int64_t now  = esp_timer_get_time();
+    int64_t next = 0;
+    for (uint8_t i = 0; i < CMD_SAMPLE_MAX; i++) {
+        SampleBody* b = live[i].get();
+        if (!b) continue;
+        // Only the table and `live` still hold it — the response is gone
+        bool dropped = live[i].use_count() <= 2;
+        if (!dropped) b->sample(now);
+        if (dropped || b->finished()) {
+            std::shared_ptr<SampleBody> retired;
+            portENTER_CRITICAL(&_mux);
+            if (_active[i] == live[i]) retired.swap(_active[i]);
+            portEXIT_CRITICAL(&_mux);
+            continue;
+        }
+        if (!next || b->_dueUs < next) next = b->_dueUs;
+    }
+    return next;
+}
+
+void CmdSampler::taskLoop() {
+    for (;;) {
+        int64_t next = pass();
+        TickType_t wait = portMAX_DELAY;
+        if (next) {
+            int64_t ms = (next - esp_timer_get_time() + 999) / 1000;
+            wait = ms < 1 ? 1 : pdMS_TO_TICKS((uint32_t)ms);
+        }
+        // add() wakes it early
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
@@ -3,6 +3,8 @@
 // ============================================================================
 
 #include "FaultLogger.h"
+#include "FixedPoint.h"
+#include "MsgPack.h"
 
 void FaultLogger::begin() {
     _prefs.begin("faultlog", false);
@@ -37,6 +39,7 @@ void FaultLogger::logOpmodeChange(uint8_t newOpmode) {
 }
 
 void FaultLogger::push(const FaultEntry& e) {
+    _version++;
     if (_count < FAULTLOG_MAX_ENTRIES) {
         writeSlot(_count, e);
         _count++;
@@ -48,40 +51,122 @@ void FaultLogger::push(const FaultEntry& e) {
     }
 }
 
-String FaultLogger::getJSON() {
-    String json = "[";
-    if (_count == 0) { json += "]"; return json; }
+// Export — "[", one object per entry read from NVS as the response drains,
+// "]"
+class FaultJSONSource : public ExportSource {
+public:
+    // Faults logged meanwhile wait for the next download
+    FaultJSONSource() : _win(FaultLogger::getInstance().window()) {}
+
+    size_t next(uint8_t* out, size_t cap) override {
+        FaultLogger& log = FaultLogger::getInstance();
+        char* text = (char*)out;
+        if (_stage == 0) {
+            _stage = 1;
+            return strlcpy(text, "[", cap);
+        }
+        FaultEntry e;
+        while (_stage == 1 && _next < _win.count) {
+            if (log.entryFromNewest(_win, _next++, e)) {
+                size_t n = log.jsonEntry(e, _first, text, cap);
+                _first = false;
+                return n;
+            }
+        }
+        if (_stage == 1) {
+            _stage = 2;
+            return strlcpy(text, "]", cap);
+        }
+        return 0;
+    }
+private:
+    FaultLogger::Window _win;
+    uint8_t _stage = 0;     // 0 = "[", 1 = entries, 2 = done
+    int     _next = 0;
+    bool    _first = true;
+};
+
+// MessagePack — the array header with its count, then one map per entry.
+// An entry that cannot be read is a nil, so the count still holds.
+class FaultMsgPackSource : public ExportSource {
+public:
+    FaultMsgPackSource() : _win(FaultLogger::getInstance().window()) {}
+
+    size_t next(uint8_t* out, size_t cap) override {
+        FaultLogger& log = FaultLogger::getInstance();
+        if (!_started) {
+            _started = true;
+            MsgPackWriter m(out, cap);
+            m.array(_win.count);
+            return m.length();
+        }
+        if (_next >= _win.count) return 0;
+        FaultEntry e;
+        if (log.entryFromNewest(_win, _next++, e)) return log.msgpackEntry(e, out, cap);
+        MsgPackWriter m(out, cap);
+        m.nil();
+        return m.length();
+    }
+private:
+    FaultLogger::Window _win;
+    bool _started = false;
+    int  _next = 0;
+};
+
+ExportSource* FaultLogger::openExport(const char*, uint8_t format) {
+    if (format == (uint8_t)FaultExport::MSGPACK) return new FaultMsgPackSource();
+    return new FaultJSONSource();
+}
 
-    int total = min(_count, (int)FAULTLOG_MAX_ENTRIES);
-    bool first = true;
+bool FaultLogger::entryFromNewest(const Window& w, int n, FaultEntry& e) const {
+    if (n < 0 || n >= w.count) return false;
+    int i = w.count - 1 - n;
+    // Writes since the window, once the free slots are used up, replaced
+    // its oldest entries first
+    int overwritten = (int)(_version - w.version) - (FAULTLOG_MAX_ENTRIES - w.count);
+    if (i < overwritten) return false;
+    int slot = w.count < FAULTLOG_MAX_ENTRIES ? i : (w.startIdx + i) % FAULTLOG_MAX_ENTRIES;
+    return readSlot(slot, e);
+}
 
-    // Newest first — iterate backwards through ring buffer
-    for (int i = total - 1; i >= 0; i--) {
-        int slot = (_startIdx + i) % FAULTLOG_MAX_ENTRIES;
-        if (_count < FAULTLOG_MAX_ENTRIES) slot = i;
+size_t FaultLogger::jsonEntry(const FaultEntry& e, bool first, char* out, size_t cap) const {
+    char t[16];
+    FixedPoint::format(t, sizeof(t), FixedPoint::fromRatio(e.timestamp_ms, 100, 0), 1);
+    int len;
+    if (e.isFault) {
+        len = snprintf(out, cap,
+            "%s{\"t\":%s,\"type\":\"fault\",\"code\":\"0x%08X\",\"desc\":\"%s\","
+            "\"param\":%u,\"opmode\":\"%s\"}",
+            first ? "" : ",", t, (unsigned)e.abortCode, decodeAbortCode(e.abortCode),
+            e.paramId, decodeOpmode(e.opmode));
+    } else {
+        len = snprintf(out, cap, "%s{\"t\":%s,\"type\":\"opmode\",\"opmode\":\"%s\"}",
+            first ? "" : ",", t, decodeOpmode(e.opmode));
+    }
+    return len < 0 ? 0 : ((size_t)len >= cap ? cap - 1 : (size_t)len);
+}
 
-        FaultEntry e;
-        if (!readSlot(slot, e)) continue;
-
-        if (!first) json += ",";
-        first = false;
-
-        float t_s = e.timestamp_ms / 1000.0f;
-        json += "{";
-        json += "\"t\":" + String(t_s, 1) + ",";
-        json += "\"type\":\"" + String(e.isFault ? "fault" : "opmode") + "\",";
-        if (e.isFault) {
-            char codeBuf[12];
-            snprintf(codeBuf, sizeof(codeBuf), "0x%08X", e.abortCode);
-            json += "\"code\":\"" + String(codeBuf) + "\",";
-            json += "\"desc\":\"" + String(decodeAbortCode(e.abortCode)) + "\",";
-            json += "\"param\":" + String(e.paramId) + ",";
-        }
-        json += "\"opmode\":\"" + String(decodeOpmode(e.opmode)) + "\"";
-        json += "}";
+// Same fields as jsonEntry
+size_t FaultLogger::msgpackEntry(const FaultEntry& e, uint8_t* out, size_t cap) const {
+    MsgPackWriter m(out, cap);
+    m.map(e.isFault ? 6 : 3);
+    m.str("t");
+    m.fixed(FixedPoint::fromRatio(e.timestamp_ms, 100, 0), 1);
+    m.str("type");
+    m.str(e.isFault ? "fault" : "opmode");
+    if (e.isFault) {
+        char code[12];
+        snprintf(code, sizeof(code), "0x%08X", (unsigned)e.abortCode);
+        m.str("code");
+        m.str(code);
+        m.str("desc");
+        m.str(decodeAbortCode(e.abortCode));
+        m.str("param");
+        m.uint(e.paramId);
     }
-    json += "]";
-    return json;
+    m.str("opmode");
+    m.str(decodeOpmode(e.opmode));
+    return m.length();
 }
 
 void FaultLogger::clear() {
@@ -92,6 +177,7 @@ void FaultLogger::clear() {
         _prefs.remove(key);
     }
     _count = 0; _startIdx = 0;
+    _version++;
     _prefs.putInt("count", 0);
     _prefs.putInt("start", 0);
     Serial.println("[FAULT] Log cleared");
@@ -0,0 +1,136 @@
+// ============================================================================
+// FixedPoint.cpp
+// ============================================================================
+
+#include "FixedPoint.h"
+#include <string.h>
+
+static const int32_t POW10[FIXED_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+FixedScale FixedPoint::sdoDefault() {
+    FixedScale s = { 1, 32, 2, "" };
+    return s;
+}
+
+int32_t FixedPoint::pow10(uint8_t decimals) {
+    return POW10[decimals > FIXED_MAX_DECIMALS ? FIXED_MAX_DECIMALS : decimals];
+}
+
+// Divide rounding half away from zero — keeps -0.5 and +0.5 symmetric
+static int64_t divRound(int64_t num, int64_t den) {
+    if (den == 0) return 0;
+    if (den < 0) { num = -num; den = -den; }
+    return (num >= 0) ? (num + den / 2) / den : (num - den / 2) / den;
+}
+
+static int32_t clamp32(int64_t v) {
+    if (v > INT32_MAX) return INT32_MAX;
+    if (v < INT32_MIN) return INT32_MIN;
+    return (int32_t)v;
+}
+
+int32_t FixedPoint::fromRaw(int32_t raw, const FixedScale& s) {
+    int64_t num = (int64_t)raw * s.rawMul * pow10(s.decimals);
+    return clamp32(divRound(num, s.rawDiv));
+}
+
+int32_t FixedPoint::toRaw(int32_t fixed, const FixedScale& s) {
+    int64_t num = (int64_t)fixed * s.rawDiv;
+    int64_t den = (int64_t)s.rawMul * pow10(s.decimals);
+    return clamp32(divRound(num, den));
+}
+
+int32_t FixedPoint::fromRatio(int32_t num, int32_t div, uint8_t decimals) {
+    return clamp32(divRound((int64_t)num * pow10(decimals), div));
+}
+
+int32_t FixedPoint::rescale(int32_t fixed, uint8_t fromDecimals, uint8_t toDecimals) {
+    if (toDecimals == fromDecimals) return fixed;
+    if (toDecimals > fromDecimals)
+        return clamp32((int64_t)fixed * pow10(toDecimals - fromDecimals));
+    return clamp32(divRound(fixed, pow10(fromDecimals - toDecimals)));
+}
+
+// ---------------------------------------------------------------------------
+// format — integer-only rendering, no printf
+// ---------------------------------------------------------------------------
+size_t FixedPoint::format(char* out, size_t cap, int32_t fixed,
+                          uint8_t decimals, uint8_t outDecimals) {
+    if (!out || cap == 0) return 0;
+    if (outDecimals > FIXED_MAX_DECIMALS) outDecimals = FIXED_MAX_DECIMALS;
+
+    int32_t v = rescale(fixed, decimals, outDecimals);
+
+    // Build digits right-to-left into a scratch buffer
+    char tmp[16];
+    int  pos = sizeof(tmp);
+    bool neg = v < 0;
+    uint32_t mag = neg ? (uint32_t)(-(int64_t)v) : (uint32_t)v;
+
+    for (uint8_t i = 0; i < outDecimals; i++) {
+        tmp[--pos] = (char)('0' + mag % 10);
+        mag /= 10;
+    }
+    if (outDecimals) tmp[--pos] = '.';
+    do {
+        tmp[--pos] = (char)('0' + mag % 10);
+        mag /= 10;
+    } while (mag);
+    if (neg) tmp[--pos] = '-';
+
+    size_t n = sizeof(tmp) - pos;
+    if (n >= cap) n = cap - 1;
+    memcpy(out, tmp + pos, n);
+    out[n] = '\0';
+    return n;
+}
+
+size_t FixedPoint::formatInt(char* out, size_t cap, int32_t v) {
+    return format(out, cap, v, 0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// parse — "-12.345" → fixed-point, no float
+// ---------------------------------------------------------------------------
+bool FixedPoint::parse(const char* str, uint8_t decimals, int32_t& out) {
+    if (!str) return false;
+    while (*str == ' ') str++;
+
+    bool neg = false;
+    if (*str == '-' || *str == '+') { neg = (*str == '-'); str++; }
+
+    int64_t  whole = 0;
+    int64_t  frac  = 0;
+    uint8_t  fracDigits = 0;
+    bool     roundUp = false;
+    bool     any = false;
+
+    while (*str >= '0' && *str <= '9') {
+        whole = whole * 10 + (*str - '0');
+        if (whole > INT32_MAX) return false;
+        str++; any = true;
+    }
+    if (*str == '.') {
+        str++;
+        while (*str >= '0' && *str <= '9') {
+            if (fracDigits < decimals) {
+                frac = frac * 10 + (*str - '0');
+                fracDigits++;
+            } else if (fracDigits == decimals) {
+                roundUp = (*str >= '5');
+                fracDigits++;   // only the first dropped digit decides rounding
+            }
+            str++; any = true;
+        }
+    }
+    while (*str == ' ') str++;
+    if (!any || *str != '\0') return false;
+
+    uint8_t kept = fracDigits > decimals ? decimals : fracDigits;
+    int64_t v = whole * pow10(decimals) + frac * pow10(decimals - kept);
+    if (roundUp) v++;
+    out = clamp32(neg ? -v : v);
+    return true;
+}
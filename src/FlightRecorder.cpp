@@ -0,0 +1,550 @@
+// ============================================================================
+// FlightRecorder.cpp
+// ============================================================================
+
+#include "FlightRecorder.h"
+#include "CANData.h"
+#include "HealthChecker.h"
+#include "FixedPoint.h"
+#include "JsonWriter.h"
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include "Storage.h"
+#include <esp_timer.h>
+#include <time.h>
+
+static const char* NVS_NS = "flightrec";
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::begin(CANDataManager* can) {
+    _can = can;
+
+    _stage = (uint8_t*)heap_caps_malloc(CANLOG_PAGE_BYTES, MALLOC_CAP_8BIT);
+    if (!FrameHistory::getInstance().enabled() || !_stage) {
+        Serial.println("[FLIGHT] No frame history or stage buffer — recorder disabled");
+        return;
+    }
+    _ready = true;
+
+    loadFromNVS();
+    _jobQ = xQueueCreate(1, sizeof(DumpJob));
+    // Low priority on core 0 with the other flash writers
+    xTaskCreatePinnedToCore(writerEntry, "FlightRec", 4096, this, 1, nullptr, 0);
+
+    Serial.printf("[FLIGHT] Armed — %u frame history, pre %ums / post %ums, next capture %u\n",
+        FrameHistory::getInstance().size(), _config.preMs, _config.postMs, _nextCapture);
+}
+
+void FlightRecorder::loadFromNVS() {
+    FlightConfig c = {};
+    c.preMs       = 10000;
+    c.postMs      = 5000;
+    c.triggerMask = (1u << (uint8_t)FlightTrigger::SDO_ABORT) |
+                    (1u << (uint8_t)FlightTrigger::OPMODE)    |
+                    (1u << (uint8_t)FlightTrigger::HEALTH)    |
+                    (1u << (uint8_t)FlightTrigger::THRESHOLD) |
+                    (1u << (uint8_t)FlightTrigger::BUTTON);
+
+    Preferences prefs;
+    prefs.begin(NVS_NS, true);
+    FlightConfig saved;
+    if (prefs.getBytes("cfg", &saved, sizeof(saved)) == sizeof(saved)) c = saved;
+    _nextCapture = prefs.getUShort("next", 1);
+    prefs.end();
+
+    if (_nextCapture < 1 || _nextCapture > FLIGHT_MAX_NUMBER) _nextCapture = 1;
+    applyConfig(c);
+}
+
+void FlightRecorder::saveToNVS() {
+    Preferences prefs;
+    prefs.begin(NVS_NS, false);
+    prefs.putBytes("cfg", &_config, sizeof(_config));
+    prefs.end();
+    Serial.println("[FLIGHT] Config saved to NVS");
+}
+
+void FlightRecorder::applyConfig(const FlightConfig& cfg) {
+    _config = cfg;
+    if (_config.thresholdCount > FLIGHT_MAX_THRESHOLDS) _config.thresholdCount = FLIGHT_MAX_THRESHOLDS;
+    if ((uint32_t)_config.preMs + _config.postMs > FLIGHT_MAX_WINDOW_MS)
+        _config.postMs = FLIGHT_MAX_WINDOW_MS - _config.preMs;
+    for (uint8_t i = 0; i < FLIGHT_MAX_THRESHOLDS; i++) {
+        _config.thresholds[i].name[sizeof(_config.thresholds[i].name) - 1] = '\0';
+        _levelKnown[i] = false;   // re-learn the side of the level we start on
+    }
+}
+
+void FlightRecorder::requestConfig(const FlightConfig& cfg) {
+    _pendingConfig = cfg;
+    _configPending = true;
+}
+
+// ---------------------------------------------------------------------------
+// Frame path — loopTask, every frame
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::checkFrame(const twai_message_t& msg) {
+    if (!_ready) return;
+
+    // SDO abort from the VCU: command byte 0x80, abort code in bytes 4-7
+    if (msg.identifier == SDO_RX_ID && msg.data[0] == 0x80) {
+        uint32_t code = msg.data[4] | (msg.data[5] << 8) | (msg.data[6] << 16) |
+                        ((uint32_t)msg.data[7] << 24);
+        trigger(FlightTrigger::SDO_ABORT, code);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Triggers
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::trigger(FlightTrigger kind, uint32_t arg) {
+    if (enabled(kind)) fire(kind, arg);
+}
+
+void FlightRecorder::fire(FlightTrigger kind, uint32_t arg) {
+    if (_pendingKind) return;   // poll() has not picked up the last one yet
+    _pendingArg  = arg;
+    _pendingKind = (uint8_t)kind;
+}
+
+void FlightRecorder::checkTriggers() {
+    if (!_can) return;
+
+    CANParameter* op = _can->getParameterByName("opmode");
+    if (op && op->received) {
+        int32_t v = op->getValueAsInt();
+        if (_lastOpmode >= 0 && v != _lastOpmode) trigger(FlightTrigger::OPMODE, (uint32_t)v);
+        _lastOpmode = v;
+    }
+
+    bool healthFail = HealthChecker::getInstance().getState() == HealthState::FAIL;
+    if (healthFail && !_lastHealthFail) trigger(FlightTrigger::HEALTH);
+    _lastHealthFail = healthFail;
+
+    for (uint8_t i = 0; i < _config.thresholdCount; i++) {
+        const FlightThreshold& t = _config.thresholds[i];
+        CANParameter* p = t.name[0] ? _can->getParameterByName(t.name) : nullptr;
+        if (!p || !p->received) { _levelKnown[i] = false; continue; }
+
+        int32_t v = FixedPoint::rescale(p->getValueFixed(), p->getDecimals(), 3);
+        if (_levelKnown[i]) {
+            bool crossed = t.above ? (_lastLevel[i] <= t.level && v > t.level)
+                                   : (_lastLevel[i] >= t.level && v < t.level);
+            if (crossed) trigger(FlightTrigger::THRESHOLD, i);
+        }
+        _lastLevel[i]  = v;
+        _levelKnown[i] = true;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// poll — loopTask
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::poll() {
+    if (!_ready) return;
+
+    if (_configPending) {
+        _configPending = false;
+        applyConfig(_pendingConfig);
+        saveToNVS();
+    }
+
+    uint32_t nowMs = millis();
+    if (nowMs - _lastCheckMs >= FLIGHT_CHECK_MS) {
+        _lastCheckMs = nowMs;
+        checkTriggers();
+    }
+
+    uint8_t kind = _pendingKind;
+    if (kind) {
+        if (_state.load() == State::ARMED) {
+            _job.trigSeq = FrameHistory::getInstance().head();
+            _job.endSeq  = _job.trigSeq;
+            _job.trigUs  = (uint32_t)esp_timer_get_time();
+            _job.trigMs  = nowMs;
+            _job.preUs   = (uint32_t)_config.preMs * 1000;
+            _job.arg     = _pendingArg;
+            _job.kind    = (FlightTrigger)kind;
+            _job.number  = _nextCapture;
+            _nextCapture = _nextCapture % FLIGHT_MAX_NUMBER + 1;
+            _state = State::POST;
+            Serial.printf("[FLIGHT] Trigger %s (%u) — capture %u after %ums post-window\n",
+                triggerName(_job.kind), _job.arg, _job.number, _config.postMs);
+        } else {
+            _suppressed++;
+        }
+        _pendingKind = 0;
+    }
+
+    if (_state.load() == State::POST &&
+        (uint32_t)esp_timer_get_time() - _job.trigUs >= (uint32_t)_config.postMs * 1000) {
+        _job.endSeq = FrameHistory::getInstance().head();
+        _state = State::WRITING;
+        xQueueSend(_jobQ, &_job, 0);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Writer task — copies the window out of the history into /capNNNN.bin
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::writerEntry(void* arg) {
+    static_cast<FlightRecorder*>(arg)->writerLoop();
+}
+
+void FlightRecorder::writerLoop() {
+    DumpJob job;
+    for (;;) {
+        if (xQueueReceive(_jobQ, &job, portMAX_DELAY) != pdTRUE) continue;
+        writeCapture(job);
+
+        // Keep the newest FLIGHT_MAX_CAPTURES
+        char path[24];
+        capturePath(captureBefore(job.number, FLIGHT_MAX_CAPTURES), path, sizeof(path));
+        if (Storage::fs().exists(path)) Storage::fs().remove(path);
+
+        Preferences prefs;
+        prefs.begin(NVS_NS, false);
+        prefs.putUShort("next", job.number % FLIGHT_MAX_NUMBER + 1);
+        prefs.end();
+
+        _state = State::ARMED;
+    }
+}
+
+void FlightRecorder::writeCapture(const DumpJob& job) {
+    const FrameHistory& hist = FrameHistory::getInstance();
+
+    // Walk back from the trigger over the pre-window, stopping at the oldest
+    // frame the history still holds
+    uint32_t start = job.trigSeq;
+    HistoryFrame fr;
+    while (start != 0 && hist.read(start - 1, fr) && job.trigUs - fr.us <= job.preUs) start--;
+
+    char path[24];
+    capturePath(job.number, path, sizeof(path));
+    File f = Storage::fs().open(path, "w");
+    if (!f) {
+        Serial.printf("[FLIGHT] Failed to open %s for writing\n", path);
+        return;
+    }
+
+    // Header fields that depend on the first frame are filled in once it is
+    // known — the header is still in the stage buffer until the first page
+    CANLogHeader* h = (CANLogHeader*)_stage;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, "ZCAN", 4);
+    h->version    = CANLOG_VERSION;
+    h->recordSize = sizeof(CANLogRecord);
+    h->bitrate    = CAN_BAUDRATE;
+    h->trigger    = (uint8_t)job.kind;
+    h->triggerArg = job.arg;
+    size_t   fill    = sizeof(CANLogHeader);
+    bool     first   = true;
+    uint32_t firstUs = job.trigUs;
+    uint32_t frames = 0, lost = 0;
+
+    for (uint32_t seq = start; seq != job.endSeq; seq++) {
+        if (!hist.read(seq, fr)) {
+            // Overwritten while we were busy — skip to the oldest intact frame
+            uint32_t resume = hist.oldest();
+            if ((int32_t)(resume - job.endSeq) >= 0) { lost += job.endSeq - seq; break; }
+            lost += resume - seq;
+            seq = resume - 1;
+            continue;
+        }
+        if (first) {
+            // Every frame of a capture sits inside one 28-bit epoch
+            // (FLIGHT_MAX_WINDOW_MS), so no epoch marks are needed
+            first = false;
+            firstUs = fr.us;
+            h->startMs   = job.trigMs - (job.trigUs - firstUs) / 1000;
+            h->triggerUs = job.trigUs - firstUs;
+            time_t now = time(nullptr);
+            h->startUnix = now > 1600000000 ? (uint32_t)now - (millis() - h->startMs) / 1000 : 0;
+        }
+        CANLogRecord rec = fr.rec;
+        rec.tsDlc = (rec.tsDlc & ~CANLOG_TS_MASK) | ((fr.us - firstUs) & CANLOG_TS_MASK);
+        memcpy(_stage + fill, &rec, sizeof(rec));
+        fill += sizeof(rec);
+        frames++;
+        if (fill == CANLOG_PAGE_BYTES) {
+            f.write(_stage, fill);
+            fill = 0;
+        }
+    }
+    if (fill) f.write(_stage, fill);
+    f.close();
+
+    Serial.printf("[FLIGHT] Capture %u written — %u frames (%u before trigger), %u lost\n",
+        job.number, frames, job.trigSeq > start ? job.trigSeq - start : 0, lost);
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::capturePath(uint16_t n, char* out, size_t cap) {
+    snprintf(out, cap, "/cap%04u.bin", n);
+}
+
+// Capture number `back` steps before n, on the 1..FLIGHT_MAX_NUMBER circle
+uint16_t FlightRecorder::captureBefore(uint16_t n, uint16_t back) {
+    return (uint16_t)(((uint32_t)n - 1 + FLIGHT_MAX_NUMBER - back % FLIGHT_MAX_NUMBER)
+                      % FLIGHT_MAX_NUMBER + 1);
+}
+
+const char* FlightRecorder::triggerName(FlightTrigger t) {
+    switch (t) {
+        case FlightTrigger::SDO_ABORT: return "sdoAbort";
+        case FlightTrigger::OPMODE:    return "opmode";
+        case FlightTrigger::HEALTH:    return "health";
+        case FlightTrigger::THRESHOLD: return "threshold";
+        case FlightTrigger::BUTTON:    return "button";
+        default:                       return "none";
+    }
+}
+
+// ---------------------------------------------------------------------------
+// HTTP
+//   GET    /can/captures          → state, config and the stored captures
+//   POST   /can/captures/config   → update config (JSON body, same shape)
+//   POST   /can/captures/trigger  → fire a capture now
+//   DELETE /can/captures?n=<num>  → delete one capture
+// Captures download through /can/log/download?capture=<num>&format=...
+// ---------------------------------------------------------------------------
+
+void FlightRecorder::registerEndpoints(AsyncWebServer* server) {
+    server->on("/can/captures", HTTP_GET,
+        [](AsyncWebServerRequest* r){ FlightRecorder::getInstance().handleList(r); });
+
+    server->on("/can/captures", HTTP_DELETE,
+        [](AsyncWebServerRequest* r){ FlightRecorder::getInstance().handleDelete(r); });
+
+    server->on("/can/captures/trigger", HTTP_POST, [](AsyncWebServerRequest* r) {
+        FlightRecorder& fr = FlightRecorder::getInstance();
+        if (!fr._ready) { r->send(503, "application/json", "{\"ok\":false,\"error\":\"recorder disabled\"}"); return; }
+        fr.fire(FlightTrigger::BUTTON, 0);
+        r->send(200, "application/json", "{\"ok\":true}");
+    });
+
+    // The body arrives in chunks; collect it in the request's _tempObject
+    // (freed with the request) and parse once it is all there.
+    server->on("/can/captures/config", HTTP_POST,
+        [](AsyncWebServerRequest* r) { FlightRecorder::getInstance().handleConfig(r); },
+        nullptr,
+        [](AsyncWebServerRequest* r, uint8_t* data, size_t len, size_t index, size_t total) {
+            if (total > FLIGHT_CONFIG_MAX_BODY) return;
+            if (index == 0) r->_tempObject = calloc(total + 1, 1);
+            char* body = (char*)r->_tempObject;
+            if (body && index + len <= total) memcpy(body + index, data, len);
+        });
+}
+
+// GET /can/captures — state and config copied and the capture headers
+// read when the request arrives, then streamed an item at a time so the
+// reply never sits whole on the async_tcp stack
+class FlightRecorder::ListBody : public JsonBody {
+public:
+    ListBody() {
+        FlightRecorder& fr = FlightRecorder::getInstance();
+        State st = fr._state.load();
+        _stateName  = !fr._ready ? "disabled" : st == State::ARMED ? "armed" :
+                      st == State::POST ? "post" : "writing";
+        _ringFrames = FrameHistory::getInstance().size();
+        _suppressed = fr._suppressed;
+        _config     = fr._config;
+        for (uint8_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+            _enabled[i] = fr.enabled(kinds[i]);
+
+        // Newest first
+        _count = 0;
+        for (uint16_t k = 1; k <= FLIGHT_MAX_CAPTURES; k++) {
+            uint16_t n = captureBefore(fr._nextCapture, k);
+            char path[24];
+            capturePath(n, path, sizeof(path));
+            if (!Storage::fs().exists(path)) continue;
+            File f = Storage::fs().open(path, "r");
+            if (!f) continue;
+            CANLogHeader h;
+            size_t size = f.size();
+            bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && memcmp(h.magic, "ZCAN", 4) == 0;
+            f.close();
+            if (!ok) continue;
+            Capture& c = _caps[_count++];
+            c.n         = n;
+            c.trigger   = h.trigger;
+            c.arg       = h.triggerArg;
+            c.triggerMs = h.triggerUs / 1000;
+            c.startMs   = h.startMs;
+            c.frames    = (uint32_t)((size - sizeof(h)) / sizeof(CANLogRecord));
+            c.size      = (uint32_t)size;
+        }
+    }
+
+    bool item(JsonWriter& w, uint32_t n) override {
+        if (n == 0) {
+            w.beginObject();
+            w.key("state");      w.valueString(_stateName);
+            w.key("ringFrames"); w.valueUint(_ringFrames);
+            w.key("suppressed"); w.valueUint(_suppressed);
+            w.key("preMs");      w.valueUint(_config.preMs);
+            w.key("postMs");     w.valueUint(_config.postMs);
+            w.key("triggers");
+            w.beginObject();
+            for (uint8_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+                const char* name = triggerName(kinds[i]);
+                w.key(name, strlen(name));
+                w.valueBool(_enabled[i]);
+            }
+            w.endObject();
+            w.key("thresholds");
+            w.beginArray();
+            return true;
+        }
+        n--;
+        if (n < _config.thresholdCount) {
+            const FlightThreshold& t = _config.thresholds[n];
+            w.beginObject();
+            w.key("name");  w.valueString(t.name);
+            w.key("level"); w.valueFixed(t.level, 3);
+            w.key("above"); w.valueBool(t.above);
+            w.endObject();
+            return true;
+        }
+        n -= _config.thresholdCount;
+        if (n == 0) {
+            w.endArray();
+            w.key("captures");
+            w.beginArray();
+            return true;
+        }
+        n--;
+        if (n < _count) {
+            const Capture& c = _caps[n];
+            w.beginObject();
+            w.key("n");         w.valueUint(c.n);
+            w.key("trigger");   w.valueString(triggerName((FlightTrigger)c.trigger));
+            w.key("arg");       w.valueUint(c.arg);
+            w.key("triggerMs"); w.valueUint(c.triggerMs);
+            w.key("startMs");   w.valueUint(c.startMs);
+            w.key("frames");    w.valueUint(c.frames);
+            w.key("size");      w.valueUint(c.size);
+            w.endObject();
+            return true;
+        }
+        if (n == _count) {
+            w.endArray();
+            w.endObject();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    static const FlightTrigger kinds[5];
+
+    struct Capture {
+        uint16_t n;
+        uint8_t  trigger;
+        uint32_t arg, triggerMs, startMs, frames, size;
+    };
+
+    const char*  _stateName;
+    uint32_t     _ringFrames;
+    uint32_t     _suppressed;
+    FlightConfig _config;
+    bool         _enabled[5];
+    Capture      _caps[FLIGHT_MAX_CAPTURES];
+    uint8_t      _count;
+};
+
+const FlightTrigger FlightRecorder::ListBody::kinds[5] = {
+    FlightTrigger::SDO_ABORT, FlightTrigger::OPMODE, FlightTrigger::HEALTH,
+    FlightTrigger::THRESHOLD, FlightTrigger::BUTTON
+};
+
+void FlightRecorder::handleList(AsyncWebServerRequest* request) {
+    AsyncWebServerResponse* resp = JsonStream::begin(request, "application/json",
+                                                     std::make_shared<ListBody>());
+    resp->addHeader("Cache-Control", "no-cache");
+    request->send(resp);
+}
+
+// Body: {"preMs":10000,"postMs":5000,
+//        "triggers":{"sdoAbort":true,"opmode":true,"health":true,"threshold":true,"button":true},
+//        "thresholds":[{"name":"udc","level":300.5,"above":false}]}
+// Missing fields keep their current value. Runs once the whole body has
+// been collected; a body that is missing, too large or not JSON gets a 400.
+void FlightRecorder::handleConfig(AsyncWebServerRequest* request) {
+    const char* body = (const char*)request->_tempObject;
+    if (!body) {
+        request->send(400, "application/json", "{\"ok\":false,\"error\":\"missing or oversized body\"}");
+        return;
+    }
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, body);
+    if (err || !doc.is<JsonObject>()) {
+        Serial.printf("[FLIGHT] Config: bad JSON (%s)\n", err ? err.c_str() : "not an object");
+        char buf[96];
+        JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        w.key("ok");    w.valueBool(false);
+        w.key("error"); w.valueString(err ? err.c_str() : "expected a JSON object");
+        w.endObject();
+        request->send(400, "application/json", w.c_str());
+        return;
+    }
+
+    FlightConfig c = _config;
+    c.preMs  = doc["preMs"]  | c.preMs;
+    c.postMs = doc["postMs"] | c.postMs;
+    JsonObject trig = doc["triggers"];
+    if (trig) {
+        for (uint8_t k = (uint8_t)FlightTrigger::SDO_ABORT; k <= (uint8_t)FlightTrigger::BUTTON; k++) {
+            const char* name = triggerName((FlightTrigger)k);
+            if (!trig[name].is<bool>()) continue;
+            if (trig[name].as<bool>()) c.triggerMask |= (1u << k);
+            else                       c.triggerMask &= ~(1u << k);
+        }
+    }
+    if (doc["thresholds"].is<JsonArray>()) {
+        c.thresholdCount = 0;
+        memset(c.thresholds, 0, sizeof(c.thresholds));
+        for (JsonObject t : doc["thresholds"].as<JsonArray>()) {
+            if (c.thresholdCount >= FLIGHT_MAX_THRESHOLDS) break;
+            const char* name = t["name"] | "";
+            if (!name[0]) continue;
+            FlightThreshold& th = c.thresholds[c.thresholdCount++];
+            strlcpy(th.name, name, sizeof(th.name));
+            th.level = (int32_t)lround((t["level"] | 0.0) * 1000.0);
+            th.above = t["above"] | true;
+        }
+    }
+    requestConfig(c);
+    Serial.println("[FLIGHT] Config update queued");
+    request->send(200, "application/json", "{\"ok\":true}");
+}
+
+void FlightRecorder::handleDelete(AsyncWebServerRequest* request) {
+    if (!request->hasParam("n")) {
+        request->send(400, "application/json", "{\"ok\":false,\"error\":\"missing n\"}");
+        return;
+    }
+    uint16_t n = (uint16_t)request->getParam("n")->value().toInt();
+    char path[24];
+    capturePath(n, path, sizeof(path));
+    if (!Storage::fs().exists(path)) {
+        request->send(404, "application/json", "{\"ok\":false,\"error\":\"no such capture\"}");
+        return;
+    }
+    Storage::fs().remove(path);
+    request->send(200, "application/json", "{\"ok\":true}");
+}
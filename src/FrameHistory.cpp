@@ -0,0 +1,59 @@
+// ============================================================================
+// FrameHistory.cpp
+// ============================================================================
+
+#include "FrameHistory.h"
+
+void FrameHistory::begin() {
+    _size = FRAME_HISTORY_FRAMES;
+    _ring = (HistoryFrame*)heap_caps_malloc(_size * sizeof(HistoryFrame),
+                                            MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!_ring) {
+        _size = FRAME_HISTORY_FRAMES_IRAM;
+        _ring = (HistoryFrame*)heap_caps_malloc(_size * sizeof(HistoryFrame), MALLOC_CAP_8BIT);
+    }
+    if (!_ring) {
+        _size = 0;
+        Serial.println("[HISTORY] No memory for the frame history");
+        return;
+    }
+    Serial.printf("[HISTORY] %u frame history (%u KB)\n",
+        _size, (unsigned)(_size * sizeof(HistoryFrame) / 1024));
+}
+
+// ---------------------------------------------------------------------------
+// Frame path — loopTask, every frame
+// ---------------------------------------------------------------------------
+
+uint32_t FrameHistory::record(const twai_message_t& msg, uint32_t nowUs) {
+    uint32_t seq = _head.load(std::memory_order_relaxed);
+    if (_ring) {
+        HistoryFrame& f = _ring[seq & (_size - 1)];
+        f.us          = nowUs;
+        f.rec.tsDlc   = (uint32_t)(msg.data_length_code & 0x0F) << CANLOG_TS_BITS;
+        f.rec.idFlags = (msg.identifier & CANLOG_ID_MASK) |
+                        (msg.extd ? CANLOG_EXT : 0) | (msg.rtr ? CANLOG_RTR : 0);
+        memcpy(f.rec.data, msg.data, 8);
+    }
+    _head.store(seq + 1, std::memory_order_release);
+    return seq;
+}
+
+// ---------------------------------------------------------------------------
+// Readers — any task
+// ---------------------------------------------------------------------------
+
+uint32_t FrameHistory::oldest() const {
+    if (!_ring) return head();
+    uint32_t h = head();
+    uint32_t keep = _size - FRAME_HISTORY_MARGIN;
+    return h > keep ? h - keep : 0;
+}
+
+bool FrameHistory::read(uint32_t seq, HistoryFrame& out) const {
+    if (!_ring || !intact(seq)) return false;
+    out = _ring[seq & (_size - 1)];
+    // Checked again after the copy — the writer may have lapped us meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return intact(seq);
+}
@@ -4,140 +4,44 @@
 
 #include "GVRETServer.h"
 #include "Config.h"
+#include "CANLogger.h"
+#include "CANTxScheduler.h"
 
 // ---------------------------------------------------------------------------
-// begin / stop
+// onData — async_tcp. Read and handle incoming GVRET commands. GVRET is
+// low-bandwidth on the command side, so the parse is byte-by-byte with
+// per-client state.
 // ---------------------------------------------------------------------------
-void GVRETServer::begin() {
-    _server.begin();
-    _server.setNoDelay(true);
-    _running = true;
-    _bufLen  = 0;
-    Serial.printf("[GVRET] TCP server listening on port %d\n", GVRET_PORT);
-}
-
-void GVRETServer::stop() {
-    for (int i = 0; i < GVRET_MAX_CLIENTS; i++) {
-        if (_clients[i].connected()) _clients[i].stop();
-    }
-    _server.end();
-    _running     = false;
-    _clientCount = 0;
-    _bufLen      = 0;
-    Serial.println("[GVRET] TCP server stopped");
-}
-
-// ---------------------------------------------------------------------------
-// update — call every loop()
-// ---------------------------------------------------------------------------
-void GVRETServer::update() {
-    if (!_running) return;
-    _acceptClients();
-    for (int i = 0; i < GVRET_MAX_CLIENTS; i++) {
-        if (_clients[i].connected() && _clients[i].available()) {
-            _processClientInput(i);
-        }
-    }
-    if (millis() - _lastFlush >= GVRET_FLUSH_MS) {
-        _flushFrameBuffer();
-        _lastFlush = millis();
-    }
-}
-
-// ---------------------------------------------------------------------------
-// pushFrame — called from main loop when a CAN frame is received
-// ---------------------------------------------------------------------------
-void GVRETServer::pushFrame(uint32_t id, bool extended, const uint8_t* data, uint8_t dlc) {
-    if (!_running) return;
-    _appendFrame(id, extended, data, dlc);
-}
-
-// ---------------------------------------------------------------------------
-// _acceptClients
-// ---------------------------------------------------------------------------
-void GVRETServer::_acceptClients() {
-    if (!_server.hasClient()) return;
-
-    // Find a free slot
-    for (int i = 0; i < GVRET_MAX_CLIENTS; i++) {
-        if (!_clients[i].connected()) {
-            _clients[i] = _server.available();
-            _clients[i].setNoDelay(true);
-            _clientCount++;
-            Serial.printf("[GVRET] Client %d connected from %s\n",
-                          i, _clients[i].remoteIP().toString().c_str());
-            return;
-        }
-    }
-
-    // No free slot — reject
-    WiFiClient rejected = _server.available();
-    rejected.stop();
-    Serial.println("[GVRET] Max clients reached — connection rejected");
-}
-
-// ---------------------------------------------------------------------------
-// _processClientInput — read and handle incoming GVRET commands
-// Maintains per-client parse state using a simple static approach:
-// GVRET is low-bandwidth on the command side so we read byte-by-byte here.
-// ---------------------------------------------------------------------------
-void GVRETServer::_processClientInput(int idx) {
-    WiFiClient& client = _clients[idx];
-
-    // Static per-client parse state
-    static uint8_t  state[GVRET_MAX_CLIENTS]       = {};  // 0=idle, 1=got_F1, 2+=collecting
-    static uint8_t  cmdByte[GVRET_MAX_CLIENTS]      = {};
-    static uint8_t  payload[GVRET_MAX_CLIENTS][16]  = {};
-    static int      payloadIdx[GVRET_MAX_CLIENTS]   = {};
-    static int      payloadLen[GVRET_MAX_CLIENTS]   = {};
-
-    // Check if client disconnected
-    if (!client.connected()) {
-        state[idx] = 0;
-        Serial.printf("[GVRET] Client %d disconnected\n", idx);
-        return;
-    }
+void GVRETServer::onData(Client& c, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
 
-    while (client.available()) {
-        uint8_t b = client.read();
-
-        switch (state[idx]) {
+        switch (c.state) {
             case 0: // idle — wait for 0xF1
-                if (b == GVRET_FRAME_START) state[idx] = 1;
+                if (b == GVRET_FRAME_START) c.state = 1;
                 break;
 
             case 1: // got 0xF1 — next byte is command
-                cmdByte[idx]    = b;
-                payloadIdx[idx] = 0;
-
-                // Determine expected payload length for each command
-                switch (b) {
-                    case GVRET_CMD_BINARY_MODE:   payloadLen[idx] = 0; break;
-                    case GVRET_CMD_GET_INFO:       payloadLen[idx] = 0; break;
-                    case GVRET_CMD_GET_EXT_BUSES:  payloadLen[idx] = 0; break;
-                    case GVRET_CMD_GET_DEV_INFO:   payloadLen[idx] = 0; break;
-                    case GVRET_CMD_BUS_ENABLE:     payloadLen[idx] = 0; break;
-                    case GVRET_CMD_BUS_DISABLE:    payloadLen[idx] = 0; break;
-                    case GVRET_CMD_GET_NUM_BUSES:  payloadLen[idx] = 0; break;
-                    case GVRET_CMD_TRANSMIT:       payloadLen[idx] = 14; break;
-                    default:                       payloadLen[idx] = 0; break;
-                }
-
-                if (payloadLen[idx] == 0) {
-                    _handleCommand(idx, cmdByte[idx], nullptr, 0);
-                    state[idx] = 0;
+                c.cmd        = b;
+                c.bufLen = 0;
+                // Only TRANSMIT carries a payload
+                c.need   = b == GVRET_CMD_TRANSMIT ? 14 : 0;
+
+                if (c.need == 0) {
+                    _handleCommand(c, c.cmd, nullptr, 0);
+                    c.state = 0;
                 } else {
-                    state[idx] = 2;
+                    c.state = 2;
                 }
                 break;
 
             case 2: // collecting payload bytes
-                if (payloadIdx[idx] < 16) {
-                    payload[idx][payloadIdx[idx]++] = b;
+                if (c.bufLen < sizeof(c.buf)) {
+                    c.buf[c.bufLen++] = b;
                 }
-                if (payloadIdx[idx] >= payloadLen[idx]) {
-                    _handleCommand(idx, cmdByte[idx], payload[idx], payloadLen[idx]);
-                    state[idx] = 0;
+                if (c.bufLen >= c.need) {
+                    _handleCommand(c, c.cmd, c.buf, c.need);
+                    c.state = 0;
                 }
                 break;
         }
@@ -147,14 +51,14 @@ void GVRETServer::_processClientInput(int idx) {
 // ---------------------------------------------------------------------------
 // _handleCommand — respond to SavvyCAN commands
 // ---------------------------------------------------------------------------
-void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
+void GVRETServer::_handleCommand(Client& c, uint8_t cmd,
                                   const uint8_t* payload, int payloadLen) {
     switch (cmd) {
 
         case GVRET_CMD_BINARY_MODE:
             // Echo back to confirm binary mode
-            _sendResponse(clientIdx, GVRET_CMD_BINARY_MODE, nullptr, 0);
-            Serial.printf("[GVRET] Client %d: binary mode\n", clientIdx);
+            _sendResponse(c, GVRET_CMD_BINARY_MODE, nullptr, 0);
+            Serial.printf("[GVRET] Client %d: binary mode\n", c.slot);
             break;
 
         case GVRET_CMD_GET_INFO: {
@@ -166,7 +70,7 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
             resp[1] = (ts >>  8) & 0xFF;
             resp[2] = (ts >> 16) & 0xFF;
             resp[3] = (ts >> 24) & 0xFF;
-            _sendResponse(clientIdx, GVRET_CMD_GET_INFO, resp, 4);
+            _sendResponse(c, GVRET_CMD_GET_INFO, resp, 4);
             break;
         }
 
@@ -175,8 +79,8 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
             // Response: 0xF1 0x0C + uint8 count (1 = one CAN bus)
             // SavvyCAN logs "Got num buses reply, Get number of buses = N"
             uint8_t resp[1] = { 1 };
-            _sendResponse(clientIdx, GVRET_CMD_GET_NUM_BUSES, resp, 1);
-            Serial.printf("[GVRET] Client %d: get num buses -> 1\n", clientIdx);
+            _sendResponse(c, GVRET_CMD_GET_NUM_BUSES, resp, 1);
+            Serial.printf("[GVRET] Client %d: get num buses -> 1\n", c.slot);
             break;
         }
 
@@ -204,8 +108,8 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
             resp[10] = (baud1 >> 16) & 0xFF;
             resp[11] = (baud1 >> 24) & 0xFF;
             resp[12] = 0;                // no single-wire CAN
-            _sendResponse(clientIdx, GVRET_CMD_GET_DEV_INFO, resp, 13);
-            Serial.printf("[GVRET] Client %d: get device info\n", clientIdx);
+            _sendResponse(c, GVRET_CMD_GET_DEV_INFO, resp, 13);
+            Serial.printf("[GVRET] Client %d: get device info\n", c.slot);
             break;
         }
 
@@ -214,7 +118,7 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
             // Response: 0xF1 0x06 + uint32 swcan_baud + uint32 lin1_baud + uint32 lin2_baud
             // All zero = not present.
             uint8_t resp[12] = {};
-            _sendResponse(clientIdx, GVRET_CMD_GET_EXT_BUSES, resp, 12);
+            _sendResponse(c, GVRET_CMD_GET_EXT_BUSES, resp, 12);
             break;
         }
 
@@ -222,13 +126,13 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
             // 0x09 = comm validation / bus enable.
             // THIS is what SavvyCAN waits for to set status = Connected.
             // Must echo back promptly.
-            _sendResponse(clientIdx, GVRET_CMD_BUS_ENABLE, nullptr, 0);
-            Serial.printf("[GVRET] Client %d: bus enable — now Connected\n", clientIdx);
+            _sendResponse(c, GVRET_CMD_BUS_ENABLE, nullptr, 0);
+            Serial.printf("[GVRET] Client %d: bus enable — now Connected\n", c.slot);
             break;
 
         case GVRET_CMD_BUS_DISABLE:
-            _sendResponse(clientIdx, GVRET_CMD_BUS_DISABLE, nullptr, 0);
-            Serial.printf("[GVRET] Client %d: bus disable\n", clientIdx);
+            _sendResponse(c, GVRET_CMD_BUS_DISABLE, nullptr, 0);
+            Serial.printf("[GVRET] Client %d: bus disable\n", c.slot);
             break;
 
         case GVRET_CMD_TRANSMIT:
@@ -241,7 +145,7 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
                 bool    ext = (id & 0x80000000) != 0;
                 id &= 0x1FFFFFFF;  // strip extended flag
 
-                twai_message_t msg;
+                twai_message_t msg = {};
                 msg.identifier         = id;
                 msg.extd               = ext ? 1 : 0;
                 msg.rtr                = 0;
@@ -249,13 +153,10 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
                 for (int i = 0; i < msg.data_length_code; i++) {
                     msg.data[i] = (i + 5 < payloadLen) ? payload[i + 5] : 0;
                 }
-                if (twai_transmit(&msg, pdMS_TO_TICKS(5)) == ESP_OK) {
-                    Serial.printf("[GVRET] Client %d: TX 0x%03X dlc=%d\n",
-                                  clientIdx, id, dlc);
-                } else {
-                    Serial.printf("[GVRET] Client %d: TX 0x%03X failed\n",
-                                  clientIdx, id);
-                }
+                // Rate limited as playback — a SavvyCAN replay cannot crowd
+                // out SDO traffic. Refusals are counted in /can/tx rather
+                // than logged per frame.
+                CANTxScheduler::getInstance().submit(TxSource::PLAYBACK, msg);
             }
             break;
 
@@ -266,88 +167,58 @@ void GVRETServer::_handleCommand(int clientIdx, uint8_t cmd,
 }
 
 // ---------------------------------------------------------------------------
-// _sendResponse — send 0xF1 + cmd + data to one client
+// _sendResponse — send 0xF1 + cmd + data to one client. Goes straight into
+// its TCP buffer between frame chunks, which only ever hold whole records.
 // ---------------------------------------------------------------------------
-void GVRETServer::_sendResponse(int clientIdx, uint8_t cmd,
+void GVRETServer::_sendResponse(Client& c, uint8_t cmd,
                                  const uint8_t* data, int len) {
-    if (!_clients[clientIdx].connected()) return;
-    uint8_t hdr[2] = { GVRET_FRAME_START, cmd };
-    _clients[clientIdx].write(hdr, 2);
-    if (data && len > 0) {
-        _clients[clientIdx].write(data, len);
-    }
+    uint8_t msg[2 + 16];
+    msg[0] = GVRET_FRAME_START;
+    msg[1] = cmd;
+    if (len > 16) len = 16;
+    if (data && len > 0) memcpy(msg + 2, data, len);
+    reply(c, msg, 2 + (data ? len : 0));
 }
 
 // ---------------------------------------------------------------------------
-// _appendFrame — encode a CAN frame into the outgoing buffer
+// encodeFrame — one CAN frame record, returns its length
 //
-// Frame wire format (14 bytes for DLC=8):
+// Frame wire format (20 bytes for DLC=8):
 //   [0]    0xF1          frame start
 //   [1]    0x00          command: incoming frame
-//   [2-5]  micros()      timestamp little-endian uint32
+//   [2-5]  µs            timestamp little-endian uint32 (esp_timer)
 //   [6-9]  can_id        little-endian uint32, bit31 set if extended
 //   [10]   (bus<<4)|dlc  upper nibble = bus (0), lower nibble = dlc
 //   [11..] data          DLC bytes
 //   [last] 0x00          checksum (unused)
 // ---------------------------------------------------------------------------
-void GVRETServer::_appendFrame(uint32_t id, bool extended,
-                                const uint8_t* data, uint8_t dlc) {
+size_t GVRETServer::encodeFrame(uint8_t* out, const HistoryFrame& f) {
+    uint32_t       us      = f.us;
+    uint32_t       idFlags = f.rec.idFlags;
+    const uint8_t* data    = f.rec.data;
+    uint8_t        dlc     = CANLogReader::dlc(f.rec);
     if (dlc > 8) dlc = 8;
-    int frameSize = 11 + dlc + 1;  // header(2) + ts(4) + id(4) + dlc_bus(1) + data + crc(1)
-
-    if (_bufLen + frameSize > GVRET_FRAME_BUF_SZ) {
-        // Buffer full — flush now before appending
-        _flushFrameBuffer();
-    }
+    uint32_t wireId = idFlags & CANLOG_ID_MASK;
+    if (idFlags & CANLOG_EXT) wireId |= 0x80000000;
 
-    uint32_t ts = (uint32_t)micros();
-    uint32_t wireId = id;
-    if (extended) wireId |= 0x80000000;
-
-    uint8_t* p = _frameBuf + _bufLen;
+    uint8_t* p = out;
     *p++ = GVRET_FRAME_START;
     *p++ = GVRET_CMD_FRAME;
     // Timestamp little-endian
-    *p++ = (ts)       & 0xFF;
-    *p++ = (ts >>  8) & 0xFF;
-    *p++ = (ts >> 16) & 0xFF;
-    *p++ = (ts >> 24) & 0xFF;
+    *p++ = (us)       & 0xFF;
+    *p++ = (us >>  8) & 0xFF;
+    *p++ = (us >> 16) & 0xFF;
+    *p++ = (us >> 24) & 0xFF;
     // CAN ID little-endian
     *p++ = (wireId)       & 0xFF;
     *p++ = (wireId >>  8) & 0xFF;
     *p++ = (wireId >> 16) & 0xFF;
     *p++ = (wireId >> 24) & 0xFF;
     // DLC + bus number: upper nibble = bus (0), lower nibble = dlc
-    // Bus 0: (0 << 4) | dlc = dlc
     *p++ = (uint8_t)((0 << 4) | (dlc & 0x0F));
     // Data
     for (int i = 0; i < dlc; i++) *p++ = data[i];
     // Checksum placeholder
     *p++ = 0x00;
-
-    _bufLen += frameSize;
-}
-
-// ---------------------------------------------------------------------------
-// _flushFrameBuffer — send buffered frames to all connected clients
-// ---------------------------------------------------------------------------
-void GVRETServer::_flushFrameBuffer() {
-    // Recount live clients on every flush — avoids counter drift bugs
-    int liveCount = 0;
-    for (int i = 0; i < GVRET_MAX_CLIENTS; i++) {
-        if (_clients[i].connected()) liveCount++;
-    }
-    _clientCount = liveCount;
-
-    if (_bufLen == 0 || _clientCount == 0) {
-        _bufLen = 0;
-        return;
-    }
-
-    for (int i = 0; i < GVRET_MAX_CLIENTS; i++) {
-        if (_clients[i].connected()) {
-            _clients[i].write(_frameBuf, _bufLen);
-        }
-    }
-    _bufLen = 0;
+    return p - out;
 }
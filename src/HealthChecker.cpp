@@ -86,7 +86,10 @@ void HealthChecker::update() {
         for (int i = 0; i < _itemCount; i++) {
             if (!_items[i].checked) {
                 _items[i].checked = true;
-                snprintf(_items[i].detail, sizeof(_items[i].detail), "No data");
+                // Distinguish "never seen" from "was live, stopped updating"
+                CANParameter* p = _can->getParameterByName(_items[i].paramName);
+                snprintf(_items[i].detail, sizeof(_items[i].detail),
+                         (p && p->received) ? "Stale" : "No data");
             }
         }
         _applyFailBehaviour();
@@ -100,12 +103,13 @@ void HealthChecker::update() {
 
     HealthItem& item = _items[_currentItem];
     CANParameter* p = _can->getParameterByName(item.paramName);
-    if (p && (millis() - p->lastUpdateTime) < 5000) {
-        item.value = (float)p->getValueAsInt();
+    // Only live values count — the stale flag follows each param's own period
+    if (p && p->received && !p->stale) {
+        item.value = p->getValueAsFloat();
         if (strcmp(item.paramName, "BMS_Vmax") == 0) {
             CANParameter* pMin = _can->getParameterByName("BMS_Vmin");
             if (pMin) {
-                item.value   = item.value - (float)pMin->getValueAsInt();
+                item.value   = item.value - pMin->getValueAsFloat();
                 item.warnMax = _cellDeltaWarn;
                 item.failMax = _cellDeltaFail;
                 item.name    = "Cell Delta";
@@ -0,0 +1,56 @@
+// ============================================================================
+// HeapChurn.cpp
+// ============================================================================
+
+#include "HeapChurn.h"
+
+static volatile TaskHandle_t s_task  = nullptr;
+static volatile uint32_t     s_count = 0;
+
+#ifdef HEAP_CHURN
+// Only the tracked task writes s_count, so a plain increment is safe
+static inline void IRAM_ATTR noteAlloc() {
+    if (s_task && xTaskGetCurrentTaskHandle() == s_task) s_count++;
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* IRAM_ATTR __wrap_malloc(size_t size) {
+    noteAlloc();
+    return __real_malloc(size);
+}
+
+void* IRAM_ATTR __wrap_calloc(size_t n, size_t size) {
+    noteAlloc();
+    return __real_calloc(n, size);
+}
+
+void* IRAM_ATTR __wrap_realloc(void* ptr, size_t size) {
+    if (size) noteAlloc();   // realloc(p, 0) is a free
+    return __real_realloc(ptr, size);
+}
+}
+#endif
+
+bool HeapChurn::enabled() {
+#ifdef HEAP_CHURN
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HeapChurn::track(TaskHandle_t task) {
+    s_task = task ? task : xTaskGetCurrentTaskHandle();
+}
+
+TaskHandle_t HeapChurn::tracked() {
+    return s_task;
+}
+
+uint32_t HeapChurn::count() {
+    return s_count;
+}
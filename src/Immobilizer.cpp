@@ -522,6 +522,13 @@ void Immobilizer::pollDriveInhibited() {
 
 void Immobilizer::onSDOResult(const SDOResult& result) {
 
+    // DriveInhibit written from the web UI (/cmd set) — not our write, but
+    // read it back so a locked dial puts its own value back
+    if (result.isWrite && result.paramId == inhibitWriteId && result.tag) {
+        if (result.success) pollDriveInhibited();
+        return;
+    }
+
     if (result.isWrite && result.paramId == inhibitWriteId) {
         writeInFlight = false;
 
@@ -0,0 +1,186 @@
+// ============================================================================
+// JsonWriter.cpp
+// ============================================================================
+
+#include "JsonWriter.h"
+#include "FixedPoint.h"
+#include <ESPAsyncWebServer.h>
+
+// ---------------------------------------------------------------------------
+// Low-level output — everything past the first thing that does not fit is
+// dropped, so a caller only has to check overflow() once per item
+// ---------------------------------------------------------------------------
+
+void JsonWriter::put(char ch) {
+    if (_st.overflow) return;
+    if (_st.len >= _cap) { _st.overflow = true; return; }
+    _buf[_st.len++] = ch;
+}
+
+void JsonWriter::put(const char* s, size_t len) {
+    if (_st.overflow) return;
+    if (_cap - _st.len < len) { _st.overflow = true; return; }
+    memcpy(_buf + _st.len, s, len);
+    _st.len += len;
+}
+
+// Comma before every member or element but the first; none after a key
+void JsonWriter::sep() {
+    if (_st.afterKey) { _st.afterKey = false; return; }
+    if (!_st.depth) return;
+    uint16_t bit = 1u << _st.depth;
+    if (_st.first & bit) _st.first &= ~bit;
+    else                 put(',');
+}
+
+void JsonWriter::open(char ch) {
+    sep();
+    put(ch);
+    if (_st.depth + 1 >= JSON_MAX_DEPTH) { _st.overflow = true; return; }
+    _st.depth++;
+    _st.first |= 1u << _st.depth;
+}
+
+void JsonWriter::close(char ch) {
+    if (_st.depth) _st.depth--;
+    put(ch);
+}
+
+void JsonWriter::beginObject() { open('{'); }
+void JsonWriter::endObject()   { close('}'); }
+void JsonWriter::beginArray()  { open('['); }
+void JsonWriter::endArray()    { close(']'); }
+
+void JsonWriter::key(const char* k, size_t len) {
+    sep();
+    put('"');
+    put(k, len);
+    put("\":", 2);
+    _st.afterKey = true;
+}
+
+// ---------------------------------------------------------------------------
+// Values
+// ---------------------------------------------------------------------------
+
+void JsonWriter::valueInt(int32_t v) {
+    char tmp[12];
+    sep();
+    put(tmp, FixedPoint::formatInt(tmp, sizeof(tmp), v));
+}
+
+void JsonWriter::valueUint(uint32_t v) {
+    char tmp[10];
+    size_t n = sizeof(tmp);
+    do { tmp[--n] = (char)('0' + v % 10); v /= 10; } while (v);
+    sep();
+    put(tmp + n, sizeof(tmp) - n);
+}
+
+void JsonWriter::valueBool(bool v) {
+    sep();
+    if (v) put("true", 4);
+    else   put("false", 5);
+}
+
+void JsonWriter::valueNull() {
+    sep();
+    put("null", 4);
+}
+
+void JsonWriter::valueFixed(int32_t fixed, uint8_t decimals) {
+    char tmp[16];
+    sep();
+    put(tmp, FixedPoint::format(tmp, sizeof(tmp), fixed, decimals));
+}
+
+void JsonWriter::valueFloat(float v, uint8_t decimals) {
+    if (decimals > FIXED_MAX_DECIMALS) decimals = FIXED_MAX_DECIMALS;
+    float scaled = v * FixedPoint::pow10(decimals);
+    // Out of fixed-point range (or NaN) — JSON has no spelling for it
+    if (!(scaled > -2.1e9f && scaled < 2.1e9f)) { valueNull(); return; }
+    valueFixed((int32_t)lroundf(scaled), decimals);
+}
+
+void JsonWriter::valueString(const char* s) {
+    static const char hex[] = "0123456789abcdef";
+    sep();
+    put('"');
+    for (; *s; s++) {
+        uint8_t ch = (uint8_t)*s;
+        if (ch == '"' || ch == '\\') {
+            put('\\');
+            put((char)ch);
+        } else if (ch < 0x20) {
+            char esc[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF] };
+            put(esc, sizeof(esc));
+        } else {
+            put((char)ch);
+        }
+    }
+    put('"');
+}
+
+void JsonWriter::valueName(const char* s, size_t len) {
+    sep();
+    put('"');
+    put(s, len);
+    put('"');
+}
+
+void JsonWriter::valueRaw(const char* json, size_t len) {
+    sep();
+    put(json, len);
+}
+
+void JsonWriter::raw(const char* s, size_t len) {
+    put(s, len);
+}
+
+const char* JsonWriter::c_str() {
+    if (_st.len < _cap) {
+        _buf[_st.len] = '\0';
+    } else {
+        _st.overflow = true;
+        if (_cap) _buf[_cap - 1] = '\0';
+    }
+    return _buf;
+}
+
+// ---------------------------------------------------------------------------
+// JsonStream
+// ---------------------------------------------------------------------------
+
+size_t JsonStream::fill(JsonBody& body, uint8_t* buf, size_t maxLen) {
+    if (body._done) return 0;
+
+    JsonWriter& w = body._w;
+    w.setBuffer((char*)buf, maxLen);
+    for (;;) {
+        if (!body.ready(body._next)) break;
+        JsonWriter::Mark m = w.mark();
+        if (!body.item(w, body._next)) {
+            body._done = true;
+            body.complete(body._bytes + w.length());
+            break;
+        }
+        if (w.overflow()) {
+            w.rewind(m);
+            break;
+        }
+        body._next++;
+    }
+    // Not even one item fitted (or was ready) — wait for the socket to drain
+    if (!w.length() && !body._done) return RESPONSE_TRY_AGAIN;
+    body._bytes += w.length();
+    return w.length();
+}
+
+AsyncWebServerResponse* JsonStream::begin(AsyncWebServerRequest* request,
+                                          const char* mime,
+                                          std::shared_ptr<JsonBody> body) {
+    return request->beginChunkedResponse(mime,
+        [body](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+            return JsonStream::fill(*body, buf, maxLen);
+        });
+}
@@ -0,0 +1,105 @@
+// ============================================================================
+// MsgPack.cpp
+// ============================================================================
+
+#include "MsgPack.h"
+#include "FixedPoint.h"
+#include <ESPAsyncWebServer.h>
+
+// Largest magnitude a float32 carries to 7 significant digits
+#define MSGPACK_FLOAT32_MAX  9999999
+
+void MsgPackWriter::put(uint8_t b) {
+    if (_overflow) return;
+    if (_len >= _cap) { _overflow = true; return; }
+    _buf[_len++] = b;
+}
+
+void MsgPackWriter::put(const void* p, size_t len) {
+    if (_overflow) return;
+    if (_cap - _len < len) { _overflow = true; return; }
+    memcpy(_buf + _len, p, len);
+    _len += len;
+}
+
+void MsgPackWriter::be(uint8_t tag, uint64_t v, uint8_t bytes) {
+    uint8_t out[9];
+    out[0] = tag;
+    for (uint8_t i = 0; i < bytes; i++)
+        out[bytes - i] = (uint8_t)(v >> (8 * i));
+    put(out, 1 + bytes);
+}
+
+void MsgPackWriter::map(uint32_t n) {
+    if (n < 16)          put((uint8_t)(0x80 | n));
+    else if (n < 65536)  be(0xDE, n, 2);
+    else                 be(0xDF, n, 4);
+}
+
+void MsgPackWriter::array(uint32_t n) {
+    if (n < 16)          put((uint8_t)(0x90 | n));
+    else if (n < 65536)  be(0xDC, n, 2);
+    else                 be(0xDD, n, 4);
+}
+
+void MsgPackWriter::str(const char* s, size_t len) {
+    if (len < 32)         put((uint8_t)(0xA0 | len));
+    else if (len < 256)   be(0xD9, len, 1);
+    else if (len < 65536) be(0xDA, len, 2);
+    else                  be(0xDB, len, 4);
+    put(s, len);
+}
+
+void MsgPackWriter::uint(uint32_t v) {
+    if (v < 128)          put((uint8_t)v);
+    else if (v < 256)     be(0xCC, v, 1);
+    else if (v < 65536)   be(0xCD, v, 2);
+    else                  be(0xCE, v, 4);
+}
+
+void MsgPackWriter::sint(int32_t v) {
+    if (v >= 0)           uint((uint32_t)v);
+    else if (v >= -32)    put((uint8_t)v);                       // negative fixint
+    else if (v >= -128)   be(0xD0, (uint8_t)v, 1);
+    else if (v >= -32768) be(0xD1, (uint16_t)v, 2);
+    else                  be(0xD2, (uint32_t)v, 4);
+}
+
+void MsgPackWriter::boolean(bool v) {
+    put((uint8_t)(v ? 0xC3 : 0xC2));
+}
+
+void MsgPackWriter::nil() {
+    put((uint8_t)0xC0);
+}
+
+void MsgPackWriter::float32(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    be(0xCA, bits, 4);
+}
+
+void MsgPackWriter::float64(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    be(0xCB, bits, 8);
+}
+
+void MsgPackWriter::fixed(int32_t fixed, uint8_t decimals) {
+    if (!decimals) { sint(fixed); return; }
+    int32_t div = FixedPoint::pow10(decimals);
+    if (fixed % div == 0) { sint(fixed / div); return; }
+    if (fixed >= -MSGPACK_FLOAT32_MAX && fixed <= MSGPACK_FLOAT32_MAX)
+        float32((float)((double)fixed / div));
+    else
+        float64((double)fixed / div);
+}
+
+// ---------------------------------------------------------------------------
+// Content negotiation
+// ---------------------------------------------------------------------------
+
+bool MsgPack::accepted(AsyncWebServerRequest* request) {
+    return request->hasHeader("Accept") &&
+           request->header("Accept").indexOf(MSGPACK_MIME) >= 0;
+}
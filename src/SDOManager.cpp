@@ -1,4 +1,5 @@
 #include "SDOManager.h"
+#include "CANTxScheduler.h"
 
 // ============================================================================
 // Construction
@@ -66,15 +67,16 @@ bool SDOManager::requestRead(uint16_t paramId, bool highPriority) {
     return xQueueSend(requestQueue, &req, 0) == pdTRUE;
 }
 
-bool SDOManager::requestWrite(uint16_t paramId, int32_t value, bool highPriority) {
-    SDORequest req = { SDO_REQ_WRITE, paramId, value, highPriority };
+bool SDOManager::requestWrite(uint16_t paramId, int32_t value, bool highPriority,
+                              uint32_t tag) {
+    SDORequest req = { SDO_REQ_WRITE, paramId, value, highPriority, tag };
     if (highPriority)
         return xQueueSendToFront(requestQueue, &req, 0) == pdTRUE;
     return xQueueSend(requestQueue, &req, 0) == pdTRUE;
 }
 
-bool SDOManager::requestSaveFlash() {
-    SDORequest req = { SDO_REQ_SAVE_FLASH, 0, 6, true };
+bool SDOManager::requestCommand(uint8_t command, int32_t value, uint32_t tag) {
+    SDORequest req = { SDO_REQ_COMMAND, command, value, true, tag };
     return xQueueSendToFront(requestQueue, &req, 0) == pdTRUE;
 }
 
@@ -124,24 +126,30 @@ void SDOManager::taskLoop() {
         }
 
         case SDO_SEND_REQUEST: {
-            uint8_t cmd;
-            int32_t val = 0;
+            uint8_t  cmd;
+            int32_t  val = 0;
+            uint16_t index    = SDO_BASE_INDEX | (currentRequest.paramId >> 8);
+            uint8_t  subindex = currentRequest.paramId & 0xFF;
 
             switch (currentRequest.type) {
                 case SDO_REQ_READ:
                     cmd = SDO_CMD_READ;
                     break;
                 case SDO_REQ_WRITE:
-                case SDO_REQ_SAVE_FLASH:
                     cmd = SDO_CMD_WRITE;
                     val = currentRequest.value;
                     break;
+                case SDO_REQ_COMMAND:
+                    cmd = SDO_CMD_WRITE;
+                    val = currentRequest.value;
+                    index = SDO_INDEX_COMMANDS;
+                    break;
                 default:
                     cmd = SDO_CMD_READ;
                     break;
             }
 
-            if (sendFrame(cmd, currentRequest.paramId, val)) {
+            if (sendFrame(cmd, index, subindex, val)) {
                 stateEnteredMs = millis();
                 state = SDO_WAIT_RESPONSE;
             } else {
@@ -223,8 +231,11 @@ void SDOManager::handleFrame(const twai_message_t& msg) {
     uint16_t index    = (uint16_t)(msg.data[1] | (msg.data[2] << 8));
     uint8_t  subindex = msg.data[3];
 
-    // Reconstruct full 16-bit param ID from index and subindex
-    uint16_t paramId = (uint16_t)(((index & 0xFF) << 8) | subindex);
+    // Reconstruct full 16-bit param ID from index and subindex — a command
+    // reply keeps the command number it was queued with
+    uint16_t paramId = (index == SDO_INDEX_COMMANDS)
+        ? currentRequest.paramId
+        : (uint16_t)(((index & 0xFF) << 8) | subindex);
 
     switch (cmd) {
 
@@ -285,23 +296,22 @@ void SDOManager::handleFrame(const twai_message_t& msg) {
 
 // ============================================================================
 // sendFrame
-// Calculates SDO index and subindex from full 16-bit param ID:
+// SDO_SEND_REQUEST calculates index and subindex from the full 16-bit param ID:
 //   index    = 0x2100 | (paramId >> 8)
 //   subindex = paramId & 0xFF
 // For params 1-255: index=0x2100, subindex=paramId  (same as before)
 // For spot 2006:    index=0x2107, subindex=0xD6
+// Commands go to index 0x5002 with the command as subindex.
 // ============================================================================
 
-bool SDOManager::sendFrame(uint8_t cmd, uint16_t paramId, int32_t value) {
+bool SDOManager::sendFrame(uint8_t cmd, uint16_t index, uint8_t subindex,
+                           int32_t value) {
     twai_message_t tx = {};
     tx.identifier       = SDO_TX_ID;
     tx.data_length_code = 8;
     tx.extd             = 0;
     tx.rtr              = 0;
 
-    uint16_t index    = SDO_BASE_INDEX | (paramId >> 8);
-    uint8_t  subindex = paramId & 0xFF;
-
     tx.data[0] = cmd;
     tx.data[1] = (uint8_t)(index & 0xFF);
     tx.data[2] = (uint8_t)(index >> 8);
@@ -311,9 +321,11 @@ bool SDOManager::sendFrame(uint8_t cmd, uint16_t paramId, int32_t value) {
     tx.data[6] = (uint8_t)((value >> 16) & 0xFF);
     tx.data[7] = (uint8_t)((value >> 24) & 0xFF);
 
-    esp_err_t rc = twai_transmit(&tx, pdMS_TO_TICKS(10));
-    if (rc != ESP_OK) {
-        Serial.printf("[SDO] twai_transmit failed: %s\n", esp_err_to_name(rc));
+    // Writes flagged high priority (and commands) jump the TX queue
+    // ahead of routine polling
+    TxSource src = currentRequest.highPriority ? TxSource::SAFETY_SDO : TxSource::SDO;
+    if (!CANTxScheduler::getInstance().submit(src, tx)) {
+        Serial.printf("[SDO] TX refused by scheduler (%s)\n", CANTxScheduler::sourceName(src));
         return false;
     }
 
@@ -331,7 +343,8 @@ void SDOManager::deliverResult(bool success, uint16_t paramId,
                                 int32_t value, bool isWrite,
                                 uint32_t abortCode) {
     if (!resultCallback) return;
-    SDOResult result = { paramId, value, success, isWrite, abortCode };
+    SDOResult result = { paramId, value, success, isWrite, abortCode,
+                         currentRequest.tag };
     resultCallback(result);
 }
 
@@ -0,0 +1,170 @@
+// ============================================================================
+// SLCANServer.cpp
+// ============================================================================
+
+#include "SLCANServer.h"
+#include "CANLogger.h"
+#include "CANTxScheduler.h"
+
+static const char s_hex[] = "0123456789ABCDEF";
+
+static int hexNibble(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    return -1;
+}
+
+// n hex digits → value, false on a non-hex character
+static bool parseHex(const char* s, uint8_t n, uint32_t& out) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        int d = hexNibble(s[i]);
+        if (d < 0) return false;
+        v = (v << 4) | (uint32_t)d;
+    }
+    out = v;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// onData — async_tcp. Collects one '\r'-terminated command at a time in
+// c.buf; c.state set means the line overflowed and is skipped to its end.
+// c.cmd holds the channel mode: 0 closed, 'O' open, 'L' listen-only.
+// ---------------------------------------------------------------------------
+
+void SLCANServer::onData(Client& c, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char ch = (char)data[i];
+        if (ch == '\n') continue;
+        if (ch != '\r') {
+            if (c.bufLen < sizeof(c.buf)) c.buf[c.bufLen++] = (uint8_t)ch;
+            else                          c.state = 1;
+            continue;
+        }
+        if (c.state) reply(c, "\a", 1);
+        else if (c.bufLen) handleCommand(c, (const char*)c.buf, c.bufLen);
+        else reply(c, "\r", 1);
+        c.bufLen = 0;
+        c.state  = 0;
+    }
+}
+
+void SLCANServer::handleCommand(Client& c, const char* cmd, uint8_t len) {
+    switch (cmd[0]) {
+        case 'S':
+            // The bus is fixed at 500k by the ZombieVerter
+            reply(c, len == 2 && cmd[1] == '6' ? "\r" : "\a", 1);
+            break;
+
+        case 'O':
+        case 'L':
+            c.cmd       = (uint8_t)cmd[0];
+            c.streaming = true;
+            reply(c, "\r", 1);
+            Serial.printf("[SLCAN] Client %d: open%s\n", c.slot,
+                          cmd[0] == 'L' ? " (listen-only)" : "");
+            break;
+
+        case 'C':
+            c.cmd       = 0;
+            c.streaming = false;
+            reply(c, "\r", 1);
+            Serial.printf("[SLCAN] Client %d: close\n", c.slot);
+            break;
+
+        case 't': case 'T': case 'r': case 'R':
+            if (transmit(c, cmd, len)) {
+                const char* ok = (cmd[0] == 't' || cmd[0] == 'r') ? "z\r" : "Z\r";
+                reply(c, ok, 2);
+            } else {
+                reply(c, "\a", 1);
+            }
+            break;
+
+        case 'Z':
+            if (len == 2 && (cmd[1] == '0' || cmd[1] == '1')) {
+                c.timestamps = cmd[1] == '1';
+                reply(c, "\r", 1);
+            } else {
+                reply(c, "\a", 1);
+            }
+            break;
+
+        case 'V': reply(c, "V1013\r", 6); break;
+        case 'N': reply(c, "NZV01\r", 6); break;
+        case 'F': reply(c, "F00\r", 4);   break;
+
+        case 's': case 'M': case 'm': case 'X': case 'W':
+            reply(c, "\r", 1);
+            break;
+
+        default:
+            reply(c, "\a", 1);
+            break;
+    }
+}
+
+// t/T/r/R — only on an open, non-listen-only channel
+bool SLCANServer::transmit(Client& c, const char* cmd, uint8_t len) {
+    if (c.cmd != 'O') return false;
+
+    bool    ext    = cmd[0] == 'T' || cmd[0] == 'R';
+    bool    rtr    = cmd[0] == 'r' || cmd[0] == 'R';
+    uint8_t idLen  = ext ? 8 : 3;
+    if (len < 1 + idLen + 1) return false;
+
+    uint32_t id, dlc;
+    if (!parseHex(cmd + 1, idLen, id) || !parseHex(cmd + 1 + idLen, 1, dlc)) return false;
+    if (dlc > 8 || id > (ext ? 0x1FFFFFFFu : 0x7FFu)) return false;
+
+    twai_message_t msg = {};
+    msg.identifier       = id;
+    msg.extd             = ext ? 1 : 0;
+    msg.rtr              = rtr ? 1 : 0;
+    msg.data_length_code = (uint8_t)dlc;
+    if (!rtr) {
+        const char* p = cmd + 2 + idLen;
+        if (len < (uint8_t)(2 + idLen + dlc * 2)) return false;
+        for (uint8_t i = 0; i < dlc; i++) {
+            uint32_t b;
+            if (!parseHex(p + i * 2, 2, b)) return false;
+            msg.data[i] = (uint8_t)b;
+        }
+    }
+    return CANTxScheduler::getInstance().submit(TxSource::PLAYBACK, msg);
+}
+
+// ---------------------------------------------------------------------------
+// encodeFrame — bridge task, straight from the history slot
+// ---------------------------------------------------------------------------
+
+size_t SLCANServer::encodeFrame(uint8_t* out, const HistoryFrame& f, bool stamp) {
+    uint32_t id  = f.rec.idFlags & CANLOG_ID_MASK;
+    bool     ext = (f.rec.idFlags & CANLOG_EXT) != 0;
+    bool     rtr = (f.rec.idFlags & CANLOG_RTR) != 0;
+    uint8_t  dlc = CANLogReader::dlc(f.rec);
+    if (dlc > 8) dlc = 8;
+
+    uint8_t* p = out;
+    *p++ = rtr ? (ext ? 'R' : 'r') : (ext ? 'T' : 't');
+    for (int shift = ext ? 28 : 8; shift >= 0; shift -= 4)
+        *p++ = s_hex[(id >> shift) & 0xF];
+    *p++ = s_hex[dlc];
+    if (!rtr) {
+        for (uint8_t i = 0; i < dlc; i++) {
+            *p++ = s_hex[f.rec.data[i] >> 4];
+            *p++ = s_hex[f.rec.data[i] & 0xF];
+        }
+    }
+    if (stamp) {
+        // Lawicel timestamps are ms, wrapping at 60000
+        uint32_t ms = (f.us / 1000) % 60000;
+        *p++ = s_hex[(ms >> 12) & 0xF];
+        *p++ = s_hex[(ms >>  8) & 0xF];
+        *p++ = s_hex[(ms >>  4) & 0xF];
+        *p++ = s_hex[ms & 0xF];
+    }
+    *p++ = '\r';
+    return p - out;
+}
@@ -0,0 +1,548 @@
+// ============================================================================
+// SpotStream.cpp
+// ============================================================================
+
+#include "SpotStream.h"
+#include "FixedPoint.h"
+#include "MsgPack.h"
+#include <ArduinoJson.h>
+
+// Decimal digits of v at p, returns the count
+static size_t putUint(char* p, uint32_t v) {
+    char tmp[10];
+    size_t n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    for (size_t i = 0; i < n; i++) p[i] = tmp[n - 1 - i];
+    return n;
+}
+
+// ---------------------------------------------------------------------------
+// begin / registerEndpoints
+// ---------------------------------------------------------------------------
+
+void SpotStream::begin(CANDataManager* can) {
+    _can = can;
+    if (_task) return;
+    _ctlQ    = xQueueCreate(8, sizeof(Ctl));
+    _connMutex = xSemaphoreCreateMutex();
+    _sinceMs = millis();
+    // Core 0 with the WiFi stack, like the /ws/can sender
+    xTaskCreatePinnedToCore(taskEntry, "SpotPush", 4096, this, 1, &_task, 0);
+}
+
+void SpotStream::registerEndpoints(AsyncWebServer* server) {
+    _ws = new AsyncWebSocket("/ws/spot");
+    _ws->onEvent(onWsEvent);
+    server->addHandler(_ws);
+
+    server->on("/spot-stats", HTTP_GET,
+        [](AsyncWebServerRequest* r){ SpotStream::getInstance().handleStats(r); });
+}
+
+void SpotStream::notePoll(Poll kind, size_t bytes) {
+    if (kind == Poll::SPOT) { _spotPolls++;  _spotBytes  += bytes; }
+    else                    { _valuePolls++; _valueBytes += bytes; }
+}
+
+// ---------------------------------------------------------------------------
+// Client bookkeeping — async_tcp posts, the push task applies
+// ---------------------------------------------------------------------------
+
+bool SpotStream::postCtl(CtlOp op, uint32_t id, Subscription* sub) {
+    Ctl ctl = { op, id, sub };
+    if (_ctlQ && xQueueSend(_ctlQ, &ctl, pdMS_TO_TICKS(10)) == pdTRUE) return true;
+    delete sub;
+    return false;
+}
+
+AsyncWebSocketClient* SpotStream::takeConn(uint32_t id) {
+    if (!_connMutex || xSemaphoreTake(_connMutex, portMAX_DELAY) != pdTRUE) return nullptr;
+    for (uint8_t i = 0; i < SPOT_WS_MAX_CLIENTS; i++)
+        if (_conns[i].id == id && _conns[i].cl) return _conns[i].cl;
+    xSemaphoreGive(_connMutex);
+    return nullptr;
+}
+
+void SpotStream::setConn(uint32_t id, AsyncWebSocketClient* cl) {
+    if (!_connMutex) return;
+    xSemaphoreTake(_connMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < SPOT_WS_MAX_CLIENTS; i++) {
+        Conn& k = _conns[i];
+        if (cl && !k.id) { k.id = id; k.cl = cl; break; }
+        if (!cl && k.id == id) { k.id = 0; k.cl = nullptr; break; }
+    }
+    xSemaphoreGive(_connMutex);
+}
+
+// Periodic WebSocket cleanup — prevents stale connections piling up
+void SpotStream::cleanupClients() {
+    static uint32_t lastCleanup = 0;
+    if (_ws && millis() - lastCleanup > 2000) {
+        _ws->cleanupClients();
+        lastCleanup = millis();
+    }
+}
+
+SpotStream::Client* SpotStream::findClient(uint32_t id) {
+    for (uint8_t i = 0; i < SPOT_WS_MAX_CLIENTS; i++)
+        if (_clients[i].id == id) return &_clients[i];
+    return nullptr;
+}
+
+void SpotStream::applyCtl(const Ctl& ctl) {
+    Client* c = findClient(ctl.id);
+    switch (ctl.op) {
+        case CtlOp::ADD:
+            if (c) break;
+            c = findClient(0);
+            if (!c) {
+                Serial.printf("[SPOT] WS client %u not served — %d clients max\n",
+                              ctl.id, SPOT_WS_MAX_CLIENTS);
+                break;
+            }
+            memset(c, 0, sizeof(*c));
+            c->id = ctl.id;
+            break;
+        case CtlOp::REMOVE:
+            if (!c) break;
+            delete c->sub;
+            c->sub = nullptr;
+            c->id  = 0;
+            break;
+        case CtlOp::SUBSCRIBE:
+            if (!c) { delete ctl.sub; break; }
+            delete c->sub;
+            c->sub = ctl.sub;
+            if (c->sub) {
+                String reply;
+                resolve(*c->sub, reply);
+                if (AsyncWebSocketClient* cl = takeConn(c->id)) {
+                    cl->text(reply);
+                    giveConn();
+                }
+                c->lastMs = millis() - c->sub->periodMs;   // first delta at once
+            }
+            break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Push task — the only place /ws/spot sends
+// ---------------------------------------------------------------------------
+
+void SpotStream::taskEntry(void* arg) {
+    static_cast<SpotStream*>(arg)->taskLoop();
+}
+
+void SpotStream::taskLoop() {
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(SPOT_WS_TICK_MS));
+        Ctl ctl;
+        while (xQueueReceive(_ctlQ, &ctl, 0) == pdTRUE) applyCtl(ctl);
+        if (!_ws || !_can) continue;
+
+        uint32_t now = millis();
+        bool due = false;
+        for (uint8_t i = 0; i < SPOT_WS_MAX_CLIENTS && !due; i++)
+            due = _clients[i].sub && now - _clients[i].lastMs >= _clients[i].sub->periodMs;
+
+        if (due) {
+            uint32_t gen   = _can->getParamsGeneration();
+            uint16_t count = 0;
+            _can->snapshotAll(_snap, MAX_PARAMETERS, count);
+            // Reloaded while the snapshot was taken — its slots may not
+            // match either generation's indices, so wait for the next pass
+            if (_can->getParamsGeneration() != gen) continue;
+            for (uint8_t i = 0; i < SPOT_WS_MAX_CLIENTS; i++) {
+                Client& c = _clients[i];
+                if (!c.sub || now - c.lastMs < c.sub->periodMs) continue;
+                // Held until this client is done — its disconnect waits for it
+                AsyncWebSocketClient* cl = takeConn(c.id);
+                if (!cl) continue;
+                if (cl->status() != WS_CONNECTED) {
+                    giveConn();
+                    continue;
+                }
+                if (cl->queueLen() >= SPOT_WS_MAX_QUEUED) {
+                    giveConn();
+                    c.skipped++;
+                    continue;
+                }
+                // Table reloaded since the indices were taken — resolve
+                // by name and tell the client the new positions
+                if (c.sub->generation != gen) {
+                    String reply;
+                    resolve(*c.sub, reply);
+                    cl->text(reply);
+                }
+                // An unfinished delta keeps the client due
+                if (push(c, cl, count)) c.lastMs = now;
+                giveConn();
+            }
+        }
+    }
+}
+
+// One delta for one client. Stale flips of values the client already has
+// are listed first (they always fit), then changed values while there is
+// room. false when values were left over for the next pass.
+bool SpotStream::push(Client& c, AsyncWebSocketClient* cl, uint16_t count) {
+    Subscription& s = *c.sub;
+    uint16_t on = 0, off = 0;
+
+    for (uint16_t j = 0; j < s.count; j++) {
+        if (s.idx[j] >= count || !(s.sentFlags[j] & SENT_VALUE)) continue;
+        bool stale = _snap[s.idx[j]].stale;
+        if (stale == ((s.sentFlags[j] & SENT_STALE) != 0)) continue;
+        if (stale) _staleOn[on++]   = (uint8_t)j;
+        else       _staleOff[off++] = (uint8_t)j;
+    }
+
+    // Room kept back for both position lists, 4 bytes a position
+    size_t   reserve = 16 + 4u * (on + off);
+    size_t   n       = 6;            // after {"v":[
+    uint16_t values  = 0;
+    bool     done    = true;
+    memcpy(_msg, "{\"v\":[", 6);
+    for (uint16_t j = 0; j < s.count; j++) {
+        uint8_t i = s.idx[j];
+        if (i >= count || !_snap[i].received) continue;
+        const ParamSnapshot& sn = _snap[i];
+        bool first = !(s.sentFlags[j] & SENT_VALUE);
+        if (!first && sn.changeCount == s.sentChange[j]) continue;
+        if (n + 32 + reserve + (first ? 4 : 0) > sizeof(_msg)) {
+            done = false;
+            break;
+        }
+        CANParameter* p = _can->getParameterByIndex(i);
+        if (!p) continue;
+
+        if (values) _msg[n++] = ',';
+        n += putUint(_msg + n, j);
+        _msg[n++] = ',';
+        n += FixedPoint::format(_msg + n, 16, sn.valueInt, p->getDecimals());
+        values++;
+        s.sentChange[j] = sn.changeCount;
+        s.sentFlags[j] |= SENT_VALUE;
+        // A value that arrives already stale is flagged with it
+        if (first && sn.stale) {
+            _staleOn[on++] = (uint8_t)j;
+            reserve += 4;
+        }
+    }
+    if (!values && !on && !off) return done;
+
+    if (values) _msg[n++] = ']';
+    else        n = 1;               // just {
+    const uint8_t* lists[2] = { _staleOn, _staleOff };
+    const uint16_t sizes[2] = { on, off };
+    for (int k = 0; k < 2; k++) {
+        if (!sizes[k]) continue;
+        if (n > 1) _msg[n++] = ',';
+        memcpy(_msg + n, k ? "\"f\":[" : "\"s\":[", 5);
+        n += 5;
+        for (uint16_t m = 0; m < sizes[k]; m++) {
+            if (m) _msg[n++] = ',';
+            n += putUint(_msg + n, lists[k][m]);
+            if (k) s.sentFlags[lists[k][m]] &= ~SENT_STALE;
+            else   s.sentFlags[lists[k][m]] |= SENT_STALE;
+        }
+        _msg[n++] = ']';
+    }
+    _msg[n++] = '}';
+
+    cl->text(_msg, n);
+    c.msgs++;
+    c.bytes  += n;
+    c.values += values;
+    _wsMsgs++;
+    _wsBytes  += n;
+    _wsValues += values;
+    return done;
+}
+
+// ---------------------------------------------------------------------------
+// WebSocket events — async_tcp
+// ---------------------------------------------------------------------------
+
+void SpotStream::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
+                           AwsEventType type, void* arg, uint8_t* data, size_t len) {
+    SpotStream& ss = SpotStream::getInstance();
+    switch (type) {
+        case WS_EVT_CONNECT:
+            ss.setConn(client->id(), client);
+            ss.postCtl(CtlOp::ADD, client->id());
+            Serial.printf("[SPOT] WS client %u connected\n", client->id());
+            break;
+        case WS_EVT_DISCONNECT:
+            // Waits for the push task to finish with this client — it is
+            // freed as soon as this handler returns
+            ss.setConn(client->id(), nullptr);
+            ss.postCtl(CtlOp::REMOVE, client->id());
+            Serial.printf("[SPOT] WS client %u disconnected\n", client->id());
+            break;
+        case WS_EVT_DATA: {
+            AwsFrameInfo* info = (AwsFrameInfo*)arg;
+            // Commands are small — whole single-frame text messages only
+            if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT)
+                ss.handleWsMessage(client, data, len);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// {"cmd":"sub","names":[...]|"all","hz":N} / {"cmd":"unsub"}
+void SpotStream::handleWsMessage(AsyncWebSocketClient* client, uint8_t* data, size_t len) {
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len)) {
+        client->text("{\"error\":\"bad json\"}");
+        return;
+    }
+    const char* cmd = doc["cmd"];
+    if (!cmd) return;
+
+    if (strcmp(cmd, "unsub") == 0) {
+        postCtl(CtlOp::SUBSCRIBE, client->id(), nullptr);
+        client->text("{\"type\":\"sub\",\"ok\":true,\"names\":[]}");
+        return;
+    }
+    if (strcmp(cmd, "sub") != 0 || !_can) return;
+
+    int hz = doc["hz"] | SPOT_WS_DEFAULT_HZ;
+    if (hz < 1) hz = 1;
+    if (hz > SPOT_WS_MAX_HZ) hz = SPOT_WS_MAX_HZ;
+
+    Subscription* sub = new Subscription();
+    sub->periodMs = (uint16_t)(1000 / hz);
+    sub->hz       = (uint8_t)hz;
+    JsonVariantConst req = doc["names"];
+    if (req.is<const char*>() && strcmp(req.as<const char*>(), "all") == 0) {
+        sub->all = true;
+    } else {
+        for (JsonVariantConst v : req.as<JsonArrayConst>()) {
+            const char* name = v.as<const char*>();
+            if (!name || !*name || strchr(name, '\n')) continue;
+            sub->requested += name;
+            sub->requested += '\n';
+        }
+    }
+
+    // Resolved and answered by the push task, so the reply can never
+    // arrive after a re-resolve it sends itself
+    if (!postCtl(CtlOp::SUBSCRIBE, client->id(), sub))
+        client->text("{\"type\":\"sub\",\"ok\":false,\"names\":[]}");
+}
+
+void SpotStream::resolve(Subscription& sub, String& reply) {
+    sub.generation = _can->getParamsGeneration();
+    sub.count      = 0;
+    memset(sub.sentFlags, 0, sizeof(sub.sentFlags));   // everything goes out again
+    uint16_t total = _can->getParameterCount();
+    if (total > MAX_PARAMETERS) total = MAX_PARAMETERS;
+
+    String names, unknown;
+    auto add = [&](uint16_t i) {
+        CANParameter* p = _can->getParameterByIndex((uint8_t)i);
+        if (!p) return;
+        for (uint16_t j = 0; j < sub.count; j++)
+            if (sub.idx[j] == i) return;   // listed twice
+        sub.idx[sub.count++] = (uint8_t)i;
+        if (names.length()) names += ',';
+        names += '"';
+        names += p->name;
+        names += '"';
+    };
+
+    if (sub.all) {
+        for (uint16_t i = 0; i < total; i++) add(i);
+    } else {
+        const char* name = sub.requested.c_str();
+        char buf[sizeof(((CANParameter*)0)->name) + 1];
+        while (*name) {
+            const char* end = strchr(name, '\n');
+            size_t len = end - name;
+            if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+            memcpy(buf, name, len);
+            buf[len] = '\0';
+            name = end + 1;
+            if (sub.count >= MAX_PARAMETERS) break;
+            CANParameter* p = _can->getParameterByName(buf);
+            uint16_t i = 0;
+            while (p && i < total && _can->getParameterByIndex((uint8_t)i) != p) i++;
+            if (p && i < total) {
+                add(i);
+            } else {
+                // Names the client sent — escaped, unlike the table's own
+                char esc[6 * sizeof(buf) + 4];
+                JsonWriter w(esc, sizeof(esc));
+                w.valueString(buf);
+                if (unknown.length()) unknown += ',';
+                unknown += w.c_str();
+            }
+        }
+    }
+
+    reply = "{\"type\":\"sub\",\"ok\":true,\"hz\":";
+    reply += sub.hz;
+    reply += ",\"names\":[";
+    reply += names;
+    reply += "],\"unknown\":[";
+    reply += unknown;
+    reply += "]}";
+}
+
+// ---------------------------------------------------------------------------
+// GET /spot-stats — polling vs push, ?reset=1 starts a new window
+// ---------------------------------------------------------------------------
+
+void SpotStream::handleStats(AsyncWebServerRequest* request) {
+    uint32_t ms = millis() - _sinceMs;
+    if (!ms) ms = 1;
+    uint32_t pollAir = (_spotBytes + _valueBytes) + (_spotPolls + _valuePolls) * SPOT_HTTP_OVERHEAD;
+    uint32_t wsAir   = _wsBytes + _wsMsgs * SPOT_WS_OVERHEAD;
+
+    char buf[320 + SPOT_WS_MAX_CLIENTS * 112];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.key("windowS"); w.valueUint(ms / 1000);
+    w.key("poll");
+    w.beginObject();
+    w.key("spot");       w.valueUint(_spotPolls);
+    w.key("spotBytes");  w.valueUint(_spotBytes);
+    w.key("value");      w.valueUint(_valuePolls);
+    w.key("valueBytes"); w.valueUint(_valueBytes);
+    w.key("perS10");     w.valueUint((uint32_t)((uint64_t)(_spotPolls + _valuePolls) * 10000 / ms));
+    w.key("airBytes");   w.valueUint(pollAir);
+    w.key("airBps");     w.valueUint((uint32_t)((uint64_t)pollAir * 1000 / ms));
+    w.endObject();
+    w.key("ws");
+    w.beginObject();
+    w.key("msgs");     w.valueUint(_wsMsgs);
+    w.key("bytes");    w.valueUint(_wsBytes);
+    w.key("values");   w.valueUint(_wsValues);
+    w.key("perS10");   w.valueUint((uint32_t)((uint64_t)_wsMsgs * 10000 / ms));
+    w.key("airBytes"); w.valueUint(wsAir);
+    w.key("airBps");   w.valueUint((uint32_t)((uint64_t)wsAir * 1000 / ms));
+    w.endObject();
+
+    w.key("clients");
+    w.beginArray();
+    for (uint8_t i = 0; i < SPOT_WS_MAX_CLIENTS; i++) {
+        const Client& c = _clients[i];
+        if (!c.id) continue;
+        const Subscription* s = c.sub;
+        w.beginObject();
+        w.key("id");      w.valueUint(c.id);
+        w.key("params");  w.valueUint(s ? s->count : 0);
+        w.key("hz");      w.valueUint(s ? 1000u / s->periodMs : 0);
+        w.key("msgs");    w.valueUint(c.msgs);
+        w.key("bytes");   w.valueUint(c.bytes);
+        w.key("values");  w.valueUint(c.values);
+        w.key("skipped"); w.valueUint(c.skipped);
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+
+    if (request->hasParam("reset")) {
+        _spotPolls = _spotBytes = _valuePolls = _valueBytes = 0;
+        _wsMsgs = _wsBytes = _wsValues = 0;
+        _sinceMs = millis();
+    }
+    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", w.c_str());
+    resp->addHeader("Access-Control-Allow-Origin", "*");
+    request->send(resp);
+}
+
+// ---------------------------------------------------------------------------
+// SpotBody — item 0 opens the object, then one item per value, the "_stale"
+// key, one item per stale name and the closing fields
+// ---------------------------------------------------------------------------
+
+SpotBody::SpotBody(const CANParameter* params, uint32_t since, const char* token, bool full)
+    : _params(params), _since(since), _full(full) {
+    strlcpy(_token, token, sizeof(_token));
+}
+
+bool SpotBody::item(JsonWriter& w, uint32_t n) {
+    if (msgpack) return itemMsgPack(w, n);
+    if (n == 0) {
+        w.beginObject();
+        return true;
+    }
+    n--;
+    if (n < count) {
+        const CANParameter& p = _params[n];
+        if (sent(n)) {
+            w.key(p.name, p.nameLen);
+            w.valueFixed(snap[n].valueInt, p.getDecimals());
+        }
+        return true;
+    }
+    n -= count;
+    if (n == 0) {
+        // Values that missed their expected updates — still listed above
+        // with their last value, flagged here so the UI can grey them out
+        w.key("_stale");
+        w.beginArray();
+        return true;
+    }
+    n--;
+    if (n < count) {
+        if (stale(n)) w.valueName(_params[n].name, _params[n].nameLen);
+        return true;
+    }
+    if (n == count) {
+        w.endArray();
+        w.key("_gen");
+        w.valueName(_token, strlen(_token));
+        if (_full) {
+            w.key("_full");
+            w.valueBool(true);
+        }
+        w.endObject();
+        return true;
+    }
+    return false;
+}
+
+// Same items and the same map, in MessagePack. Item 0 counts the entries
+// first — the map and the "_stale" array carry their sizes up front.
+bool SpotBody::itemMsgPack(JsonWriter& w, uint32_t n) {
+    uint8_t buf[JSON_ITEM_MAX];
+    MsgPackWriter m(buf, sizeof(buf));
+    if (n == 0) {
+        uint32_t entries = 2 + (_full ? 1 : 0);       // _stale, _gen, _full
+        for (uint16_t i = 0; i < count; i++) entries += sent(i);
+        m.map(entries);
+    } else if (--n < count) {
+        if (sent(n)) {
+            m.str(_params[n].name, _params[n].nameLen);
+            m.fixed(snap[n].valueInt, _params[n].getDecimals());
+        }
+    } else if ((n -= count) == 0) {
+        uint32_t names = 0;
+        for (uint16_t i = 0; i < count; i++) names += stale(i);
+        m.str("_stale");
+        m.array(names);
+    } else if (--n < count) {
+        if (stale(n)) m.str(_params[n].name, _params[n].nameLen);
+    } else if (n == count) {
+        m.str("_gen");
+        m.str(_token);
+        if (_full) {
+            m.str("_full");
+            m.boolean(true);
+        }
+    } else {
+        return false;
+    }
+    w.raw((const char*)buf, m.length());
+    return true;
+}
+
+void SpotBody::complete(uint32_t bytes) {
+    if (counted) SpotStream::getInstance().notePoll(SpotStream::Poll::SPOT, bytes);
+}
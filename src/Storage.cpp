@@ -0,0 +1,393 @@
+// ============================================================================
+// Storage.cpp
+// ============================================================================
+
+#include "Storage.h"
+#include "CANLogger.h"
+#include "MsgPack.h"
+#include <LittleFS.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static StorageBackend s_backend = StorageBackend::NONE;
+
+// ---------------------------------------------------------------------------
+// Mount
+// ---------------------------------------------------------------------------
+
+bool Storage::begin() {
+    if (s_backend != StorageBackend::NONE) return true;
+
+    Preferences prefs;
+    prefs.begin(STORAGE_NVS_NS, true);
+    bool migrating = prefs.getBool("migrating", false);
+    bool failed    = prefs.getBool("failed", false);
+    prefs.end();
+
+    if (LittleFS.begin(false, "/littlefs", FS_MAX_OPEN_FILES, STORAGE_PARTITION)) {
+        if (migrating) {
+            // Power was lost between the format and the end of the restore
+            Serial.println("[Storage] Migration was interrupted — files not carried over");
+            prefs.begin(STORAGE_NVS_NS, false);
+            prefs.putBool("migrating", false);
+            prefs.end();
+        }
+        s_backend = StorageBackend::LITTLEFS;
+        Serial.printf("[Storage] LittleFS, %u of %u bytes used\n",
+                      (unsigned)usedBytes(), (unsigned)totalBytes());
+        return true;
+    }
+
+    Stage stage = { nullptr, 0 };
+    if (SPIFFS.begin(false, "/spiffs", FS_MAX_OPEN_FILES, STORAGE_PARTITION)) {
+        if (failed) {
+            Serial.println("[Storage] SPIFFS — migration failed on an earlier boot, not retried");
+            s_backend = StorageBackend::SPIFFS;
+            return true;
+        }
+        Serial.println("[Storage] SPIFFS partition found, migrating to LittleFS");
+        FsBenchResult r;
+        if (runBench(SPIFFS, StorageBackend::SPIFFS, r)) {
+            prefs.begin(STORAGE_NVS_NS, false);
+            prefs.putBytes("spiffs", &r, sizeof(r));
+            prefs.end();
+        }
+        if (!stageFiles(SPIFFS, stage)) {
+            // No room for the config — carry on as before, and remember
+            // so the bench and the staging are not rerun every boot
+            Serial.println("[Storage] Staging failed, staying on SPIFFS");
+            prefs.begin(STORAGE_NVS_NS, false);
+            prefs.putBool("failed", true);
+            prefs.end();
+            s_backend = StorageBackend::SPIFFS;
+            return true;
+        }
+        prefs.begin(STORAGE_NVS_NS, false);
+        prefs.putBool("migrating", true);
+        prefs.end();
+        SPIFFS.end();
+    }
+
+    // Formats a blank or SPIFFS partition
+    if (!LittleFS.begin(true, "/littlefs", FS_MAX_OPEN_FILES, STORAGE_PARTITION)) {
+        Serial.println("[Storage] Mount failed");
+        heap_caps_free(stage.buf);
+        return false;
+    }
+    s_backend = StorageBackend::LITTLEFS;
+
+    if (stage.buf || migrating) {
+        if (stage.buf) restore(LittleFS, stage);
+        else Serial.println("[Storage] Migration was interrupted — files not carried over");
+        heap_caps_free(stage.buf);
+        prefs.begin(STORAGE_NVS_NS, false);
+        prefs.putBool("migrating", false);
+        prefs.end();
+    }
+    Serial.printf("[Storage] LittleFS, %u of %u bytes used\n",
+                  (unsigned)usedBytes(), (unsigned)totalBytes());
+    return true;
+}
+
+fs::FS& Storage::fs() {
+    if (s_backend == StorageBackend::SPIFFS) return SPIFFS;
+    return LittleFS;
+}
+
+StorageBackend Storage::backend() {
+    return s_backend;
+}
+
+const char* Storage::backendName(StorageBackend b) {
+    switch (b) {
+        case StorageBackend::LITTLEFS: return "littlefs";
+        case StorageBackend::SPIFFS:   return "spiffs";
+        default:                       return "none";
+    }
+}
+
+size_t Storage::totalBytes() {
+    if (s_backend == StorageBackend::LITTLEFS) return LittleFS.totalBytes();
+    if (s_backend == StorageBackend::SPIFFS)   return SPIFFS.totalBytes();
+    return 0;
+}
+
+size_t Storage::usedBytes() {
+    if (s_backend == StorageBackend::LITTLEFS) return LittleFS.usedBytes();
+    if (s_backend == StorageBackend::SPIFFS)   return SPIFFS.usedBytes();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Migration staging — the files held in RAM across the format
+// ---------------------------------------------------------------------------
+
+// Every file below `dir`, depth first. fn(path, file) returns false to stop.
+template <typename Fn>
+static bool walk(fs::FS& fs, const char* dir, Fn fn) {
+    File root = fs.open(dir);
+    if (!root || !root.isDirectory()) return true;
+    for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+        String path = f.path();
+        if (f.isDirectory()) {
+            f.close();
+            if (!walk(fs, path.c_str(), fn)) return false;
+        } else if (!fn(path, f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// What the migration carries over. CAN logs, flight-recorder captures,
+// benchmark leftovers and /params.msgpack are regenerated and never
+// staged; params.json, the logo and other .json config go first and must
+// all fit; anything else (/edit uploads) fills what room is left.
+enum StageRank : uint8_t { STAGE_ESSENTIAL, STAGE_OPTIONAL, STAGE_SKIP };
+
+static StageRank stageRank(const String& path) {
+    if (path == CANLOG_PATH || path == PARAMS_MSGPACK_PATH ||
+        (path.startsWith("/cap") && path.endsWith(".bin")) ||
+        path.startsWith("/canbench") || path.startsWith("/fsb_") ||
+        path.endsWith(".tmp")) {
+        return STAGE_SKIP;
+    }
+    if (path == "/params.json" || path == "/logo.bin" || path.endsWith(".json"))
+        return STAGE_ESSENTIAL;
+    return STAGE_OPTIONAL;
+}
+
+// Entries are u16 name length, name, u32 size, data — back to back
+bool Storage::stageFiles(fs::FS& from, Stage& out) {
+    // PSRAM when there is any, else internal RAM; either way one block
+    uint32_t caps  = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    size_t   limit = heap_caps_get_largest_free_block(caps);
+    if (!limit) {
+        caps  = MALLOC_CAP_8BIT;
+        limit = heap_caps_get_largest_free_block(caps) / 2;   // leave the rest running
+    }
+    if (limit > STORAGE_STAGE_MAX) limit = STORAGE_STAGE_MAX;
+
+    // Size everything first. Essentials that do not fit fail the
+    // migration; the partition then stays on SPIFFS.
+    uint32_t need = 0, skipped = 0;
+    bool fits = true;
+    for (uint8_t rank = STAGE_ESSENTIAL; rank < STAGE_SKIP; rank++) {
+        walk(from, "/", [&](const String& path, File& f) -> bool {
+            StageRank r = stageRank(path);
+            if (r == STAGE_SKIP) {
+                if (rank == STAGE_ESSENTIAL) skipped++;
+                return true;
+            }
+            if (r != rank) return true;
+            uint32_t entry = 2 + path.length() + 4 + f.size();
+            if (need + entry <= limit) need += entry;
+            else if (r == STAGE_ESSENTIAL) fits = false;
+            return true;
+        });
+    }
+    if (!fits) {
+        Serial.printf("[Storage] Config files do not fit %u bytes of RAM, not migrating\n",
+                      (unsigned)limit);
+        return false;
+    }
+    if (skipped)
+        Serial.printf("[Storage] %u logs and captures are not carried over\n", skipped);
+
+    out.buf = need ? (uint8_t*)heap_caps_malloc(need, caps) : nullptr;
+    out.len = 0;
+    if (need && !out.buf) return false;
+
+    for (uint8_t rank = STAGE_ESSENTIAL; rank < STAGE_SKIP; rank++) {
+        bool ok = walk(from, "/", [&](const String& path, File& f) -> bool {
+            if (stageRank(path) != rank) return true;
+            uint16_t nameLen = path.length();
+            uint32_t size    = f.size();
+            if (out.len + 2 + nameLen + 4 + size > need) {
+                Serial.printf("[Storage] No room to migrate %s (%u bytes), dropped\n",
+                              path.c_str(), size);
+                return true;
+            }
+            uint8_t* p = out.buf + out.len;
+            memcpy(p, &nameLen, 2);
+            memcpy(p + 2, path.c_str(), nameLen);
+            memcpy(p + 2 + nameLen, &size, 4);
+            p += 2 + nameLen + 4;
+            for (uint32_t done = 0; done < size; ) {
+                size_t n = f.read(p + done, size - done);
+                if (!n) return false;
+                done += n;
+            }
+            out.len += 2 + nameLen + 4 + size;
+            return true;
+        });
+        if (!ok) {
+            heap_caps_free(out.buf);
+            out.buf = nullptr;
+            return false;
+        }
+    }
+    Serial.printf("[Storage] Staged %u bytes in %s\n", (unsigned)out.len,
+                  (caps & MALLOC_CAP_SPIRAM) ? "PSRAM" : "RAM");
+    return true;
+}
+
+bool Storage::restore(fs::FS& to, const Stage& stage) {
+    const uint8_t* p   = stage.buf;
+    const uint8_t* end = stage.buf + stage.len;
+    uint32_t count = 0, restored = 0;
+    while (p + 6 <= end) {
+        uint16_t nameLen;
+        uint32_t size;
+        char     name[256];
+        memcpy(&nameLen, p, 2);
+        if (nameLen >= sizeof(name) || p + 2 + nameLen + 4 > end) break;
+        memcpy(name, p + 2, nameLen);
+        name[nameLen] = '\0';
+        memcpy(&size, p + 2 + nameLen, 4);
+        p += 2 + nameLen + 4;
+        if (p + size > end) break;
+        count++;
+
+        File f = to.open(name, FILE_WRITE, true);
+        size_t done = f ? f.write(p, size) : 0;
+        if (f) f.close();
+        if (f && done == size) {
+            restored++;
+        } else {
+            Serial.printf("[Storage] Could not restore %s (%u of %u bytes)\n",
+                          name, (unsigned)done, size);
+            to.remove(name);
+        }
+        p += size;
+    }
+    Serial.printf("[Storage] Restored %u of %u files\n", restored, count);
+    return restored == count;
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark suite
+// ---------------------------------------------------------------------------
+
+static void benchPath(char* out, size_t cap, unsigned n) {
+    snprintf(out, cap, "/fsb_%u", n);
+}
+
+uint16_t Storage::countFiles(fs::FS& fs) {
+    uint16_t n = 0;
+    walk(fs, "/", [&](const String&, File&) -> bool { n++; return true; });
+    return n;
+}
+
+bool Storage::bench(FsBenchResult& out) {
+    if (s_backend == StorageBackend::NONE) return false;
+    return runBench(fs(), s_backend, out);
+}
+
+bool Storage::runBench(fs::FS& fs, StorageBackend b, FsBenchResult& out) {
+    memset(&out, 0, sizeof(out));
+    out.backend = (uint8_t)b;
+    out.files   = countFiles(fs);
+
+    char path[16];
+    uint8_t buf[FS_BENCH_CHUNK];
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)i;
+
+    for (unsigned i = 0; i < FS_BENCH_FILES; i++) {
+        benchPath(path, sizeof(path), i);
+        File f = fs.open(path, FILE_WRITE);
+        if (!f) return false;
+        f.write(buf, FS_BENCH_RECORD);
+        f.close();
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    for (unsigned i = 0; i < FS_BENCH_LOOKUPS; i++) {
+        benchPath(path, sizeof(path), i % FS_BENCH_FILES);
+        File f = fs.open(path, FILE_READ);
+        f.close();
+    }
+    int64_t t1 = esp_timer_get_time();
+    for (unsigned i = 0; i < FS_BENCH_LOOKUPS; i++) {
+        benchPath(path, sizeof(path), i % FS_BENCH_FILES);
+        fs.exists(path);
+    }
+    int64_t t2 = esp_timer_get_time();
+    for (unsigned i = 0; i < FS_BENCH_LOOKUPS; i++) {
+        benchPath(path, sizeof(path), FS_BENCH_FILES + i);
+        fs.exists(path);
+    }
+    int64_t t3 = esp_timer_get_time();
+    out.openUs       = (t1 - t0) / FS_BENCH_LOOKUPS;
+    out.existsHitUs  = (t2 - t1) / FS_BENCH_LOOKUPS;
+    out.existsMissUs = (t3 - t2) / FS_BENCH_LOOKUPS;
+
+    // Append: a log record at a time, reopened each time as the loggers do
+    benchPath(path, sizeof(path), 0);
+    t0 = esp_timer_get_time();
+    for (unsigned i = 0; i < FS_BENCH_APPENDS; i++) {
+        File f = fs.open(path, FILE_APPEND);
+        f.write(buf, FS_BENCH_RECORD);
+        f.close();
+    }
+    out.appendUs = (esp_timer_get_time() - t0) / FS_BENCH_APPENDS;
+
+    for (unsigned i = 0; i < FS_BENCH_FILES; i++) {
+        benchPath(path, sizeof(path), i);
+        fs.remove(path);
+    }
+
+    // Sequential
+    benchPath(path, sizeof(path), 0);
+    bool ok = true;
+    t0 = esp_timer_get_time();
+    File f = fs.open(path, FILE_WRITE);
+    for (uint32_t done = 0; f && done < FS_BENCH_BYTES; done += sizeof(buf)) {
+        if (f.write(buf, sizeof(buf)) != sizeof(buf)) { ok = false; break; }
+    }
+    if (f) f.close(); else ok = false;
+    t1 = esp_timer_get_time();
+
+    f = fs.open(path, FILE_READ);
+    uint32_t got = 0;
+    while (f) {
+        size_t n = f.read(buf, sizeof(buf));
+        if (!n) break;
+        got += n;
+    }
+    if (f) f.close();
+    t2 = esp_timer_get_time();
+    fs.remove(path);
+
+    if (!ok || got != FS_BENCH_BYTES) {
+        Serial.printf("[Storage] Bench on %s failed (no room?)\n", backendName(b));
+        return false;
+    }
+    // bytes/us * 1e6 / 1024 = KB/s
+    out.writeKBps = (uint64_t)FS_BENCH_BYTES * 1000000ULL / 1024 / (uint64_t)(t1 - t0 + 1);
+    out.readKBps  = (uint64_t)FS_BENCH_BYTES * 1000000ULL / 1024 / (uint64_t)(t2 - t1 + 1);
+    out.valid = true;
+    return true;
+}
+
+FsBenchResult Storage::migrationBench() {
+    FsBenchResult r;
+    memset(&r, 0, sizeof(r));
+    Preferences prefs;
+    prefs.begin(STORAGE_NVS_NS, true);
+    if (prefs.getBytes("spiffs", &r, sizeof(r)) != sizeof(r)) r.valid = false;
+    prefs.end();
+    return r;
+}
+
+void Storage::benchJson(String& json, const FsBenchResult& r) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"backend\":\"%s\",\"files\":%u,\"open_us\":%u,\"exists_hit_us\":%u,"
+             "\"exists_miss_us\":%u,\"append_us\":%u,\"write_kbps\":%u,\"read_kbps\":%u}",
+             backendName((StorageBackend)r.backend), r.files, r.openUs, r.existsHitUs,
+             r.existsMissUs, r.appendUs, r.writeKBps, r.readKBps);
+    json += buf;
+}
@@ -0,0 +1,310 @@
+// ============================================================================
+// StreamExport.cpp
+// ============================================================================
+
+#include "StreamExport.h"
+#include <ESPAsyncWebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <memory>
+
+// ---------------------------------------------------------------------------
+// Size cache — totals of rendered exports, keyed by (key, format, version).
+// Written by async_tcp and the sizing task, hence the spinlock.
+// ---------------------------------------------------------------------------
+
+struct SizeEntry {
+    char     key[EXPORT_KEY_LEN];
+    uint8_t  format;
+    bool     used;
+    bool     ready;         // false = being sized
+    uint32_t version;
+    uint32_t length;
+    uint32_t touchedMs;     // least recently touched entry is replaced
+};
+
+struct SizeJob {
+    ExportOpen open;
+    char       key[EXPORT_KEY_LEN];
+    uint8_t    format;
+    uint32_t   version;
+};
+
+static SizeEntry     s_sizes[EXPORT_SIZE_CACHE];
+static portMUX_TYPE  s_sizeMux = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t s_sizeQ = nullptr;
+static uint32_t      s_bootSalt = 0;
+
+// Entry for (key, format) — any version — or the slot to reuse for it
+static SizeEntry* sizeSlot(const char* key, uint8_t format) {
+    SizeEntry* victim = &s_sizes[0];
+    for (uint8_t i = 0; i < EXPORT_SIZE_CACHE; i++) {
+        SizeEntry& e = s_sizes[i];
+        if (e.used && e.format == format && strcmp(e.key, key) == 0) return &e;
+        if (!e.used) { if (victim->used) victim = &e; }
+        else if (victim->used && (int32_t)(e.touchedMs - victim->touchedMs) < 0) victim = &e;
+    }
+    return victim;
+}
+
+bool StreamExport::cachedLength(const char* key, uint8_t format, uint32_t version, uint32_t& len) {
+    bool hit = false;
+    portENTER_CRITICAL(&s_sizeMux);
+    SizeEntry* e = sizeSlot(key, format);
+    if (e->used && e->ready && e->version == version && e->format == format &&
+        strcmp(e->key, key) == 0) {
+        len = e->length;
+        e->touchedMs = millis();
+        hit = true;
+    }
+    portEXIT_CRITICAL(&s_sizeMux);
+    return hit;
+}
+
+void StreamExport::storeLength(const char* key, uint8_t format, uint32_t version, uint32_t len) {
+    portENTER_CRITICAL(&s_sizeMux);
+    SizeEntry* e = sizeSlot(key, format);
+    strlcpy(e->key, key, sizeof(e->key));
+    e->format    = format;
+    e->version   = version;
+    e->length    = len;
+    e->used      = true;
+    e->ready     = true;
+    e->touchedMs = millis();
+    portEXIT_CRITICAL(&s_sizeMux);
+}
+
+// Queue a sizing pass unless this version is already sized or being sized
+void StreamExport::requestSizing(const ExportSpec& spec) {
+    if (strlen(spec.key) >= EXPORT_KEY_LEN) return;
+
+    bool queue = false;
+    portENTER_CRITICAL(&s_sizeMux);
+    SizeEntry* e = sizeSlot(spec.key, spec.format);
+    if (!(e->used && e->version == spec.version && e->format == spec.format &&
+          strcmp(e->key, spec.key) == 0)) {
+        strlcpy(e->key, spec.key, sizeof(e->key));
+        e->format    = spec.format;
+        e->version   = spec.version;
+        e->used      = true;
+        e->ready     = false;
+        e->touchedMs = millis();
+        queue = true;
+    }
+    portEXIT_CRITICAL(&s_sizeMux);
+    if (!queue) return;
+
+    if (!s_sizeQ) {
+        s_sizeQ = xQueueCreate(4, sizeof(SizeJob));
+        // Low priority on core 0 — it only competes with idle time
+        xTaskCreatePinnedToCore(sizerEntry, "ExpSize", 6144, nullptr, 1, nullptr, 0);
+    }
+    SizeJob job;
+    job.open    = spec.open;
+    job.format  = spec.format;
+    job.version = spec.version;
+    strlcpy(job.key, spec.key, sizeof(job.key));
+    if (xQueueSend(s_sizeQ, &job, 0) != pdTRUE) {
+        // Queue full — forget the placeholder so a later download retries
+        portENTER_CRITICAL(&s_sizeMux);
+        e->used = false;
+        portEXIT_CRITICAL(&s_sizeMux);
+    }
+}
+
+// Render each queued export once, counting bytes only
+void StreamExport::sizerEntry(void*) {
+    uint8_t scratch[EXPORT_PIECE_MAX];
+    SizeJob job;
+    for (;;) {
+        if (xQueueReceive(s_sizeQ, &job, portMAX_DELAY) != pdTRUE) continue;
+        std::unique_ptr<ExportSource> src(job.open(job.key, job.format));
+        if (!src) continue;
+        uint32_t total = 0;
+        uint32_t pieces = 0;
+        size_t n;
+        while ((n = src->next(scratch, sizeof(scratch))) > 0) {
+            total += n;
+            if (++pieces % 64 == 0) vTaskDelay(1);   // leave the core to WiFi
+        }
+        storeLength(job.key, job.format, job.version, total);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Sources
+// ---------------------------------------------------------------------------
+
+size_t FileExportSource::next(uint8_t* out, size_t cap) {
+    return file ? file.read(out, cap) : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Response body — one cursor per request, shared by every response kind
+// ---------------------------------------------------------------------------
+
+struct ExportCursor {
+    std::unique_ptr<ExportSource> src;
+    uint8_t  piece[EXPORT_PIECE_MAX];
+    size_t   pieceLen = 0;
+    size_t   piecePos = 0;
+    uint32_t skip = 0;          // Range start still to discard
+    uint32_t remaining = 0;     // bytes owed by a fixed-length response
+    uint32_t produced = 0;      // chunked: bytes so far, cached at the end
+    bool     fixedLen = false;
+    bool     ended = false;
+    bool     stored = false;
+    char     key[EXPORT_KEY_LEN];
+    uint8_t  format = 0;
+    uint32_t version = 0;
+};
+
+// Next piece into the cursor; false once the source is exhausted
+static bool nextPiece(ExportCursor& c) {
+    c.piecePos = 0;
+    c.pieceLen = c.ended ? 0 : c.src->next(c.piece, sizeof(c.piece));
+    if (!c.pieceLen) c.ended = true;
+    return c.pieceLen > 0;
+}
+
+size_t StreamExport::fill(ExportCursor& c, uint8_t* buf, size_t maxLen) {
+    // Resuming without seek — render and drop a bounded amount per call
+    if (c.skip) {
+        size_t budget = EXPORT_SKIP_BUDGET;
+        while (c.skip && budget) {
+            if (c.piecePos == c.pieceLen && !nextPiece(c)) { c.skip = 0; break; }
+            size_t n = c.pieceLen - c.piecePos;
+            if (n > c.skip) n = c.skip;
+            if (n > budget) n = budget;
+            c.piecePos += n;
+            c.skip     -= n;
+            budget     -= n;
+        }
+        if (c.skip) return RESPONSE_TRY_AGAIN;
+    }
+
+    size_t used = 0;
+    while (used < maxLen && !(c.fixedLen && !c.remaining)) {
+        if (c.piecePos == c.pieceLen && !nextPiece(c)) {
+            if (!c.fixedLen) {
+                // A complete chunked body is its own sizing pass
+                if (!c.stored) storeLength(c.key, c.format, c.version, c.produced);
+                c.stored = true;
+                break;
+            }
+            // Shorter than when it was sized (the log changed underneath) —
+            // pad so the promised Content-Length still arrives
+            size_t n = maxLen - used;
+            if (n > c.remaining) n = c.remaining;
+            memset(buf + used, '\n', n);
+            used        += n;
+            c.remaining -= n;
+            break;
+        }
+        size_t n = c.pieceLen - c.piecePos;
+        if (n > maxLen - used) n = maxLen - used;
+        if (c.fixedLen && n > c.remaining) n = c.remaining;
+        memcpy(buf + used, c.piece + c.piecePos, n);
+        c.piecePos += n;
+        used       += n;
+        c.produced += n;
+        if (c.fixedLen) c.remaining -= n;
+    }
+    return used;
+}
+
+// ---------------------------------------------------------------------------
+// send
+// ---------------------------------------------------------------------------
+
+void StreamExport::send(AsyncWebServerRequest* request, const ExportSpec& spec) {
+    std::shared_ptr<ExportCursor> cur(new ExportCursor());
+    cur->src.reset(spec.open(spec.key, spec.format));
+    if (!cur->src) {
+        request->send(404, "text/plain", "Nothing to export");
+        return;
+    }
+    strlcpy(cur->key, spec.key, sizeof(cur->key));
+    cur->format  = spec.format;
+    cur->version = spec.version;
+
+    if (!s_bootSalt) s_bootSalt = esp_random() | 1;
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%08x-%08x-%u\"",
+             (unsigned)s_bootSalt, (unsigned)spec.version, spec.format);
+
+    uint32_t total = spec.size;
+    bool known = total != EXPORT_SIZE_UNKNOWN ||
+                 cachedLength(spec.key, spec.format, spec.version, total);
+    if (known && !total) known = false;   // empty — nothing to resume
+
+    // One "bytes=N-" or "bytes=N-M" range, only against the current ETag.
+    // Suffix and multi-range requests get the whole body.
+    uint32_t from = 0;
+    uint32_t to   = known ? total - 1 : 0;
+    bool ranged   = false;
+    const AsyncWebHeader* range   = request->getHeader("Range");
+    const AsyncWebHeader* ifRange = request->getHeader("If-Range");
+    if (known && range && (!ifRange || ifRange->value() == etag)) {
+        const char* v = range->value().c_str();
+        if (strncmp(v, "bytes=", 6) == 0 && isdigit((unsigned char)v[6])) {
+            char* end;
+            uint32_t first = strtoul(v + 6, &end, 10);
+            uint32_t last  = to;
+            if (*end == '-') {
+                end++;
+                if (isdigit((unsigned char)*end)) last = strtoul(end, &end, 10);
+                if (*end == '\0') {
+                    if (first > last || first >= total) {
+                        AsyncWebServerResponse* resp = request->beginResponse(416, "text/plain",
+                            "Range not satisfiable");
+                        char cr[32];
+                        snprintf(cr, sizeof(cr), "bytes */%u", (unsigned)total);
+                        resp->addHeader("Content-Range", cr);
+                        request->send(resp);
+                        return;
+                    }
+                    ranged = true;
+                    from   = first;
+                    to     = last < to ? last : to;
+                }
+            }
+        }
+    }
+
+    AsyncWebServerResponse* resp;
+    if (known) {
+        if (from && !cur->src->seek(from)) cur->skip = from;
+        cur->fixedLen  = true;
+        cur->remaining = to - from + 1;
+        resp = request->beginResponse(spec.mime, cur->remaining,
+            [cur](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+                return StreamExport::fill(*cur, buf, maxLen);
+            });
+        if (ranged) {
+            resp->setCode(206);
+            char cr[48];
+            snprintf(cr, sizeof(cr), "bytes %u-%u/%u",
+                     (unsigned)from, (unsigned)to, (unsigned)total);
+            resp->addHeader("Content-Range", cr);
+        }
+    } else {
+        resp = request->beginChunkedResponse(spec.mime,
+            [cur](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+                return StreamExport::fill(*cur, buf, maxLen);
+            });
+        requestSizing(spec);
+    }
+
+    resp->addHeader("Accept-Ranges", "bytes");
+    resp->addHeader("ETag", etag);
+    resp->addHeader("Cache-Control", "no-cache");
+    resp->addHeader("Access-Control-Allow-Origin", "*");
+    if (spec.vary) resp->addHeader("Vary", "Accept");
+    if (spec.fileName) {
+        char disp[64];
+        snprintf(disp, sizeof(disp), "attachment; filename=\"%s\"", spec.fileName);
+        resp->addHeader("Content-Disposition", disp);
+    }
+    request->send(resp);
+}
@@ -0,0 +1,70 @@
+// ============================================================================
+// TimerWheel.cpp
+// ============================================================================
+
+#include "TimerWheel.h"
+
+void TimerWheel::reset(uint32_t nowTick) {
+    _tick = nowTick;
+    for (int l = 0; l < 2; l++)
+        for (int s = 0; s < TW_SLOTS; s++) _head[l][s] = TW_NIL;
+    for (int i = 0; i < TW_MAX_ENTRIES; i++) {
+        _next[i] = _prev[i] = TW_NIL;
+        _level[i] = 0xFF;
+    }
+}
+
+void TimerWheel::schedule(uint16_t idx, uint32_t deadline) {
+    if (idx >= TW_MAX_ENTRIES) return;
+    if (_level[idx] != 0xFF) unlink(idx);
+
+    int32_t delta = (int32_t)(deadline - _tick);
+    if (delta < 1) { delta = 1; deadline = _tick + 1; }
+    _deadline[idx] = deadline;
+
+    if (delta < TW_SLOTS) {
+        link(idx, 0, deadline % TW_SLOTS);
+    } else {
+        // Clamp to the wheel span; the owner re-arms when it fires early
+        if (delta >= TW_SLOTS * TW_SLOTS) deadline = _tick + TW_SLOTS * TW_SLOTS - 1;
+        _deadline[idx] = deadline;
+        link(idx, 1, (deadline / TW_SLOTS) % TW_SLOTS);
+    }
+}
+
+void TimerWheel::cancel(uint16_t idx) {
+    if (idx < TW_MAX_ENTRIES && _level[idx] != 0xFF) unlink(idx);
+}
+
+void TimerWheel::link(uint16_t idx, uint8_t level, uint8_t slot) {
+    _level[idx] = level;
+    _slot[idx]  = slot;
+    _prev[idx]  = TW_NIL;
+    _next[idx]  = _head[level][slot];
+    if (_next[idx] != TW_NIL) _prev[_next[idx]] = idx;
+    _head[level][slot] = idx;
+}
+
+void TimerWheel::unlink(uint16_t idx) {
+    uint8_t level = _level[idx], slot = _slot[idx];
+    if (_prev[idx] != TW_NIL) _next[_prev[idx]] = _next[idx];
+    else                      _head[level][slot] = _next[idx];
+    if (_next[idx] != TW_NIL) _prev[_next[idx]] = _prev[idx];
+    _next[idx] = _prev[idx] = TW_NIL;
+    _level[idx] = 0xFF;
+}
+
+// Move every level-1 entry of this slot down to its exact level-0 slot
+void TimerWheel::cascade(uint8_t slot1) {
+    uint16_t idx = _head[1][slot1];
+    _head[1][slot1] = TW_NIL;
+    while (idx != TW_NIL) {
+        uint16_t nxt = _next[idx];
+        _level[idx] = 0xFF;
+        _next[idx] = _prev[idx] = TW_NIL;
+        // Due exactly now: put it in the slot advance() is about to drain
+        if ((int32_t)(_deadline[idx] - _tick) <= 0) link(idx, 0, _tick % TW_SLOTS);
+        else                                        schedule(idx, _deadline[idx]);
+        idx = nxt;
+    }
+}
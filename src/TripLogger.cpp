@@ -3,6 +3,8 @@
 // ============================================================================
 
 #include "TripLogger.h"
+#include "FixedPoint.h"
+#include "MsgPack.h"
 
 // ---------------------------------------------------------------------------
 // begin() — call once in setup() after Serial is ready
@@ -43,6 +45,7 @@ void TripLogger::update(int speed_rpm, int udc_dv, int idc_da,
     e.tmpm    = (int8_t) constrain(tmpm_c,      -128,   127);
     e.potnorm = (int16_t)constrain(potnorm,        0,  1000);
 
+    _version++;
     if (_count < TRIPLOG_MAX_ENTRIES) {
         // Buffer not yet full — write to next sequential slot
         writeSlot(_count, e);
@@ -62,30 +65,77 @@ void TripLogger::update(int speed_rpm, int udc_dv, int idc_da,
 }
 
 // ---------------------------------------------------------------------------
-// getCSV() — returns all entries in chronological order (oldest first)
+// Export — rows are read from NVS one at a time as the response drains,
+// oldest first
 // ---------------------------------------------------------------------------
-String TripLogger::getCSV() {
-    String csv = "row,time_s,speed_rpm,voltage_V,current_A,power_kW,SOC_pct,heatsink_C,motor_C,throttle_pct\n";
-
-    if (_count == 0) return csv;
-
-    TripEntry e;
-    int rows = 0;
-
-    if (_count < TRIPLOG_MAX_ENTRIES) {
-        // Buffer not yet full — entries are in slots 0.._count-1, already ordered
-        for (int i = 0; i < _count; i++) {
-            if (readSlot(i, e)) csv += entryToCSVRow(e, ++rows);
+class TripCSVSource : public ExportSource {
+public:
+    // Rows logged meanwhile wait for the next download
+    TripCSVSource() : _win(TripLogger::getInstance().window()) {}
+
+    size_t next(uint8_t* out, size_t cap) override {
+        TripLogger& log = TripLogger::getInstance();
+        char* text = (char*)out;
+        if (!_headerDone) {
+            _headerDone = true;
+            return log.csvHeader(text, cap);
         }
-    } else {
-        // Buffer full — start at _startIdx (oldest), wrap around
-        for (int i = 0; i < TRIPLOG_MAX_ENTRIES; i++) {
-            int slot = (_startIdx + i) % TRIPLOG_MAX_ENTRIES;
-            if (readSlot(slot, e)) csv += entryToCSVRow(e, ++rows);
+        TripEntry e;
+        while (_next < _win.count) {
+            if (log.entryAt(_win, _next++, e)) return log.csvRow(e, ++_rows, text, cap);
         }
+        return 0;
     }
+private:
+    TripLogger::Window _win;
+    bool _headerDone = false;
+    int  _next = 0;
+    int  _rows = 0;
+};
+
+// MessagePack — the array header with the row count instead of the CSV
+// header line. A row that cannot be read is a nil, so the count still holds.
+class TripMsgPackSource : public ExportSource {
+public:
+    TripMsgPackSource() : _win(TripLogger::getInstance().window()) {}
+
+    size_t next(uint8_t* out, size_t cap) override {
+        TripLogger& log = TripLogger::getInstance();
+        if (!_started) {
+            _started = true;
+            MsgPackWriter m(out, cap);
+            m.array(_win.count);
+            return m.length();
+        }
+        if (_next >= _win.count) return 0;
+        TripEntry e;
+        _next++;
+        if (log.entryAt(_win, _next - 1, e)) return log.msgpackRow(e, _next, out, cap);
+        MsgPackWriter m(out, cap);
+        m.nil();
+        return m.length();
+    }
+private:
+    TripLogger::Window _win;
+    bool _started = false;
+    int  _next = 0;
+};
+
+ExportSource* TripLogger::openExport(const char*, uint8_t format) {
+    if (format == (uint8_t)TripExport::MSGPACK) return new TripMsgPackSource();
+    return new TripCSVSource();
+}
 
-    return csv;
+bool TripLogger::entryAt(const Window& w, int n, TripEntry& e) const {
+    if (n < 0 || n >= w.count) return false;
+    // Every write since the window bumped _version; once the free slots
+    // are used up, each one replaced the window's oldest remaining row
+    int overwritten = (int)(_version - w.version) - (TRIPLOG_MAX_ENTRIES - w.count);
+    if (n < overwritten) return false;
+    // Not yet full: slots 0..count-1 are already in order. Full: the
+    // oldest is at startIdx and the ring wraps.
+    int slot = w.count < TRIPLOG_MAX_ENTRIES ? n : (w.startIdx + n) % TRIPLOG_MAX_ENTRIES;
+    return readSlot(slot, e);
 }
 
 // ---------------------------------------------------------------------------
@@ -101,6 +151,7 @@ void TripLogger::clear() {
     }
     _count    = 0;
     _startIdx = 0;
+    _version++;
     _prefs.putInt("count", 0);
     _prefs.putInt("start", 0);
     Serial.println("[TRIPLOG] Log cleared");
@@ -125,20 +176,42 @@ bool TripLogger::readSlot(int slot, TripEntry& e) const {
     return len == sizeof(TripEntry);
 }
 
-String TripLogger::entryToCSVRow(const TripEntry& e, int rowNum) const {
-    char buf[140];
-    snprintf(buf, sizeof(buf),
-        "%d,%.1f,%d,%.1f,%.1f,%.2f,%d,%d,%d,%.1f\n",
-        rowNum,
-        e.timestamp_ms / 1000.0f,
-        (int)e.speed,
-        e.udc     / 10.0f,
-        e.idc     / 10.0f,
-        e.pwr     / 100.0f,
-        (int)e.SOC,
-        (int)e.tmphs,
-        (int)e.tmpm,
-        e.potnorm / 10.0f
-    );
-    return String(buf);
+size_t TripLogger::csvHeader(char* out, size_t cap) const {
+    return strlcpy(out,
+        "row,time_s,speed_rpm,voltage_V,current_A,power_kW,SOC_pct,heatsink_C,motor_C,throttle_pct\n",
+        cap);
+}
+
+size_t TripLogger::csvRow(const TripEntry& e, int rowNum, char* out, size_t cap) const {
+    // Stored fields are already fixed-point (dV, dA, 10 W, ‰) — render them
+    // with FixedPoint instead of float printf
+    char t[16], u[16], i[16], w[16], pot[16];
+    FixedPoint::format(t,   sizeof(t),   FixedPoint::fromRatio(e.timestamp_ms, 100, 0), 1);
+    FixedPoint::format(u,   sizeof(u),   e.udc,     1);
+    FixedPoint::format(i,   sizeof(i),   e.idc,     1);
+    FixedPoint::format(w,   sizeof(w),   e.pwr,     2);
+    FixedPoint::format(pot, sizeof(pot), e.potnorm, 1);
+
+    int len = snprintf(out, cap,
+        "%d,%s,%d,%s,%s,%s,%d,%d,%d,%s\n",
+        rowNum, t, (int)e.speed, u, i, w,
+        (int)e.SOC, (int)e.tmphs, (int)e.tmpm, pot);
+    return len < 0 ? 0 : ((size_t)len >= cap ? cap - 1 : (size_t)len);
+}
+
+// One row as an array, the CSV's columns in the same units
+size_t TripLogger::msgpackRow(const TripEntry& e, int rowNum, uint8_t* out, size_t cap) const {
+    MsgPackWriter m(out, cap);
+    m.array(10);
+    m.sint(rowNum);
+    m.fixed(FixedPoint::fromRatio(e.timestamp_ms, 100, 0), 1);
+    m.sint(e.speed);
+    m.fixed(e.udc, 1);
+    m.fixed(e.idc, 1);
+    m.fixed(e.pwr, 2);
+    m.uint(e.SOC);
+    m.sint(e.tmphs);
+    m.sint(e.tmpm);
+    m.fixed(e.potnorm, 1);
+    return m.length();
 }
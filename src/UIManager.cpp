@@ -2,9 +2,10 @@
 #include "Immobilizer.h"
 #include "HealthChecker.h"
 #include "EfficiencyTracker.h"
-#include <SPIFFS.h>
+#include "Storage.h"
 #include <esp_heap_caps.h>
 #include "FaultLogger.h"
+#include "FixedPoint.h"
 #include <M5GFX.h>
 
 // Static instance for callbacks
@@ -12,7 +13,8 @@ UIManager* UIManager::instance = nullptr;
 
 UIManager::UIManager() 
     : canManager(nullptr), immobilizer(nullptr), currentScreen(SCREEN_SPLASH), 
-      lastUpdateTime(0), buf1(nullptr), buf2(nullptr), editMode(false), lockPinPadVisible(false),
+      lastUpdateTime(0), buf1(nullptr), buf2(nullptr), editMode(false), liveDataDirty(true),
+      lockPinPadVisible(false),
       settings_selected_item(0), settingsArrivalTime(0) {
     strncpy(dialFWVersion, "---", sizeof(dialFWVersion));
     strncpy(uiFWVersion,   "---", sizeof(uiFWVersion));
@@ -83,6 +85,20 @@ bool UIManager::init(CANDataManager* canMgr, Immobilizer* immob) {
     createHealthCheckScreen();
     
     setScreen(SCREEN_SPLASH);
+
+    // Live-data screens only redraw when a displayed parameter changes.
+    // Watches bind by name, so this works before params are loaded.
+    if (canManager) {
+        int8_t sub = canManager->subscribe([this](const ParamChange*, uint8_t) {
+            liveDataDirty = true;
+        });
+        static const char* const watched[] = {
+            "speed", "udc", "idc", "SOC", "tmpm", "tmphs", "tmpaux",
+            "BMS_Vmax", "BMS_Vmin", "BMS_Tmax", "Gear", "MotActive", "regenmax",
+            nullptr
+        };
+        for (int i = 0; watched[i]; i++) canManager->watch(sub, watched[i]);
+    }
     
     Serial.println("LVGL UI initialized successfully!");
     return true;
@@ -147,17 +163,21 @@ void UIManager::update() {
     
     if (millis() - lastUpdateTime >= 100) {
         lastUpdateTime = millis();
+
+        // CAN-only screens are skipped entirely while nothing they show changed
+        bool live = liveDataDirty;
+        liveDataDirty = false;
         
         switch (currentScreen) {
             case SCREEN_LOCK:        break;
-            case SCREEN_DASHBOARD:   updateDashboard();   break;
-            case SCREEN_POWER:       updatePower();       break;
-            case SCREEN_TEMPERATURE: updateTemperature(); break;
-            case SCREEN_BATTERY:     updateBattery();     break;
-            case SCREEN_BMS:         updateBMS();         break;
-            case SCREEN_GEAR:        updateGear();        break;
-            case SCREEN_MOTOR:       updateMotor();       break;
-            case SCREEN_REGEN:       updateRegen();       break;
+            case SCREEN_DASHBOARD:   if (live) updateDashboard();   break;
+            case SCREEN_POWER:       if (live) updatePower();       break;
+            case SCREEN_TEMPERATURE: if (live) updateTemperature(); break;
+            case SCREEN_BATTERY:     if (live) updateBattery();     break;
+            case SCREEN_BMS:         if (live) updateBMS();         break;
+            case SCREEN_GEAR:        if (live) updateGear();        break;
+            case SCREEN_MOTOR:       if (live) updateMotor();       break;
+            case SCREEN_REGEN:       if (live) updateRegen();       break;
             case SCREEN_SETTINGS:    updateSettings();    break;
             case SCREEN_CHARGING:    updateCharging();    break;
             case SCREEN_HEALTH_CHECK: updateHealthCheck(); break;
@@ -202,6 +222,7 @@ void UIManager::setScreen(ScreenID screen) {
         }
     }
     currentScreen = screen;
+    liveDataDirty = true;   // new screen needs one full redraw
     if (screens[screen]) {
         lv_scr_load_anim(screens[screen], LV_SCR_LOAD_ANIM_FADE_IN, 200, 0, false);
     }
@@ -275,12 +296,12 @@ void UIManager::createSplashScreen() {
     screens[SCREEN_SPLASH] = lv_obj_create(NULL);
     lv_obj_set_style_bg_color(screens[SCREEN_SPLASH], lv_color_black(), 0);
 
-    // ── Attempt to load logo from SPIFFS ─────────────────────────────────
+    // ── Attempt to load logo from flash ──────────────────────────────────
     // /logo.bin: 4-byte header (uint16 w, uint16 h) + raw RGB565 pixels
     bool logoLoaded = false;
 
-    if (SPIFFS.exists("/logo.bin")) {
-        File f = SPIFFS.open("/logo.bin", "r");
+    if (Storage::fs().exists("/logo.bin")) {
+        File f = Storage::fs().open("/logo.bin", "r");
         if (f) {
             uint16_t w = 0, h = 0;
             f.read((uint8_t*)&w, 2);
@@ -369,7 +390,7 @@ void UIManager::createSplashScreen() {
 }
 
 // Called from main.cpp after a successful logo upload while WiFi is active.
-// Loads /logo.bin from SPIFFS into the existing splash screen widget without
+// Loads /logo.bin from flash into the existing splash screen widget without
 // requiring a reboot. Safe to call while WiFi is running — splash is not the
 // active screen so LVGL won't be rendering it during the update.
 void UIManager::reloadLogo() {
@@ -387,11 +408,11 @@ void UIManager::reloadLogo() {
         splash_logo_img = nullptr;
     }
 
-    if (!SPIFFS.exists("/logo.bin")) {
+    if (!Storage::fs().exists("/logo.bin")) {
         Serial.println("[SPLASH] reloadLogo: no logo.bin");
         return;
     }
-    File f = SPIFFS.open("/logo.bin", "r");
+    File f = Storage::fs().open("/logo.bin", "r");
     if (!f) return;
 
     uint16_t w = 0, h = 0;
@@ -1016,6 +1037,12 @@ void UIManager::scrollSettingsMenu(int delta) {
 // UPDATE FUNCTIONS
 // ============================================================================
 
+// Dim a widget whose source parameter has gone stale — the last value stays
+// readable but is visibly not live
+static void applyStaleStyle(lv_obj_t* obj, bool stale) {
+    if (obj) lv_obj_set_style_opa(obj, stale ? LV_OPA_40 : LV_OPA_COVER, 0);
+}
+
 void UIManager::updateDashboard() {
     if (!canManager) return;
 
@@ -1025,17 +1052,20 @@ void UIManager::updateDashboard() {
         lv_meter_set_indicator_value(dash_rpm_meter, dash_rpm_needle, value);
         lv_meter_set_indicator_end_value(dash_rpm_meter, dash_rpm_arc, value);
         lv_label_set_text_fmt(dash_rpm_label, "%d RPM", rpm->getValueAsInt());
+        applyStaleStyle(dash_rpm_label, rpm->stale);
     }
 
     CANParameter* voltage = canManager->getParameterByName("udc");
     if (voltage) {
         lv_label_set_text_fmt(dash_voltage_label, "%dV", voltage->getValueAsInt());
+        applyStaleStyle(dash_voltage_label, voltage->stale);
     }
 
     CANParameter* soc = canManager->getParameterByName("SOC");
     if (soc) {
         int32_t value = soc->getValueAsInt();
         lv_arc_set_value(dash_soc_arc, value);
+        applyStaleStyle(dash_soc_arc, soc->stale);
         if (value > 80) {
             lv_obj_set_style_arc_color(dash_soc_arc, lv_palette_main(LV_PALETTE_GREEN), LV_PART_INDICATOR);
         } else if (value > 20) {
@@ -1049,6 +1079,7 @@ void UIManager::updateDashboard() {
     if (voltage && current) {
         int32_t kw = (voltage->getValueAsInt() * current->getValueAsInt()) / 1000;
         lv_label_set_text_fmt(dash_power_label, "%dkW", kw);
+        applyStaleStyle(dash_power_label, voltage->stale || current->stale);
     }
 }
 
@@ -1063,12 +1094,14 @@ void UIManager::updatePower() {
         lv_meter_set_indicator_value(power_meter, power_needle, kw);
         lv_meter_set_indicator_end_value(power_meter, power_arc, kw);
         lv_label_set_text_fmt(power_label, "%d", kw);
+        applyStaleStyle(power_label, voltage->stale || current->stale);
     }
 
     CANParameter* soc = canManager->getParameterByName("SOC");
     if (soc) {
         int32_t value = soc->getValueAsInt();
         lv_label_set_text_fmt(power_soc_label, "SOC: %d%%", value);
+        applyStaleStyle(power_soc_label, soc->stale);
         if (value > 80) {
             lv_obj_set_style_text_color(power_soc_label, lv_palette_main(LV_PALETTE_GREEN), 0);
         } else if (value > 20) {
@@ -1094,6 +1127,7 @@ void UIManager::updateTemperature() {
         int32_t val = motorTemp->getValueAsInt();
         lv_label_set_text_fmt(temp_motor_label, "%d\xC2\xB0", val);
         applyTempColor(temp_motor_label, val);
+        applyStaleStyle(temp_motor_label, motorTemp->stale);
     }
 
     CANParameter* invTemp = canManager->getParameterByName("tmphs");
@@ -1101,6 +1135,7 @@ void UIManager::updateTemperature() {
         int32_t val = invTemp->getValueAsInt();
         lv_label_set_text_fmt(temp_inverter_label, "%d\xC2\xB0", val);
         applyTempColor(temp_inverter_label, val);
+        applyStaleStyle(temp_inverter_label, invTemp->stale);
     }
 
     CANParameter* batTemp = canManager->getParameterByName("tmpaux");
@@ -1108,6 +1143,7 @@ void UIManager::updateTemperature() {
         int32_t val = batTemp->getValueAsInt();
         lv_label_set_text_fmt(temp_battery_label, "%d\xC2\xB0", val);
         applyTempColor(temp_battery_label, val);
+        applyStaleStyle(temp_battery_label, batTemp->stale);
     }
 }
 
@@ -1118,6 +1154,7 @@ void UIManager::updateBattery() {
     if (soc) {
         int32_t value = soc->getValueAsInt();
         lv_label_set_text_fmt(battery_soc_label, "%d", value);
+        applyStaleStyle(battery_soc_label, soc->stale);
         lv_color_t c = value > 80 ? lv_palette_main(LV_PALETTE_GREEN) :
                        value > 20 ? lv_palette_main(LV_PALETTE_YELLOW) :
                                     lv_palette_main(LV_PALETTE_RED);
@@ -1126,17 +1163,24 @@ void UIManager::updateBattery() {
 
     CANParameter* voltage = canManager->getParameterByName("udc");
     if (voltage) {
-        lv_label_set_text_fmt(battery_voltage_label, "%dV", voltage->getValueAsInt());
+        char buf[16];
+        voltage->format(buf, sizeof(buf), 1);
+        lv_label_set_text_fmt(battery_voltage_label, "%sV", buf);
+        applyStaleStyle(battery_voltage_label, voltage->stale);
     }
 
     CANParameter* current = canManager->getParameterByName("idc");
     if (current) {
-        lv_label_set_text_fmt(battery_current_label, "%dA", current->getValueAsInt());
+        char buf[16];
+        current->format(buf, sizeof(buf), 1);
+        lv_label_set_text_fmt(battery_current_label, "%sA", buf);
+        applyStaleStyle(battery_current_label, current->stale);
     }
 
     CANParameter* temp = canManager->getParameterByName("tmpm");
     if (temp) {
         lv_label_set_text_fmt(battery_temp_label, "%d\xC2\xB0""C", temp->getValueAsInt());
+        applyStaleStyle(battery_temp_label, temp->stale);
     }
 }
 
@@ -1147,20 +1191,20 @@ void UIManager::updateBMS() {
     CANParameter* vmin = canManager->getParameterByName("BMS_Vmin");
     CANParameter* tmax = canManager->getParameterByName("BMS_Tmax");
 
-    // Use snprintf for voltage formatting — LVGL's lv_label_set_text_fmt
-    // does not support %f (float printf disabled to save flash space).
+    // Cell voltages are held in mV — render as volts with FixedPoint since
+    // LVGL's lv_label_set_text_fmt does not support %f (float printf disabled).
     if (vmax && bms_cell_max_label) {
-        int32_t mv = vmax->getValueAsInt();
         char buf[12];
-        snprintf(buf, sizeof(buf), "%d.%03dV", mv / 1000, mv % 1000);
-        lv_label_set_text_fmt(bms_cell_max_label, "Max Cell: %s", buf);
+        FixedPoint::format(buf, sizeof(buf), vmax->getValueAsInt(), 3);
+        lv_label_set_text_fmt(bms_cell_max_label, "Max Cell: %sV", buf);
+        applyStaleStyle(bms_cell_max_label, vmax->stale);
     }
 
     if (vmin && bms_cell_min_label) {
-        int32_t mv = vmin->getValueAsInt();
         char buf[12];
-        snprintf(buf, sizeof(buf), "%d.%03dV", mv / 1000, mv % 1000);
-        lv_label_set_text_fmt(bms_cell_min_label, "Min Cell: %s", buf);
+        FixedPoint::format(buf, sizeof(buf), vmin->getValueAsInt(), 3);
+        lv_label_set_text_fmt(bms_cell_min_label, "Min Cell: %sV", buf);
+        applyStaleStyle(bms_cell_min_label, vmin->stale);
     }
 
     if (vmax && vmin && bms_cell_delta_label) {
@@ -1168,6 +1212,7 @@ void UIManager::updateBMS() {
         lv_label_set_text_fmt(bms_cell_delta_label, "Delta: %dmV", delta);
         lv_obj_set_style_text_color(bms_cell_delta_label,
             delta > 100 ? lv_palette_main(LV_PALETTE_RED) : lv_color_white(), 0);
+        applyStaleStyle(bms_cell_delta_label, vmax->stale || vmin->stale);
     }
 
     if (tmax && bms_temp_max_label) {
@@ -1177,6 +1222,7 @@ void UIManager::updateBMS() {
             tempC > 45 ? lv_palette_main(LV_PALETTE_RED) :
             tempC > 35 ? lv_palette_main(LV_PALETTE_YELLOW) :
                          lv_color_white(), 0);
+        applyStaleStyle(bms_temp_max_label, tmax->stale);
     }
 }
 
@@ -1200,6 +1246,7 @@ void UIManager::updateGear() {
         const char* gearNames[] = {"LOW", "HIGH", "AUTO", "HI/LO"};
         if (value >= 0 && value < 4) {
             lv_label_set_text(gear_current_label, gearNames[value]);
+            applyStaleStyle(gear_current_label, gear->stale);
             for (int i = 0; i < 4; i++) {
                 if (i == value) {
                     lv_obj_set_style_bg_color(gear_indicators[i], lv_palette_main(LV_PALETTE_CYAN), 0);
@@ -1234,6 +1281,7 @@ void UIManager::updateMotor() {
         const char* motorNames[] = {"MG1 only", "MG2 only", "MG1+MG2", "Blended"};
         if (value >= 0 && value < 4) {
             lv_label_set_text(motor_current_label, motorNames[value]);
+            applyStaleStyle(motor_current_label, motor->stale);
             for (int i = 0; i < 4; i++) {
                 if (i == value) {
                     lv_obj_set_style_bg_color(motor_indicators[i], lv_palette_main(LV_PALETTE_ORANGE), 0);
@@ -1264,6 +1312,7 @@ void UIManager::updateRegen() {
         int32_t value = regen->getValueAsInt();
         lv_arc_set_value(regen_arc, value);
         lv_label_set_text_fmt(regen_value_label, "%d%%", value);
+        applyStaleStyle(regen_value_label, regen->stale);
         int absValue = abs(value);
         if (absValue > 25) {
             lv_obj_set_style_arc_color(regen_arc, lv_palette_main(LV_PALETTE_GREEN), LV_PART_INDICATOR);
@@ -1350,6 +1399,7 @@ void UIManager::showSystemInfo() {
 void UIManager::toggleEditMode() {
     if (isEditableScreen()) {
         editMode = !editMode;
+        liveDataDirty = true;   // title shows [EDITING]
     }
 }
 
@@ -0,0 +1,66 @@
+// ============================================================================
+// WebAssets.cpp
+// ============================================================================
+
+#include "WebAssets.h"
+#include <ESPAsyncWebServer.h>
+
+// Generated WebAssetsData.cpp — weak, so a build without the extra script
+// still links and simply serves everything from the filesystem
+extern const uint8_t  webAssetBlob[]    __attribute__((weak));
+extern const char     webAssetBundle[]  __attribute__((weak));
+extern const uint16_t webAssetCount     __attribute__((weak));
+extern const WebAsset webAssetIndex[]   __attribute__((weak));
+
+#define WEB_ASSET_IMMUTABLE  "public, max-age=31536000, immutable"
+
+uint16_t WebAssets::count() {
+    return &webAssetCount ? webAssetCount : 0;
+}
+
+const char* WebAssets::bundle() {
+    return webAssetBundle ? webAssetBundle : "";
+}
+
+const uint8_t* WebAssets::data(const WebAsset& a) {
+    return webAssetBlob + a.offset;
+}
+
+const WebAsset* WebAssets::find(const char* path) {
+    uint16_t lo = 0, hi = count();
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        int c = strcmp(path, webAssetIndex[mid].path);
+        if (c == 0) return &webAssetIndex[mid];
+        if (c < 0) hi = mid;
+        else       lo = mid + 1;
+    }
+    return nullptr;
+}
+
+bool WebAssets::serve(AsyncWebServerRequest* request, const char* path) {
+    const WebAsset* a = find(path);
+    if (!a) return false;
+
+    char etag[20];
+    snprintf(etag, sizeof(etag), "\"%s\"", a->hash);
+
+    // Pinned URL — the content is the hash in it, for good
+    bool pinned = request->hasParam("v") &&
+                  request->getParam("v")->value() == a->hash;
+    const char* cache = pinned ? WEB_ASSET_IMMUTABLE : "no-cache";
+
+    AsyncWebServerResponse* resp;
+    if (request->hasHeader("If-None-Match") &&
+        request->header("If-None-Match").indexOf(etag) >= 0) {
+        resp = request->beginResponse(304);
+    } else {
+        // Straight from memory-mapped flash — nothing is copied up front
+        resp = request->beginResponse(200, a->mime, data(*a), a->length);
+        if (a->gzip) resp->addHeader("Content-Encoding", "gzip");
+    }
+    resp->addHeader("ETag", etag);
+    resp->addHeader("Cache-Control", cache);
+    request->send(resp);
+    return true;
+}
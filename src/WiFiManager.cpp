@@ -5,8 +5,8 @@
 // the existing HTML/JS/CSS web assets work without modification.
 //
 // Uses ESPAsyncWebServer for concurrent file serving.
-// Uses synchronous SDO polling (like jamiejones CAN backend) during WiFi mode
-// so /cmd?cmd=json returns live values and /cmd?cmd=get works correctly.
+// /cmd writes go through SDOManager and are answered when the VCU replies,
+// so no handler ever waits on CAN.
 // =============================================================================
 
 #include "WiFiManager.h"
@@ -15,85 +15,121 @@
 #include "Config.h"
 #include "TripLogger.h"
 #include "GVRETServer.h"
+#include "SLCANServer.h"
+#include "CannelloniBridge.h"
 #include "FaultLogger.h"
 #include "EfficiencyTracker.h"
 #include "HealthChecker.h"
+#include "FlightRecorder.h"
+#include "SpotStream.h"
+#include "CmdSampler.h"
+#include "WebAssets.h"
+#include "JsonWriter.h"
+#include "MsgPack.h"
 #include "UIManager.h"
 #include "Immobilizer.h"
+#include "Benchmark.h"
 #include "pngle.h"
 
 #include <WiFi.h>
 #include <ESPmDNS.h>
 #include <ESPAsyncWebServer.h>
 #include <Update.h>
-#include <SPIFFS.h>
+#include "Storage.h"
 #include <FS.h>
 #include <ArduinoJson.h>
-#include "driver/twai.h"
-
-// ---------------------------------------------------------------------------
-// SDO constants (mirroring jamiejones oi_can.cpp)
-// ---------------------------------------------------------------------------
-#define SDO_READ              (2 << 5)
-#define SDO_WRITE             ((1 << 5) | (1 << 1) | 1)
-#define SDO_WRITE_REPLY       (3 << 5)
-#define SDO_READ_REPLY        ((2 << 5) | (1 << 1) | 1)
-#define SDO_ABORT             0x80
-#define SDO_INDEX_PARAM_UID   0x2100
-#define SDO_INDEX_COMMANDS    0x5002
-#define SDO_CMD_SAVE          0
-
-// ---------------------------------------------------------------------------
-// Synchronous SDO helpers — used during WiFi mode when LVGL is suspended
-// Sends a raw SDO request and waits up to timeoutMs for a response.
-// Returns the raw int32 value (caller applies /32 scaling if needed).
-// ---------------------------------------------------------------------------
-static bool sdoRequestSync(uint8_t nodeId, uint16_t index, uint8_t subIndex,
-                           twai_message_t* response, uint32_t timeoutMs = 50) {
-    twai_message_t tx;
-    tx.extd = false;
-    tx.identifier = 0x600 | nodeId;
-    tx.data_length_code = 8;
-    tx.data[0] = SDO_READ;
-    tx.data[1] = index & 0xFF;
-    tx.data[2] = index >> 8;
-    tx.data[3] = subIndex;
-    tx.data[4] = tx.data[5] = tx.data[6] = tx.data[7] = 0;
-
-    if (twai_transmit(&tx, pdMS_TO_TICKS(10)) != ESP_OK) return false;
-
-    uint32_t deadline = millis() + timeoutMs;
-    while (millis() < deadline) {
-        if (twai_receive(response, pdMS_TO_TICKS(5)) == ESP_OK) {
-            if (response->identifier == (uint32_t)(0x580 | nodeId)) return true;
-        }
+#include "CANTxScheduler.h"
+
+// ---------------------------------------------------------------------------
+// Pending /cmd writes — a request queued on SDOManager holds a slot until its
+// result is in and its reply has gone out (or the client has gone away).
+// The SDO task fills in the result and applies it (cached value, refetch)
+// whether or not anyone is still waiting; the response's chunk callback on
+// async_tcp only reports it. SDOManager answers every queued request, with
+// a timeout result at worst, so an abandoned slot is always freed.
+// ---------------------------------------------------------------------------
+struct CmdWriteSlot {
+    uint32_t tag;          // 0 = free
+    bool     queued;       // on SDOManager — a result will come
+    bool     released;     // response gone, slot waits only for the result
+    bool     done;
+    bool     ok;
+    uint32_t abortCode;
+    uint16_t paramId;      // set: cache raw once the VCU accepts it (0 = command)
+    int32_t  raw;
+    bool     refetch;      // load/defaults: parameter table is out of date
+};
+
+static CmdWriteSlot s_cmdWrites[CMD_WRITE_MAX] = {};
+static portMUX_TYPE s_cmdWriteMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t     s_cmdWriteTag = 0;
+
+static void cmdWriteRelease(uint32_t tag) {
+    portENTER_CRITICAL(&s_cmdWriteMux);
+    for (int i = 0; i < CMD_WRITE_MAX; i++) {
+        CmdWriteSlot& s = s_cmdWrites[i];
+        if (s.tag != tag) continue;
+        if (s.queued && !s.done) s.released = true;
+        else                     s.tag = 0;
     }
-    return false;
+    portEXIT_CRITICAL(&s_cmdWriteMux);
 }
 
-static bool sdoWriteSync(uint8_t nodeId, uint16_t index, uint8_t subIndex,
-                         uint32_t value, uint32_t timeoutMs = 50) {
-    twai_message_t tx, rx;
-    tx.extd = false;
-    tx.identifier = 0x600 | nodeId;
-    tx.data_length_code = 8;
-    tx.data[0] = SDO_WRITE;
-    tx.data[1] = index & 0xFF;
-    tx.data[2] = index >> 8;
-    tx.data[3] = subIndex;
-    *(uint32_t*)&tx.data[4] = value;
-
-    if (twai_transmit(&tx, pdMS_TO_TICKS(10)) != ESP_OK) return false;
-
-    uint32_t deadline = millis() + timeoutMs;
-    while (millis() < deadline) {
-        if (twai_receive(&rx, pdMS_TO_TICKS(5)) == ESP_OK) {
-            if (rx.identifier == (uint32_t)(0x580 | nodeId)) {
-                return rx.data[0] != SDO_ABORT;
-            }
-        }
+static void cmdWriteQueued(uint32_t tag) {
+    portENTER_CRITICAL(&s_cmdWriteMux);
+    for (int i = 0; i < CMD_WRITE_MAX; i++) {
+        if (s_cmdWrites[i].tag == tag) s_cmdWrites[i].queued = true;
     }
-    return false;
+    portEXIT_CRITICAL(&s_cmdWriteMux);
+}
+
+// Owned by the response; lets go of the slot however the response ends
+struct CmdWriteTicket {
+    uint32_t tag;
+    uint32_t deadlineMs;
+
+    ~CmdWriteTicket() { cmdWriteRelease(tag); }
+};
+
+// Claim a slot — 0 when CMD_WRITE_MAX writes are already outstanding
+static uint32_t cmdWriteClaim(uint16_t paramId, int32_t raw, bool refetch) {
+    uint32_t tag = 0;
+    portENTER_CRITICAL(&s_cmdWriteMux);
+    for (int i = 0; i < CMD_WRITE_MAX; i++) {
+        if (s_cmdWrites[i].tag) continue;
+        if (++s_cmdWriteTag == 0) s_cmdWriteTag = 1;
+        tag = s_cmdWriteTag;
+        s_cmdWrites[i] = { tag, false, false, false, false, 0, paramId, raw, refetch };
+        break;
+    }
+    portEXIT_CRITICAL(&s_cmdWriteMux);
+    return tag;
+}
+
+// True once the result is in; ok/abortCode are then valid
+static bool cmdWritePoll(uint32_t tag, bool& ok, uint32_t& abortCode) {
+    bool done = false;
+    portENTER_CRITICAL(&s_cmdWriteMux);
+    for (int i = 0; i < CMD_WRITE_MAX; i++) {
+        if (s_cmdWrites[i].tag != tag) continue;
+        done      = s_cmdWrites[i].done;
+        ok        = s_cmdWrites[i].ok;
+        abortCode = s_cmdWrites[i].abortCode;
+        break;
+    }
+    portEXIT_CRITICAL(&s_cmdWriteMux);
+    return done;
+}
+
+// ---------------------------------------------------------------------------
+// formatCmdValue — renders a parameter for /cmd get and /value.
+// The openinverter JS (inverter.getValues) only matches numbers containing a
+// decimal point, so at least two decimals are always emitted.
+// ---------------------------------------------------------------------------
+static size_t formatCmdValue(char* out, size_t cap, const CANParameter* p) {
+    if (!p) return FixedPoint::format(out, cap, 0, 0, 2);
+    uint8_t dec = p->getDecimals();
+    return p->format(out, cap, dec < 2 ? 2 : dec);
 }
 
 // ---------------------------------------------------------------------------
@@ -143,9 +179,9 @@ static void logo_on_init(pngle_t* pngle, uint32_t w, uint32_t h) {
         w, h, s_logoCtx->dstW, s_logoCtx->dstH,
         s_logoCtx->dstX0, s_logoCtx->dstY0);
 
-    s_logoCtx->file = SPIFFS.open("/logo.tmp", "w");
+    s_logoCtx->file = Storage::fs().open("/logo.tmp", "w");
     if (!s_logoCtx->file) {
-        Serial.println("[LOGO] SPIFFS open failed");
+        Serial.println("[LOGO] open failed");
         s_logoCtx->error = true;
         return;
     }
@@ -206,13 +242,14 @@ WiFiManager::WiFiManager()
 }
 
 // ---------------------------------------------------------------------------
-// init — mounts SPIFFS, configures AP, registers routes
+// init — mounts storage, configures AP, registers routes
 // ---------------------------------------------------------------------------
 bool WiFiManager::init(CANDataManager* canManager) {
     can = canManager;
 
-    if (!SPIFFS.begin(true)) {
-        Serial.println("[WiFi] SPIFFS mount failed");
+    // Normally mounted in setup() already — this is a no-op then
+    if (!Storage::begin()) {
+        Serial.println("[WiFi] Storage mount failed");
     }
 
     WiFi.mode(WIFI_OFF);
@@ -242,6 +279,8 @@ void WiFiManager::startAP() {
 
     startServer();
     GVRETServer::getInstance().begin();
+    SLCANServer::getInstance().begin();
+    CannelloniBridge::getInstance().begin();
     active = true;
 }
 
@@ -252,6 +291,8 @@ void WiFiManager::stopAP() {
     if (!active) return;
     stopServer();
     GVRETServer::getInstance().stop();
+    SLCANServer::getInstance().stop();
+    CannelloniBridge::getInstance().stop();
     MDNS.end();
     WiFi.softAPdisconnect(true);
     WiFi.mode(WIFI_OFF);
@@ -260,10 +301,16 @@ void WiFiManager::stopAP() {
 }
 
 // ---------------------------------------------------------------------------
-// update — no-op: ESPAsyncWebServer handles everything internally
+// update — network I/O runs on async_tcp (web, CAN bridges); only deferred work
+// happens here
 // ---------------------------------------------------------------------------
 void WiFiManager::update() {
-    if (active) GVRETServer::getInstance().update();
+    // WebSocket cleanup edits the library's client lists — here on loopTask,
+    // never on the streaming tasks
+    if (serverStarted) {
+        CANMonitor::instance().cleanupClients();
+        SpotStream::getInstance().cleanupClients();
+    }
 
     // Deferred PNG decode — runs on loopTask so async_tcp watchdog is never starved
     if (pngPending && pngBuffer && pngBufLen > 0) {
@@ -293,15 +340,15 @@ void WiFiManager::update() {
             if (!error && s_logoCtx->file && s_logoCtx->srcW > 0) {
                 if (s_logoCtx->lastY != 0xFFFF) logo_flush_row(s_logoCtx->lastY);
                 s_logoCtx->file.close();
-                SPIFFS.remove("/logo.bin");
-                SPIFFS.rename("/logo.tmp", "/logo.bin");
+                Storage::fs().remove("/logo.bin");
+                Storage::fs().rename("/logo.tmp", "/logo.bin");
                 ok = true;
                 s_logoUploadOk = true;
                 logoReloadRequested = true;
                 Serial.printf("[LOGO] /logo.bin written OK (%u pixels)\n", s_logoCtx->pixCount);
             } else {
                 if (s_logoCtx->file) s_logoCtx->file.close();
-                SPIFFS.remove("/logo.tmp");
+                Storage::fs().remove("/logo.tmp");
                 Serial.println("[LOGO] Decode failed — logo.bin preserved");
             }
         }
@@ -357,7 +404,7 @@ void WiFiManager::startServer() {
     });
 
     // -----------------------------------------------------------------------
-    // /list — SPIFFS file listing
+    // /list — file listing
     // -----------------------------------------------------------------------
     server->on("/list", HTTP_GET, [](AsyncWebServerRequest* request) {
         if (!instance) { request->send(500); return; }
@@ -365,7 +412,7 @@ void WiFiManager::startServer() {
     });
 
     // -----------------------------------------------------------------------
-    // /edit DELETE — delete file from SPIFFS
+    // /edit DELETE — delete file from flash
     // -----------------------------------------------------------------------
     server->on("/edit", HTTP_DELETE, [](AsyncWebServerRequest* request) {
         if (!instance) { request->send(500); return; }
@@ -373,7 +420,7 @@ void WiFiManager::startServer() {
     });
 
     // -----------------------------------------------------------------------
-    // /edit POST — upload file to SPIFFS
+    // /edit POST — upload file to flash
     // -----------------------------------------------------------------------
     server->on("/edit", HTTP_POST,
         [](AsyncWebServerRequest* request) {
@@ -387,8 +434,9 @@ void WiFiManager::startServer() {
     );
 
     // -----------------------------------------------------------------------
-    // /spot — live parameter values from RAM, no SPIFFS
-    // Returns {"name":value,...} for all parameters with live CAN data
+    // /spot — live parameter values from RAM, no filesystem
+    // Returns {"name":value,...} for all parameters with live CAN data,
+    // or only the changed ones with ?since=<_gen>
     // -----------------------------------------------------------------------
     server->on("/spot", HTTP_GET, [](AsyncWebServerRequest* request) {
         if (!instance || !instance->can) { request->send(200, "application/json", "{}"); return; }
@@ -476,7 +524,7 @@ void WiFiManager::startServer() {
     );
 
     // -----------------------------------------------------------------------
-    // /upload-logo  POST — accepts PNG, decodes, saves /logo.bin to SPIFFS
+    // /upload-logo  POST — accepts PNG, decodes, saves /logo.bin to flash
     // /delete-logo  DELETE — removes /logo.bin
     // -----------------------------------------------------------------------
     server->on("/upload-logo", HTTP_POST,
@@ -489,7 +537,7 @@ void WiFiManager::startServer() {
         },
         [](AsyncWebServerRequest* request, const String& filename,
            size_t index, uint8_t* data, size_t len, bool final) {
-            // Buffer raw PNG bytes only — all pngle/SPIFFS work happens in update()
+            // Buffer raw PNG bytes only — all pngle/file work happens in update()
             // on the loopTask so the async_tcp watchdog is never starved.
             if (index == 0) {
                 s_logoUploadOk = false;
@@ -558,7 +606,7 @@ void WiFiManager::startServer() {
     });
 
     // -----------------------------------------------------------------------
-    // Catch-all — serve static files from SPIFFS (with .gz support)
+    // Catch-all — serve static files from the filesystem (with .gz support)
     // -----------------------------------------------------------------------
     server->onNotFound([](AsyncWebServerRequest* request) {
         if (!instance) { request->send(404); return; }
@@ -567,6 +615,37 @@ void WiFiManager::startServer() {
         }
     });
 
+    // -----------------------------------------------------------------------
+    // /bms — pack statistics and per-cell voltages / trend slopes
+    // /bms-settings — GET: cell-frame layout, POST: update and persist
+    // -----------------------------------------------------------------------
+    server->on("/bms", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!instance) { request->send(500); return; }
+        instance->handleBMS(request);
+    });
+
+    server->on("/bms-settings", HTTP_GET, [](AsyncWebServerRequest* request) {
+        if (!instance) { request->send(500); return; }
+        instance->handleBMSSettingsGet(request);
+    });
+
+    // The body arrives in chunks; collect it in the request's _tempObject
+    // (freed with the request) and parse once it is all there.
+    server->on("/bms-settings", HTTP_POST,
+        [](AsyncWebServerRequest* request) {
+            if (!instance) { request->send(500); return; }
+            instance->handleBMSSettingsPost(request);
+        },
+        nullptr,
+        [](AsyncWebServerRequest* request, uint8_t* data, size_t len,
+           size_t index, size_t total) {
+            if (total > BMS_SETTINGS_MAX_BODY) return;
+            if (index == 0) request->_tempObject = calloc(total + 1, 1);
+            char* body = (char*)request->_tempObject;
+            if (body && index + len <= total) memcpy(body + index, data, len);
+        }
+    );
+
     // -----------------------------------------------------------------------
     // /health-settings — GET: read health thresholds + fail behaviour (NVS)
     //                    POST: update and persist
@@ -598,10 +677,32 @@ void WiFiManager::startServer() {
         }
     );
 
+    // -----------------------------------------------------------------------
+    // /bench — on-target micro-benchmarks (GET /bench lists the cases)
+    // -----------------------------------------------------------------------
+    server->on("/bench", HTTP_GET, [](AsyncWebServerRequest* request) {
+        String body = request->hasParam("name")
+            ? Benchmark::run(request->getParam("name")->value())
+            : Benchmark::list();
+        AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", body);
+        resp->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(resp);
+    });
+
     // -----------------------------------------------------------------------
     // CAN Monitor — WebSocket + REST endpoints
     // -----------------------------------------------------------------------
     CANMonitor::instance().registerEndpoints(server);
+    CANTxScheduler::getInstance().registerEndpoints(server);
+    FlightRecorder::getInstance().registerEndpoints(server);
+    CANBridge::registerEndpoints(server);
+
+    // Live values pushed over /ws/spot
+    SpotStream::getInstance().begin(can);
+    SpotStream::getInstance().registerEndpoints(server);
+
+    // Sample clock for /cmd get|stream with repeat
+    CmdSampler::getInstance().begin();
 
     server->begin();
     serverStarted = true;
@@ -626,6 +727,16 @@ void WiFiManager::stopServer() {
 // ---------------------------------------------------------------------------
 // /cmd
 // ---------------------------------------------------------------------------
+
+// &rate=<hz> for repeated get/stream
+static int cmdSampleRate(AsyncWebServerRequest* request) {
+    if (!request->hasParam("rate")) return CMD_SAMPLE_DEFAULT_HZ;
+    int hz = request->getParam("rate")->value().toInt();
+    if (hz < 1) hz = 1;
+    if (hz > CMD_SAMPLE_MAX_HZ) hz = CMD_SAMPLE_MAX_HZ;
+    return hz;
+}
+
 void WiFiManager::handleCmd(AsyncWebServerRequest* request) {
     if (!request->hasParam("cmd")) {
         request->send(400, "text/plain", "BAD ARGS");
@@ -634,7 +745,6 @@ void WiFiManager::handleCmd(AsyncWebServerRequest* request) {
 
     String cmd = request->getParam("cmd")->value();
     cmd.trim();
-    String response;
 
     AsyncWebServerResponse* resp = nullptr;
 
@@ -652,8 +762,7 @@ void WiFiManager::handleCmd(AsyncWebServerRequest* request) {
         if (repeat > 500) repeat = 500;
         String names = cmd.substring(firstSpace + 1);
         names.trim();
-        response = cmdGetRepeated(names, repeat);
-        resp = request->beginResponse(200, "text/plain", response);
+        resp = cmdGetResponse(request, names, repeat, cmdSampleRate(request));
 
     } else if (cmd.startsWith("get ")) {
         // plot.js uses: /cmd?cmd=get name1,name2&repeat=N
@@ -665,8 +774,7 @@ void WiFiManager::handleCmd(AsyncWebServerRequest* request) {
             if (repeat < 1) repeat = 1;
             if (repeat > 500) repeat = 500;
         }
-        response = cmdGetRepeated(names, repeat);
-        resp = request->beginResponse(200, "text/plain", response);
+        resp = cmdGetResponse(request, names, repeat, cmdSampleRate(request));
 
     } else if (cmd.startsWith("set ")) {
         String rest = cmd.substring(4);
@@ -680,11 +788,22 @@ void WiFiManager::handleCmd(AsyncWebServerRequest* request) {
         String value = rest.substring(spaceIdx + 1);
         name.trim();
         value.trim();
-        response = cmdSet(name, value);
-        resp = request->beginResponse(200, "text/plain", response);
-
-    } else if (cmd == "save" || cmd == "load") {
-        resp = request->beginResponse(200, "text/plain", "1\n");
+        resp = cmdSetResponse(request, name, value);
+
+    } else if (cmd == "save") {
+        resp = cmdCommandResponse(request, SDO_COMMAND_SAVE, 0);
+    } else if (cmd == "load") {
+        resp = cmdCommandResponse(request, SDO_COMMAND_LOAD, 0);
+    } else if (cmd == "defaults") {
+        resp = cmdCommandResponse(request, SDO_COMMAND_DEFAULTS, 0);
+    } else if (cmd == "reset") {
+        resp = cmdCommandResponse(request, SDO_COMMAND_RESET, 0);
+    } else if (cmd == "stop") {
+        resp = cmdCommandResponse(request, SDO_COMMAND_STOP, 0);
+    } else if (cmd == "start" || cmd.startsWith("start ")) {
+        // "start <mode>" — opmode to start in, 1 (normal run) when left out
+        int32_t mode = cmd.length() > 6 ? cmd.substring(6).toInt() : 1;
+        resp = cmdCommandResponse(request, SDO_COMMAND_START, mode);
 
     } else if (cmd == "errors") {
         resp = request->beginResponse(200, "text/plain", "0\n");
@@ -700,83 +819,130 @@ void WiFiManager::handleCmd(AsyncWebServerRequest* request) {
 }
 
 // ---------------------------------------------------------------------------
-// cmdJson — not used, params.json served directly from SPIFFS
+// cmdJson — not used, params.json served directly from flash
 // ---------------------------------------------------------------------------
 String WiFiManager::cmdJson() {
     return "{}";
 }
 
 // ---------------------------------------------------------------------------
-// cmdGet — returns live values from local CAN parameter cache
-// The cache is updated continuously from CAN broadcasts and SDO polling
+// cmdSet — writes a parameter value through SDOManager; the reply waits for
+// the VCU's ACK or abort
 // ---------------------------------------------------------------------------
-String WiFiManager::cmdGet(const String& names) {
-    String response;
-    String nameList = names;
-    nameList.trim();
+AsyncWebServerResponse* WiFiManager::cmdSetResponse(AsyncWebServerRequest* request,
+                                                    const String& name,
+                                                    const String& value) {
+    // Look up param in local cache to get id
+    CANParameter* p = can ? can->getParameterByName(name.c_str()) : nullptr;
+    if (!p) {
+        Serial.printf("[WiFi] Set: param '%s' not found\n", name.c_str());
+        return request->beginResponse(200, "text/plain", "0\n");
+    }
 
-    int start = 0;
-    while (start < (int)nameList.length()) {
-        int comma = nameList.indexOf(',', start);
-        String name;
-        if (comma < 0) {
-            name = nameList.substring(start);
-            start = nameList.length();
-        } else {
-            name = nameList.substring(start, comma);
-            start = comma + 1;
-        }
-        name.trim();
-        if (name.length() == 0) continue;
+    int32_t fixed;
+    if (!FixedPoint::parse(value.c_str(), p->getDecimals(), fixed)) {
+        Serial.printf("[WiFi] Set: bad value '%s'\n", value.c_str());
+        return request->beginResponse(200, "text/plain", "0\n");
+    }
 
-        char valBuf[32];
-        CANParameter* param = can ? can->getParameterByName(name.c_str()) : nullptr;
-        if (param) {
-            snprintf(valBuf, sizeof(valBuf), "%.2f", (float)param->getValueAsInt());
-        } else {
-            snprintf(valBuf, sizeof(valBuf), "0.00");
-        }
-        response += valBuf;
-        response += "\n";
+    int32_t  raw = FixedPoint::toRaw(fixed, p->scale);
+    uint32_t tag = cmdWriteClaim(p->id, raw, false);
+    if (!tag) {
+        Serial.println("[WiFi] Set: too many writes outstanding");
+        return request->beginResponse(200, "text/plain", "0\n");
+    }
+    AsyncWebServerResponse* resp = cmdWriteResponse(request, tag);
+    if (!can->getSDOManager()->requestWrite(p->id, raw, false, tag)) {
+        Serial.printf("[WiFi] Set %s: SDO queue full\n", name.c_str());
+        delete resp;   // drops the ticket, freeing the slot
+        return request->beginResponse(200, "text/plain", "0\n");
     }
-    return response;
+    cmdWriteQueued(tag);
+    Serial.printf("[WiFi] Set %s = %s queued\n", name.c_str(), value.c_str());
+    return resp;
 }
 
 // ---------------------------------------------------------------------------
-// cmdSet — writes a parameter value via synchronous SDO
+// cmdCommand — save, load, defaults, reset, start, stop as SDO commands
 // ---------------------------------------------------------------------------
-String WiFiManager::cmdSet(const String& name, const String& value) {
-    if (!can) return "0\n";
+AsyncWebServerResponse* WiFiManager::cmdCommandResponse(AsyncWebServerRequest* request,
+                                                        uint8_t command, int32_t value) {
+    bool refetch = command == SDO_COMMAND_LOAD || command == SDO_COMMAND_DEFAULTS;
+    uint32_t tag = can ? cmdWriteClaim(0, 0, refetch) : 0;
+    if (!tag) return request->beginResponse(200, "text/plain", "0\n");
 
-    // Look up param in local cache to get id
-    CANParameter* p = can->getParameterByName(name.c_str());
-    if (!p) {
-        Serial.printf("[WiFi] Set: param '%s' not found\n", name.c_str());
-        return "0\n";
+    AsyncWebServerResponse* resp = cmdWriteResponse(request, tag);
+    if (!can->getSDOManager()->requestCommand(command, value, tag)) {
+        Serial.printf("[WiFi] Command %u: SDO queue full\n", command);
+        delete resp;
+        return request->beginResponse(200, "text/plain", "0\n");
     }
+    cmdWriteQueued(tag);
+    return resp;
+}
 
-    double dval = value.toDouble();
-    uint32_t raw = (uint32_t)(int32_t)(dval * 32.0);
-
-    uint16_t index = SDO_INDEX_PARAM_UID | (p->id >> 8);
-    uint8_t  sub   = p->id & 0xFF;
+// ---------------------------------------------------------------------------
+// cmdWriteResponse — "1\n" / "0\n" once slot `tag` has its result. Until then
+// the chunk callback answers RESPONSE_TRY_AGAIN, so nothing (not even the
+// headers) is sent and async_tcp asks again on the connection's next poll.
+// ---------------------------------------------------------------------------
+AsyncWebServerResponse* WiFiManager::cmdWriteResponse(AsyncWebServerRequest* request,
+                                                      uint32_t tag) {
+    std::shared_ptr<CmdWriteTicket> t = std::make_shared<CmdWriteTicket>();
+    t->tag        = tag;
+    t->deadlineMs = millis() + CMD_WRITE_TIMEOUT_MS;
+
+    return request->beginChunkedResponse("text/plain",
+        [t](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+            if (index) return 0;                      // reply already sent
+            if (maxLen < 2) return RESPONSE_TRY_AGAIN;
+            bool ok = false;
+            uint32_t abortCode = 0;
+            if (!cmdWritePoll(t->tag, ok, abortCode)) {
+                if ((int32_t)(millis() - t->deadlineMs) < 0) return RESPONSE_TRY_AGAIN;
+                Serial.printf("[WiFi] Write %u: no answer from VCU\n", (unsigned)t->tag);
+            } else if (!ok) {
+                Serial.printf("[WiFi] Write %u: abort 0x%08X\n",
+                              (unsigned)t->tag, (unsigned)abortCode);
+            }
+            buf[0] = ok ? '1' : '0';
+            buf[1] = '\n';
+            return 2;
+        });
+}
 
-    if (sdoWriteSync(CAN_NODE_ID, index, sub, raw)) {
-        Serial.printf("[WiFi] Set %s = %.2f\n", name.c_str(), dval);
-        p->setValue((int32_t)dval);
-        return "1\n";
+// ---------------------------------------------------------------------------
+// onSDOResult — SDO task; applies an accepted write and records the result
+// for the response to pick up. A write whose response has already gone
+// (timed out, client gone) is still applied; only the reply is lost.
+// ---------------------------------------------------------------------------
+void WiFiManager::onSDOResult(const SDOResult& result) {
+    CmdWriteSlot slot = {};
+    portENTER_CRITICAL(&s_cmdWriteMux);
+    for (int i = 0; i < CMD_WRITE_MAX; i++) {
+        if (s_cmdWrites[i].tag != result.tag) continue;
+        s_cmdWrites[i].done      = true;
+        s_cmdWrites[i].ok        = result.success;
+        s_cmdWrites[i].abortCode = result.abortCode;
+        slot = s_cmdWrites[i];
+        if (s_cmdWrites[i].released) s_cmdWrites[i].tag = 0;
+        break;
     }
+    portEXIT_CRITICAL(&s_cmdWriteMux);
 
-    Serial.printf("[WiFi] Set %s failed\n", name.c_str());
-    return "0\n";
+    if (!slot.tag || !result.success) return;
+    // Through the parameter's current descriptor — the VCU holds the raw value
+    CANParameter* p = (slot.paramId && can) ? can->getParameter(slot.paramId) : nullptr;
+    if (p) p->setRaw(slot.raw);
+    if (slot.refetch) refetchRequested = true;
 }
 
 // ---------------------------------------------------------------------------
 // /wifi GET
 // ---------------------------------------------------------------------------
 void WiFiManager::handleWifiGet(AsyncWebServerRequest* request) {
-    if (SPIFFS.exists("/wifi.html")) {
-        File f = SPIFFS.open("/wifi.html", "r");
+    if (Storage::fs().exists("/wifi.html")) {
+        File f = Storage::fs().open("/wifi.html", "r");
         String html = f.readString();
         f.close();
         html.replace("%apSSID%",  WiFi.softAPSSID());
@@ -812,17 +978,27 @@ void WiFiManager::handleWifiPost(AsyncWebServerRequest* request) {
 // ---------------------------------------------------------------------------
 // /list
 // ---------------------------------------------------------------------------
-void WiFiManager::handleFileList(AsyncWebServerRequest* request) {
-    File root = SPIFFS.open("/");
-    String output = "[";
-    File file = root.openNextFile();
-    while (file) {
+// Every file, subdirectories flattened — "name" is the path without the
+// leading slash, which is what /edit?f= takes back.
+static void listDir(File dir, String& output) {
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        if (file.isDirectory()) {
+            listDir(file, output);
+            continue;
+        }
         if (output != "[") output += ",";
         output += "{\"type\":\"file\",\"name\":\"";
-        output += String(file.name());
-        output += "\"}";
-        file = root.openNextFile();
+        output += file.path() + 1;
+        output += "\",\"size\":";
+        output += String((uint32_t)file.size());
+        output += "}";
     }
+}
+
+void WiFiManager::handleFileList(AsyncWebServerRequest* request) {
+    File root = Storage::fs().open("/");
+    String output = "[";
+    if (root) listDir(root, output);
     output += "]";
     request->send(200, "text/json", output);
 }
@@ -839,7 +1015,10 @@ void WiFiManager::handleFileUpload(AsyncWebServerRequest* request,
 
     if (index == 0) {
         Serial.printf("[WiFi] Upload start: %s\n", path.c_str());
-        fsUploadFile = SPIFFS.open(path, "w");
+        // The MessagePack copy would be stale — served as JSON until refetched
+        if (path == "/params.json") Storage::fs().remove(PARAMS_MSGPACK_PATH);
+        // create = true makes any missing directories on the way
+        fsUploadFile = Storage::fs().open(path, FILE_WRITE, true);
     }
     if (fsUploadFile) {
         fsUploadFile.write(data, len);
@@ -861,11 +1040,12 @@ void WiFiManager::handleFileDelete(AsyncWebServerRequest* request) {
         return;
     }
     String path = request->getParam("f")->value();
-    if (!SPIFFS.exists(path)) {
+    if (!path.startsWith("/")) path = "/" + path;
+    if (!Storage::fs().exists(path)) {
         request->send(404, "text/plain", "File not found");
         return;
     }
-    SPIFFS.remove(path);
+    Storage::fs().remove(path);
     Serial.printf("[WiFi] Deleted: %s\n", path.c_str());
     request->send(200, "text/plain", "");
 }
@@ -924,26 +1104,42 @@ String WiFiManager::getContentType(const String& filename) {
     return "text/plain";
 }
 
-// Serve file from SPIFFS — tries .gz version first
+// Serve file from the filesystem — tries .gz version first
 // Called from onNotFound catch-all
 bool WiFiManager::serveFile(AsyncWebServerRequest* request, const String& overridePath) {
     String path = overridePath.length() > 0 ? overridePath : request->url();
     if (path == "/") path = "/index.html";
 
-    // Try .gz first
+    // Built into the firmware — see WebAssets.h
+    if (WebAssets::serve(request, path.c_str())) return true;
+
+    // The parameter schema (also /cmd?cmd=json), converted when it was saved
+    if (path == "/params.json") {
+        if (!Storage::fs().exists(path)) return false;
+        bool msgpack = MsgPack::accepted(request) && Storage::fs().exists(PARAMS_MSGPACK_PATH);
+        AsyncWebServerResponse* response = msgpack
+            ? request->beginResponse(Storage::fs(), PARAMS_MSGPACK_PATH, MSGPACK_MIME)
+            : request->beginResponse(Storage::fs(), path, "application/json");
+        response->addHeader("Cache-Control", "max-age=86400");
+        response->addHeader("Vary", "Accept");
+        request->send(response);
+        return true;
+    }
+
+    // Written at run time or uploaded through /edit. Try .gz first
     String gzPath = path + ".gz";
-    if (SPIFFS.exists(gzPath)) {
+    if (Storage::fs().exists(gzPath)) {
         AsyncWebServerResponse* response =
-            request->beginResponse(SPIFFS, gzPath, getContentType(path));
+            request->beginResponse(Storage::fs(), gzPath, getContentType(path));
         response->addHeader("Content-Encoding", "gzip");
         response->addHeader("Cache-Control", "max-age=86400");
         request->send(response);
         return true;
     }
 
-    if (SPIFFS.exists(path)) {
+    if (Storage::fs().exists(path)) {
         AsyncWebServerResponse* response =
-            request->beginResponse(SPIFFS, path, getContentType(path));
+            request->beginResponse(Storage::fs(), path, getContentType(path));
         response->addHeader("Cache-Control", "max-age=86400");
         request->send(response);
         return true;
@@ -953,36 +1149,63 @@ bool WiFiManager::serveFile(AsyncWebServerRequest* request, const String& overri
 }
 
 // ---------------------------------------------------------------------------
-// cmdGetRepeated — returns <repeat> samples of named params, space-separated
+// cmdGetResponse — <repeat> samples of named params, space-separated
 // plot.js and log.js call /cmd?cmd=get names&repeat=N (or cmd=stream N names).
 // Response is a flat stream of floats; the JS regex matches all of them and
-// distributes them across datasets in signal order.
-// ---------------------------------------------------------------------------
-String WiFiManager::cmdGetRepeated(const String& names, int repeat) {
-    // Parse comma-separated signal names
-    std::vector<String> nameList;
-    int start = 0;
-    while (start < (int)names.length()) {
-        int comma = names.indexOf(',', start);
-        String name = (comma < 0) ? names.substring(start) : names.substring(start, comma);
-        start = (comma < 0) ? names.length() : comma + 1;
-        name.trim();
-        if (name.length() > 0) nameList.push_back(name);
+// distributes them across datasets in signal order. Names are looked up once.
+// A single sample is the current values; repeat > 1 is a SampleBody that
+// CmdSampler fills at `hz`, streamed as the rows are taken.
+// ---------------------------------------------------------------------------
+class CmdGetBody : public JsonBody {
+public:
+    const CANParameter* params[CMD_GET_MAX_NAMES];   // nullptr = unknown name
+    uint8_t  count  = 0;
+    uint16_t repeat = 1;
+
+    bool item(JsonWriter& w, uint32_t n) override {
+        if (n >= (uint32_t)count * repeat) return false;
+        char valBuf[24];
+        w.raw(valBuf, formatCmdValue(valBuf, sizeof(valBuf), params[n % count]));
+        w.raw(' ');
+        return true;
     }
-    if (nameList.empty()) return "";
-
-    String response;
-    response.reserve(nameList.size() * repeat * 8);
-    for (int r = 0; r < repeat; r++) {
-        for (const String& name : nameList) {
-            char valBuf[24];
-            CANParameter* p = can ? can->getParameterByName(name.c_str()) : nullptr;
-            snprintf(valBuf, sizeof(valBuf), "%.2f", p ? (float)p->getValueAsInt() : 0.0f);
-            response += valBuf;
-            response += " ";
+};
+
+AsyncWebServerResponse* WiFiManager::cmdGetResponse(AsyncWebServerRequest* request,
+                                                    const String& names, int repeat,
+                                                    int hz) {
+    std::shared_ptr<CmdGetBody> body = std::make_shared<CmdGetBody>();
+    body->repeat = (uint16_t)repeat;
+
+    // Comma-separated signal names, blanks around each ignored
+    const char* p = names.c_str();
+    while (*p && body->count < CMD_GET_MAX_NAMES) {
+        while (*p == ' ' || *p == ',') p++;
+        const char* end = p;
+        while (*end && *end != ',') end++;
+        const char* last = end;
+        while (last > p && last[-1] == ' ') last--;
+        if (last > p) {
+            char name[sizeof(((CANParameter*)0)->name)];
+            size_t len = last - p;
+            if (len >= sizeof(name)) len = sizeof(name) - 1;
+            memcpy(name, p, len);
+            name[len] = '\0';
+            body->params[body->count++] = can ? can->getParameterByName(name) : nullptr;
         }
+        p = end;
+    }
+
+    if (repeat > 1 && body->count) {
+        std::shared_ptr<SampleBody> series = std::make_shared<SampleBody>(
+            body->params, body->count, (uint16_t)repeat, (uint16_t)hz);
+        AsyncWebServerResponse* resp = JsonStream::begin(request, "text/plain", series);
+        if (CmdSampler::getInstance().add(series)) return resp;
+        delete resp;
+        // Every sampler busy — the old burst of current values beats no plot
+        Serial.println("[WiFi] Get: sampler busy, repeating current values");
     }
-    return response;
+    return JsonStream::begin(request, "text/plain", body);
 }
 
 // ---------------------------------------------------------------------------
@@ -998,7 +1221,8 @@ void WiFiManager::handleValue(AsyncWebServerRequest* request) {
     uint16_t paramId = (uint16_t)request->getParam("id")->value().toInt();
     char valBuf[24];
     CANParameter* p = can ? can->getParameter(paramId) : nullptr;
-    snprintf(valBuf, sizeof(valBuf), "%.2f", p ? (float)p->getValueAsInt() : 0.0f);
+    size_t len = formatCmdValue(valBuf, sizeof(valBuf), p);
+    SpotStream::getInstance().notePoll(SpotStream::Poll::VALUE, len);
     AsyncWebServerResponse* resp = request->beginResponse(200, "text/plain", String(valBuf));
     resp->addHeader("Access-Control-Allow-Origin", "*");
     resp->addHeader("Cache-Control", "no-cache");
@@ -1007,14 +1231,22 @@ void WiFiManager::handleValue(AsyncWebServerRequest* request) {
 
 // ---------------------------------------------------------------------------
 // handleTripLog — GET /log
-// Returns the full trip log as a CSV download (chronological, ring buffer order)
+// Returns the full trip log as a CSV download (chronological, ring buffer order),
+// streamed row by row from NVS. With "Accept: application/msgpack", an array
+// of rows in the CSV's column order instead.
 // ---------------------------------------------------------------------------
 void WiFiManager::handleTripLog(AsyncWebServerRequest* request) {
-    String csv = TripLogger::getInstance().getCSV();
-    AsyncWebServerResponse* resp = request->beginResponse(200, "text/csv", csv);
-    resp->addHeader("Content-Disposition", "attachment; filename=\"trip_log.csv\"");
-    resp->addHeader("Access-Control-Allow-Origin", "*");
-    request->send(resp);
+    ExportSpec spec;
+    bool msgpack = MsgPack::accepted(request);
+    spec.open     = TripLogger::openExport;
+    spec.key      = "triplog";
+    spec.format   = (uint8_t)(msgpack ? TripExport::MSGPACK : TripExport::CSV);
+    spec.version  = TripLogger::getInstance().exportVersion();
+    spec.size     = EXPORT_SIZE_UNKNOWN;
+    spec.mime     = msgpack ? MSGPACK_MIME : "text/csv";
+    spec.fileName = msgpack ? nullptr : "trip_log.csv";
+    spec.vary     = true;
+    StreamExport::send(request, spec);
 }
 
 // ---------------------------------------------------------------------------
@@ -1030,14 +1262,21 @@ void WiFiManager::handleTripLogDelete(AsyncWebServerRequest* request) {
 
 // ---------------------------------------------------------------------------
 // handleFaultLog — GET /faults
-// Returns NVS fault/opmode log as JSON array, newest first
+// Returns NVS fault/opmode log as JSON array, newest first (MessagePack with
+// "Accept: application/msgpack")
 // ---------------------------------------------------------------------------
 void WiFiManager::handleFaultLog(AsyncWebServerRequest* request) {
-    String json = FaultLogger::getInstance().getJSON();
-    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", json);
-    resp->addHeader("Access-Control-Allow-Origin", "*");
-    resp->addHeader("Cache-Control", "no-cache");
-    request->send(resp);
+    ExportSpec spec;
+    bool msgpack = MsgPack::accepted(request);
+    spec.open     = FaultLogger::openExport;
+    spec.key      = "faultlog";
+    spec.format   = (uint8_t)(msgpack ? FaultExport::MSGPACK : FaultExport::JSON);
+    spec.version  = FaultLogger::getInstance().exportVersion();
+    spec.size     = EXPORT_SIZE_UNKNOWN;
+    spec.mime     = msgpack ? MSGPACK_MIME : "application/json";
+    spec.fileName = nullptr;
+    spec.vary     = true;
+    StreamExport::send(request, spec);
 }
 
 // ---------------------------------------------------------------------------
@@ -1066,13 +1305,17 @@ void WiFiManager::handleDialSettingsGet(AsyncWebServerRequest* request) {
     uint16_t immobReadId  = prefs.getUShort("immobReadId",  VCU_SPOT_DRIVE_INHIBITED);
     prefs.end();
 
-    String json = "{\"finalDrive\":"   + String(finalDrive, 2) +
-                  ",\"wheelCirc\":"    + String(wheelCirc,  2) +
-                  ",\"screenMask\":"   + String(screenMask)    +
-                  ",\"immobEnabled\":" + String(immobEnabled ? "true" : "false") +
-                  ",\"immobWriteId\":" + String(immobWriteId) +
-                  ",\"immobReadId\":"  + String(immobReadId)  + "}";
-    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", json);
+    char buf[160];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.key("finalDrive");   w.valueFloat(finalDrive, 2);
+    w.key("wheelCirc");    w.valueFloat(wheelCirc, 2);
+    w.key("screenMask");   w.valueUint(screenMask);
+    w.key("immobEnabled"); w.valueBool(immobEnabled);
+    w.key("immobWriteId"); w.valueUint(immobWriteId);
+    w.key("immobReadId");  w.valueUint(immobReadId);
+    w.endObject();
+    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", w.c_str());
     resp->addHeader("Access-Control-Allow-Origin", "*");
     request->send(resp);
 }
@@ -1175,27 +1418,67 @@ void WiFiManager::handleDialSettingsPost(AsyncWebServerRequest* request,
 
 // ---------------------------------------------------------------------------
 // handleSpot — build live values JSON purely from in-memory parameter cache
-// No SPIFFS, no deserialization — just loop over parameters[] array
+// No filesystem, no deserialization — just loop over parameters[] array.
+// The live fields are copied in one snapshotAll() pass first, so the values,
+// timestamps and stale flags all describe the same instant even while the
+// loop and SDO tasks keep writing. SpotBody then streams them as chunks.
+//
+// Every response carries "_gen", an opaque "<boot salt>-<updateGen>" token,
+// also sent as the ETag. ?since=<token> lists only the values changed or
+// flipped stale/fresh after it; a token from another boot (or a future one)
+// gets the whole set, marked "_full":true. "_stale" is always the complete
+// list. A matching If-None-Match answers 304 before anything is copied.
+// "Accept: application/msgpack" gets the same map in MessagePack.
 // ---------------------------------------------------------------------------
+static uint32_t s_spotSalt = 0;
+
 void WiFiManager::handleSpot(AsyncWebServerRequest* request) {
-    String json = "{";
-    bool first = true;
-    uint16_t count = can->getParameterCount();
-
-    for (uint16_t i = 0; i < count; i++) {
-        CANParameter* p = can->getParameterByIndex(i);
-        if (!p || p->lastUpdateTime == 0) continue;
-
-        if (!first) json += ",";
-        json += "\"";
-        json += p->name;
-        json += "\":";
-        json += p->valueInt;
-        first = false;
+    if (!s_spotSalt) s_spotSalt = esp_random() | 1;
+    // Read before the snapshot — a store stamped while it runs is > gen and
+    // goes out again in the next delta
+    uint32_t gen = CANParameter::updateGen.load(std::memory_order_acquire);
+    char token[24];
+    snprintf(token, sizeof(token), "%08x-%u", (unsigned)s_spotSalt, (unsigned)gen);
+    // One ETag per representation of the same generation
+    bool msgpack = MsgPack::accepted(request);
+    char etag[30];
+    snprintf(etag, sizeof(etag), "\"%s%s\"", token, msgpack ? "m" : "");
+
+    if (request->hasHeader("If-None-Match") &&
+        request->header("If-None-Match") == etag) {
+        SpotStream::getInstance().notePoll(SpotStream::Poll::SPOT, 0);
+        AsyncWebServerResponse* resp = request->beginResponse(304);
+        resp->addHeader("ETag", etag);
+        resp->addHeader("Vary", "Accept");
+        resp->addHeader("Access-Control-Allow-Origin", "*");
+        resp->addHeader("Cache-Control", "no-cache");
+        request->send(resp);
+        return;
     }
-    json += "}";
 
-    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", json);
+    // since — 0 sends everything
+    uint32_t since = 0;
+    bool delta = false;
+    if (request->hasParam("since")) {
+        unsigned salt = 0, g = 0;
+        if (sscanf(request->getParam("since")->value().c_str(), "%x-%u", &salt, &g) == 2 &&
+            salt == s_spotSalt && g <= gen) {
+            since = g;
+            delta = true;
+        }
+    }
+
+    // Rendered into the chunk buffers from this one snapshot — the body is
+    // the handler's only allocation, whatever the number of parameters
+    std::shared_ptr<SpotBody> body = std::make_shared<SpotBody>(
+        can->getParameters(), since, token, request->hasParam("since") && !delta);
+    can->snapshotAll(body->snap, MAX_PARAMETERS, body->count);
+    body->msgpack = msgpack;
+
+    AsyncWebServerResponse* resp = JsonStream::begin(request,
+        msgpack ? MSGPACK_MIME : "application/json", body);
+    resp->addHeader("ETag", etag);
+    resp->addHeader("Vary", "Accept");
     resp->addHeader("Access-Control-Allow-Origin", "*");
     resp->addHeader("Cache-Control", "no-cache");
     request->send(resp);
@@ -1207,20 +1490,22 @@ void WiFiManager::handleSpot(AsyncWebServerRequest* request) {
 // ---------------------------------------------------------------------------
 void WiFiManager::handleHealthSettingsGet(AsyncWebServerRequest* request) {
     HealthChecker& hc = HealthChecker::getInstance();
-    String json = "{";
-    json += "\"failBehav\":"   + String((int)hc.getFailBehaviour())  + ",";
-    json += "\"cdWarn\":"      + String(hc.getCellDeltaWarn(),  1)   + ",";
-    json += "\"cdFail\":"      + String(hc.getCellDeltaFail(),  1)   + ",";
-    json += "\"mcWarn\":"      + String(hc.getMinCellWarn(),    3)   + ",";
-    json += "\"mcFail\":"      + String(hc.getMinCellFail(),    3)   + ",";
-    json += "\"mtWarn\":"      + String(hc.getMotorTempWarn(),  1)   + ",";
-    json += "\"mtFail\":"      + String(hc.getMotorTempFail(),  1)   + ",";
-    json += "\"itWarn\":"      + String(hc.getInvTempWarn(),    1)   + ",";
-    json += "\"itFail\":"      + String(hc.getInvTempFail(),    1)   + ",";
-    json += "\"pvWarn\":"      + String(hc.getPackVoltWarn(),   1)   + ",";
-    json += "\"pvFail\":"      + String(hc.getPackVoltFail(),   1);
-    json += "}";
-    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", json);
+    char buf[256];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.key("failBehav"); w.valueInt((int)hc.getFailBehaviour());
+    w.key("cdWarn");    w.valueFloat(hc.getCellDeltaWarn(),  1);
+    w.key("cdFail");    w.valueFloat(hc.getCellDeltaFail(),  1);
+    w.key("mcWarn");    w.valueFloat(hc.getMinCellWarn(),    3);
+    w.key("mcFail");    w.valueFloat(hc.getMinCellFail(),    3);
+    w.key("mtWarn");    w.valueFloat(hc.getMotorTempWarn(),  1);
+    w.key("mtFail");    w.valueFloat(hc.getMotorTempFail(),  1);
+    w.key("itWarn");    w.valueFloat(hc.getInvTempWarn(),    1);
+    w.key("itFail");    w.valueFloat(hc.getInvTempFail(),    1);
+    w.key("pvWarn");    w.valueFloat(hc.getPackVoltWarn(),   1);
+    w.key("pvFail");    w.valueFloat(hc.getPackVoltFail(),   1);
+    w.endObject();
+    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", w.c_str());
     resp->addHeader("Access-Control-Allow-Origin", "*");
     request->send(resp);
 }
@@ -1277,6 +1562,141 @@ void WiFiManager::handleHealthSettingsPost(AsyncWebServerRequest* request,
     Serial.println("[WiFi] Health settings updated and saved");
 }
 
+// ---------------------------------------------------------------------------
+// handleBMS — GET /bms
+// Pack statistics are maintained incrementally by BMSCells; this only reads
+// them. "cells" is [[mV, slope 0.1mV/min], ...] indexed by cell number,
+// streamed one cell per item.
+// ---------------------------------------------------------------------------
+class BMSBody : public JsonBody {
+public:
+    explicit BMSBody(BMSCells& bms) : _bms(bms), _s(bms.getStats()), _n(bms.getCellCount()) {}
+
+    bool item(JsonWriter& w, uint32_t n) override {
+        if (n == 0) {
+            w.beginObject();
+            w.key("count");  w.valueUint(_s.count);
+            w.key("min");    w.valueUint(_s.minMv);
+            w.key("minIdx"); w.valueUint(_s.minIdx);
+            w.key("max");    w.valueUint(_s.maxMv);
+            w.key("maxIdx"); w.valueUint(_s.maxIdx);
+            w.key("delta");  w.valueUint(_s.deltaMv);
+            return true;
+        }
+        if (n == 1) {
+            w.key("mean");      w.valueFixed(_s.meanDmv,   1);
+            w.key("stddev");    w.valueFixed(_s.stddevDmv, 1);
+            w.key("meanSlope"); w.valueFixed(_s.meanSlope, 1);
+            w.key("cells");
+            w.beginArray();
+            return true;
+        }
+        n -= 2;
+        if (n < _n) {
+            w.beginArray();
+            w.valueUint(_bms.getVoltage(n));
+            w.valueFixed(_bms.getSlope(n), 1);
+            w.endArray();
+            return true;
+        }
+        if (n == _n) {
+            w.endArray();
+            w.endObject();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    BMSCells& _bms;
+    BMSStats  _s;
+    uint16_t  _n;
+};
+
+void WiFiManager::handleBMS(AsyncWebServerRequest* request) {
+    AsyncWebServerResponse* resp = JsonStream::begin(request, "application/json",
+        std::make_shared<BMSBody>(can->getBMSCells()));
+    resp->addHeader("Access-Control-Allow-Origin", "*");
+    resp->addHeader("Cache-Control", "no-cache");
+    request->send(resp);
+}
+
+// ---------------------------------------------------------------------------
+// handleBMSSettingsGet — GET /bms-settings
+// ---------------------------------------------------------------------------
+void WiFiManager::handleBMSSettingsGet(AsyncWebServerRequest* request) {
+    const BMSLayout& l = can->getBMSCells().getLayout();
+    char buf[96 + BMS_MAX_RANGES * 48];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.key("type"); w.valueUint((uint8_t)l.type);
+    w.key("cpf");  w.valueUint(l.cellsPerFrame);
+    w.key("be");   w.valueUint(l.bigEndian ? 1 : 0);
+    w.key("ranges");
+    w.beginArray();
+    for (uint8_t r = 0; r < l.rangeCount; r++) {
+        w.beginObject();
+        w.key("base");   w.valueUint(l.ranges[r].baseId);
+        w.key("frames"); w.valueUint(l.ranges[r].frames);
+        w.key("first");  w.valueUint(l.ranges[r].firstCell);
+        w.endObject();
+    }
+    w.endArray();
+    w.key("maxCells"); w.valueUint(BMS_MAX_CELLS);
+    w.endObject();
+    AsyncWebServerResponse* resp = request->beginResponse(200, "application/json", w.c_str());
+    resp->addHeader("Access-Control-Allow-Origin", "*");
+    request->send(resp);
+}
+
+// ---------------------------------------------------------------------------
+// handleBMSSettingsPost — POST /bms-settings
+// Body: {"type":1,"cpf":4,"be":0,"ranges":[{"base":1024,"frames":48,"first":0}]}
+// Applied on the CAN task (BMSCells::applyPending) so cell arrays are never
+// reset underneath a frame being decoded. Runs once the whole body has been
+// collected; a body that is missing, too large or not JSON gets a 400.
+// ---------------------------------------------------------------------------
+void WiFiManager::handleBMSSettingsPost(AsyncWebServerRequest* request) {
+    const char* body = (const char*)request->_tempObject;
+    if (!body) {
+        request->send(400, "application/json", "{\"ok\":false,\"error\":\"missing or oversized body\"}");
+        return;
+    }
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, body);
+    if (err || !doc.is<JsonObject>()) {
+        Serial.printf("[WiFi] BMS settings: bad JSON (%s)\n", err ? err.c_str() : "not an object");
+        char buf[96];
+        JsonWriter w(buf, sizeof(buf));
+        w.beginObject();
+        w.key("ok");    w.valueBool(false);
+        w.key("error"); w.valueString(err ? err.c_str() : "expected a JSON object");
+        w.endObject();
+        request->send(400, "application/json", w.c_str());
+        return;
+    }
+
+    BMSCells& bms = can->getBMSCells();
+    BMSLayout l = bms.getLayout();
+    l.type          = (BMSType)(doc["type"] | (int)l.type);
+    l.cellsPerFrame = doc["cpf"] | l.cellsPerFrame;
+    l.bigEndian     = (doc["be"] | (l.bigEndian ? 1 : 0)) != 0;
+    if (doc["ranges"].is<JsonArray>()) {
+        l.rangeCount = 0;
+        for (JsonObject r : doc["ranges"].as<JsonArray>()) {
+            if (l.rangeCount >= BMS_MAX_RANGES) break;
+            BMSRange& rg = l.ranges[l.rangeCount++];
+            rg.baseId    = r["base"]   | 0;
+            rg.frames    = r["frames"] | 0;
+            rg.firstCell = r["first"]  | 0;
+        }
+    }
+    bms.requestLayout(l);
+
+    Serial.println("[WiFi] BMS layout update queued");
+    request->send(200, "text/plain", "ok");
+}
+
 // ---------------------------------------------------------------------------
 // Logo upload state — lives for the duration of one POST request
 // ---------------------------------------------------------------------------
@@ -1293,8 +1713,8 @@ void WiFiManager::handleLogoUpload(AsyncWebServerRequest* request,
 // handleLogoDelete — DELETE /delete-logo
 // ---------------------------------------------------------------------------
 void WiFiManager::handleLogoDelete(AsyncWebServerRequest* request) {
-    if (SPIFFS.exists("/logo.bin")) {
-        SPIFFS.remove("/logo.bin");
+    if (Storage::fs().exists("/logo.bin")) {
+        Storage::fs().remove("/logo.bin");
         logoReloadRequested = true;   // clears live widget via main.cpp → reloadLogo()
         Serial.println("[LOGO] /logo.bin deleted");
         AsyncWebServerResponse* resp = request->beginResponse(200, "application/json",
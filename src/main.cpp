@@ -1,5 +1,6 @@
 #include <Arduino.h>
-#include <SPIFFS.h>
+#include "Storage.h"
+#include "MsgPack.h"
 #include <Preferences.h>
 #include "Config.h"
 #include "Hardware.h"
@@ -9,9 +10,10 @@
 #include "UIManager.h"
 #include "WiFiManager.h"
 #include "TripLogger.h"
-#include "GVRETServer.h"
 #include "FaultLogger.h"
 #include "HealthChecker.h"
+#include "FlightRecorder.h"
+#include "FrameHistory.h"
 #include "EfficiencyTracker.h"
 #include "Immobilizer.h"
 #include "SDOManager.h"
@@ -35,7 +37,7 @@ uint32_t lastParamRequestTime = 0;
 uint8_t currentParamIndex = 0;
 uint8_t lastOpmode = 255;  // opmode change detection (255 = uninitialised)
 
-// Fallback parameters — used only if SPIFFS params.json is missing or corrupt.
+// Fallback parameters — used only if the cached params.json is missing or corrupt.
 const char* sampleParams = R"(
 {
   "parameters": [
@@ -64,6 +66,9 @@ const char* sampleParams = R"(
 // ============================================================================
 
 void onSDOResult(const SDOResult& result) {
+    // Tagged results come from a web request (/cmd set, save, load …): the
+    // write is applied there, then the result goes the usual way as well
+    if (result.tag) wifiManager.onSDOResult(result);
     // Immobilizer owns param 156 (DriveInhibit write) and spot 2124 (DriveInhibited read)
     if (result.paramId == VCU_PARAM_DRIVE_INHIBIT ||
         result.paramId == VCU_SPOT_DRIVE_INHIBITED) {
@@ -74,6 +79,33 @@ void onSDOResult(const SDOResult& result) {
     canManager.onSDOResult(result);
 }
 
+// ============================================================================
+// Opmode change subscription — auto-switch screens and log transitions.
+// Delivered by canManager.dispatchChanges() only when opmode actually moves.
+// ============================================================================
+
+void onOpmodeChange(const ParamChange* changes, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t opmode = (uint8_t)changes[i].param->getValueAsInt();
+        if (opmode == lastOpmode) continue;
+
+        FaultLogger::getInstance().logOpmodeChange(opmode);
+
+        if (opmode == 3) {
+            // Entered charge mode
+            EfficiencyTracker::getInstance().startChargeSession();
+            uiManager.setScreen(SCREEN_CHARGING);
+            Serial.println("[Main] Charge mode detected — switching to charging screen");
+        } else if (lastOpmode == 3) {
+            // Left charge mode
+            EfficiencyTracker::getInstance().endChargeSession();
+            uiManager.setScreen(SCREEN_DASHBOARD);
+            Serial.println("[Main] Charge mode ended — returning to dashboard");
+        }
+        lastOpmode = opmode;
+    }
+}
+
 // ============================================================================
 // WiFi mode helpers
 // ============================================================================
@@ -293,7 +325,9 @@ void onButtonDoubleClick() {
 }
 
 void onButtonTripleClick() {
-    // Reserved for future use
+    // Manual flight-recorder capture — the last few seconds of CAN traffic
+    FlightRecorder::getInstance().trigger(FlightTrigger::BUTTON);
+    if (!wifiMode) uiManager.showSuccess("CAN capture\ntriggered");
 }
 
 void onButtonLongPress() {
@@ -440,7 +474,7 @@ void setup() {
     Serial.println("Hardware initialized");
     #endif
 
-    SPIFFS.begin(true);  // Must be before uiManager.init so /logo.bin is visible at splash creation
+    Storage::begin();  // Must be before uiManager.init so /logo.bin is visible at splash creation
 
     uiManager.init(&canManager, &immobilizer);
     uiManager.setVersionInfo(DIAL_FW_VERSION, UI_VERSION);
@@ -482,6 +516,9 @@ void setup() {
     Serial.println("WiFi manager initialized");
     #endif
 
+    // Frame history — every received frame, read by the monitor and the
+    // flight recorder
+    FrameHistory::getInstance().begin();
     CANMonitor::instance().init(&canManager);
 
     wifiMode = false;
@@ -490,7 +527,7 @@ void setup() {
     // -----------------------------------------------------------------------
     // Parameter loading — try in order:
     //   1. Fetch live from VCU via SDO (always up to date)
-    //   2. Load from SPIFFS params.json (cached from previous fetch)
+    //   2. Load from the cached params.json (cached from previous fetch)
     //   3. Keep sample params (basic functionality only)
     // -----------------------------------------------------------------------
     bool paramsLoaded = false;
@@ -507,24 +544,27 @@ void setup() {
         paramsLoaded = true;
         uiManager.showFetchStatus("VCU params loaded!");
     } else {
-        Serial.printf("VCU fetch failed (%d), trying SPIFFS...\n", (int)fetchResult);
+        Serial.printf("VCU fetch failed (%d), trying flash...\n", (int)fetchResult);
         uiManager.showFetchStatus("VCU unavailable\nLoading cached...");
 
-        if (SPIFFS.exists("/params.json")) {
-            File paramFile = SPIFFS.open("/params.json", "r");
+        if (Storage::fs().exists("/params.json")) {
+            File paramFile = Storage::fs().open("/params.json", "r");
             if (paramFile) {
                 size_t fileSize = paramFile.size();
                 if (fileSize > 0 && fileSize < MAX_JSON_SIZE) {
                     String jsonContent = paramFile.readString();
                     paramFile.close();
                     if (canManager.loadParametersFromJSON(jsonContent.c_str())) {
-                        Serial.printf("Loaded %d parameters from SPIFFS\n", canManager.getParameterCount());
+                        Serial.printf("Loaded %d parameters from flash\n", canManager.getParameterCount());
+                        // Cached by an older firmware, before there was a MessagePack copy
+                        if (!Storage::fs().exists(PARAMS_MSGPACK_PATH))
+                            CANDataManager::saveParamsMsgPack(jsonContent.c_str(), jsonContent.length());
                         paramsLoaded = true;
                         uiManager.showFetchStatus("Cached params\nloaded OK");
                     }
                 } else {
                     paramFile.close();
-                    SPIFFS.remove("/params.json");
+                    Storage::fs().remove("/params.json");
                 }
             }
         }
@@ -593,6 +633,9 @@ void setup() {
     // Health checker — wired to canManager for SDO polling
     HealthChecker::getInstance().begin(&canManager);
 
+    // Flight recorder — dumps the frame history around fault triggers
+    FlightRecorder::getInstance().begin(&canManager);
+
     // Efficiency tracker — load saved drive params from NVS
     {
         Preferences prefs;
@@ -606,11 +649,9 @@ void setup() {
                       finalDrive, wheelCirc);
     }
 
-    // Register GVRET bridge as CAN frame observer — pushes every frame to
-    // connected SavvyCAN clients in real time when WiFi AP is active
-    canManager.setFrameObserver([](uint32_t id, bool extd, const uint8_t* data, uint8_t dlc) {
-        GVRETServer::getInstance().pushFrame(id, extd, data, dlc);
-    });
+    // Opmode drives screen switching and fault logging — subscribe rather
+    // than re-reading it every loop
+    canManager.watch(canManager.subscribe(onOpmodeChange), "opmode");
 
     // Brief pause so user can see the status message
     for (int i = 0; i < 100; i++) { lv_timer_handler(); delay(10); }
@@ -639,6 +680,7 @@ void setup() {
     Serial.println("  Rotate: Switch screens");
     Serial.println("  Click: Toggle WiFi mode");
     Serial.println("  Double-click: (Reserved)");
+    Serial.println("  Triple-click: CAN flight-recorder capture");
     Serial.println("  Long-press: Back to Dashboard");
     Serial.println("====================================");
     Serial.println("WiFi Mode:");
@@ -740,9 +782,9 @@ void loop() {
 
         TripLogger::getInstance().update(
             spd  ? spd->getValueAsInt()              : 0,   // speed_rpm
-            udc  ? (int)(udc->getValueAsInt() * 10)  : 0,   // udc_dv  (V × 10)
-            idc  ? (int)(idc->getValueAsInt() * 10)  : 0,   // idc_da  (A × 10)
-            pwr  ? (int)(pwr->getValueAsInt() * 100) : 0,   // pwr_dkw (kW × 100)
+            udc  ? FixedPoint::rescale(udc->getValueFixed(), udc->getDecimals(), 1) : 0,  // udc_dv  (V × 10)
+            idc  ? FixedPoint::rescale(idc->getValueFixed(), idc->getDecimals(), 1) : 0,  // idc_da  (A × 10)
+            pwr  ? FixedPoint::rescale(pwr->getValueFixed(), pwr->getDecimals(), 2) : 0,  // pwr_dkw (kW × 100)
             soc  ? soc->getValueAsInt()              : 0,   // soc_pct
             ths  ? ths->getValueAsInt()              : 0,   // tmphs_c
             tm   ? tm->getValueAsInt()               : 0,   // tmpm_c
@@ -750,29 +792,8 @@ void loop() {
         );
     }
 
-    // Opmode change detection — auto-switch screens and log transitions
-    {
-        CANParameter* p = canManager.getParameterByName("opmode");
-        if (p) {
-            uint8_t opmode = (uint8_t)p->getValueAsInt();
-            if (opmode != lastOpmode) {
-                FaultLogger::getInstance().logOpmodeChange(opmode);
-
-                if (opmode == 3) {
-                    // Entered charge mode
-                    EfficiencyTracker::getInstance().startChargeSession();
-                    uiManager.setScreen(SCREEN_CHARGING);
-                    Serial.println("[Main] Charge mode detected — switching to charging screen");
-                } else if (lastOpmode == 3) {
-                    // Left charge mode
-                    EfficiencyTracker::getInstance().endChargeSession();
-                    uiManager.setScreen(SCREEN_DASHBOARD);
-                    Serial.println("[Main] Charge mode ended — returning to dashboard");
-                }
-                lastOpmode = opmode;
-            }
-        }
-    }
+    // Deliver batched parameter changes — opmode screen switching, UI labels
+    canManager.dispatchChanges();
 
     // Health checker update — drives async SDO poll sequence
     HealthChecker::getInstance().update();